@@ -0,0 +1,177 @@
+#ifndef __ACTUATION_H__
+#define __ACTUATION_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Include FreeRTOS common header
+#include "freertos/FreeRTOS.h"
+// Include FreeRTOS task API
+#include "freertos/task.h"
+// Include FreeRTOS semaphore API
+#include "freeRTOS/semphr.h"
+
+// This queues requests to actuate (ex. squirt) in front of one actuator, so the menu, TCP, and the watering loop
+// can all ask for it at once, and it is run by one executor at a time in a set order, at a safe pace.
+// Each request says where it came from, how urgent it is, and how much it wants (ex. microlitres of water), the executor
+// decides how many actuations that takes.
+// A request from a source that already has one waiting is merged into it, it asks for the larger amount of the two,
+// so asking again before the first was served (ex. pressing "Test dose" twice) does not actuate twice as much.
+// Waiting requests are run most urgent first, then oldest first, one whole request at a time.
+// Actuations are spaced at least a set gap apart, and capped at a set number per hour, past either the executor waits,
+// the requests stay queued until then.
+// Counters are kept of what was queued, merged, dropped, and done, and how long requests took, see: actuation_stats_t
+
+// Define the most requests queued at once, one waiting per source, plus the one being run
+#define ACTUATION_QUEUE_LENGTH (ACTUATION_SOURCE_MAX + 1)
+// Define the number of tasks that can wait on requests at once, extra waiters check back every ACTUATION_MS_WAIT_POLL
+#define ACTUATION_MAX_WAITERS 4
+#define ACTUATION_MS_WAIT_POLL 50
+// Define the highest per-hour cap, the times of this many actuations are kept to enforce it
+#define ACTUATION_MAX_PER_HOUR_LIMIT 120
+// Define the window, in seconds, the per-hour cap counts actuations over
+#define ACTUATION_S_CAP_WINDOW (60 * 60)
+
+// Where a request came from
+enum ACTUATION_SOURCE_t : uint8_t
+{
+    // The menu, ex. "Test dose"
+    ACTUATION_SOURCE_MENU = 0,
+    // A TCP command
+    ACTUATION_SOURCE_TCP,
+    // Watering, see: Context::step_water
+    ACTUATION_SOURCE_WATER,
+    ACTUATION_SOURCE_MAX
+};
+
+// How urgent a request is, waiting requests are run highest first
+enum ACTUATION_PRIORITY_t : uint8_t
+{
+    ACTUATION_PRIORITY_LOW = 0,
+    ACTUATION_PRIORITY_NORMAL,
+    // Someone is watching for it, ex. a test from the menu
+    ACTUATION_PRIORITY_HIGH,
+    ACTUATION_PRIORITY_MAX
+};
+
+// A queued request
+typedef struct actuation_request_s {
+    // Tickets count up from 1, 0 marks an unused slot
+    uint32_t ticket;
+    ACTUATION_SOURCE_t source;
+    ACTUATION_PRIORITY_t priority;
+    // Whether the executor started on it, requests are only merged into before then
+    bool is_running;
+    // How much is asked for, in whatever unit the executor works in (ex. microlitres of water)
+    uint32_t amount;
+    // When it was queued, from esp_timer_get_time
+    int64_t us_queued;
+} actuation_request_t;
+
+// How requests have been handled, to tell how much the actuator can deliver under contention
+typedef struct actuation_stats_s {
+    // The number of requests from each source, whether queued, merged, or dropped
+    uint32_t num_requests[ACTUATION_SOURCE_MAX];
+    // The number of requests that were queued on their own
+    uint32_t num_queued;
+    // The number of requests merged into one already waiting from the same source
+    uint32_t num_merged;
+    // The number of requests dropped because the queue was full
+    uint32_t num_dropped;
+    // The number of requests cancelled before the executor started on them
+    uint32_t num_cancelled;
+    // The number of queued requests done
+    uint32_t num_done;
+    // The number of actuations done, and how many of them waited for the gap or the per-hour cap first
+    uint32_t num_actuations;
+    uint32_t num_deferred;
+    // The time, in microseconds, from being queued until the last actuation finished, of the last request done, the slowest, and all of them
+    uint32_t us_last_latency;
+    uint32_t us_max_latency;
+    uint64_t us_latencies;
+} actuation_stats_t;
+
+// A queue of requests to actuate one actuator, run by one executor at a time
+class ActuationQueue
+{
+    public:
+        // Constructor
+        ActuationQueue();
+        // Set up the queue to space actuations at least ms_min_gap apart, and allow at most max_per_hour of them per hour
+        // max_per_hour is capped at ACTUATION_MAX_PER_HOUR_LIMIT, 0 turns the cap off
+        void init(
+            uint32_t ms_min_gap,
+            uint32_t max_per_hour);
+        // Set the semaphore given whenever a request is queued, the tasks taking it should run start_next, until it returns false
+        // A semaphore, instead of a task, lets a pool of tasks run many queues, see: ZoneScheduler
+        void set_executor(SemaphoreHandle_t semaphore_handle);
+
+        // Ask for amount from source, merging into the request already waiting from source, if there is one, which then asks for the larger amount
+        // Returns the ticket of the request this joined, pass it to wait to wait for it to finish, 0 if it was dropped
+        uint32_t request(
+            ACTUATION_SOURCE_t source,
+            ACTUATION_PRIORITY_t priority,
+            uint32_t amount);
+        // Wait up to ticks_to_wait for the request with ticket to finish
+        // Returns whether it finished
+        bool wait(
+            uint32_t ticket,
+            TickType_t ticks_to_wait);
+        // Get whether the request with ticket finished (or was never queued), without waiting, for tasks that can't block on it
+        bool is_done(uint32_t ticket);
+        // Take the request with ticket off the queue, if the executor has not started on it, and wake everyone waiting on it
+        // Returns false if it already finished, or the executor started on it, then it runs until it finishes
+        bool cancel(uint32_t ticket);
+
+        // Executor functions //
+
+        // Start on the most urgent waiting request, oldest first, copying it into out_request
+        // Returns false if nothing is waiting
+        bool start_next(actuation_request_t *out_request);
+        // Get the number of ticks until the gap and the per-hour cap allow the next actuation, 0 if they allow it now
+        TickType_t get_ticks_until_allowed();
+        // Count an actuation that just finished, is_deferred if it waited for get_ticks_until_allowed first
+        void record_actuation(bool is_deferred);
+        // Mark request done, and wake everyone waiting on it
+        void finish(const actuation_request_t *request);
+
+        // Copy how requests have been handled into out_stats
+        void get_stats(actuation_stats_t *out_stats);
+
+    private:
+        // Find the slot of the request with ticket, nullptr if it is done (or was never queued)
+        actuation_request_t *find(uint32_t ticket);
+        // Stop everyone waiting on ticket from waiting, copying their task handles into out_task_handles, must hold the mutex
+        void take_waiters(
+            uint32_t ticket,
+            TaskHandle_t *out_task_handles);
+        // Wake the tasks taken by take_waiters, outside the lock, so they can take it straight away
+        void wake_waiters(const TaskHandle_t *task_handles);
+
+        SemaphoreHandle_t mutex_handle;
+        StaticSemaphore_t mutex_buffer;
+        // Given whenever a request is queued, see: set_executor
+        SemaphoreHandle_t executor_semaphore_handle;
+        // The queued requests, in no order
+        actuation_request_t requests[ACTUATION_QUEUE_LENGTH];
+        // The ticket of the last request queued
+        uint32_t ticket_last;
+        // The tasks waiting for a request to finish, and the ticket each is waiting for
+        TaskHandle_t waiter_task_handles[ACTUATION_MAX_WAITERS];
+        uint32_t waiter_tickets[ACTUATION_MAX_WAITERS];
+
+        // The least time, in microseconds, between the end of one actuation and the start of the next
+        int64_t us_min_gap;
+        // The most actuations in any ACTUATION_S_CAP_WINDOW, 0 if there is no cap
+        uint32_t max_per_hour;
+        // When the last actuation finished, from esp_timer_get_time
+        int64_t us_last_actuation;
+        // When the most recent actuations finished, in seconds since boot, oldest overwritten first
+        uint32_t s_actuations[ACTUATION_MAX_PER_HOUR_LIMIT];
+        size_t actuation_index;
+
+        // How requests have been handled
+        actuation_stats_t stats;
+};
+
+#endif // __ACTUATION_H__
\ No newline at end of file
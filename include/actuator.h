@@ -0,0 +1,110 @@
+#ifndef __ACTUATOR_H__
+#define __ACTUATOR_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Include custom servo motor API
+#include "servo.h"
+// Include custom pump API
+#include "pump.h"
+// Include custom lock-free snapshot API
+#include "seqlock.h"
+
+// This is what waters a pot, whichever kind it is, so water can be asked for as a volume:
+// - A servo squeezing a spray bottle's trigger, every squirt delivers about the same volume, and a dose is a whole number of squirts
+// - A pump, or a solenoid valve on a raised reservoir, delivers water for as long as it runs, at a steady flow rate,
+//   so a dose is however long delivers the volume asked for, and is exact once the flow rate is calibrated
+// Each kind is calibrated by its rate, in microlitres per unit, a unit being one squirt, or one second of running.
+// To calibrate, run ACTUATOR_NUM_CALIBRATION_UNITS units into a measuring cup, then set the rate to what was collected over that.
+
+// Define the number of units (squirts, or seconds of running) a calibration run is
+#define ACTUATOR_NUM_CALIBRATION_UNITS 10
+// Define the lowest and highest rate, in microlitres per unit
+#define ACTUATOR_MIN_UL_PER_UNIT 100
+#define ACTUATOR_MAX_UL_PER_UNIT 100000
+// Define the shortest time, in milliseconds, a pump runs at full power, shorter runs deliver too little to be worth starting it
+#define ACTUATOR_MS_MIN_PUMP_RUN 200
+
+// The kinds of actuator
+enum ACTUATOR_TYPE_t : uint8_t
+{
+    // A servo squeezing a spray bottle's trigger, see: ServoMotor
+    ACTUATOR_TYPE_SERVO = 0,
+    // A pump or solenoid valve, see: Pump
+    ACTUATOR_TYPE_PUMP,
+    ACTUATOR_TYPE_MAX
+};
+
+// How an actuator is wired
+typedef struct actuator_config_s {
+    ACTUATOR_TYPE_t type;
+    // The pin driving the servo's signal, or the pump's MOSFET
+    gpio_num_t pin;
+} actuator_config_t;
+
+// What an actuator has dosed, the volumes are worked out from its rate
+typedef struct actuator_stats_s {
+    // The number of doses since init()
+    uint32_t num_doses;
+    // The volume, in microlitres, of the last dose, and of all of them
+    uint32_t ul_last_dose;
+    uint64_t ul_dosed;
+    // The time, in microseconds, the last dose took
+    uint32_t us_last_dose;
+} actuator_stats_t;
+
+// One servo, pump, or solenoid valve, dosing water by volume
+// Only one task may dose at a time, see: Context::step_actuate
+class Actuator
+{
+    public:
+        // Constructor
+        Actuator();
+        // Set up the actuator config describes, dosing ul_per_unit per squirt, or per second of running
+        // A servo is added to servo_scheduler and squirts as servo_profile describes, a pump runs as pump_profile describes
+        // Returns false if it could not be set up
+        bool init(
+            const actuator_config_t *config,
+            ServoScheduler *servo_scheduler,
+            const servo_profile_t *servo_profile,
+            const pump_profile_t *pump_profile,
+            uint32_t ul_per_unit);
+        // Get the kind of actuator
+        ACTUATOR_TYPE_t get_type();
+        // Get or set the rate, in microlitres per squirt, or per second of running, it is kept between the lowest and highest rates
+        // NOTE: The rate can be set while another task doses, the next dose uses it
+        uint32_t get_ul_per_unit();
+        void set_ul_per_unit(uint32_t ul_per_unit);
+        // Get the smallest volume, in microlitres, one dose delivers, one squirt, or ACTUATOR_MS_MIN_PUMP_RUN of running
+        uint32_t get_ul_min_dose();
+        // Deliver up to ul_wanted in one go, blocking until done, one squirt, or one run of at most PUMP_MS_MAX_RUN
+        // Sets out_ul_dosed to the volume delivered, which may be more than ul_wanted for a servo, a squirt can't be split
+        // Returns false if the actuator did not work as asked, water may still have been delivered
+        bool dose(
+            uint32_t ul_wanted,
+            uint32_t *out_ul_dosed);
+        // Stop between doses, a servo stops being sent pulses, so it does not jitter or draw current
+        void stop();
+        // Copy what has been dosed into out_stats, never blocking
+        void get_stats(actuator_stats_t *out_stats);
+        // Copy how long a servo's squirts have taken into out_stats, all zeros if this is not a servo
+        void get_servo_stats(servo_stats_t *out_stats);
+
+    private:
+        // The kind of actuator, and the rate it doses at
+        ACTUATOR_TYPE_t type;
+        uint32_t ul_per_unit;
+        // For a servo, the scheduler owning it, its index in it, and how it squirts
+        ServoScheduler *servo_scheduler;
+        size_t servo_index;
+        servo_profile_t servo_profile;
+        // For a pump, the pump, and how it runs
+        Pump pump;
+        pump_profile_t pump_profile;
+        // What has been dosed, published after every dose, so it can be read from other tasks without locking
+        actuator_stats_t stats;
+        Seqlock<actuator_stats_t> stats_snapshot;
+};
+
+#endif // __ACTUATOR_H__
\ No newline at end of file
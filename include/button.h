@@ -3,6 +3,8 @@
 
 // Include ESP32 GPIO API
 #include "driver/gpio.h"
+// Include custom button debouncing API
+#include "debounce.h"
 // Include FreeRTOS task handling API
 //#include "freeRTOS/task.h"
 
@@ -22,6 +24,9 @@
 //#define PIN_BUTTON_DOWN_OUT GND
 #define NUM_BUTTONS 4
 
+// Define how often, in microseconds, buttons are sampled while they are settling
+#define BUTTON_US_SAMPLE_PERIOD 1000
+
 // Initialize GPIO buttons and their interrupts
 void init_buttons();
 
@@ -29,44 +34,51 @@ class Button
 {
     public:
         // Constructor for Button
-        Button(bool arg_is_pull_up, uint8_t arg_ms_debounce, gpio_num_t arg_pin_in);
+        Button(
+            bool arg_is_pull_up,
+            uint32_t arg_us_debounce,
+            bool arg_is_repeating,
+            gpio_num_t arg_pin_in,
+            void (*arg_func_on_event)(BUTTON_EVENT_t event, int64_t us_event_time));
         // Configure GPIO pin pin_in to read input from this button
         void register_pin();
-        // Set up this button to have interrupts on either:
-        // - is_pull_up == TRUE, on negative edges, when the state of the button transitions from HIGH (1) to LOW (0)
-        // - is_pull_up == FALSE, on positive edges, when the state of the button transitions from LOW (0) to HIGH (1)
-        // This function will register intr_write_button_press, defined in button.cpp,
-        // its interrupt routine (the function called when an interrupt is received), with pin_in as the argument.
+        // Set up this button to have interrupts on any edge, when the state of the button changes.
+        // This function will register intr_start_button_sampling, defined in button.cpp,
+        // its interrupt routine (the function called when an interrupt is received), with this button as the argument.
         void register_intr();
         // Start listening for this interrupt
         void enable_intr();
         // Stop listening for this interrupt
         void disable_intr();
-        // Determine whether this interrupt is too close to the previous, and is 'static noise', or is not, and is a valid button press.
-        bool is_button_press();
+        // Stop listening for this interrupt, and sample this button every BUTTON_US_SAMPLE_PERIOD until it settles
+        // This is called from an interrupt, so it must stay short
+        void start_sampling();
+        // Sample this button once, call func_on_event if it settled into a new state, or if it is time for it to repeat, see: debounce_sample
+        // Returns whether this button still needs sampling, when it doesn't, its interrupt is enabled again
+        bool sample(int64_t us_current_time);
+        // Get whether this button is being sampled instead of waiting for an interrupt
+        bool get_is_sampling();
 
     private:
-        // Hold the last valid state of this button.
-        bool is_pressed;
+        // Read whether the button is physically held down right now, bouncing or not
+        bool read_is_down();
+
         // Whether the button is pull-up or pull-down.
         // If the button is pull-up, its default state is HIGH (1), and its pressed state is LOW (0).
         // If the button is not pull-up, it is pull-down, and its default state is is LOW (0), and its pressed state is HIGH (1).
         bool is_pull_up;
-        // When a digital button is pressed, it may flicker between HIGH (1) and LOW (0) many times before finally settling into its new state.
-        // For example, with a pull-up button, when you press it, it might alternate between HIGH (1) and LOW (0) several times before staying on LOW.
-        // To not register this flickering 'static noise' as repeated button presses, which it's not,
-        // do not count edges within ms_debouce milliseconds of each other as new button presses.
-        // https://esp32io.com/tutorials/esp32-button-debounce
-        uint8_t ms_debounce;
+        // Whether this button's events are wanted, ex. while asleep, only the sleep button is listened to.
+        volatile bool is_enabled;
+        // Whether this button is being sampled instead of waiting for an interrupt.
+        volatile bool is_sampling;
+        // Where this button is in settling, and repeating while held, its times are in microseconds since the processor started running.
+        // A held repeating button keeps being sampled instead of waiting for an interrupt, so it can time its repeats and see its release.
+        debounce_t debounce;
         // The number of the GPIO pin listening for input from this button.
         gpio_num_t pin_in;
-        // At what time, in milliseconds since the processor started running,
-        // an interrupt for this edge can be considered a valid button press again instead of just 'static noise'.
-        int64_t ms_next_valid_edge;
-        // A mutual exlusion to apply when only one thread should be able to access something at a time.
-        //SemaphoreHandle_t mutex_handle;
-        // A statically allocated buffer for the mutex to live in.
-        //StaticSemaphore_t mutex_buffer;
+        // The function to call when this button settles into a new state.
+        // It is called from the esp_timer task, not an interrupt.
+        void (*func_on_event)(BUTTON_EVENT_t event, int64_t us_event_time);
 };
 
 #endif // __BUTTON_H__
\ No newline at end of file
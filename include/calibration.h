@@ -0,0 +1,111 @@
+#ifndef __CALIBRATION_H__
+#define __CALIBRATION_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// This converts raw soil moisture probe readings into percent volumetric water content (the share of the soil's volume that is water).
+// Raw readings are ADC counts that go DOWN as the soil gets wetter, and where a given count falls depends on the probe,
+// its cable, and the soil, so each probe is calibrated by reading it at two or three known water contents.
+//
+// The probe's reading falls roughly with the inverse of the soil's capacitance, which rises in line with its water content,
+// so equal steps in the reading are smaller steps in water content near dry than near wet. That curve is the same for every
+// probe once stretched between its dry and wet points, so it is worked out once, at compile time, into a small table,
+// and each probe only keeps where its own points fall on it. A third point, in the middle, corrects the curve for
+// probes that do not follow it closely.
+//
+// Converting is all integer math (a multiply and shift to find where a reading falls on the curve, then interpolating
+// the table), so it is cheap enough to run on every sample of a burst. Dividing is only done when calibrating.
+//
+// Percents are kept in fixed point, with 8 fractional bits (256 is 1%), see: CALIBRATION_PERCENT_Q8
+
+// Convert a percent to fixed point with 8 fractional bits, use this on constants, so the float math happens at compile time
+#define CALIBRATION_PERCENT_Q8(PERCENT) ((uint16_t) ((PERCENT) * 256))
+#define CALIBRATION_MAX_PERCENT_Q8 CALIBRATION_PERCENT_Q8(100)
+
+// Define the number of entries in the curve table, covering the curve from the dry point to the wet point in equal steps
+// NOTE: This must be a power of 2, plus 1
+#define CALIBRATION_TABLE_LENGTH 17
+// Define the number of bits of a position along the curve, from 0 at the dry point to 1 << this at the wet point
+// Each step between table entries is split into 1 << (this - log2(CALIBRATION_TABLE_LENGTH - 1)) positions to interpolate
+#define CALIBRATION_POSITION_BITS 12
+// Define the number of bits of a fraction of the way from the dry point's percent to the wet point's, in the table
+#define CALIBRATION_FRACTION_BITS 15
+// Define the raw reading at the wet point over the raw reading at the dry point, for the probe the curve is shaped for
+// The curve bends more the lower this is, a capacitive probe at 11 dB reads about 2900 in dry soil and about 1200 in wet soil
+#define CALIBRATION_CURVE_WET_TO_DRY_RATIO 0.4
+
+// Define the points a probe is calibrated at until it is calibrated, a capacitive probe at 11 dB attenuation
+// Dry is the probe in soil dried out until it stops getting lighter, wet is the probe in soil soaked until water drains out
+#define CALIBRATION_DEFAULT_RAW_DRY 2900
+#define CALIBRATION_DEFAULT_RAW_WET 1200
+// Define the water content of the dry and wet points, most potting mixes hold about half their volume in water once soaked
+#define CALIBRATION_DEFAULT_PERCENT_DRY 0
+#define CALIBRATION_DEFAULT_PERCENT_WET 50
+
+// The points a probe is calibrated at
+enum CALIBRATION_POINT_t : uint8_t
+{
+    // The probe in dry soil
+    CALIBRATION_POINT_DRY = 0,
+    // The probe in soaked soil
+    CALIBRATION_POINT_WET,
+    // The probe in soil between the two, optional
+    CALIBRATION_POINT_MID,
+    CALIBRATION_POINT_MAX
+};
+
+// A raw reading, and the water content it was taken at
+typedef struct calibration_point_s {
+    uint16_t raw;
+    // Percent volumetric water content, in fixed point, see: CALIBRATION_PERCENT_Q8
+    uint16_t percent_q8;
+} calibration_point_t;
+
+// How a probe was calibrated, this is what is kept in NVS
+typedef struct calibration_s {
+    calibration_point_t dry;
+    calibration_point_t wet;
+    // The middle point, only used if is_mid_set, and it falls between the dry and wet points
+    calibration_point_t mid;
+    bool is_mid_set;
+} calibration_t;
+
+// What a calibration_t works out to, so converting only takes integer math
+// Positions along the curve are piecewise linear in the raw reading, through the dry point, the middle point (if set),
+// and the wet point, so the curve passes through every point
+typedef struct calibration_converter_s {
+    // The lowest and highest raw readings converted, readings past them are clamped to them
+    uint16_t raw_min;
+    uint16_t raw_max;
+    // The raw readings where the first and second pieces start
+    uint16_t raws_start[2];
+    // The positions along the curve where the first and second pieces start, and where the second piece ends
+    int32_t positions_start[3];
+    // How far along the curve each piece moves per raw count, with 16 fractional bits, negative if readings fall as it gets wetter
+    int32_t positions_per_raw_q16[2];
+    // The water content at the dry point, and how much wetter the wet point is, in fixed point, see: CALIBRATION_PERCENT_Q8
+    int32_t percent_q8_dry;
+    int32_t percent_q8_span;
+} calibration_converter_t;
+
+// Set calibration to the default points, without a middle point
+void calibration_set_default(calibration_t *calibration);
+// Get the point of calibration, nullptr if point is not one of CALIBRATION_POINT_t
+calibration_point_t *calibration_get_point(
+    calibration_t *calibration,
+    CALIBRATION_POINT_t point);
+// Work out calibration into out_converter, so readings can be converted with calibration_convert
+// Returns false if the dry and wet points are the same reading, or the dry point is not the lower percent,
+// out_converter is then set from the default points
+// A middle point that does not fall between the dry and wet points, in both its reading and percent, is left out
+bool calibration_build(
+    const calibration_t *calibration,
+    calibration_converter_t *out_converter);
+// Convert a raw reading into percent volumetric water content, in fixed point, see: CALIBRATION_PERCENT_Q8
+// Readings past the dry or wet point are clamped to it
+uint16_t calibration_convert(
+    const calibration_converter_t *converter,
+    uint16_t raw);
+
+#endif // __CALIBRATION_H__
\ No newline at end of file
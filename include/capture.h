@@ -0,0 +1,76 @@
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Include FreeRTOS common header
+#include "freertos/FreeRTOS.h"
+// Include FreeRTOS task API
+#include "freertos/task.h"
+
+// Include custom analog sensor API
+#include "sensor.h"
+
+// This captures a sensor at a fixed rate for a bounded window, for diagnosing a misbehaving probe.
+// The sensor's ADC is paced by its own hardware timer and writes samples by DMA, so the rate does not depend on
+// when the capturing task gets to run. Samples are averaged down (decimated) to the asked for rate,
+// and packed into one of two preallocated blocks. Once a block is full, a second task sends it,
+// while the first fills the other block. If the sending task falls behind, samples are dropped, and the
+// next block sent is flagged, capturing never waits on sending.
+// Nothing is allocated from the heap, both tasks and both blocks are statically allocated.
+// Both tasks run at a lower priority than the menu and watering tasks, so they only use time those leave over.
+// NOTE: The sensor can't be read while it is being captured, Sensor::read() fails until the capture is done.
+
+// Define the number of samples in each block
+#define CAPTURE_BLOCK_NUM_SAMPLES 256
+// Define the longest, in milliseconds, a capture can run for
+#define CAPTURE_MS_MAX_WINDOW 5000
+// Define the longest, in milliseconds, to wait for a sensor reading to finish before starting a capture
+#define CAPTURE_MS_START_TIMEOUT 1000
+// Define the bytes every block starts with, "SQ" in ASCII, so a reader can find blocks in the stream
+#define CAPTURE_BLOCK_MAGIC 0x5153
+// Define capture_block_header_t flags
+// This is the last block of the capture
+#define CAPTURE_BLOCK_FLAG_LAST 0x01
+// Samples were dropped right before this block, because sending fell behind or the ADC's buffer overran
+#define CAPTURE_BLOCK_FLAG_DROPPED 0x02
+
+// The header of a block of captured samples, sent as is, little-endian
+typedef struct __attribute__((packed)) capture_block_header_s {
+    // Always CAPTURE_BLOCK_MAGIC
+    uint16_t magic;
+    // Counts up from 0 for every block of a capture, a gap means blocks were lost
+    uint16_t sequence;
+    // The number of samples after this header
+    uint16_t num_samples;
+    // CAPTURE_BLOCK_FLAG_* ORed together
+    uint16_t flags;
+    // The rate, in Hz, the samples were taken at
+    uint32_t sample_hz;
+} capture_block_header_t;
+
+// A block of captured samples, only the first header.num_samples samples are sent
+typedef struct __attribute__((packed)) capture_block_s {
+    capture_block_header_t header;
+    // The raw ADC values, from 0 to 4095, oldest first
+    uint16_t samples[CAPTURE_BLOCK_NUM_SAMPLES];
+} capture_block_t;
+
+// Start capturing the pin at index of sensor for ms_window (up to CAPTURE_MS_MAX_WINDOW), averaging every decimation samples into one,
+// so samples are taken at sensor->get_channel_sample_hz() / decimation, and sending every block with func_send_block
+// func_send_block is called from the sending task, and may block
+// Returns false if a capture is already running, or index is not one of the sensor's pins, the capture itself runs in the background
+bool capture_start(
+    Sensor *sensor,
+    size_t index,
+    uint32_t ms_window,
+    uint32_t decimation,
+    bool (*func_send_block)(const void *block, size_t num_block_bytes));
+
+// Define a task for capturing samples into blocks, started by capture_start
+void task_capture(void *parameters);
+// Define a task for sending blocks as they fill up, so capturing never waits on sending
+void task_send_capture(void *parameters);
+
+#endif // __CAPTURE_H__
\ No newline at end of file
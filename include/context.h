@@ -1,27 +1,57 @@
 #ifndef __CONTEXT_H__
 #define __CONTEXT_H__
 
-// Include Arduino-like servo motor API
-#include <ESP32Servo.h>
 // Include FreeRTOS common header
 #include "freertos/FreeRTOS.h"
 // Include FreeRTOS task API
 #include "freertos/task.h"
 // Include FreeRTOS task handling API
 #include "freeRTOS/semphr.h"
+// Include FreeRTOS software timer API
+#include "freertos/timers.h"
 
 // Include custom Menu class implementation
 #include "menu.h"
 // Include custom storage API
 #include "storage.h"
+// Include custom lock-free snapshot API
+#include "seqlock.h"
+// Include custom analog sensor API
+#include "sensor.h"
+// Include custom sensor capture API
+#include "capture.h"
+// Include custom soil moisture calibration API
+#include "calibration.h"
+// Include custom watering model API
+#include "watering.h"
+// Include custom actuator API
+#include "actuator.h"
+// Include custom actuation queue API
+#include "actuation.h"
+// Include custom zone scheduler API
+#include "zones.h"
+// Include custom debug macros and compile flags
+#include "flags.h"
 
 // Define what pins are mapped to what peripherals
 //#define PIN_SERVO_NEG GND
 //#define PIN_SERVO_POS VIN
 #define PIN_SERVO_OUT ((gpio_num_t) GPIO_NUM_33)
+// A pump or solenoid valve can water a pot instead of a servo, through a logic-level MOSFET switched by this pin,
+// see: zone_configs in menu.cpp
+#define PIN_PUMP_OUT ((gpio_num_t) GPIO_NUM_26)
 //#define PIN_SOIL_MOISTURE_SENSOR_NEG GND
 //#define PIN_SOIL_MOISTURE_SENSOR_POS VIN
 #define PIN_SOIL_MOISTURE_SENSOR_IN ((gpio_num_t) GPIO_NUM_35)
+// More probes, for large pots or more zones, go on other ADC1 pins (GPIO 32 to 39), see: zone_configs in menu.cpp
+// Power the soil moisture sensor from this pin (directly, or through a transistor switched by it), instead of VIN,
+// so it is only powered around readings, set it to GPIO_NUM_NC if the sensor is wired to VIN
+#define PIN_SOIL_MOISTURE_SENSOR_POWER_OUT ((gpio_num_t) GPIO_NUM_25)
+
+// Define how many servos sharing the 5 V supply may move at once, and the least time, in milliseconds, between their moves starting,
+// see: ServoScheduler. A hobby servo can draw most of an amp starting to move under load, lower this if the board resets when several move.
+#define CONTEXT_MAX_SERVOS_MOVING 2
+#define CONTEXT_MS_SERVO_STAGGER 50
 
 // Create macros to avoid erroneous/annoying copy/paste
 // Take the Context sempahore to prevent miscellaneous reads and writes from other threads
@@ -30,19 +60,256 @@
 // Return mutex so other threads can read and write to context members again
 #define CONTEXT_UNLOCK() xSemaphoreGive(/* xSemaphore = */ mutex_handle);
 
+// Define how the soil moisture sensor is read, see: Sensor
+// Define the number of samples reduced into each reading, about 3 milliseconds of samples at SENSOR_SAMPLE_FREQ_HZ
+#define CONTEXT_SOIL_MOISTURE_NUM_SAMPLES 64
+// Define how the samples are reduced
+#define CONTEXT_SOIL_MOISTURE_REDUCTION SENSOR_REDUCTION_MEDIAN
+// Define how long, in milliseconds, the sensor takes to give steady readings after being powered on
+#define CONTEXT_MS_SOIL_MOISTURE_SENSOR_WARM_UP 200
+
+// Define how readings from many soil moisture probes in one pot are fused into one, see: soil_moisture_probe_t
+// Define the most probes a Context can read, their calibrations are kept in NVS as one blob of this many,
+// so it stays the same as the sensor is shared by more zones, and reads more channels
+#define CONTEXT_MAX_SOIL_MOISTURE_PROBES 4
+// Define the range of readings a connected probe gives, a probe reading at either rail is taken as disconnected
+#define CONTEXT_PROBE_MIN_CONNECTED 32
+#define CONTEXT_PROBE_MAX_CONNECTED 4063
+// Define how noisy a probe's burst can be before it is taken as disconnected, a floating pin wanders across the range
+#define CONTEXT_PROBE_MAX_CONNECTED_NOISE 100
+// Define how little a probe's soil moisture can change and still count as not having moved
+#define CONTEXT_PROBE_STUCK_TOLERANCE CALIBRATION_PERCENT_Q8(0.125)
+// Define how far the other probes must move, while a probe does not, before it is taken as stuck
+// This is CONTEXT_SOIL_MOISTURE_WATERED_RISE, the others moving that much means the pot was watered, which every probe should see
+#define CONTEXT_PROBE_STUCK_OTHERS_MOVED CONTEXT_SOIL_MOISTURE_WATERED_RISE
+
+// Define the range, in minutes, the soil moisture check frequency, and its adaptive limits, can be set to
+#define CONTEXT_MINUTE_MIN_SOIL_MOISTURE_CHECK_FREQ 5
+#define CONTEXT_MINUTE_MAX_SOIL_MOISTURE_CHECK_FREQ (7 * 24 * 60)
+// Define how long, in seconds, to wait before checking again after a check that could not read the soil moisture,
+// doubled for every failed check in a row, up to the most, so a disconnected probe is not read over and over
+#define CONTEXT_S_MIN_CHECK_RETRY 30
+#define CONTEXT_S_MAX_CHECK_RETRY (15 * 60)
+// Define how long, in milliseconds, the soil moisture check frequency must stop changing before it is written to NVS,
+// so holding a button to sweep through it only writes to flash once
+#define CONTEXT_MS_SAVE_DELAY 1000
+
+// Define how the servo squeezes the bottle's handle for each spray, see: servo_profile_t
+// A hobby servo turns about 60 degrees per 150 ms unloaded, the squeeze and release are slower, so it keeps up under load
+#define CONTEXT_SERVO_ANGLE_REST 0
+#define CONTEXT_SERVO_ANGLE_SQUEEZE 90
+#define CONTEXT_SERVO_MS_SQUEEZE 300
+#define CONTEXT_SERVO_MS_HOLD 200
+#define CONTEXT_SERVO_MS_RELEASE 300
+#define CONTEXT_SERVO_MS_REST 100
+// Define the volume, in microlitres, one squirt is taken to deliver until the rate is calibrated, see: Actuator
+#define CONTEXT_SERVO_DEFAULT_UL_PER_SQUIRT 1000
+
+// Define how a pump runs, see: pump_profile_t
+// A small pump is run at full power, with a soft start, a solenoid valve should have CONTEXT_PUMP_MS_SOFT_START 0
+#define CONTEXT_PUMP_DUTY_PERCENT 100
+#define CONTEXT_PUMP_MS_SOFT_START 200
+// Define the flow rate, in microlitres per second, taken until the rate is calibrated, about what a small 5 V pump delivers
+#define CONTEXT_PUMP_DEFAULT_UL_PER_S 5000
+
+// Define how doses are paced, see: ActuationQueue
+// Define the least time, in milliseconds, between the end of one dose and the start of the next, so the bottle's trigger springs back
+#define CONTEXT_MS_MIN_DOSE_GAP 250
+// Define the most doses per hour, so a stuck sensor reading dry can not empty the bottle or reservoir into the pot
+#define CONTEXT_MAX_DOSES_PER_HOUR 60
+// Define the longest, in milliseconds, watering waits for each unit (squirt, or second of running) it asked for to be dosed
+#define CONTEXT_MS_DOSE_TIMEOUT (30 * 1000)
+// Define how often, in milliseconds, watering checks whether the dose it asked for is done
+#define CONTEXT_MS_DOSE_POLL 250
+
 #define CONTEXT_NVS_KEY_MINUTE_SOIL_MOISTURE_CHECK_FREQ "read_freq"
-#define CONTEXT_NVS_KEY_DESIRED_SOIL_MOISTURE "target_moist"
+// NOTE: The desired soil moisture and squirt model were kept in raw readings under other keys, before probes were calibrated,
+//       those are left alone, so they are not read back as percents. The squirt model, learned per squirt, is left alone
+//       the same way, so it is not read back as per millilitre.
+#define CONTEXT_NVS_KEY_DESIRED_SOIL_MOISTURE "target_pct"
+#define CONTEXT_NVS_KEY_DOSE_MODEL "dose_model"
+// Each kind of actuator keeps its rate under its own key, so switching kinds does not read one's rate as the other's
+#define CONTEXT_NVS_KEY_SERVO_RATE "servo_rate"
+#define CONTEXT_NVS_KEY_PUMP_RATE "pump_rate"
+#define CONTEXT_NVS_KEY_CHECK_SCHEDULE "read_sched"
+#define CONTEXT_NVS_KEY_SOAK_MODEL "soak_model"
+#define CONTEXT_NVS_KEY_PROBE_CALIBRATIONS "probe_calib"
+
+// Soil moisture is kept as percent volumetric water content, in fixed point, see: CALIBRATION_PERCENT_Q8
+// Higher is wetter. Each probe's raw readings are converted with its own calibration, see: calibration.h
+
+// Why a soil moisture probe is, or is not, counted towards the fused soil moisture
+enum PROBE_STATUS_t : uint8_t
+{
+    // Counted
+    PROBE_STATUS_OK = 0,
+    // Not counted, its reading is at a rail, or too noisy, as if nothing is connected to its pin
+    PROBE_STATUS_DISCONNECTED,
+    // Not counted, its reading has not moved while the other probes moved as if the pot was watered
+    PROBE_STATUS_STUCK,
+    PROBE_STATUS_MAX
+};
+
+// One soil moisture probe of a Context, and what it last read
+// Large pots need more than one probe, their readings are fused into one soil moisture by a weighted average
+// of the probes that seem to work. A probe that is disconnected reads at a rail, or wanders with noise.
+// A probe that is stuck (ex. pulled out of the soil, or shorted) stops moving, which is only noticed
+// once the other probes move as if the pot was watered. A stuck probe counts again once it moves.
+// Probes are averaged after converting each to percent with its own calibration, since the same raw reading
+// means a different water content on each probe.
+typedef struct soil_moisture_probe_s {
+    // How the probe is wired and weighed
+    soil_moisture_probe_config_t config;
+    // The index of the probe's reading among the shared sensor's, see: ZoneScheduler::get_soil_moisture_sensor_channel
+    size_t channel;
+    // How the probe was calibrated, and what that works out to, see: calibration.h
+    calibration_t calibration;
+    calibration_converter_t converter;
+    // The probe's last raw reading, and how noisy it was, in raw counts
+    uint16_t raw;
+    uint16_t noise;
+    // The probe's last reading, converted to percent
+    uint16_t soil_moisture;
+    // Whether the last reading was counted, and if not, why
+    PROBE_STATUS_t status;
+    // What the probe, and the other probes, read when the probe last moved more than CONTEXT_PROBE_STUCK_TOLERANCE
+    uint16_t soil_moisture_last_moved;
+    uint16_t others_soil_moisture_last_moved;
+    // Whether the other probes have been read since the probe last moved, so others_soil_moisture_last_moved is set
+    bool is_others_last_moved_set;
+} soil_moisture_probe_t;
+
+// Fuse one reading from each of num_probes probes into one soil moisture, and update why each was, or was not, counted
+// Returns false if no probe could be counted, out_soil_moisture is left as is
+bool soil_moisture_probes_fuse(
+    soil_moisture_probe_t *probes,
+    size_t num_probes,
+    const sensor_reading_t *readings,
+    uint16_t *out_soil_moisture);
+
+// What a menu shows of one soil moisture probe
+typedef struct soil_moisture_probe_reading_s {
+    uint16_t raw;
+    uint16_t soil_moisture;
+    PROBE_STATUS_t status;
+    calibration_t calibration;
+} soil_moisture_probe_reading_t;
 
-// The overall state the menu display and the sensors operate on
+// The state of a Context that is shown to users, published all at once so it can be read without locking
+typedef struct context_snapshot_s {
+    // When the soil moisture sensor was last checked, what its reading was
+    uint16_t current_soil_moisture;
+    // When next watering, what to make the soil moisture at or above
+    uint16_t desired_soil_moisture;
+    // How often to check the soil moisture, in minutes, if the schedule is not adaptive
+    uint32_t minute_soil_moisture_check_freq;
+    // The time when the soil moisture was last checked
+    time_t time_last_soil_moisture_check;
+    // The time when the soil moisture should be next checked
+    time_t time_next_soil_moisture_check;
+    // How the next check is decided
+    check_schedule_t check_schedule;
+    // What each soil moisture probe last read, the first num_soil_moisture_probes are set
+    soil_moisture_probe_reading_t soil_moisture_probes[CONTEXT_MAX_SOIL_MOISTURE_PROBES];
+    size_t num_soil_moisture_probes;
+    // What kind of actuator waters the pot, and its rate, in microlitres per squirt, or per second of running
+    ACTUATOR_TYPE_t actuator_type;
+    uint32_t ul_per_unit;
+} context_snapshot_t;
+
+// Where a Context is in watering its pot, see: Context::step_water
+enum WATER_STATE_t : uint8_t
+{
+    // Waiting for the next soil moisture check
+    WATER_STATE_IDLE = 0,
+    // Waiting for a batch it asked for to be dosed
+    WATER_STATE_DOSING,
+    // Reading water soak into the soil at growing intervals, until the readings settle
+    WATER_STATE_SOAKING,
+    WATER_STATE_MAX
+};
+
+// How far a Context is through watering its pot, only touched by the zone scheduler's task
+// Watering used to be one loop on a task of its own, blocking between steps, this keeps what the loop kept on its stack,
+// so the steps can run one at a time, between other zones' steps
+typedef struct water_progress_s {
+    WATER_STATE_t state;
+    // When the next step is due, from esp_timer_get_time, unused while idle, the next check is the deadline then
+    int64_t us_next_step;
+    // The batch being dosed, its ticket in the dose queue, and when to stop waiting for it
+    uint32_t ul_batch;
+    uint32_t dose_ticket;
+    int64_t us_dose_timeout;
+    // How much had been dosed for watering when the batch was asked for, the actuator may dose less, see: Context::ul_water_dosed
+    uint32_t ul_water_dosed_start;
+    // The soil moisture before the batch, the readings since it was dosed, the next wait between them, and when it was dosed
+    uint16_t soil_moisture_before;
+    soak_curve_t soak_curve;
+    uint32_t ms_soak_interval;
+    int64_t us_soak_start;
+    // When watering started, and how many reads, batches, and microlitres it has taken so far
+    int64_t us_start;
+    uint32_t num_reads;
+    uint32_t num_batches;
+    uint32_t ul_watered;
+} water_progress_t;
+
+// The overall state the menu display and the sensors operate on, one per zone (pot)
 class Context
 {
     public:
-        // Constructor
+        // Constructor, set up the zone zone_config describes, and add it to zone_scheduler, which reads its probes and steps its watering
         Context(
             StaticSemaphore_t *arg_mutex_buffer, 
-            int arg_pin_servo_out,
-            gpio_num_t arg_pin_soil_moisture_sensor_in,
-            char *arg_nvs_namespace);
+            ZoneScheduler *arg_zone_scheduler,
+            ServoScheduler *arg_servo_scheduler,
+            const zone_config_t *zone_config);
+
+        // Copy the state shown to users into snapshot, never blocking, and never mixing values from before and after a change
+        void get_snapshot(context_snapshot_t *out_snapshot);
+
+        // Get the volume, in microlitres, predicted to bring the current soil moisture to the desired soil moisture, see: dose_model_t
+        uint32_t get_ul_to_desired();
+        // Get the rate of the actuator, in microlitres per unit (a squirt, or a second of running)
+        uint32_t get_ul_per_unit();
+        // Get how long, in milliseconds, readings have taken to settle after dosing
+        uint32_t get_ms_soak_settle();
+        // Read the soil moisture sensor into out_soil_moisture without recording it, for watching water soak in
+        // Returns false if the sensor can't be read, or no probe could be counted, out_soil_moisture is left as is
+        bool read_soil_moisture(uint16_t *out_soil_moisture);
+        // Record the newest reading of curve as the current soil moisture, keep curve for get_soak_curve,
+        // and learn from it how long water takes to soak into this pot, saving what was learned to NVS
+        void finish_soak(const soak_curve_t *curve);
+        // Copy the readings of water soaking in after the most recent dose into out_curve
+        void get_soak_curve(soak_curve_t *out_curve);
+        // Copy how long the soil moisture sensor has been powered into out_stats
+        void get_soil_moisture_sensor_power_stats(sensor_power_stats_t *out_stats);
+        // Copy how long the servo's squirts have taken into out_stats, all zeros if the actuator is not a servo
+        void get_servo_stats(servo_stats_t *out_stats);
+        // Copy how much the actuator has dosed into out_stats
+        void get_actuator_stats(actuator_stats_t *out_stats);
+        // Copy how the servo scheduler, shared with every other Context, has held moves back into out_stats
+        void get_servo_scheduler_stats(servo_scheduler_stats_t *out_stats);
+        // Copy how dose requests have been handled into out_stats
+        void get_dose_queue_stats(actuation_stats_t *out_stats);
+        // Get the number of soil moisture probes
+        size_t get_num_soil_moisture_probes();
+        // Copy up to max_probes soil moisture probes, and what they last read, into out_probes
+        // Returns the number of probes copied
+        size_t get_soil_moisture_probes(
+            soil_moisture_probe_t *out_probes,
+            size_t max_probes);
+        // Start capturing soil moisture probe index in the background, see: capture_start
+        bool capture_soil_moisture_sensor(
+            size_t index,
+            uint32_t ms_window,
+            uint32_t decimation,
+            bool (*func_send_block)(const void *block, size_t num_block_bytes));
+        // Learn from ul_dosed microlitres moving the soil moisture from before_soil_moisture to after_soil_moisture, and save it to NVS
+        void learn_dose_response(
+            uint16_t before_soil_moisture,
+            uint16_t after_soil_moisture,
+            uint32_t ul_dosed);
 
         // Get whether we are overdue for a soil moisture check
         bool is_soil_moisture_check_overdue();
@@ -51,47 +318,205 @@ class Context
 
         // Poll the soil moisture sensor, update the context with its reading, the time it was taken, and when it should next be taken
         MENU_CONTROL check_soil_moisture(bool update_next_soil_moisture_check);
+        // The same as check_soil_moisture, if the soil moisture can't be read, and update_next_soil_moisture_check,
+        // the next check is pushed out by a backoff instead, see: CONTEXT_S_MIN_CHECK_RETRY
+        // Returns whether a fresh soil moisture was recorded
+        bool try_check_soil_moisture(bool update_next_soil_moisture_check);
 
-        // Trigger water_task_handle, telling the servo to move many times until our desired soil moisture is reached
+        // Make the next soil moisture check now, and tell the zone scheduler, so it doses many times until our desired soil moisture is reached
         MENU_CONTROL water();
-        // Trigger rotate_servo_task_handle, telling the servo to move once
-        MENU_CONTROL spray(
-            bool in_isr,
-            bool is_blocking);
+        // Ask the zone scheduler's actuate tasks to dose ul microlitres for source, and wait up to ticks_to_wait for it to finish
+        MENU_CONTROL dose(
+            ACTUATION_SOURCE_t source,
+            ACTUATION_PRIORITY_t priority,
+            uint32_t ul,
+            TickType_t ticks_to_wait);
+        // Queue a request for the zone scheduler's actuate tasks to dose ul microlitres for source
+        // A request made before the actuator starts on the one already waiting from source joins it, it doses the larger volume.
+        // Returns the ticket of the request this joined, pass it to wait_for_dose to wait for it to finish, 0 if the queue was full
+        uint32_t request_dose(
+            ACTUATION_SOURCE_t source,
+            ACTUATION_PRIORITY_t priority,
+            uint32_t ul);
+        // Wait up to ticks_to_wait for the dose request with dose_ticket to finish
+        // Returns whether it finished
+        bool wait_for_dose(
+            uint32_t dose_ticket,
+            TickType_t ticks_to_wait);
+        // Dose the smallest volume the actuator can, one squirt, or the shortest run of a pump, for source, for testing it
+        MENU_CONTROL test_dose(ACTUATION_SOURCE_t source);
+
+        // Zone scheduler functions //
+
+        // Run the next step of watering, checking the soil moisture once it is due, then dosing and reading it in batches
+        // until it reaches the desired soil moisture, each step returns instead of blocking until the next
+        // Returns when the step after it is due, from esp_timer_get_time
+        // NOTE: Only the zone scheduler's task calls this, once get_us_next_water_step() is due
+        int64_t step_water();
+        // Get when the next step of watering is due, from esp_timer_get_time, the next soil moisture check if not watering
+        // NOTE: Only the zone scheduler's task calls this
+        int64_t get_us_next_water_step();
+        // Dose once (a squirt, or one run of a pump) towards the dose request being run, starting the next one if none is,
+        // unless another task is dosing this Context, or the gap or hourly cap do not allow it yet
+        // Sets out_ticks_until_allowed to how long until they do, portMAX_DELAY if nothing is waiting on them
+        // Returns whether anything was done, the zone scheduler's actuate tasks call this for every zone until none does anything
+        bool step_actuate(TickType_t *out_ticks_until_allowed);
 
         // Menu functions //
         // TODO: Is there a better way to do this? Arguments? Lambdas?
 
         // Set desired_soil_moisture to current_soil_moisture
         MENU_CONTROL set_desired_soil_moisture_to_current();
-        // Add num_minutes to minute_moisture_check_freq, update time_next_moisture_check
+        // Add percent_q8 to desired_soil_moisture, clamped from 0 to 100%, and write it to NVS
+        MENU_CONTROL add_desired_soil_moisture(int percent_q8);
+        // Read soil moisture probe index, and move its calibration point to the reading, keeping the point's water content,
+        // then write the calibration to NVS, a middle point is only used once it has been read
+        MENU_CONTROL calibrate_soil_moisture_probe(
+            size_t index,
+            CALIBRATION_POINT_t point);
+        // Add percent_q8 to the water content of a calibration point of soil moisture probe index, then write it to NVS
+        // The dry point is kept below the wet point, and the middle point between them,
+        // moving the middle point down to the dry point leaves it out until it is read again
+        MENU_CONTROL add_soil_moisture_probe_calibration_percent(
+            size_t index,
+            CALIBRATION_POINT_t point,
+            int percent_q8);
+        // Add num_minutes to minute_moisture_check_freq, clamped to its allowed range, and move the next check to match
+        // It is written to NVS once it stops changing for CONTEXT_MS_SAVE_DELAY
         MENU_CONTROL add_minute_soil_moisture_check_freq(int num_minutes);
+        // Switch between checking every minute_soil_moisture_check_freq, and checking when the soil is projected to dry
+        MENU_CONTROL toggle_adaptive_check_schedule();
+        // Add num_minutes to the shortest time an adaptive schedule waits between checks, clamped to at most the longest
+        MENU_CONTROL add_minute_min_check_freq(int num_minutes);
+        // Add num_minutes to the longest time an adaptive schedule waits between checks, clamped to at least the shortest
+        MENU_CONTROL add_minute_max_check_freq(int num_minutes);
+        // Add ul to the actuator's rate, clamped to its allowed range, and write it to NVS
+        MENU_CONTROL add_actuator_rate(int ul);
+        // Dose ACTUATOR_NUM_CALIBRATION_UNITS units, so the rate can be set to a tenth of what was collected
+        MENU_CONTROL calibrate_actuator();
+        // Write minute_soil_moisture_check_freq and check_schedule to NVS, called by save_timer_handle
+        void save_check_schedule();
 
-        // Get current_soil_moisture as a human-readable formatted string
-        String str_current_soil_moisture();
-        // Get desired_soil_moisture as a human-readable formatted string
-        String str_desired_soil_moisture();
-        // Get minute_soil_moisture_check_freq as a human-readable formatted string
-        String str_minute_soil_moisture_check_freq();
-        // Get time_last_soil_moisture_check as a human-readable formatted string
-        String str_time_last_soil_moisture_check();
-        // Get time_next_soil_moisture_check as a human-readable formatted string
-        String str_time_next_soil_moisture_check();
+        // Write current_soil_moisture into buf as a human-readable formatted string, return the number of characters written
+        size_t str_current_soil_moisture(
+            char *buf,
+            size_t num_buf_chars);
+        // Write desired_soil_moisture into buf as a human-readable formatted string, return the number of characters written
+        size_t str_desired_soil_moisture(
+            char *buf,
+            size_t num_buf_chars);
+        // Write how often the soil moisture is checked into buf as a human-readable formatted string, return the number of characters written
+        // For adaptive schedules, this is the interval it picked for the next check
+        size_t str_minute_soil_moisture_check_freq(
+            char *buf,
+            size_t num_buf_chars);
+        // Write whether the check schedule is adaptive into buf as a human-readable formatted string, return the number of characters written
+        size_t str_check_schedule_mode(
+            char *buf,
+            size_t num_buf_chars);
+        // Write the shortest time between adaptive checks into buf as a human-readable formatted string, return the number of characters written
+        size_t str_minute_min_check_freq(
+            char *buf,
+            size_t num_buf_chars);
+        // Write the longest time between adaptive checks into buf as a human-readable formatted string, return the number of characters written
+        size_t str_minute_max_check_freq(
+            char *buf,
+            size_t num_buf_chars);
+        // Write time_last_soil_moisture_check into buf as a human-readable formatted string, return the number of characters written
+        size_t str_time_last_soil_moisture_check(
+            char *buf,
+            size_t num_buf_chars);
+        // Write time_next_soil_moisture_check into buf as a human-readable formatted string, return the number of characters written
+        size_t str_time_next_soil_moisture_check(
+            char *buf,
+            size_t num_buf_chars);
+        // Write the actuator's rate into buf as a human-readable formatted string, return the number of characters written
+        size_t str_actuator_rate(
+            char *buf,
+            size_t num_buf_chars);
+        // Write what soil moisture probe index last read into buf as a human-readable formatted string, return the number of characters written
+        size_t str_soil_moisture_probe(
+            size_t index,
+            char *buf,
+            size_t num_buf_chars);
+        // Write a calibration point of soil moisture probe index into buf as a human-readable formatted string, return the number of characters written
+        size_t str_soil_moisture_probe_calibration(
+            size_t index,
+            CALIBRATION_POINT_t point,
+            char *buf,
+            size_t num_buf_chars);
 
     private:
+        // Publish the members shown to users to snapshot, so readers see every change made under the mutex at once
+        // Call this before CONTEXT_UNLOCK() in every function that changes them
+        void publish_snapshot();
+        // Set the current soil moisture to soil_moisture, read now, must hold the mutex
+        void record_soil_moisture(
+            uint16_t soil_moisture,
+            bool update_next_moisture_check);
+        // Fuse readings, one per probe, into out_soil_moisture, see: soil_moisture_probes_fuse, must hold the mutex
+        // Returns false if no probe could be counted
+        bool fuse_soil_moisture_probes(
+            const sensor_reading_t *readings,
+            uint16_t *out_soil_moisture);
+        // Set time_next_soil_moisture_check from time_last_soil_moisture_check and check_schedule, must hold the mutex
+        void update_time_next_soil_moisture_check();
+        // Push time_next_soil_moisture_check out by a backoff doubling with every failed check in a row, must hold the mutex
+        void delay_time_next_soil_moisture_check();
+        // Start save_timer_handle over, so the check schedule is written to NVS once it stops changing
+        void save_check_schedule_later();
+        // Write every soil moisture probe's calibration to NVS, must hold the mutex
+        void save_soil_moisture_probe_calibrations();
+        // Get the NVS key the actuator's rate is kept under, each kind of actuator has its own
+        char *get_actuator_rate_nvs_key();
+        // Read every probe through the shared sensor into out_readings, one per probe, in the order of soil_moisture_probes
+        // Returns false if the sensor could not be read
+        bool read_soil_moisture_probes(sensor_reading_t *out_readings);
+        // Ask for the next batch of watering, or, if the soil moisture reached the desired soil moisture, finish watering
+        // Returns when the next step is due, see: step_water
+        int64_t start_water_batch(int64_t us_now);
+        // Tell the zone scheduler, so it sees the next soil moisture check moved
+        // Call this after CONTEXT_UNLOCK() in every function that changes time_next_soil_moisture_check
+        void notify_zone_scheduler();
+
         // A mutex to keep updating all members of this class thread-safe
         // Easier, but slower to have one mutex for all members than one for each
+        // Readers that only need the members in context_snapshot_t should use snapshot instead
         SemaphoreHandle_t mutex_handle;
+        // The last published copy of the members shown to users, see: publish_snapshot
+        Seqlock<context_snapshot_t> snapshot;
 
-        // A handle to a task that periodically checks the soil moisture, adds water when below our desired moisture, see: task_water
-        TaskHandle_t water_task_handle;
-        // A handle to a task that can be used to rotate the servo motor, see: task_rotate_servo
-        TaskHandle_t rotate_servo_task_handle;
+        // The scheduler stepping this Context's watering and dosing, and reading its probes, shared with every other Context,
+        // and this Context's index in it
+        ZoneScheduler *zone_scheduler;
+        size_t zone_index;
+        // How far watering is, see: step_water
+        water_progress_t water_progress;
 
-        // A handle to the servo motor
-        Servo servo;
-        // The ADC (Analog to Digital Converter) supporting GPIO pin that reads the soil moisture sensor output
-        gpio_num_t pin_soil_moisture_sensor_in;
+        // The dose requests from the menu, TCP, and watering, in microlitres, run by step_actuate
+        ActuationQueue dose_queue;
+        // Whether a task is in step_actuate, so only one doses at a time
+        bool is_actuating;
+        // The request being dosed, its ticket is 0 if none is, and how much of it is left, in microlitres
+        actuation_request_t dose_request;
+        uint32_t ul_dose_left;
+        // Whether the next dose waited for the gap or hourly cap, and whether the actuator was stopped since the last dose
+        bool is_dose_deferred;
+        bool is_actuator_stopped;
+        // The microlitres dosed for watering requests since boot, counted by step_actuate, so step_water learns from what was dosed
+        uint32_t ul_water_dosed;
+
+        // A handle to a timer that calls save_check_schedule, restarted whenever it changes
+        TimerHandle_t save_timer_handle;
+
+        // The scheduler owning every servo motor, shared with every other Context, for its stats
+        ServoScheduler *servo_scheduler;
+        // The servo, pump, or solenoid valve that waters the pot
+        Actuator actuator;
+        // The soil moisture probes, and what they last read, read together with every other Context's through the ADC
+        // (Analog to Digital Converter) in bursts, see: ZoneScheduler::get_soil_moisture_sensor
+        soil_moisture_probe_t soil_moisture_probes[CONTEXT_MAX_SOIL_MOISTURE_PROBES];
+        size_t num_soil_moisture_probes;
 
         // The namespace within NVS this Context maps to
         char *nvs_namespace;
@@ -108,11 +533,18 @@ class Context
         time_t time_last_soil_moisture_check;
         // The time when the soil moisture should be next checked
         time_t time_next_soil_moisture_check;
+        // The number of checks in a row that could not read the soil moisture, see: delay_time_next_soil_moisture_check
+        uint32_t num_failed_soil_moisture_checks;
+        // What has been learned about how this pot responds to water
+        dose_model_t dose_model;
+        // How the next check is decided
+        check_schedule_t check_schedule;
+        // The readings since the pot was last watered
+        soil_moisture_history_t soil_moisture_history;
+        // What has been learned about how long water takes to soak into this pot
+        soak_model_t soak_model;
+        // The readings of water soaking in after the most recent dose
+        soak_curve_t soak_curve;
 };
 
-// Define a task for rotating a servo to neutral, an angle, and back
-void task_rotate_servo(Servo *servo);
-// Define a task for periodically checking, then adding water if soil moisture is below desired
-void task_water(Context *context);
-
 #endif // __CONTEXT_H__
\ No newline at end of file
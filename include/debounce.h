@@ -0,0 +1,86 @@
+#ifndef __DEBOUNCE_H__
+#define __DEBOUNCE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// This decides what a button did from samples of whether it is held down, without reading any pins itself,
+// so the same state machine runs on the samples Button reads, and on synthetic bounce waveforms in tests.
+// When a digital button is pressed, it may flicker between HIGH (1) and LOW (0) many times before finally settling into its new state.
+// To not register this flickering 'static noise' as repeated button presses, which it's not,
+// a new state is only trusted once it has been sampled the same for us_debounce in a row.
+// https://esp32io.com/tutorials/esp32-button-debounce
+// Ex: HI _____                   _____
+//     LO      \/\/\/\_____/\/\/\/
+//             ^ first edge, start sampling
+//                    ^ stable for us_debounce, press
+//                         ^ first edge, start sampling
+//                                ^ stable for us_debounce, release, stop sampling
+
+// Define how long, in microseconds, a repeating button must be held before it starts repeating
+#define BUTTON_US_REPEAT_DELAY (500 * 1000)
+// Define the time, in microseconds, between the first two repeats of a held button
+#define BUTTON_US_REPEAT_PERIOD_START (200 * 1000)
+// Define the shortest time, in microseconds, between two repeats of a held button
+#define BUTTON_US_REPEAT_PERIOD_MIN (40 * 1000)
+
+// What happened to a button once it stopped bouncing
+enum BUTTON_EVENT_t : uint8_t
+{
+    BUTTON_EVENT_NONE = 0,
+    BUTTON_EVENT_PRESS,
+    BUTTON_EVENT_RELEASE,
+    // The button is still being held, sent every repeat period for buttons that repeat
+    BUTTON_EVENT_REPEAT,
+    BUTTON_EVENT_MAX
+};
+
+// What a sample found the button did, and when
+typedef struct debounce_event_s {
+    BUTTON_EVENT_t type;
+    // When it happened, in microseconds, a press or release is reported at its first edge,
+    // so it does not include the time spent debouncing
+    int64_t us_time;
+} debounce_event_t;
+
+// How one button is debounced, and where it is in settling
+typedef struct debounce_s {
+    // How long, in microseconds, a new state must be sampled the same in a row to be trusted
+    uint32_t us_debounce;
+    // Whether holding the button sends BUTTON_EVENT_REPEAT, faster the longer it is held
+    bool is_repeating;
+    // The last settled state of the button
+    bool is_pressed;
+    // Whether the last sample found the button held down, bouncing or not
+    bool was_down;
+    // Whether the button settled into being pressed, and is being sampled for repeats
+    bool is_held;
+    // When, in microseconds, the last sample found something different than the one before it
+    int64_t us_last_change;
+    // When, in microseconds, the button first left is_pressed, ex. the first edge of a press,
+    // set by whoever saw the edge (ex. an interrupt) before sampling starts
+    volatile int64_t us_first_change;
+    // When, in microseconds, the next BUTTON_EVENT_REPEAT is due
+    int64_t us_next_repeat;
+    // The time, in microseconds, until the repeat after the next one, it shrinks every repeat until BUTTON_US_REPEAT_PERIOD_MIN
+    uint32_t us_repeat_period;
+} debounce_t;
+
+// Set up debounce for a button that must be steady for us_debounce, and that repeats while held if is_repeating
+void debounce_init(
+    debounce_t *debounce,
+    uint32_t us_debounce,
+    bool is_repeating);
+// Start from whether the button is held down now, without calling it a press or release
+void debounce_reset(
+    debounce_t *debounce,
+    bool is_down);
+// Take one sample, whether the button is held down at us_current_time, sets out_event to what the button did, if anything
+// Returns whether the button still needs sampling, false once it settled, and is not being held for repeats
+bool debounce_sample(
+    debounce_t *debounce,
+    bool is_down,
+    int64_t us_current_time,
+    debounce_event_t *out_event);
+
+#endif // __DEBOUNCE_H__
\ No newline at end of file
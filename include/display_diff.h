@@ -0,0 +1,38 @@
+#ifndef __DISPLAY_DIFF_H__
+#define __DISPLAY_DIFF_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// These functions work out which characters of a character display changed since the last frame,
+// and group them into runs that can each be sent with one cursor move, so an unchanged frame sends nothing.
+// They never touch the display, so they run the same in the firmware and on synthetic frames in tests.
+
+// A run of characters on one line of the display that has to be rewritten
+typedef struct display_run_s {
+    // The column the run starts at
+    size_t col;
+    // The number of characters in the run
+    size_t num_chars;
+} display_run_t;
+
+// Compare line, padded with spaces from num_line_chars to num_cols, against displayed_line (num_cols characters),
+// write the runs of characters that have to be rewritten into out_runs (room for num_cols runs),
+// copy the new characters into displayed_line, and return the number of runs written.
+// Changed characters with at most max_gap_chars unchanged characters between them are sent as one run.
+// If is_displayed_line_valid is false, what is on the display is unknown, so the whole line is one run.
+size_t display_diff_line(
+    const char *line,
+    size_t num_line_chars,
+    char *displayed_line,
+    size_t num_cols,
+    bool is_displayed_line_valid,
+    size_t max_gap_chars,
+    display_run_t *out_runs);
+// Get the number of bytes sending runs costs the HD44780: one instruction byte to move the cursor, then one data byte per character
+// NOTE: Each of these bytes is at least 4 bytes on the I2C bus to the PCF8574, see lcd.cpp
+size_t display_count_lcd_bytes(
+    const display_run_t *runs,
+    size_t num_runs);
+
+#endif // __DISPLAY_DIFF_H__
\ No newline at end of file
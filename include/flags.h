@@ -28,6 +28,27 @@
 #define PRINT_STACK_USAGE (void) 0
 #endif // PRINT_STACK_DIAGNOSTICS
 
+// Define whether you want the menu to print how many bytes it sent to the display for each frame,
+// and how much heap generating the frame used (it should be none).
+// This is useful for measuring how much I2C traffic and memory redrawing the display costs,
+// but it prints on every frame, so it is noisy otherwise
+#define PRINT_DISPLAY_DIAGNOSTICS 0
+
+// Define whether you want the display to time how long writing a full frame and a single character takes when it starts.
+// This is useful when changing the display driver or I2C clock, it writes over the display for a moment when enabled
+#define RUN_DISPLAY_BENCHMARK 0
+
+// Define whether you want the menu to print, for every run of inputs it handles,
+// how long the inputs waited in the menu input queue and how long after being captured they were handled.
+// This is useful for finding where the time between pressing a button and the menu reacting goes,
+// but it prints on every input, so it is noisy otherwise
+#define PRINT_INPUT_LATENCY 0
+
+// Define whether you want every soil moisture sensor reading to print its value, noise, number of samples,
+// and the CPU time spent reducing them, along with the time one analogRead() takes, once, when starting.
+// This is useful for tuning how the sensor is sampled, but it prints on every reading, so it is noisy otherwise
+#define PRINT_SENSOR_DIAGNOSTICS 0
+
 // Define whether you want to compile the code to WiFi-enable this project, which takes more memory and power
 #define WIFI_ENABLED 1
 
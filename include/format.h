@@ -0,0 +1,38 @@
+#ifndef __FORMAT_H__
+#define __FORMAT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// These functions format text straight into a caller-provided buffer, without allocating from the heap.
+// Unlike Arduino String, they never allocate, so they are safe to call every frame for weeks without fragmenting the heap.
+// Each writes at most num_buf_chars characters, does NOT write a null terminator, and returns the number of characters written.
+// They can be chained by advancing buf and shrinking num_buf_chars by what the previous call returned.
+// A number that does not fit is written as FORMAT_OVERFLOW_CHAR filling buf, never with digits cut off,
+// so it can't be mistaken for a smaller number that does fit.
+
+// Define the character a number that does not fit is shown as
+#define FORMAT_OVERFLOW_CHAR '#'
+
+// Copy str into buf, cutting it short if it does not fit
+size_t format_str(
+    char *buf,
+    size_t num_buf_chars,
+    const char *str);
+// Write value into buf as decimal digits
+size_t format_uint(
+    char *buf,
+    size_t num_buf_chars,
+    uint32_t value);
+// Write value, in fixed point with 8 fractional bits, into buf as decimal digits with one, rounded, decimal place (ex. 42.5)
+size_t format_q8(
+    char *buf,
+    size_t num_buf_chars,
+    uint32_t value_q8);
+// Write value, in thousandths (ex. microlitres, to show as millilitres), into buf as decimal digits with one, rounded, decimal place (ex. 1.5)
+size_t format_milli(
+    char *buf,
+    size_t num_buf_chars,
+    uint32_t value_milli);
+
+#endif // __FORMAT_H__
\ No newline at end of file
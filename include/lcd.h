@@ -0,0 +1,126 @@
+#ifndef __LCD_H__
+#define __LCD_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Include Arduino-dependant I2C API
+#include <Wire.h>
+// Include FreeRTOS common header
+#include "freertos/FreeRTOS.h"
+// Include FreeRTOS task API
+#include "freertos/task.h"
+// Include FreeRTOS queue API
+#include "freertos/queue.h"
+
+// This is a driver for a HD44780 character LCD behind a PCF8574 I2C backpack (the common 0x27/0x3F boards).
+// The PCF8574 only has 8 output pins, so the LCD is driven in 4-bit mode, and every byte sent to the LCD
+// is 2 nibbles, each clocked in by raising then lowering the enable pin.
+// Instead of one I2C transaction per pin change, every byte of a whole run of characters is packed into one I2C write.
+// Datasheets:
+// - https://www.sparkfun.com/datasheets/LCD/HD44780.pdf
+// - https://www.ti.com/lit/ds/symlink/pcf8574.pdf
+
+// Define the I2C clock speed, in Hz, for talking to the display
+// NOTE: The PCF8574 datasheet only promises 100 kHz, but the backpacks tested so far work in 400 kHz fast mode.
+//       Lower this if characters come out garbled.
+#define LCD_I2C_HZ 400000
+// Define the most characters one queued write can hold, longer writes are split up
+#define LCD_MAX_RUN_CHARS 20
+// Define the number of writes that can wait to be sent to the display before queueing another blocks
+#define LCD_COMMAND_QUEUE_LENGTH 16
+
+// What a command waiting in the LCD command queue should do
+enum LCD_COMMAND_t : uint8_t
+{
+    LCD_COMMAND_NONE = 0,
+    // Write chars, starting at col and row
+    LCD_COMMAND_WRITE,
+    // Erase every character on the display
+    LCD_COMMAND_CLEAR,
+    // Turn the display on (arg != 0) or off (arg == 0), what it shows is kept while it's off
+    LCD_COMMAND_SET_DISPLAY,
+    // Turn the backlight on (arg != 0) or off (arg == 0)
+    LCD_COMMAND_SET_BACKLIGHT,
+    // Set the 5x8 pixel custom character at location arg to the 8 rows in chars
+    LCD_COMMAND_CREATE_CHAR,
+    LCD_COMMAND_MAX
+};
+
+// A command waiting in the LCD command queue
+typedef struct lcd_command_s {
+    // What this command should do
+    LCD_COMMAND_t type;
+    // A command specific argument, see LCD_COMMAND_t
+    uint8_t arg;
+    // The column to start writing at, for LCD_COMMAND_WRITE
+    uint8_t col;
+    // The row to start writing at, for LCD_COMMAND_WRITE
+    uint8_t row;
+    // The number of used bytes in chars
+    uint8_t num_chars;
+    // The characters to write, or custom character rows
+    uint8_t chars[LCD_MAX_RUN_CHARS];
+} lcd_command_t;
+
+// A HD44780 character LCD behind a PCF8574 I2C backpack
+class Lcd
+{
+    public:
+        // Constructor
+        Lcd(
+            uint8_t arg_i2c_addr,
+            uint8_t arg_num_cols,
+            uint8_t arg_num_rows);
+        // Put the LCD in 4-bit mode, clear it, turn it and its backlight on, and start the task draining the command queue
+        // Wire must already be started, ideally at LCD_I2C_HZ
+        void init();
+        // Queue a command to erase every character on the display
+        void clear();
+        // Queue a command to turn the display on or off
+        void set_display(bool is_on);
+        // Queue a command to turn the backlight on or off
+        void set_backlight(bool is_on);
+        // Queue a command to set the custom character at location (0 to 7) to the 8 rows of 5 pixels in charmap
+        void create_char(
+            uint8_t location,
+            const uint8_t *charmap);
+        // Queue commands to write num_chars characters, starting at col and row
+        // This returns as soon as the commands are queued, it only blocks if the command queue is full
+        void write(
+            uint8_t col,
+            uint8_t row,
+            const char *chars,
+            size_t num_chars);
+        // Print how long, in microseconds, writing a full frame and writing a single character take
+        // This writes over what is on the display, and must be called before anything else is queued
+        void benchmark();
+
+    private:
+        // Queue a command for task_drain_lcd to send to the display
+        void queue_command(lcd_command_t *command);
+        // Send a command to the display, blocking until the I2C bus is done with it
+        void execute_command(lcd_command_t *command);
+        // Send the 4 high bits of value to the display on its own, only needed while putting it in 4-bit mode
+        void write_nibble(uint8_t value);
+        // Use non-member function as the task entry point, so it can be passed to xTaskCreate
+        friend void task_drain_lcd(Lcd *lcd);
+
+        // The I2C address of the PCF8574 backpack
+        uint8_t i2c_addr;
+        // The number of columns (characters per line) on the display
+        uint8_t num_cols;
+        // The number of rows (lines) on the display
+        uint8_t num_rows;
+        // The PCF8574 backlight pin bit, ORed into every byte sent, so the backlight stays how it was last set
+        uint8_t backlight_bit;
+        // The handle to the queue of commands waiting to be sent to the display
+        QueueHandle_t command_queue_handle;
+        // The handle to the task sending queued commands to the display, see: task_drain_lcd
+        TaskHandle_t drain_task_handle;
+};
+
+// Define a task for sending queued commands to the display, so whoever queued them does not wait on the I2C bus
+void task_drain_lcd(Lcd *lcd);
+
+#endif // __LCD_H__
\ No newline at end of file
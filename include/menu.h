@@ -4,8 +4,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
-// Include Arduino-dependant I2C LED API
-#include <LiquidCrystal_I2C.h>
+// Include custom LCD driver
+#include "lcd.h"
 // Include FreeRTOS common header
 #include "freertos/FreeRTOS.h"
 // Include FreeRTOS task API
@@ -33,6 +33,31 @@
 #if NUM_DISPLAY_CHARS_PER_LINE < 2
 #error "Menu code requires at least 2 characters per line on the display"
 #endif
+// Define how many unchanged characters may sit between two changed characters before they are sent as separate runs.
+// Moving the cursor costs one command byte, so bridging a gap of one unchanged character costs the same as skipping it.
+#define NUM_DISPLAY_MAX_RUN_GAP_CHARS 1
+
+// Define menu input constants
+// Define the number of inputs from each source that can wait in the menu input queue, more are dropped
+// NOTE: This must be a power of 2
+#define MENU_INPUT_RING_LENGTH 16
+#if (MENU_INPUT_RING_LENGTH & (MENU_INPUT_RING_LENGTH - 1)) != 0
+#error "MENU_INPUT_RING_LENGTH must be a power of 2"
+#endif
+// Define the longest, in milliseconds, the menu will keep taking waiting inputs before updating the display for them
+#define MENU_MS_INPUT_BATCH_BUDGET 20
+// Define the shortest time, in milliseconds, between two frames drawn on the display, changes in between are drawn together
+#define MENU_MS_MIN_FRAME_PERIOD 50
+// Define how often, in milliseconds, the display is redrawn even if nothing notified it of a change,
+// so lines showing times (ex. "X read: 5min ago") do not go stale
+#define MENU_MS_AUTO_REFRESH_PERIOD (30 * 1000)
+
+// Create macros to avoid erroneous/annoying copy/paste
+// Take the Menu sempahore to prevent the menu from being drawn while inputs are changing it
+#define MENU_LOCK(RET_VAL) \
+    if(pdFALSE == xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ 100)) return RET_VAL;
+// Return mutex so other threads can read and write to menu members again
+#define MENU_UNLOCK() xSemaphoreGive(/* xSemaphore = */ mutex_handle);
 
 enum MENU_INPUT_t : uint8_t
 {
@@ -43,14 +68,64 @@ enum MENU_INPUT_t : uint8_t
     MENU_INPUT_MAX
 };
 
+// Where a menu input came from, each source has its own ring in the menu input queue
+enum MENU_INPUT_SOURCE_t : uint8_t
+{
+    MENU_INPUT_SOURCE_BUTTON = 0,
+    MENU_INPUT_SOURCE_TCP,
+    MENU_INPUT_SOURCE_MAX
+};
+
+// Bits within menu_input_event_t.flags
+// This input is a repeat from a button being held, instead of its own press
+#define MENU_INPUT_FLAG_REPEAT (1 << 0)
+
+// A menu input waiting in the menu input queue
+typedef struct menu_input_event_s {
+    // The input received
+    MENU_INPUT_t input;
+    // Where the input came from
+    MENU_INPUT_SOURCE_t source;
+    // MENU_INPUT_FLAG_* bits
+    uint8_t flags;
+    // When the input was captured, in microseconds since the processor started running.
+    // Only the low 32 bits are kept, they wrap every ~71 minutes, so only compare them by subtracting.
+    uint32_t us_time;
+} menu_input_event_t;
+
 // Initialze menu and its input queue/task
 void init_menu();
-// Add a new menu_input to the back of the menu input queue
+// Add a new menu_input to the back of the menu input queue, and wake the task reading it
+// Only one task or interrupt may add inputs from each source, this is safe to call from an interrupt if from_isr is true
+// us_time is when the input was captured, ex. the first edge of a button press
 void add_to_menu_input_queue(
     MENU_INPUT_t menu_input,
+    MENU_INPUT_SOURCE_t source,
+    bool is_repeat,
+    int64_t us_time,
     bool from_isr);
-// Get the main display for the device
-LiquidCrystal_I2C *get_display();
+// Tell the task drawing the display that something shown on the menu changed, so it should draw a new frame
+void notify_menu_changed();
+// Show the next zone on the menu, wrapping around, so the menu and TCP commands act on it, and send which zone is shown over TCP
+void show_next_zone();
+// Water the context shown on the menu now instead of waiting for its next check, ex. when asked to remotely
+void water_now();
+// Dose the least the actuator can for the context shown on the menu, queued behind any doses already running, ex. when asked to remotely
+void dose_now();
+// Send the readings of water soaking in after the most recent dose over TCP, for diagnosing how long the pot takes to settle
+void send_soak_curve();
+// Send how long the soil moisture sensor has been powered over TCP, for measuring how much energy powering it only around readings saves
+void send_probe_stats();
+// Send how long the servo's squirts have taken over TCP, for measuring how fast water can be delivered
+void send_servo_stats();
+// Send how dose requests from the menu, TCP, and the watering loop have been queued, merged, and served, and how much was dosed, over TCP
+void send_dose_queue_stats();
+// Send what each soil moisture probe last read, and whether it counts towards the soil moisture, over TCP
+void send_soil_moisture_probes();
+// Start capturing the soil moisture probe shown on the menu at a high rate, streaming the samples over TCP in binary blocks, see: capture_block_t
+void start_probe_capture();
+// Turn the display and its backlight on or off, the task drawing the display will apply it
+void set_display_enabled(bool is_enabled);
 // Get the handle of the task that reads the menu input queue
 TaskHandle_t get_read_menu_input_queue_task_handle();
 
@@ -62,36 +137,61 @@ typedef bool MENU_CONTROL;
 #define MENU_CONTROL_RELEASE false
 
 // A line within a Menu
+// Every member is const and the constructor is constexpr, so a table of menu lines
+// can be built at compile time and placed in flash instead of RAM
 class MenuLine
 {
     public:
         // Constructor
-        MenuLine(
-            String arg_str_display,
-            String (*arg_func_to_str)(),
-            bool (*arg_func_on_up)(),
-            bool (*arg_func_on_confirm)(),
-            bool (*arg_func_on_down)());
-        // Call func_on_* based on what menu input was received
-        // Returns true if, after this press, it is giving control back to the menu.
-        MENU_CONTROL react_to_menu_input(MENU_INPUT_t input);
-        // Get the string this menu line should currently be displaying as
-        void get_str(String **arg_str);
+        constexpr MenuLine(
+            const char *arg_str_display,
+            size_t (*arg_func_to_str)(char *buf, size_t num_buf_chars),
+            MENU_CONTROL (*arg_func_on_up)(size_t num_inputs, size_t *num_inputs_used),
+            MENU_CONTROL (*arg_func_on_confirm)(size_t num_inputs, size_t *num_inputs_used),
+            MENU_CONTROL (*arg_func_on_down)(size_t num_inputs, size_t *num_inputs_used)) :
+            str_display(arg_str_display),
+            func_to_str(arg_func_to_str),
+            // NOTE: This must be in the same order as MENU_INPUT_t
+            funcs_on_input{
+                /* MENU_INPUT_NONE = */ nullptr,
+                /* MENU_INPUT_UP = */ arg_func_on_up,
+                /* MENU_INPUT_CONFIRM = */ arg_func_on_confirm,
+                /* MENU_INPUT_DOWN = */ arg_func_on_down}
+        {
+        }
+        // Call the funcs_on_input for the menu input received num_inputs times in a row, sets out_num_inputs_used to how many it used,
+        // 0 if there is no function for this input, the rest are left for the menu
+        // Returns true if, after these presses, it is giving control back to the menu.
+        MENU_CONTROL react_to_menu_input(
+            MENU_INPUT_t input,
+            size_t num_inputs,
+            size_t *out_num_inputs_used) const;
+        // Write the string this menu line should currently be displaying as into buf, without a null terminator
+        // Returns the number of characters written, at most num_buf_chars
+        size_t get_str(
+            char *buf,
+            size_t num_buf_chars) const;
+        // Get the number of characters in str_display, at compile time if needed
+        constexpr size_t get_str_display_len() const
+        {
+            size_t len = 0;
+            for(; '\0' != str_display[len]; ++len);
+            return len;
+        }
 
     private:
-        // The string this line is currently displayed as.
-        String str_display;
-        // The function that should be used to used to convert this menu line to a string.
-        String (*func_to_str)();
-        // When a user clicks confirm on this menu line while modifying it, the function it will call.
-        // It should return true if, after this press, it is giving control back to the menu.
-        MENU_CONTROL (*func_on_confirm)();
-        // When a user clicks up on this menu line while modifying it, the function it will call.
-        // It should return true if, after this press, it is giving control back to the menu.
-        MENU_CONTROL (*func_on_up)();
-        // When a user clicks down on this menu line while modifying it, the function it will call.
-        // It should return true if, after this press, it is giving control back to the menu.
-        MENU_CONTROL (*func_on_down)();
+        // The string this line is displayed as, if it has no func_to_str.
+        const char *const str_display;
+        // The function that should be used to used to write this menu line into a buffer as a string.
+        // It should write at most num_buf_chars characters, without a null terminator, and return how many it wrote.
+        size_t (*const func_to_str)(char *buf, size_t num_buf_chars);
+        // When a user clicks a button on this menu line while modifying it, the function it will call, indexed by MENU_INPUT_t.
+        // It is given how many times the button was pressed (or repeated while held) since it was last called,
+        // values should be changed by that many steps, actions should be done once, and set num_inputs_used to 1.
+        // num_inputs_used starts as num_inputs, whatever it does not use is handled after it, by the menu if it gave control back,
+        // or by calling it again if it kept it.
+        // It should return true if, after these presses, it is giving control back to the menu.
+        MENU_CONTROL (*const funcs_on_input[MENU_INPUT_MAX])(size_t num_inputs, size_t *num_inputs_used);
         // Sometimes a menu option wil take more than once press of confirm, such as when changing a string.
         // Use this counter to keep track of how far you are.
         //bool num_confirm;
@@ -103,16 +203,29 @@ class Menu
     public:
         // Constructor
         Menu(
-            MenuLine *arg_menu_lines,
+            StaticSemaphore_t *arg_mutex_buffer,
+            const MenuLine *arg_menu_lines,
             size_t arg_num_menu_lines);
-        // Decide what to do based on what menu input was received
-        void react_to_menu_input(MENU_INPUT_t menu_input);
+        // Decide what to do based on what menu input was received num_menu_inputs times in a row
+        // This does not update the display, so many inputs can be handled before calling update_display() once
+        void react_to_menu_input(
+            MENU_INPUT_t menu_input,
+            size_t num_menu_inputs);
         // Update what is displayed on the I2C LED display
-        // NOTE: Right now this is only coded for a 20x04 I2C LED display, and lines over 18 hcaracter will have a bad time
+        // Only the task drawing the display, task_render_menu, should call this
+        // NOTE: Menu lines longer than NUM_DISPLAY_CHARS_PER_LINE - 2 characters are cut short
         void update_display();
+        // Forget what was last pushed to the display, so the next update_display() rewrites every character
+        // Use this if something other than update_display() wrote to the display
+        void invalidate_display();
+        // Get the number of bytes (cursor moves and characters) the last update_display() sent to the HD44780
+        // NOTE: This is not I2C bytes, each of these is at least 4 bytes on the I2C bus to the PCF8574
+        size_t get_num_lcd_bytes_last_frame();
     private:
+        // A mutex to keep inputs from changing the menu while a frame of it is being generated
+        SemaphoreHandle_t mutex_handle;
         // All of the lines available in the menu
-        MenuLine *menu_lines;
+        const MenuLine *menu_lines;
         // The number of lines available in the menu
         size_t num_menu_lines;
         // The index of the menu line the user is currently hovering over or selecting
@@ -121,6 +234,13 @@ class Menu
         bool is_menu_item_selected;
         // Store current screen buffer (it will be transmitted over WiFi or Bluetooth)
         char display_buffer[sizeof('\0') + (NUM_DISPLAY_LINES * (NUM_DISPLAY_CHARS_PER_LINE + sizeof('\n')))];
+        // Store the frame last pushed to the display, so only characters that changed since then are rewritten.
+        // Unlike display_buffer, every line is padded with spaces to the full width of the display.
+        char displayed_buffer[NUM_DISPLAY_LINES][NUM_DISPLAY_CHARS_PER_LINE];
+        // Whether displayed_buffer is known to match what is on the display, ex. false before the first frame
+        bool is_displayed_buffer_valid;
+        // The number of bytes (cursor moves and characters) the last update_display() sent to the HD44780
+        size_t num_lcd_bytes_last_frame;
 };
 
 #endif // __MENU_H__
\ No newline at end of file
@@ -0,0 +1,67 @@
+#ifndef __PUMP_H__
+#define __PUMP_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Include ESP32 LED PWM controller API, for driving the pump's MOSFET and ramping its power up in hardware
+#include "driver/ledc.h"
+// Include ESP32 GPIO API
+#include "driver/gpio.h"
+
+// This runs a small DC pump, or opens a solenoid valve, through a logic-level MOSFET driven by the ESP32's LEDC (LED PWM) peripheral.
+// Water is dosed by how long it runs, so a pump delivers an exact volume once its flow rate is calibrated, see: Actuator.
+// A pump's motor draws several times its running current as it starts, so its power is ramped up over a soft start
+// with a hardware fade, the same way servo moves are, to keep the 5 V rail up. A solenoid valve needs full power to open, so has no soft start.
+// https://docs.espressif.com/projects/esp-idf/en/v4.4/esp32/api-reference/peripherals/ledc.html
+
+// Define the PWM rate, in Hz, above hearing, so the motor does not whine
+#define PUMP_PWM_FREQ_HZ 20000
+// Define the resolution of the duty, in bits, the highest the LEDC supports at PUMP_PWM_FREQ_HZ on every ESP32
+#define PUMP_DUTY_RESOLUTION LEDC_TIMER_10_BIT
+#define PUMP_DUTY_BITS 10
+// Define the LEDC timer every pump shares, servos use their own, since they run at another rate
+#define PUMP_TIMER LEDC_TIMER_1
+// Define the most pumps, each takes the next LEDC channel, starting from PUMP_FIRST_CHANNEL, after the servos' channels
+#define PUMP_MAX_PUMPS 4
+#define PUMP_FIRST_CHANNEL LEDC_CHANNEL_4
+// Define the LEDC speed mode used, every ESP32 has the low speed mode
+#define PUMP_SPEED_MODE LEDC_LOW_SPEED_MODE
+// Define the longest, in milliseconds, one run can be, so a bad flow rate can not run a pump dry for long
+#define PUMP_MS_MAX_RUN (60 * 1000)
+
+// How a pump runs, see: Pump::run
+typedef struct pump_profile_s {
+    // The share of full power to run at, in percent, a pump runs slower and quieter below 100, a solenoid valve needs 100 to open
+    uint8_t duty_percent;
+    // How long, in milliseconds, to ramp the power up from off to duty_percent at the start of every run, 0 for a solenoid valve
+    uint16_t ms_soft_start;
+} pump_profile_t;
+
+// A pump or solenoid valve driven by one LEDC channel
+class Pump
+{
+    public:
+        // Constructor
+        Pump();
+        // Set up LEDC timer PUMP_TIMER, and the next free LEDC channel, to drive arg_pin, starting off
+        // Returns false if there is no channel left, or the LEDC could not be set up
+        bool init(gpio_num_t arg_pin);
+        // Run as described by profile for ms_run, counting the soft start, blocking until it is off again
+        // Runs longer than PUMP_MS_MAX_RUN are cut short
+        // Returns false if the pump was not set up
+        bool run(
+            const pump_profile_t *profile,
+            uint32_t ms_run);
+
+    private:
+        // Set the duty cycle to duty, right away
+        void set_duty(uint32_t duty);
+
+        // The GPIO pin driving the MOSFET
+        gpio_num_t pin;
+        // The LEDC channel driving the pin, PUMP_FIRST_CHANNEL + PUMP_MAX_PUMPS if not set up
+        ledc_channel_t channel;
+};
+
+#endif // __PUMP_H__
\ No newline at end of file
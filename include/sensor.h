@@ -0,0 +1,206 @@
+#ifndef __SENSOR_H__
+#define __SENSOR_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Include ESP32 ADC driver API, for continuous (DMA) mode
+#include "driver/adc.h"
+// Include ESP32 ADC calibration API, for converting readings to millivolts
+#include "esp_adc_cal.h"
+// Include ESP32 GPIO API, for powering the sensor
+#include "driver/gpio.h"
+// Include FreeRTOS common header
+#include "freertos/FreeRTOS.h"
+// Include FreeRTOS semaphore API
+#include "freeRTOS/semphr.h"
+// Include FreeRTOS software timer API
+#include "freertos/timers.h"
+// Include custom sample reduction API
+#include "sensor_reduce.h"
+
+// This reads analog sensors on ADC1 pins by taking a burst of samples in ADC continuous (DMA) mode,
+// then reducing each sensor's samples to one reading that single noisy samples can't move much.
+// Sensors on different pins (ex. several probes in one pot) are read in the same burst, the ADC takes turns
+// sampling each pin, so they are read at the same time, instead of one after another.
+// A single analogRead() on the ESP32 is off by dozens of counts, and costs the CPU the whole conversion.
+// Here the ADC fills a DMA buffer on its own while the reading task blocks, so the CPU is only spent reducing the burst,
+// see: sensor_reduce_samples. PRINT_SENSOR_DIAGNOSTICS prints how long that takes next to one analogRead(), to compare.
+// NOTE: The ESP32 only supports continuous mode on ADC1 (GPIO 32 to 39).
+// https://docs.espressif.com/projects/esp-idf/en/v4.4/esp32/api-reference/peripherals/adc.html
+//
+// The sensors can be powered from a GPIO (or a transistor switched by one), so they are only powered around readings.
+// This keeps it from corroding and drawing current between readings. After powering on, it is given time to warm up
+// before being sampled, and after a reading, it is kept on for as long as it takes to warm up, in case another reading
+// comes soon. Staying on any longer costs more than warming up again. Readings asked for while another is being taken
+// share its powered window, and get its result if its burst started after they asked.
+
+// Define the most samples one burst can take from each pin
+#define SENSOR_MAX_SAMPLES 128
+// Define the most pins read in one burst, every ADC1 pin, so one sensor can read every zone's probes, see: ZoneScheduler
+#define SENSOR_MAX_CHANNELS 8
+// Define the rate, in Hz, samples are taken at during a burst, the ESP32's lowest rate for continuous mode
+// This is shared by all pins, each pin is sampled at this divided by the number of pins
+#define SENSOR_SAMPLE_FREQ_HZ 20000
+// Define the number of bytes the ADC writes per sample
+#define SENSOR_BYTES_PER_SAMPLE 2
+// Define how many bursts the driver's ring buffer holds, before it starts dropping samples
+// This is allocated once by init(), a capture that falls behind by less than this loses nothing
+#define SENSOR_NUM_RING_BUF_BURSTS 8
+// Define the longest, in milliseconds, to wait for a burst to be captured
+#define SENSOR_MS_READ_TIMEOUT 100
+// Define the longest, in milliseconds, past the warm-up, to wait for another task's burst to finish before giving up on the sensor
+// A burst takes far less, a capture holds the sensor for up to CAPTURE_MS_MAX_WINDOW, which is not worth waiting for
+#define SENSOR_MS_LOCK_TIMEOUT 500
+// Define the reference voltage, in millivolts, assumed when the chip has none burned into its eFuses
+#define SENSOR_DEFAULT_MV_VREF 1100
+
+// One reading reduced from a burst of samples from one pin
+typedef struct sensor_reading_s {
+    // The reduced raw ADC value, from 0 to 4095
+    uint16_t value;
+    // An estimate of how noisy the samples were, half the range of the middle half of them (the semi-interquartile range)
+    uint16_t noise;
+    // value converted to millivolts, if the sensor was initialized calibrated, otherwise 0
+    uint32_t mv;
+    // The number of samples reduced, fewer than asked for if the burst timed out
+    uint32_t num_samples;
+} sensor_reading_t;
+
+// How long a sensor has been powered, to tell how much energy powering it only around readings saves
+typedef struct sensor_power_stats_s {
+    // The time, in microseconds, the sensor has been powered since init()
+    uint64_t us_powered;
+    // The time, in microseconds, since init()
+    uint64_t us_since_init;
+    // The number of times the sensor was powered on
+    uint32_t num_power_windows;
+    // The number of bursts of samples taken
+    uint32_t num_bursts;
+    // The number of read() calls that got the result of a burst asked for by another, instead of taking their own
+    uint32_t num_coalesced_reads;
+} sensor_power_stats_t;
+
+// Analog sensors on up to SENSOR_MAX_CHANNELS ADC1 pins, read together in bursts
+class Sensor
+{
+    public:
+        // Constructor
+        Sensor();
+        // Set up the ADC to take num_samples samples from each of the num_pins pins every read(), and reduce them with reduction
+        // If is_calibrated, also convert readings to millivolts with the reference voltage burned into the chip
+        // If arg_pin_power is not GPIO_NUM_NC, only power the sensors from it around readings, waiting arg_ms_warm_up after powering on
+        // Returns false if a pin is not an ADC1 pin, or the ADC could not be set up
+        bool init(
+            const gpio_num_t *pins,
+            size_t num_pins,
+            adc_atten_t atten,
+            size_t arg_num_samples,
+            SENSOR_REDUCTION_t arg_reduction,
+            bool arg_is_calibrated,
+            gpio_num_t arg_pin_power,
+            uint32_t arg_ms_warm_up);
+        // Get the number of pins read, and so the number of readings read() writes
+        size_t get_num_channels();
+        // Get the rate, in Hz, each pin is sampled at
+        uint32_t get_channel_sample_hz();
+        // Take a burst of samples and reduce them into out_readings, one per pin, in the order passed to init(), blocking until it is captured
+        // If another task is taking a burst, wait for it, and take its result if it started after this was called
+        // Returns false if the sensor is busy for longer than a burst takes (ex. being captured),
+        // or if no samples were captured from any pin, a pin with no samples reads 0 with num_samples 0
+        bool read(sensor_reading_t *out_readings);
+        // Copy how long the sensor has been powered into out_stats, all zeros if the sensor is busy for longer than a burst takes
+        void get_power_stats(sensor_power_stats_t *out_stats);
+        // Keep the sensor to one caller, waiting up to ms_timeout for read() calls to finish, then power it and start the ADC
+        // Samples are taken continuously at get_channel_sample_hz() until stop_capture(), read() calls fail until then
+        // Returns false if the sensor could not be taken
+        bool start_capture(uint32_t ms_timeout);
+        // Copy up to max_samples (at most SENSOR_MAX_SAMPLES) samples taken since the last call from the pin at index into out_samples,
+        // waiting up to ms_timeout for them, samples from the other pins are thrown away
+        // out_is_overrun is set if samples were dropped since the last call because they were not read fast enough
+        // Returns the number of samples copied, 0 if none came in time
+        size_t read_capture(
+            size_t index,
+            uint16_t *out_samples,
+            size_t max_samples,
+            uint32_t ms_timeout,
+            bool *out_is_overrun);
+        // Stop the ADC, and let read() calls use the sensor again
+        void stop_capture();
+
+    private:
+        // Power the sensor on, throw away samples left over from the last burst, and start the ADC, must hold the mutex
+        void start_adc();
+        // Stop the ADC, and power the sensor off later, must hold the mutex
+        void stop_adc();
+        // Read up to max_bytes of samples the ADC has taken into dma_buf, waiting up to ms_timeout for them
+        // out_is_overrun is set if samples were dropped because they were not read fast enough
+        // Returns the number of bytes read, 0 if none came in time
+        uint32_t read_dma(
+            uint32_t max_bytes,
+            uint32_t ms_timeout,
+            bool *out_is_overrun);
+        // Get the index of the pin the sample at byte offset in dma_buf was taken from, num_channels if it is not one of ours
+        size_t get_sample_index(
+            uint32_t offset,
+            uint16_t *out_sample);
+        // Power the sensor on and wait for it to warm up, if it is not already on, must hold the mutex
+        void power_on();
+        // Power the sensor off, if it is on, must hold the mutex
+        void power_off();
+        // Use non-member function as the timer callback, so it can be passed to xTimerCreate
+        friend void timer_power_off_sensor(TimerHandle_t timer_handle);
+        // Reduce the first num_captured samples of the pin at index into out_reading
+        void reduce(
+            size_t index,
+            size_t num_captured,
+            sensor_reading_t *out_reading);
+
+        // A handle to a mutex, so only one task uses the ADC at a time
+        SemaphoreHandle_t mutex_handle;
+        // The ADC1 channels of the pins being read
+        adc1_channel_t channels[SENSOR_MAX_CHANNELS];
+        // The number of pins being read
+        size_t num_channels;
+        // The number of samples to take from each pin every read()
+        size_t num_samples;
+        // How samples are reduced to one reading
+        SENSOR_REDUCTION_t reduction;
+        // Whether to convert readings to millivolts
+        bool is_calibrated;
+        // The characteristics of the ADC, used to convert readings to millivolts
+        esp_adc_cal_characteristics_t adc_chars;
+        // The buffer the ADC's DMA writes samples into, the samples of every pin, interleaved
+        uint8_t dma_buf[SENSOR_MAX_CHANNELS * SENSOR_MAX_SAMPLES * SENSOR_BYTES_PER_SAMPLE];
+        // The samples taken from dma_buf, split by pin, sorted when reduced
+        uint16_t samples[SENSOR_MAX_CHANNELS][SENSOR_MAX_SAMPLES];
+
+        // The GPIO pin powering the sensor, GPIO_NUM_NC if it is always powered
+        gpio_num_t pin_power;
+        // How long, in milliseconds, the sensor takes to warm up after powering on
+        uint32_t ms_warm_up;
+        // A handle to a timer that powers the sensor off, restarted after every burst
+        TimerHandle_t power_timer_handle;
+        // Whether the sensor is powered
+        bool is_powered;
+        // When, in microseconds since boot, init() was called
+        int64_t us_init;
+        // When, in microseconds since boot, the sensor was last powered on
+        int64_t us_power_on;
+        // The time, in microseconds, the sensor was powered for before it was last powered on
+        uint64_t us_powered_before;
+        // The number of times the sensor was powered on
+        uint32_t num_power_windows;
+        // The number of bursts of samples taken
+        uint32_t num_bursts;
+        // The number of read() calls that got the result of another's burst
+        uint32_t num_coalesced_reads;
+        // When, in microseconds since boot, the last burst started, and what it was reduced to
+        int64_t us_last_burst;
+        sensor_reading_t last_readings[SENSOR_MAX_CHANNELS];
+};
+
+// Define a timer callback for powering the sensor off once it has not been read for as long as it takes to warm up
+void timer_power_off_sensor(TimerHandle_t timer_handle);
+
+#endif // __SENSOR_H__
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef __SENSOR_REDUCE_H__
+#define __SENSOR_REDUCE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// This reduces a burst of ADC samples from one pin to one reading, and an estimate of how noisy they were,
+// without touching the ADC, so the same reduction runs in Sensor, and on synthetic bursts in tests.
+
+// How a burst of samples is reduced to one reading
+enum SENSOR_REDUCTION_t : uint8_t
+{
+    // The middle sample
+    SENSOR_REDUCTION_MEDIAN = 0,
+    // The mean of the middle half of the samples, smoother than the median, while still ignoring outliers
+    SENSOR_REDUCTION_TRIMMED_MEAN,
+    SENSOR_REDUCTION_MAX
+};
+
+// Reduce the num_samples samples to out_value, and half the range of the middle half of them (the semi-interquartile range) to out_noise
+// NOTE: This sorts samples in place, and num_samples must be at least 1
+void sensor_reduce_samples(
+    uint16_t *samples,
+    size_t num_samples,
+    SENSOR_REDUCTION_t reduction,
+    uint16_t *out_value,
+    uint16_t *out_noise);
+
+#endif // __SENSOR_REDUCE_H__
\ No newline at end of file
@@ -0,0 +1,67 @@
+#ifndef __SEQLOCK_H__
+#define __SEQLOCK_H__
+
+#include <stdint.h>
+#include <string.h>
+
+// Include FreeRTOS common header
+#include "freertos/FreeRTOS.h"
+// Include FreeRTOS task API
+#include "freertos/task.h"
+
+// A value that many readers can copy out without ever blocking, while it is being written to
+// Writing bumps a sequence number to odd before changing the value, and back to even after.
+// Readers copy the value between two reads of the sequence number, and try again if it was odd or changed,
+// so a copy that was torn by a write in the middle of it is never handed out.
+// https://en.wikipedia.org/wiki/Seqlock
+// NOTE: Writes are done in a critical section, so a writer can't be preempted halfway through by a reader spinning on its core.
+//       Keep T small, interrupts are disabled on the writer's core while it is copied.
+template <typename T>
+class Seqlock
+{
+    public:
+        // Constructor
+        Seqlock() :
+            sequence(0),
+            value(),
+            spinlock(portMUX_INITIALIZER_UNLOCKED)
+        {
+        }
+        // Replace the value with new_value, this is safe to call from many tasks at once
+        void store(const T *new_value)
+        {
+            portENTER_CRITICAL(&spinlock);
+            // Mark the value as being written, before any of it changes
+            __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            memcpy(&value, new_value, sizeof(value));
+            // Mark the value as done being written, after all of it changed
+            __atomic_store_n(&sequence, sequence + 1, __ATOMIC_RELEASE);
+            portEXIT_CRITICAL(&spinlock);
+        }
+        // Copy the value into out_value, never blocking, and never copying a value that is halfway written
+        // Returns the sequence number of the value copied, it goes up by 2 every store()
+        uint32_t load(T *out_value) const
+        {
+            uint32_t sequence_before = 0;
+            uint32_t sequence_after = 0;
+            do
+            {
+                sequence_before = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE);
+                memcpy(out_value, &value, sizeof(value));
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                sequence_after = __atomic_load_n(&sequence, __ATOMIC_RELAXED);
+            } while((0 != (sequence_before & 1)) || (sequence_before != sequence_after));
+            return sequence_before;
+        }
+
+    private:
+        // Odd while the value is being written, even otherwise
+        uint32_t sequence;
+        // The value being protected
+        T value;
+        // A spinlock keeping writers from interleaving, and from being preempted while writing
+        portMUX_TYPE spinlock;
+};
+
+#endif // __SEQLOCK_H__
\ No newline at end of file
@@ -0,0 +1,219 @@
+#ifndef __SERVO_H__
+#define __SERVO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Include ESP32 LED PWM controller API, for generating servo pulses and fading between them in hardware
+#include "driver/ledc.h"
+// Include ESP32 GPIO API
+#include "driver/gpio.h"
+// Include FreeRTOS common header
+#include "freertos/FreeRTOS.h"
+// Include FreeRTOS semaphore API
+#include "freeRTOS/semphr.h"
+
+// Include custom lock-free snapshot API
+#include "seqlock.h"
+// Include custom servo budget API
+#include "servo_budget.h"
+// Include custom debug macros and compile flags
+#include "flags.h"
+
+// This moves a hobby servo by generating its pulses with the ESP32's LEDC (LED PWM) peripheral.
+// Each move is a hardware fade of the pulse width, the LEDC steps the duty once per PWM period on its own,
+// so the servo moves at a set speed, and the CPU is not involved until the fade-end interrupt says the move is done.
+// A squirt is a trapezoid: move to the squeeze angle at a set speed, hold it, move back at a set speed, then rest.
+// Hobby servos do not report where they are, so a move is taken as done once its fade is, pick fade times the servo can keep up with.
+// Between squirts the pulses are stopped (detached), so the servo does not jitter or draw current holding its position.
+// https://docs.espressif.com/projects/esp-idf/en/v4.4/esp32/api-reference/peripherals/ledc.html
+//
+// Servos draw several times more current moving than resting, mostly as they start, so several starting together
+// on one 5 V supply can brown out the rail and reset the board. A ServoScheduler owns every servo, and only lets a set number
+// of them squeeze at once (the concurrency budget), starting each squeeze at least a set stagger after the one before.
+// A servo holding the squeeze angle pushes against what it squeezes, drawing nearly as much as moving, so the budget is held
+// from the start of the squeeze until the release ends, and only the rest is left out, see: servo_budget.h
+// One servo can squeeze while another rests, which interleaves their squirts as tightly as the budget allows.
+// A budget of 1 serializes every squeeze.
+
+// Define the rate, in Hz, pulses are sent at, the rate hobby servos expect
+#define SERVO_PWM_FREQ_HZ 50
+// Define the resolution of the pulse width, in bits, the highest the LEDC supports at SERVO_PWM_FREQ_HZ on every ESP32
+#define SERVO_DUTY_RESOLUTION LEDC_TIMER_14_BIT
+#define SERVO_DUTY_BITS 14
+// Define the pulse widths, in microseconds, of the lowest and highest angles, the same as the Arduino Servo library
+#define SERVO_US_MIN_PULSE 544
+#define SERVO_US_MAX_PULSE 2400
+// Define the highest angle, in degrees
+#define SERVO_MAX_ANGLE 180
+// Define the shortest fade, in milliseconds, a shorter fade is lengthened to this, so it has at least one step
+#define SERVO_MS_MIN_FADE (1000 / SERVO_PWM_FREQ_HZ)
+// Define how much longer, in milliseconds, than a fade to wait for it to end, before giving up on the interrupt
+#define SERVO_MS_FADE_TIMEOUT_MARGIN 100
+// Define the LEDC speed mode used, every ESP32 has the low speed mode
+#define SERVO_SPEED_MODE LEDC_LOW_SPEED_MODE
+
+// Define the most servos a ServoScheduler owns, each takes the next LEDC channel, starting from SERVO_SCHEDULER_FIRST_CHANNEL
+#define SERVO_SCHEDULER_MAX_SERVOS 4
+#define SERVO_SCHEDULER_FIRST_CHANNEL LEDC_CHANNEL_0
+// Define the LEDC timer every servo a ServoScheduler owns shares
+#define SERVO_SCHEDULER_TIMER LEDC_TIMER_0
+
+// How a servo squirts, see: ServoMotor::squirt
+typedef struct servo_profile_s {
+    // The angle, in degrees, the servo rests at between squirts
+    uint8_t angle_rest;
+    // The angle, in degrees, the servo squeezes to
+    uint8_t angle_squeeze;
+    // How long, in milliseconds, to move from angle_rest to angle_squeeze, this sets how fast the servo squeezes
+    uint16_t ms_squeeze;
+    // How long, in milliseconds, to hold angle_squeeze
+    uint16_t ms_hold;
+    // How long, in milliseconds, to move from angle_squeeze back to angle_rest
+    uint16_t ms_release;
+    // How long, in milliseconds, to wait at angle_rest after releasing, so what the servo squeezes springs back before the next squirt
+    uint16_t ms_rest;
+} servo_profile_t;
+
+// How long squirts have taken, to tell how many squirts a second a servo can deliver
+typedef struct servo_stats_s {
+    // The number of squirts done since init()
+    uint32_t num_squirts;
+    // The time, in microseconds, the last squirt took, from starting to squeeze until done resting
+    uint32_t us_last_squirt;
+    // The time, in microseconds, all squirts took
+    uint64_t us_squirts;
+    // The number of moves whose fade-end interrupt did not come in time
+    uint32_t num_fade_timeouts;
+    // The number of times pulses were started again after being stopped
+    uint32_t num_attaches;
+} servo_stats_t;
+
+// How a ServoScheduler has held squeezes back, to tell whether its budget is too tight
+typedef struct servo_scheduler_stats_s {
+    // The number of squeezes started, each moves to the squeeze angle, holds it, and moves back
+    uint32_t num_moves;
+    // The number of squeezes that waited for another to end, because the budget was used up
+    uint32_t num_budget_waits;
+    // The number of squeezes that waited for the stagger after the last start
+    uint32_t num_stagger_waits;
+    // The time, in microseconds, squeezes spent waiting altogether
+    uint64_t us_waited;
+    // The most servos that have squeezed at once
+    uint8_t max_moving_seen;
+} servo_scheduler_stats_t;
+
+class ServoScheduler;
+
+// A hobby servo driven by one LEDC channel
+class ServoMotor
+{
+    public:
+        // Constructor
+        ServoMotor();
+        // Set up LEDC timer arg_timer to SERVO_PWM_FREQ_HZ, and LEDC channel arg_channel to send its pulses out of arg_pin
+        // Servos can share a timer, but each needs its own channel
+        // Every squeeze waits for arg_scheduler's budget, if it is not nullptr
+        // Pulses are not sent until the first squirt()
+        // Returns false if the LEDC could not be set up
+        bool init(
+            gpio_num_t arg_pin,
+            ledc_timer_t arg_timer,
+            ledc_channel_t arg_channel,
+            ServoScheduler *arg_scheduler);
+        // Squirt once as described by profile, blocking until the servo is back at rest
+        // Returns false if a move could not be started, or its fade did not end in time
+        bool squirt(const servo_profile_t *profile);
+        // Stop sending pulses, so the servo does not jitter or draw current holding its position, the next squirt() starts them again
+        void detach();
+        // Copy how long squirts have taken into out_stats, never blocking
+        void get_stats(servo_stats_t *out_stats);
+
+    private:
+        // Start sending pulses for angle, if they were stopped
+        void attach(uint8_t angle);
+        // Fade the pulse width to angle over ms_fade, and wait for the fade-end interrupt
+        // Returns false if the fade could not be started, or did not end in time
+        bool move(
+            uint8_t angle,
+            uint32_t ms_fade);
+        // Get the duty cycle of the pulses for angle
+        uint32_t get_duty(uint8_t angle);
+        // Use non-member function as the interrupt handler, so it can be passed to ledc_cb_register
+        friend bool isr_servo_fade_end(
+            const ledc_cb_param_t *param,
+            void *user_arg);
+
+        // The scheduler whose budget every squeeze waits for, nullptr if squeezes are not budgeted
+        ServoScheduler *scheduler;
+        // The GPIO pin the pulses are sent out of
+        gpio_num_t pin;
+        // The LEDC timer and channel generating the pulses
+        ledc_timer_t timer;
+        ledc_channel_t channel;
+        // Given by the fade-end interrupt, taken by move()
+        SemaphoreHandle_t fade_done_semaphore_handle;
+        StaticSemaphore_t fade_done_semaphore_buffer;
+        // Whether pulses are being sent
+        bool is_attached;
+        // The angle, in degrees, the pulses were last set to
+        uint8_t angle;
+        // How long squirts have taken, published after every squirt, so it can be read from other tasks without locking
+        servo_stats_t stats;
+        Seqlock<servo_stats_t> stats_snapshot;
+};
+
+// Every servo sharing one supply, and the budget of how many of them may squeeze at once
+// Each servo is squirted from its own task, a squeeze waits for the budget, blocking that task, so other servos keep going
+class ServoScheduler
+{
+    public:
+        // Constructor, let max_moving servos squeeze at once, starting squeezes at least ms_stagger apart
+        ServoScheduler(
+            uint8_t max_moving,
+            uint32_t ms_stagger);
+        // Set up a servo sending its pulses out of pin, on the next free LEDC channel
+        // Returns its index, or SERVO_SCHEDULER_MAX_SERVOS if there is no channel left, or the LEDC could not be set up
+        size_t add_servo(gpio_num_t pin);
+        // Squirt servo index once as described by profile, blocking until it is back at rest, see: ServoMotor::squirt
+        bool squirt(
+            size_t index,
+            const servo_profile_t *profile);
+        // Stop sending pulses to servo index, see: ServoMotor::detach
+        void detach(size_t index);
+        // Copy how long servo index's squirts have taken into out_stats, never blocking
+        void get_servo_stats(
+            size_t index,
+            servo_stats_t *out_stats);
+        // Copy how squeezes have been held back into out_stats
+        void get_stats(servo_scheduler_stats_t *out_stats);
+
+    private:
+        // Block until the budget allows a squeeze to start, then count it as squeezing
+        void start_squeeze();
+        // Count a squeeze as back at rest, letting the next one waiting start
+        void end_squeeze();
+        // Let servos wait for the budget around their squeezes
+        friend class ServoMotor;
+
+        // The servos, the first num_servos are set up
+        ServoMotor servos[SERVO_SCHEDULER_MAX_SERVOS];
+        size_t num_servos;
+        // Guards budget and stats
+        SemaphoreHandle_t mutex_handle;
+        StaticSemaphore_t mutex_buffer;
+        // Counts the squeezes the budget has room for, so a squeeze waiting for room blocks on it instead of polling
+        SemaphoreHandle_t room_semaphore_handle;
+        StaticSemaphore_t room_semaphore_buffer;
+        // How many servos may squeeze at once, and how many are
+        servo_budget_t budget;
+        // How squeezes have been held back
+        servo_scheduler_stats_t stats;
+};
+
+// Define an interrupt handler for a servo's fade ending, so the task waiting on it can move on
+bool isr_servo_fade_end(
+    const ledc_cb_param_t *param,
+    void *user_arg);
+
+#endif // __SERVO_H__
\ No newline at end of file
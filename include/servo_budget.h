@@ -0,0 +1,44 @@
+#ifndef __SERVO_BUDGET_H__
+#define __SERVO_BUDGET_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// This decides when a servo may start a squeeze, without touching FreeRTOS or the LEDC,
+// so the same policy runs in ServoScheduler, and on a virtual clock in tests.
+// A servo draws several times more current moving, and pushing against what it squeezes, than resting, so a squeeze is counted
+// from when it starts moving to the squeeze angle, through holding it, until it is back at rest. Only max_moving squeezes
+// are counted at once, and each starts at least a set stagger after the one before, that is when a servo draws the most current.
+
+// Define what servo_budget_try_start returns when as many servos as the budget allows are already squeezing
+#define SERVO_BUDGET_FULL -1
+
+// How many servos may squeeze at once, and how many are
+typedef struct servo_budget_s {
+    // The most servos squeezing at once
+    uint8_t max_moving;
+    // The least time, in microseconds, between the starts of two squeezes
+    int64_t us_stagger;
+    // The number of servos squeezing now
+    uint8_t num_moving;
+    // When the last squeeze started
+    int64_t us_last_start;
+    // Whether any squeeze has started
+    bool is_started;
+} servo_budget_t;
+
+// Set budget to let max_moving servos squeeze at once, starting squeezes at least ms_stagger apart, with none squeezing
+void servo_budget_init(
+    servo_budget_t *budget,
+    uint8_t max_moving,
+    uint32_t ms_stagger);
+// Start a squeeze at us_now if the budget allows it, counting it as squeezing until servo_budget_end
+// Returns 0 if the squeeze started, the time, in microseconds, to wait before calling this again if the stagger holds it back,
+// or SERVO_BUDGET_FULL if the budget is used up, call this again after servo_budget_end
+int64_t servo_budget_try_start(
+    servo_budget_t *budget,
+    int64_t us_now);
+// Count a squeeze started by servo_budget_try_start as back at rest
+void servo_budget_end(servo_budget_t *budget);
+
+#endif // __SERVO_BUDGET_H__
\ No newline at end of file
@@ -0,0 +1,162 @@
+#ifndef __WATERING_H__
+#define __WATERING_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// Include custom soil moisture calibration API
+#include "calibration.h"
+
+// This is what a Context learns about how its pot dries and takes up water, and the math that decides from it
+// when to check the soil moisture next, how much to dose, and when the water has soaked in, see: Context::step_water
+// None of it touches the ESP32's peripherals or FreeRTOS, so it is kept apart from Context, and can be tested on a computer,
+// see: [env:native] in platformio.ini
+// Soil moisture is kept as percent volumetric water content, in fixed point, see: CALIBRATION_PERCENT_Q8
+
+// Define how the soil moisture history estimates how fast the soil is drying, see: soil_moisture_history_t
+// Define the number of readings since the last watering kept to estimate how fast the soil is drying
+#define CONTEXT_SOIL_MOISTURE_HISTORY_LENGTH 8
+// Define the number of readings needed before a line is fit through them, until then the adaptive interval is its minimum
+#define CONTEXT_MIN_SOIL_MOISTURE_HISTORY_FIT 3
+// Define how much wetter a reading must be than the one before it to count as the pot having been watered,
+// which starts the history over, since how fast it dried before watering says little about after
+#define CONTEXT_SOIL_MOISTURE_WATERED_RISE CALIBRATION_PERCENT_Q8(1)
+// Define how much each new reading wears the fastest drying rate seen down towards how fast the soil is drying now,
+// by this share of the difference, see: soil_moisture_history_t
+#define CONTEXT_MAX_DRYING_DECAY 0.05f
+// Define the share of the time the soil is projected to take to dry to desired that an adaptive schedule waits,
+// so the check lands before desired even if the soil dries up to 1 / this faster than projected,
+// and checks come closer together as the soil nears desired, instead of sleeping past it
+#define CONTEXT_PROJECTED_CHECK_SHARE 0.5f
+
+// Define how watering doses water, see: dose_model_t
+// Define the number of dose/read pairs learned from before doses are batched, until then it doses one unit per read
+#define CONTEXT_DOSE_MODEL_MIN_SAMPLES 2
+// Define how much each new dose/read pair moves the learned average, older pairs decay by (1 - this) every new pair
+#define CONTEXT_DOSE_MODEL_WEIGHT 0.25f
+// Define the most units (squirts, or seconds of running) watering doses before reading the soil moisture sensor again
+#define CONTEXT_MAX_UNITS_PER_BATCH 10
+
+// Define how watering waits for water to soak into the soil after dosing, see: soak_curve_t and soak_model_t
+// Define the least time, in milliseconds, after dosing before a reading can count as settled
+#define CONTEXT_MS_SOAK 5000
+// Define the settle time, in milliseconds, assumed until one has been learned
+#define CONTEXT_MS_DEFAULT_SOAK_SETTLE (60 * 1000)
+// Define the shortest and longest time, in milliseconds, between readings while water soaks in,
+// each interval is twice the one before it, starting from half the learned settle time
+#define CONTEXT_MS_MIN_SOAK_INTERVAL 2000
+#define CONTEXT_MS_MAX_SOAK_INTERVAL (30 * 1000)
+// Define the longest time, in milliseconds, to wait for readings to settle, after which the last reading is used
+#define CONTEXT_MS_SOAK_TIMEOUT (3 * 60 * 1000)
+// Define how slowly, in soil moisture per minute, readings must change to count as settled
+#define CONTEXT_SOAK_SETTLED_MOISTURE_PER_MINUTE CALIBRATION_PERCENT_Q8(0.125)
+// Define how much two readings can differ from noise alone, they count as settled if they are this close, however far apart
+#define CONTEXT_SOAK_SETTLED_MOISTURE_NOISE CALIBRATION_PERCENT_Q8(0.1)
+// Define how much each new settle time moves the learned average, older settle times decay by (1 - this) every new one
+#define CONTEXT_SOAK_MODEL_WEIGHT 0.25f
+// Define the most readings kept of water soaking in, reaching it counts as timing out
+#define CONTEXT_SOAK_CURVE_LENGTH 16
+
+// The readings of water soaking into the soil after a dose
+// Water takes a while to reach the probe, so readings keep getting wetter for a while after dosing.
+// Watering reads at growing intervals until two readings in a row are close enough to count as settled,
+// and only then decides whether to dose again.
+typedef struct soak_curve_s {
+    // The soil moisture before dosing
+    uint16_t soil_moisture_before;
+    // The readings after dosing, oldest first
+    uint16_t soil_moistures[CONTEXT_SOAK_CURVE_LENGTH];
+    // How long after dosing each reading was, in milliseconds
+    uint32_t ms_after_dose[CONTEXT_SOAK_CURVE_LENGTH];
+    // The number of readings held
+    size_t num_readings;
+    // Whether the readings settled, instead of timing out
+    bool is_settled;
+} soak_curve_t;
+
+// What a Context has learned about how long water takes to soak into its pot
+typedef struct soak_model_s {
+    // An exponentially weighted moving average of how long, in milliseconds, readings took to settle after dosing
+    uint32_t ms_settle;
+    // Whether ms_settle has been learned from a settled curve yet, instead of being CONTEXT_MS_DEFAULT_SOAK_SETTLE
+    bool is_learned;
+} soak_model_t;
+
+// Add a reading taken ms_after_dose after dosing to curve, return whether the curve settled
+// A full curve never settles
+bool soak_curve_add(
+    soak_curve_t *curve,
+    uint16_t soil_moisture,
+    uint32_t ms_after_dose);
+// Learn how long curve took to settle, return false if it did not settle, so nothing was learned
+bool soak_model_learn(
+    soak_model_t *soak_model,
+    const soak_curve_t *curve);
+
+// How a Context decides when to next check the soil moisture
+typedef struct check_schedule_s {
+    // Whether to check when the soil is projected to dry to desired_soil_moisture, instead of every minute_soil_moisture_check_freq
+    bool is_adaptive;
+    // The shortest time, in minutes, an adaptive schedule waits between checks
+    uint32_t minute_min_check_freq;
+    // The longest time, in minutes, an adaptive schedule waits between checks
+    uint32_t minute_max_check_freq;
+} check_schedule_t;
+
+// The readings since the pot was last watered, oldest first, used to estimate how fast it is drying
+typedef struct soil_moisture_history_s {
+    uint16_t soil_moistures[CONTEXT_SOIL_MOISTURE_HISTORY_LENGTH];
+    time_t times[CONTEXT_SOIL_MOISTURE_HISTORY_LENGTH];
+    // The number of readings held, once full, the oldest is dropped for every new one
+    size_t num_readings;
+    // The fastest the soil has been seen drying, in soil moisture per second, from the lines fit through the readings,
+    // this is not started over when the pot is watered, so what was seen by day is remembered through the night
+    float max_drying_per_sec;
+} soil_moisture_history_t;
+
+// Add a reading to history, starting it over if the reading shows the pot was watered, and update the fastest drying rate seen
+void soil_moisture_history_add(
+    soil_moisture_history_t *history,
+    uint16_t soil_moisture,
+    time_t time_reading);
+// Fit a line to history, and predict how many minutes after its newest reading the soil dries to desired_soil_moisture,
+// drying at the faster of the line and the fastest drying rate seen, waits CONTEXT_PROJECTED_CHECK_SHARE of that,
+// at most the time history spans, and clamped between the minimum and maximum of check_schedule
+uint32_t soil_moisture_history_predict_minute_interval(
+    const soil_moisture_history_t *history,
+    uint16_t desired_soil_moisture,
+    const check_schedule_t *check_schedule);
+
+// What a Context has learned about how its pot responds to water
+// Instead of dosing a little and reading the sensor after each dose, watering predicts how much water
+// reaches the desired soil moisture, doses that much at once, then reads the sensor and learns from the result.
+// Water is counted by volume, so what is learned holds whatever actuator delivers it, see: Actuator
+// NOTE: Predictions are rounded down, so a batch stops short of the desired soil moisture instead of going past it,
+//       and the last bit is made up by dosing once more.
+typedef struct dose_model_s {
+    // The average rise in soil moisture from one millilitre of water, once it soaks in
+    // Every new dose/read pair moves it CONTEXT_DOSE_MODEL_WEIGHT of the way towards what that pair saw
+    float moisture_per_ml;
+    // The number of dose/read pairs learned from, it stops counting at CONTEXT_DOSE_MODEL_MIN_SAMPLES
+    uint32_t num_samples;
+} dose_model_t;
+
+// Predict the volume, in microlitres, that will bring the soil moisture from current_soil_moisture to, but not past,
+// desired_soil_moisture, a whole number of ul_min_dose, from ul_min_dose to CONTEXT_MAX_UNITS_PER_BATCH units of ul_per_unit
+// Until enough has been learned, this is one unit
+uint32_t dose_model_predict(
+    const dose_model_t *dose_model,
+    uint16_t current_soil_moisture,
+    uint16_t desired_soil_moisture,
+    uint32_t ul_per_unit,
+    uint32_t ul_min_dose);
+// Learn from ul_dosed microlitres moving the soil moisture from before_soil_moisture to after_soil_moisture
+// Returns whether the model changed, readings that did not get wetter are ignored, the water may not have soaked in yet
+bool dose_model_learn(
+    dose_model_t *dose_model,
+    uint16_t before_soil_moisture,
+    uint16_t after_soil_moisture,
+    uint32_t ul_dosed);
+
+#endif // __WATERING_H__
\ No newline at end of file
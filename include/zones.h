@@ -0,0 +1,141 @@
+#ifndef __ZONES_H__
+#define __ZONES_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Include FreeRTOS common header
+#include "freertos/FreeRTOS.h"
+// Include FreeRTOS task API
+#include "freertos/task.h"
+// Include FreeRTOS semaphore API
+#include "freeRTOS/semphr.h"
+
+// Include custom analog sensor API
+#include "sensor.h"
+// Include custom actuator API
+#include "actuator.h"
+// Include custom debug macros and compile flags
+#include "flags.h"
+
+// A shelf of pots is watered as zones, one Context per pot, each with its own probes, actuator, settings, and schedule.
+// Zones spend nearly all their time waiting (for the next check, for a dose, for water to soak in), so instead of
+// every zone having tasks of its own, a ZoneScheduler runs them all:
+// - One schedule task keeps every zone's next deadline in a min-heap, sleeps until the soonest, and steps that zone's
+//   watering (check, dose, soak, check again) one step at a time, see: Context::step_water
+// - A few actuate tasks take turns dosing every zone's queued requests, see: Context::step_actuate
+// - One Sensor reads every zone's probes, the ESP32 has one ADC continuous-mode driver, so zones can't each have their own
+// Anything that moves a zone's next step (ex. "Water now", or a new check frequency) notifies the schedule task with the zone's bit,
+// it re-keys just that zone. Adding a zone costs its Context, and no tasks or stacks.
+// NOTE: A step that reads the sensor blocks the schedule task for the sensor's warm up, the other zones' steps wait behind it.
+
+// Define the most zones, each zone has a bit of the schedule task's notification value, and every ADC1 pin can have a probe
+#define ZONE_MAX_ZONES 8
+// Define the number of tasks dosing, a servo squirt or a pump run blocks its task, so this many zones can dose at once,
+// more than CONTEXT_MAX_SERVOS_MOVING only helps pumps, servos past it wait for the servo scheduler anyway
+#define ZONE_NUM_ACTUATE_TASKS 2
+// Define the longest, in milliseconds, the schedule task sleeps, so its wait never overflows ticks, waking up early only means sleeping again
+#define ZONE_MS_MAX_SCHEDULE_WAIT (60 * 60 * 1000)
+
+static_assert(ZONE_MAX_ZONES <= 32, "Every zone needs a bit of a task notification value");
+
+// How one soil moisture probe is wired and weighed, see: soil_moisture_probe_t
+typedef struct soil_moisture_probe_config_s {
+    // The ADC1 pin the probe's signal is wired to
+    gpio_num_t pin;
+    // How much the probe counts towards the fused soil moisture, relative to the others, 0 to only show it
+    uint8_t weight;
+} soil_moisture_probe_config_t;
+
+// How one zone is wired, and where it keeps its settings, passed to its Context, and to the ZoneScheduler, which sets up every zone's probes
+typedef struct zone_config_s {
+    // What waters the zone
+    actuator_config_t actuator;
+    // The zone's soil moisture probes, up to CONTEXT_MAX_SOIL_MOISTURE_PROBES, a pin can be shared with other zones
+    const soil_moisture_probe_config_t *soil_moisture_probes;
+    size_t num_soil_moisture_probes;
+    // The namespace within NVS the zone's settings, and what it learned, are kept in, at most 15 characters
+    char *nvs_namespace;
+} zone_config_t;
+
+// A zone's next deadline
+typedef struct zone_deadline_s {
+    // When the zone's next step is due, from esp_timer_get_time
+    int64_t us_deadline;
+    // The zone's index
+    uint8_t zone;
+} zone_deadline_t;
+
+// A min-heap of zones' next deadlines, soonest first, each zone is in it at most once
+// Finding the soonest is O(1), and moving a zone's deadline is O(log n), the schedule task does both every step
+typedef struct zone_heap_s {
+    // The deadlines, deadlines[0] is the soonest, each is no later than its children at 2i + 1 and 2i + 2
+    zone_deadline_t deadlines[ZONE_MAX_ZONES];
+    size_t num_deadlines;
+    // Where each zone is in deadlines, ZONE_MAX_ZONES if it is not in it
+    uint8_t positions[ZONE_MAX_ZONES];
+} zone_heap_t;
+
+// Empty heap
+void zone_heap_init(zone_heap_t *heap);
+// Set the deadline of zone to us_deadline, adding zone if it is not in heap, moving it up or down to keep the soonest first
+void zone_heap_set(
+    zone_heap_t *heap,
+    uint8_t zone,
+    int64_t us_deadline);
+// Copy the soonest deadline into out_deadline
+// Returns false if heap is empty
+bool zone_heap_peek(
+    const zone_heap_t *heap,
+    zone_deadline_t *out_deadline);
+
+class Context;
+
+// Every zone, the tasks that run them, and the sensor reading their probes
+class ZoneScheduler
+{
+    public:
+        // Constructor, set up one sensor reading the probes of all num_zones zones in zone_configs, only powered around readings
+        // from pin_soil_moisture_sensor_power_out, then start the schedule and actuate tasks, they wait until zones are added
+        ZoneScheduler(
+            const zone_config_t *zone_configs,
+            size_t num_zones,
+            gpio_num_t pin_soil_moisture_sensor_power_out);
+        // Add zone, it is stepped once its next step is notified, see: notify_zone
+        // Returns its index, or ZONE_MAX_ZONES if there is no room
+        size_t add_zone(Context *zone);
+        // Tell the schedule task the next step of zone index moved, it asks the zone for it again
+        void notify_zone(size_t index);
+        // Get the semaphore every zone's dose queue gives when a dose is requested, it wakes an actuate task, see: ActuationQueue::set_executor
+        SemaphoreHandle_t get_actuate_semaphore_handle();
+        // Get the sensor reading every zone's probes
+        Sensor *get_soil_moisture_sensor();
+        // Get the index of the sensor's reading of the probe on pin, SENSOR_MAX_CHANNELS if no zone has a probe on it
+        size_t get_soil_moisture_sensor_channel(gpio_num_t pin);
+
+    private:
+        // Use non-member functions as the task entry points, so they can be passed to xTaskCreate
+        friend void task_schedule_zones(ZoneScheduler *zone_scheduler);
+        friend void task_actuate_zones(ZoneScheduler *zone_scheduler);
+
+        // The zones, the first num_zones are added
+        // NOTE: Zones are added while setting up, before any is notified, so this is not locked
+        Context *zones[ZONE_MAX_ZONES];
+        size_t num_zones;
+        // The sensor reading every zone's probes, and the pin read on each of its channels
+        Sensor soil_moisture_sensor;
+        gpio_num_t pins_soil_moisture_sensor[SENSOR_MAX_CHANNELS];
+        size_t num_soil_moisture_sensor_pins;
+        // A handle to the task stepping every zone's watering, see: task_schedule_zones
+        TaskHandle_t schedule_task_handle;
+        // Counts doses requested from any zone, so an actuate task waiting for one blocks on it instead of polling
+        SemaphoreHandle_t actuate_semaphore_handle;
+        StaticSemaphore_t actuate_semaphore_buffer;
+};
+
+// Define a task for stepping every zone's watering as each falls due, soonest first
+void task_schedule_zones(ZoneScheduler *zone_scheduler);
+// Define a task for dosing the requests queued in every zone, taking turns between zones
+void task_actuate_zones(ZoneScheduler *zone_scheduler);
+
+#endif // __ZONES_H__
\ No newline at end of file
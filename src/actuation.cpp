@@ -0,0 +1,348 @@
+// Include custom actuation queue API
+#include "actuation.h"
+// Include ESP32 high resolution timer API
+#include "esp_timer.h"
+// Include custom debug macros and compile flags
+#include "flags.h"
+
+// ==================================== //
+// Define ActuationQueue implementation //
+// ==================================== //
+
+ActuationQueue::ActuationQueue()
+{
+    mutex_handle = nullptr;
+    executor_semaphore_handle = nullptr;
+    for(size_t i = 0; i < ACTUATION_QUEUE_LENGTH; ++i)
+    {
+        requests[i] = {};
+    }
+    ticket_last = 0;
+    for(size_t i = 0; i < ACTUATION_MAX_WAITERS; ++i)
+    {
+        waiter_task_handles[i] = nullptr;
+        waiter_tickets[i] = 0;
+    }
+    us_min_gap = 0;
+    max_per_hour = 0;
+    us_last_actuation = 0;
+    for(size_t i = 0; i < ACTUATION_MAX_PER_HOUR_LIMIT; ++i)
+    {
+        s_actuations[i] = 0;
+    }
+    actuation_index = 0;
+    stats = {};
+}
+
+void ActuationQueue::init(
+    uint32_t ms_min_gap,
+    uint32_t arg_max_per_hour)
+{
+    // Create the mutex from static memory
+    mutex_handle = xSemaphoreCreateMutexStatic(/* StaticSemaphore_t *pxMutexBuffer = */ &mutex_buffer);
+    configASSERT(mutex_handle);
+
+    us_min_gap = (int64_t) ms_min_gap * 1000;
+    max_per_hour = (arg_max_per_hour < ACTUATION_MAX_PER_HOUR_LIMIT) ? arg_max_per_hour : ACTUATION_MAX_PER_HOUR_LIMIT;
+}
+
+void ActuationQueue::set_executor(SemaphoreHandle_t semaphore_handle)
+{
+    executor_semaphore_handle = semaphore_handle;
+}
+
+uint32_t ActuationQueue::request(
+    ACTUATION_SOURCE_t source,
+    ACTUATION_PRIORITY_t priority,
+    uint32_t amount)
+{
+    if((0 == amount) || (source >= ACTUATION_SOURCE_MAX))
+    {
+        return 0;
+    }
+
+    if(pdFALSE == xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY))
+    {
+        return 0;
+    }
+    ++stats.num_requests[source];
+
+    // Merge into the request waiting from the same source, if there is one, otherwise take a free slot
+    actuation_request_t *free_request = nullptr;
+    uint32_t ticket = 0;
+    for(size_t i = 0; i < ACTUATION_QUEUE_LENGTH; ++i)
+    {
+        actuation_request_t *request = &requests[i];
+        if(0 == request->ticket)
+        {
+            free_request = (nullptr == free_request) ? request : free_request;
+        }
+        else if((source == request->source) && (false == request->is_running))
+        {
+            request->amount = (amount > request->amount) ? amount : request->amount;
+            request->priority = (priority > request->priority) ? priority : request->priority;
+            ticket = request->ticket;
+            ++stats.num_merged;
+            break;
+        }
+    }
+    if((0 == ticket) && (nullptr != free_request))
+    {
+        // Skip 0 when the tickets wrap around, it marks an unused slot
+        ticket_last = (0 == (ticket_last + 1)) ? 1 : (ticket_last + 1);
+        ticket = ticket_last;
+        free_request->ticket = ticket;
+        free_request->source = source;
+        free_request->priority = priority;
+        free_request->is_running = false;
+        free_request->amount = amount;
+        free_request->us_queued = esp_timer_get_time();
+        ++stats.num_queued;
+    }
+    else if(0 == ticket)
+    {
+        ++stats.num_dropped;
+    }
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+
+    // Run the executor
+    if((0 != ticket) && (nullptr != executor_semaphore_handle))
+    {
+        (void) xSemaphoreGive(/* xSemaphore = */ executor_semaphore_handle);
+    }
+    return ticket;
+}
+
+bool ActuationQueue::wait(
+    uint32_t ticket,
+    TickType_t ticks_to_wait)
+{
+    TickType_t ticks_start = xTaskGetTickCount();
+    TaskHandle_t task_handle = xTaskGetCurrentTaskHandle();
+    bool is_done = false;
+    bool is_waiter = false;
+    while(1)
+    {
+        // Check if the request is done, if not, make sure finish will wake this task when it is
+        if(pdFALSE == xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY))
+        {
+            return false;
+        }
+        is_done = (nullptr == find(/* uint32_t ticket = */ ticket));
+        if((true == is_done) || (false == is_waiter))
+        {
+            for(size_t i = 0; i < ACTUATION_MAX_WAITERS; ++i)
+            {
+                if(task_handle == waiter_task_handles[i])
+                {
+                    waiter_task_handles[i] = nullptr;
+                }
+                else if((false == is_done) && (false == is_waiter) && (nullptr == waiter_task_handles[i]))
+                {
+                    waiter_task_handles[i] = task_handle;
+                    waiter_tickets[i] = ticket;
+                    is_waiter = true;
+                }
+            }
+        }
+        (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+
+        TickType_t ticks_waited = xTaskGetTickCount() - ticks_start;
+        if((true == is_done) || (ticks_waited >= ticks_to_wait))
+        {
+            break;
+        }
+
+        // Wait to be woken by finish, or check back later if there was no room to be a waiter
+        // NOTE: Other notifications to this task (ex. a menu input arriving while the menu waits on a dose) also wake it,
+        //       which is fine, this checks again and goes back to waiting
+        TickType_t ticks_left = ticks_to_wait - ticks_waited;
+        TickType_t ticks_poll = pdMS_TO_TICKS(ACTUATION_MS_WAIT_POLL);
+        (void) ulTaskNotifyTake(
+            /* BaseType_t xClearCountOnExit = */ pdTRUE,
+            /* TickType_t xTicksToWait = */ ((true == is_waiter) || (ticks_left < ticks_poll)) ? ticks_left : ticks_poll);
+    }
+
+    // Stop being a waiter if this timed out
+    if((false == is_done) && (true == is_waiter))
+    {
+        (void) xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY);
+        for(size_t i = 0; i < ACTUATION_MAX_WAITERS; ++i)
+        {
+            if(task_handle == waiter_task_handles[i])
+            {
+                waiter_task_handles[i] = nullptr;
+            }
+        }
+        (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+    }
+    return is_done;
+}
+
+bool ActuationQueue::is_done(uint32_t ticket)
+{
+    if(pdFALSE == xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY))
+    {
+        return false;
+    }
+    bool is_done = (nullptr == find(/* uint32_t ticket = */ ticket));
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+    return is_done;
+}
+
+bool ActuationQueue::start_next(actuation_request_t *out_request)
+{
+    if(pdFALSE == xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY))
+    {
+        return false;
+    }
+    actuation_request_t *next = nullptr;
+    for(size_t i = 0; i < ACTUATION_QUEUE_LENGTH; ++i)
+    {
+        actuation_request_t *request = &requests[i];
+        if((0 == request->ticket) || (true == request->is_running))
+        {
+            continue;
+        }
+        if((nullptr == next) ||
+            (request->priority > next->priority) ||
+            ((request->priority == next->priority) && (request->us_queued < next->us_queued)))
+        {
+            next = request;
+        }
+    }
+    if(nullptr != next)
+    {
+        // Requests made from now on start a new request, instead of joining this one
+        next->is_running = true;
+        *out_request = *next;
+    }
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+    return nullptr != next;
+}
+
+TickType_t ActuationQueue::get_ticks_until_allowed()
+{
+    if(pdFALSE == xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY))
+    {
+        return 0;
+    }
+    int64_t us_now = esp_timer_get_time();
+    int64_t us_wait = 0;
+
+    // Wait out the rest of the gap after the last actuation
+    if(0 != stats.num_actuations)
+    {
+        int64_t us_since_last = us_now - us_last_actuation;
+        us_wait = (us_since_last < us_min_gap) ? (us_min_gap - us_since_last) : 0;
+    }
+
+    // If the cap was reached within the window, wait until the oldest actuation counted falls out of it
+    if((0 != max_per_hour) && (stats.num_actuations >= max_per_hour))
+    {
+        size_t oldest_index = (actuation_index + ACTUATION_MAX_PER_HOUR_LIMIT - max_per_hour) % ACTUATION_MAX_PER_HOUR_LIMIT;
+        int64_t us_window_end = ((int64_t) s_actuations[oldest_index] + ACTUATION_S_CAP_WINDOW) * 1000 * 1000;
+        us_wait = ((us_window_end - us_now) > us_wait) ? (us_window_end - us_now) : us_wait;
+    }
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+
+    // Round up, so waiting this long is always enough
+    return (0 >= us_wait) ? 0 : (TickType_t) pdMS_TO_TICKS((us_wait + 999) / 1000) + 1;
+}
+
+void ActuationQueue::record_actuation(bool is_deferred)
+{
+    (void) xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY);
+    us_last_actuation = esp_timer_get_time();
+    s_actuations[actuation_index] = (uint32_t) (us_last_actuation / (1000 * 1000));
+    actuation_index = (actuation_index + 1) % ACTUATION_MAX_PER_HOUR_LIMIT;
+    ++stats.num_actuations;
+    stats.num_deferred += (true == is_deferred) ? 1 : 0;
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+}
+
+void ActuationQueue::finish(const actuation_request_t *request)
+{
+    // Free the request's slot, count how long it took, and take everyone waiting on it
+    TaskHandle_t task_handles[ACTUATION_MAX_WAITERS] = {};
+    (void) xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY);
+    actuation_request_t *slot = find(/* uint32_t ticket = */ request->ticket);
+    if(nullptr != slot)
+    {
+        slot->ticket = 0;
+    }
+    uint32_t us_latency = (uint32_t) (esp_timer_get_time() - request->us_queued);
+    ++stats.num_done;
+    stats.us_last_latency = us_latency;
+    stats.us_max_latency = (us_latency > stats.us_max_latency) ? us_latency : stats.us_max_latency;
+    stats.us_latencies += us_latency;
+    take_waiters(/* uint32_t ticket = */ request->ticket, /* TaskHandle_t *out_task_handles = */ task_handles);
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+    wake_waiters(/* const TaskHandle_t *task_handles = */ task_handles);
+}
+
+bool ActuationQueue::cancel(uint32_t ticket)
+{
+    // Free the request's slot, unless the executor started on it, and take everyone waiting on it
+    TaskHandle_t task_handles[ACTUATION_MAX_WAITERS] = {};
+    (void) xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY);
+    actuation_request_t *slot = find(/* uint32_t ticket = */ ticket);
+    bool is_cancelled = (nullptr != slot) && (false == slot->is_running);
+    if(true == is_cancelled)
+    {
+        slot->ticket = 0;
+        ++stats.num_cancelled;
+        take_waiters(/* uint32_t ticket = */ ticket, /* TaskHandle_t *out_task_handles = */ task_handles);
+    }
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+    wake_waiters(/* const TaskHandle_t *task_handles = */ task_handles);
+    return is_cancelled;
+}
+
+void ActuationQueue::get_stats(actuation_stats_t *out_stats)
+{
+    (void) xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY);
+    *out_stats = stats;
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+}
+
+void ActuationQueue::take_waiters(
+    uint32_t ticket,
+    TaskHandle_t *out_task_handles)
+{
+    for(size_t i = 0; i < ACTUATION_MAX_WAITERS; ++i)
+    {
+        if((nullptr != waiter_task_handles[i]) && (ticket == waiter_tickets[i]))
+        {
+            out_task_handles[i] = waiter_task_handles[i];
+            waiter_task_handles[i] = nullptr;
+        }
+    }
+}
+
+void ActuationQueue::wake_waiters(const TaskHandle_t *task_handles)
+{
+    for(size_t i = 0; i < ACTUATION_MAX_WAITERS; ++i)
+    {
+        if(nullptr != task_handles[i])
+        {
+            (void) xTaskNotifyGive(/* TaskHandle_t xTaskToNotify = */ task_handles[i]);
+        }
+    }
+}
+
+actuation_request_t *ActuationQueue::find(uint32_t ticket)
+{
+    if(0 == ticket)
+    {
+        return nullptr;
+    }
+    for(size_t i = 0; i < ACTUATION_QUEUE_LENGTH; ++i)
+    {
+        if(ticket == requests[i].ticket)
+        {
+            return &requests[i];
+        }
+    }
+    return nullptr;
+}
\ No newline at end of file
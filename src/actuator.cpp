@@ -0,0 +1,141 @@
+// Include custom actuator API
+#include "actuator.h"
+// Include ESP32 high resolution timer API
+#include "esp_timer.h"
+// Include custom debug macros and compile flags
+#include "flags.h"
+
+// ============================== //
+// Define Actuator implementation //
+// ============================== //
+
+Actuator::Actuator()
+{
+    type = ACTUATOR_TYPE_SERVO;
+    ul_per_unit = ACTUATOR_MIN_UL_PER_UNIT;
+    servo_scheduler = nullptr;
+    servo_index = SERVO_SCHEDULER_MAX_SERVOS;
+    servo_profile = {};
+    pump_profile = {};
+    stats = {};
+}
+
+bool Actuator::init(
+    const actuator_config_t *config,
+    ServoScheduler *arg_servo_scheduler,
+    const servo_profile_t *arg_servo_profile,
+    const pump_profile_t *arg_pump_profile,
+    uint32_t arg_ul_per_unit)
+{
+    type = config->type;
+    set_ul_per_unit(/* uint32_t ul_per_unit = */ arg_ul_per_unit);
+    servo_profile = *arg_servo_profile;
+    pump_profile = *arg_pump_profile;
+    switch(type)
+    {
+        case ACTUATOR_TYPE_SERVO:
+            servo_scheduler = arg_servo_scheduler;
+            servo_index = servo_scheduler->add_servo(/* gpio_num_t pin = */ config->pin);
+            return servo_index < SERVO_SCHEDULER_MAX_SERVOS;
+        case ACTUATOR_TYPE_PUMP:
+            return pump.init(/* gpio_num_t arg_pin = */ config->pin);
+        default:
+            return false;
+    }
+}
+
+ACTUATOR_TYPE_t Actuator::get_type()
+{
+    return type;
+}
+
+uint32_t Actuator::get_ul_per_unit()
+{
+    return __atomic_load_n(&ul_per_unit, __ATOMIC_RELAXED);
+}
+
+void Actuator::set_ul_per_unit(uint32_t arg_ul_per_unit)
+{
+    arg_ul_per_unit = (arg_ul_per_unit < ACTUATOR_MIN_UL_PER_UNIT) ? ACTUATOR_MIN_UL_PER_UNIT : arg_ul_per_unit;
+    arg_ul_per_unit = (arg_ul_per_unit > ACTUATOR_MAX_UL_PER_UNIT) ? ACTUATOR_MAX_UL_PER_UNIT : arg_ul_per_unit;
+    __atomic_store_n(&ul_per_unit, arg_ul_per_unit, __ATOMIC_RELAXED);
+}
+
+uint32_t Actuator::get_ul_min_dose()
+{
+    uint32_t rate = get_ul_per_unit();
+    return (ACTUATOR_TYPE_PUMP == type) ? ((rate * ACTUATOR_MS_MIN_PUMP_RUN) / 1000) : rate;
+}
+
+bool Actuator::dose(
+    uint32_t ul_wanted,
+    uint32_t *out_ul_dosed)
+{
+    int64_t us_start = esp_timer_get_time();
+    uint32_t rate = get_ul_per_unit();
+    uint32_t ul_dosed = 0;
+    bool is_done = false;
+    switch(type)
+    {
+        case ACTUATOR_TYPE_SERVO:
+        {
+            // A squirt can't be split, it delivers the same volume however little is wanted
+            is_done = servo_scheduler->squirt(
+                /* size_t index = */ servo_index,
+                /* const servo_profile_t *profile = */ &servo_profile);
+            ul_dosed = (servo_index < SERVO_SCHEDULER_MAX_SERVOS) ? rate : 0;
+            break;
+        }
+        case ACTUATOR_TYPE_PUMP:
+        {
+            // Work out how long to run at full power, then lengthen the run by half the soft start,
+            // the ramp delivers about half what running at full power for as long would
+            uint32_t ms_soft_start_half = pump_profile.ms_soft_start / 2;
+            uint32_t ms_full = (uint32_t) ((((uint64_t) ul_wanted * 1000) + (rate / 2)) / rate);
+            ms_full = (ms_full < ACTUATOR_MS_MIN_PUMP_RUN) ? ACTUATOR_MS_MIN_PUMP_RUN : ms_full;
+            ms_full = ((ms_full + ms_soft_start_half) > PUMP_MS_MAX_RUN) ? (PUMP_MS_MAX_RUN - ms_soft_start_half) : ms_full;
+            is_done = pump.run(
+                /* const pump_profile_t *profile = */ &pump_profile,
+                /* uint32_t ms_run = */ ms_full + ms_soft_start_half);
+            ul_dosed = (true == is_done) ? (uint32_t) (((uint64_t) ms_full * rate) / 1000) : 0;
+            break;
+        }
+        default:
+            break;
+    }
+
+    // Publish what was dosed
+    ++stats.num_doses;
+    stats.ul_last_dose = ul_dosed;
+    stats.ul_dosed += ul_dosed;
+    stats.us_last_dose = (uint32_t) (esp_timer_get_time() - us_start);
+    stats_snapshot.store(/* const actuator_stats_t *new_value = */ &stats);
+    *out_ul_dosed = ul_dosed;
+    return is_done;
+}
+
+void Actuator::stop()
+{
+    // A pump is already off between runs
+    if(ACTUATOR_TYPE_SERVO == type)
+    {
+        servo_scheduler->detach(/* size_t index = */ servo_index);
+    }
+}
+
+void Actuator::get_stats(actuator_stats_t *out_stats)
+{
+    (void) stats_snapshot.load(/* actuator_stats_t *out_value = */ out_stats);
+}
+
+void Actuator::get_servo_stats(servo_stats_t *out_stats)
+{
+    if(ACTUATOR_TYPE_SERVO != type)
+    {
+        *out_stats = {};
+        return;
+    }
+    servo_scheduler->get_servo_stats(
+        /* size_t index = */ servo_index,
+        /* servo_stats_t *out_stats = */ out_stats);
+}
\ No newline at end of file
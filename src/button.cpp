@@ -14,42 +14,84 @@
 #include "menu.h"
 // Include custom TCP/IP API
 #include "tcp_ip.h"
+// Include ESP32 high resolution timer API
+#include "esp_timer.h"
 
 // ======================= //
 // Instantiate useful data //
 // ======================= //
 
+// Store handle for sleep task, so it can be resumed when the sleep button is pressed
+TaskHandle_t toggle_sleep_mode_task_handle;
+
 // Instantiate instance of buttons
+// Each button only needs to be stable for 30 ms to count as settled, long enough for the buttons tested so far to stop bouncing
+// Up and down repeat while held, so values changed by them can be swept through without a press per step
 Button buttons[NUM_BUTTONS] = {
     { 
         /* bool arg_is_pull_up = */ true,
-        /* uint8_t arg_ms_debounce = */ 100,
-        /* gpio_num_t arg_pin_in = */ PIN_BUTTON_UP_IN
+        /* uint32_t arg_us_debounce = */ 30 * 1000,
+        /* bool arg_is_repeating = */ true,
+        /* gpio_num_t arg_pin_in = */ PIN_BUTTON_UP_IN,
+        /* void (*arg_func_on_event)(BUTTON_EVENT_t, int64_t) = */ [](BUTTON_EVENT_t event, int64_t us_event_time) {
+            if((BUTTON_EVENT_PRESS == event) || (BUTTON_EVENT_REPEAT == event)) add_to_menu_input_queue(
+                /* MENU_INPUT_t menu_input = */ MENU_INPUT_UP,
+                /* MENU_INPUT_SOURCE_t source = */ MENU_INPUT_SOURCE_BUTTON,
+                /* bool is_repeat = */ BUTTON_EVENT_REPEAT == event,
+                /* int64_t us_time = */ us_event_time,
+                /* bool from_isr = */ false); }
     },
     { 
         /* bool arg_is_pull_up = */ true,
-        /* uint8_t arg_ms_debounce = */ 100,
-        /* gpio_num_t arg_pin_in = */ PIN_BUTTON_CONFIRM_IN
+        /* uint32_t arg_us_debounce = */ 30 * 1000,
+        /* bool arg_is_repeating = */ false,
+        /* gpio_num_t arg_pin_in = */ PIN_BUTTON_CONFIRM_IN,
+        /* void (*arg_func_on_event)(BUTTON_EVENT_t, int64_t) = */ [](BUTTON_EVENT_t event, int64_t us_event_time) {
+            if(BUTTON_EVENT_PRESS == event) add_to_menu_input_queue(
+                /* MENU_INPUT_t menu_input = */ MENU_INPUT_CONFIRM,
+                /* MENU_INPUT_SOURCE_t source = */ MENU_INPUT_SOURCE_BUTTON,
+                /* bool is_repeat = */ false,
+                /* int64_t us_time = */ us_event_time,
+                /* bool from_isr = */ false); }
     },
     { 
         /* bool arg_is_pull_up = */ true,
-        /* uint8_t arg_ms_debounce = */ 100,
-        /* gpio_num_t arg_pin_in = */ PIN_BUTTON_DOWN_IN
+        /* uint32_t arg_us_debounce = */ 30 * 1000,
+        /* bool arg_is_repeating = */ true,
+        /* gpio_num_t arg_pin_in = */ PIN_BUTTON_DOWN_IN,
+        /* void (*arg_func_on_event)(BUTTON_EVENT_t, int64_t) = */ [](BUTTON_EVENT_t event, int64_t us_event_time) {
+            if((BUTTON_EVENT_PRESS == event) || (BUTTON_EVENT_REPEAT == event)) add_to_menu_input_queue(
+                /* MENU_INPUT_t menu_input = */ MENU_INPUT_DOWN,
+                /* MENU_INPUT_SOURCE_t source = */ MENU_INPUT_SOURCE_BUTTON,
+                /* bool is_repeat = */ BUTTON_EVENT_REPEAT == event,
+                /* int64_t us_time = */ us_event_time,
+                /* bool from_isr = */ false); }
     },
     // NOTE: PIN_BUTTON_SLEEP_IN MUST be defined last for current sleep logic to work
     {
         /* bool arg_is_pull_up = */ true,
-        /* uint8_t arg_ms_debounce = */ 100,
-        /* gpio_num_t arg_pin_in = */ PIN_BUTTON_SLEEP_IN
+        /* uint32_t arg_us_debounce = */ 30 * 1000,
+        /* bool arg_is_repeating = */ false,
+        /* gpio_num_t arg_pin_in = */ PIN_BUTTON_SLEEP_IN,
+        /* void (*arg_func_on_event)(BUTTON_EVENT_t, int64_t) = */ [](BUTTON_EVENT_t event, int64_t us_event_time) {
+            if(BUTTON_EVENT_PRESS == event) vTaskResume(/* TaskHandle_t xTaskToResume = */ toggle_sleep_mode_task_handle); }
     }
 };
 
-// Store handle for sleep task, so it can be resumed from interrupt
-TaskHandle_t toggle_sleep_mode_task_handle;
+// Store the handle of the timer that samples buttons while they settle, see: timer_sample_buttons
+esp_timer_handle_t sample_buttons_timer_handle = nullptr;
+
+// Whether sample_buttons_timer_handle is running
+volatile bool is_sampling_buttons = false;
+
+// A spinlock to keep button interrupts and timer_sample_buttons from starting and stopping the timer at the same time
+// Spinlocks, unlike mutexes, can be taken from interrupts, and work across both cores
+portMUX_TYPE sample_buttons_spinlock = portMUX_INITIALIZER_UNLOCKED;
 
 // Declare static functions
 static void task_toggle_sleep_mode();
-static void IRAM_ATTR intr_write_button_press(gpio_num_t gpio_pin);
+static void IRAM_ATTR intr_start_button_sampling(Button *button);
+static void timer_sample_buttons(void *arg);
 
 // =================================== //
 // Functions for configuring button IO //
@@ -70,6 +112,18 @@ void init_buttons()
     // https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-reference/system/intr_alloc.html
     ESP_ERROR_CHECK(gpio_install_isr_service(/* int intr_alloc_flags = */ ESP_INTR_FLAG_LEVEL1 | ESP_INTR_FLAG_EDGE | ESP_INTR_FLAG_LOWMED));
 
+    // Create the timer that samples buttons while they settle, it is only started once a button has an interrupt
+    const esp_timer_create_args_t sample_buttons_timer_args = {
+        /* esp_timer_cb_t callback = */ timer_sample_buttons,
+        /* void *arg = */ nullptr,
+        /* esp_timer_dispatch_t dispatch_method = */ ESP_TIMER_TASK,
+        /* const char *name = */ "sample_buttons",
+        /* bool skip_unhandled_events = */ true
+    };
+    ESP_ERROR_CHECK(esp_timer_create(
+        /* const esp_timer_create_args_t *create_args = */ &sample_buttons_timer_args,
+        /* esp_timer_handle_t *out_handle = */ &sample_buttons_timer_handle));
+
     // Set up GPIO buttons
     for(size_t i = 0; i < NUM_BUTTONS; ++i)
     {
@@ -111,7 +165,6 @@ void init_buttons()
 static void task_toggle_sleep_mode()
 {
     bool is_asleep = false;
-    LiquidCrystal_I2C *display = get_display();
     TaskHandle_t read_menu_input_queue_task_handle = get_read_menu_input_queue_task_handle();
 
     // Tasks must be implemented to never return (i.e. continuous loop)
@@ -134,8 +187,7 @@ static void task_toggle_sleep_mode()
             }
 
             // Turn on screen
-            display->display();
-            display->backlight();
+            set_display_enabled(/* bool is_enabled = */ true);
 
 #if WIFI_ENABLED
             // Reinstantiate all TCP and WiFi connections
@@ -167,8 +219,7 @@ static void task_toggle_sleep_mode()
 #endif
 
             // Turn off screen
-            display->noDisplay();
-            display->noBacklight();
+            set_display_enabled(/* bool is_enabled = */ false);
 
             // Turn off all button interrupts besides sleep button
             for(size_t i = 0; i < NUM_BUTTONS - 1; ++i)
@@ -188,54 +239,47 @@ static void task_toggle_sleep_mode()
     }
 }
 
-// Define event (interrupt) for a GPIO button press
+// Define event (interrupt) for any edge on a GPIO button
 // This ISR handler will be called from an ISR.
 // So there is a stack size limit (configurable as "ISR stack size" in menuconfig).
 // This limit is smaller compared to a global GPIO interrupt handler due to the additional level of indirection.
-// TODO: Check stack/heap size.
 // https://github.com/espressif/esp-idf/blob/v5.3/examples/peripherals/gpio/generic_gpio/main/gpio_example_main.c
 // IRAM_ATTR puts this function in internal RAM instead of flash memory to run faster
-static void IRAM_ATTR intr_write_button_press(gpio_num_t gpio_pin)
+// All debouncing is deferred to timer_sample_buttons, this only hands the button over to it
+static void IRAM_ATTR intr_start_button_sampling(Button *button)
 {
-    // TODO: This code is gross and error prone
-    Button *button = NULL;
-    MENU_INPUT_t menu_input = MENU_INPUT_NONE;
-    switch(gpio_pin)
-    {
-        case PIN_BUTTON_UP_IN:
-            button = &buttons[0];
-            menu_input = MENU_INPUT_UP;
-            break;
-        case PIN_BUTTON_CONFIRM_IN:
-            button = &buttons[1];
-            menu_input = MENU_INPUT_CONFIRM;
-            break;
-        case PIN_BUTTON_DOWN_IN:
-            button = &buttons[2];
-            menu_input = MENU_INPUT_DOWN;
-            break;
-        case PIN_BUTTON_SLEEP_IN:
-            button = &buttons[3];
-            break;
-        default:
-            return;
-    }
+    button->start_sampling();
+}
 
-    // Do not add this button press to the queue if it was just static noise
-    if(false == button->is_button_press())
+// Define timer callback for sampling every button that is settling
+// This is called from the esp_timer task every BUTTON_US_SAMPLE_PERIOD while any button is settling, not from an interrupt
+static void timer_sample_buttons(void *arg)
+{
+    int64_t us_current_time = esp_timer_get_time();
+    bool is_any_button_sampling = false;
+
+    // Sample every button that is settling, buttons call their event functions from here
+    for(size_t i = 0; i < NUM_BUTTONS; ++i)
     {
-        return;
+        is_any_button_sampling |= buttons[i].sample(/* int64_t us_current_time = */ us_current_time);
     }
 
-    // Write button input as menu input in menu input queue
-    if (PIN_BUTTON_SLEEP_IN == gpio_pin)
+    // Stop the timer once every button has settled, so it is not waking the processor while nobody is touching a button
+    // Check and stop inside the spinlock, so an interrupt can't start sampling a button between the check and the stop
+    if(false == is_any_button_sampling)
     {
-        (void) xTaskResumeFromISR(/* TaskHandle_t xTaskToResume = */ toggle_sleep_mode_task_handle);
-        return;
+        portENTER_CRITICAL(&sample_buttons_spinlock);
+        for(size_t i = 0; i < NUM_BUTTONS; ++i)
+        {
+            is_any_button_sampling |= buttons[i].get_is_sampling();
+        }
+        if(false == is_any_button_sampling)
+        {
+            (void) esp_timer_stop(/* esp_timer_handle_t timer = */ sample_buttons_timer_handle);
+            is_sampling_buttons = false;
+        }
+        portEXIT_CRITICAL(&sample_buttons_spinlock);
     }
-    add_to_menu_input_queue(
-        /* MENU_INPUT_t menu_input = */ menu_input,
-        /* bool from_isr = */ true);
 }
 
 // ======================= //
@@ -244,19 +288,20 @@ static void IRAM_ATTR intr_write_button_press(gpio_num_t gpio_pin)
 
 Button::Button(
     bool arg_is_pull_up,
-    uint8_t arg_ms_debounce,
-    gpio_num_t arg_pin_in)
+    uint32_t arg_us_debounce,
+    bool arg_is_repeating,
+    gpio_num_t arg_pin_in,
+    void (*arg_func_on_event)(BUTTON_EVENT_t event, int64_t us_event_time))
 {
-    is_pressed = false;
     is_pull_up = arg_is_pull_up;
-    ms_debounce = arg_ms_debounce;
+    is_enabled = false;
+    is_sampling = false;
+    debounce_init(
+        /* debounce_t *debounce = */ &debounce,
+        /* uint32_t us_debounce = */ arg_us_debounce,
+        /* bool is_repeating = */ arg_is_repeating);
     pin_in = arg_pin_in;
-    ms_next_valid_edge = 0;
-    // Mutex type semaphores cannot be used from within interrupt service routines.
-    // https://docs.espressif.com/projects/esp-idf/en/latest/esp32s3/api-reference/system/freertos_idf.html
-    // TODO: Look into 'direct to task notification'
-    //       See if a mtuex actually helps the reliability of the debounce code
-    //mutex_handle = xSemaphoreCreateBinaryStatic(&mutex_buffer);
+    func_on_event = arg_func_on_event;
 }
 
 void Button::register_pin()
@@ -278,93 +323,118 @@ void Button::register_pin()
 
 void Button::register_intr()
 {
-    // Set GPIO interrupt trigger type to an edge,
-    // which edge depends on whether this is a pull-up or pull-down resistor button
+    // Set GPIO interrupt trigger type to any edge,
+    // the first edge of a press or a release starts sampling, and sampling decides what it was
     ESP_ERROR_CHECK(gpio_set_intr_type(
         /* gpio_num_t gpio_num = */ pin_in,
-        /* gpio_int_type_t intr_type = */ is_pull_up ? GPIO_INTR_NEGEDGE : GPIO_INTR_POSEDGE));
+        /* gpio_int_type_t intr_type = */ GPIO_INTR_ANYEDGE));
 
     // Register interrupt handler for this GPIO pin specifically,
-    // it will call intr_write_button_press on falling/rising edge
-    // It's possible to use one ISR for all GPIO pins,
-    // but they don't support interrputs on edge changes
+    // it will call intr_start_button_sampling on any edge, with this button as its argument
     ESP_ERROR_CHECK(gpio_isr_handler_add(
         /* gpio_num_t gpio_num = */ pin_in,
-        /* gpio_isr_t isr_handler = */ (gpio_isr_t) intr_write_button_press,
-        /* void *args = */ (void *) pin_in));
+        /* gpio_isr_t isr_handler = */ (gpio_isr_t) intr_start_button_sampling,
+        /* void *args = */ (void *) this));
 }
 
 void Button::enable_intr()
 {
+    // Start from however the button is being held now, without calling it a press or release
+    debounce_reset(
+        /* debounce_t *debounce = */ &debounce,
+        /* bool is_down = */ read_is_down());
+    is_enabled = true;
+
     // Enable GPIO module interrupt for this GPIO pin
     ESP_ERROR_CHECK(gpio_intr_enable(/* gpio_num_t gpio_num = */ pin_in));
 }
 
 void Button::disable_intr()
 {
+    // Ignore this button, even if it is in the middle of being sampled
+    is_enabled = false;
+
     // Disable GPIO module interrupt for this GPIO pin
     // NOTE: This function is allowed to be executed when Cache is disabled within ISR context,
     // by enabling CONFIG_GPIO_CTRL_FUNC_IN_IRAM
     ESP_ERROR_CHECK(gpio_intr_disable(/* gpio_num_t gpio_num = */ pin_in));
 }
 
-bool Button::is_button_press()
+void IRAM_ATTR Button::start_sampling()
 {
-    // This button press logic is flawed, but good enough for now.
-    // User IO is not the main concern of this system, or FreeRTOS generally.
-    // Ex: HI _____                   _____
-    //     LO      \/\/\/\_____/\/\/\/
-    // 0) assume all buttons start unpressed and in HIGH
-    // 1) set the button as pressed once the first static happens
-    // 2) ignore static for next X ms
-    // 3) set button as unpressed once the first static happens
-    // 4) ignore static for the next X ms
-    // 5) repeat starting from 1
+    // Stop taking interrupts for this button, it is going to bounce, and sampling will watch it settle instead
+    // NOTE: This function is allowed to be executed when Cache is disabled within ISR context,
+    // by enabling CONFIG_GPIO_CTRL_FUNC_IN_IRAM
+    (void) gpio_intr_disable(/* gpio_num_t gpio_num = */ pin_in);
 
-#if 0
-    // It's possible to just disable interrupts on this pin instead for the next X milliseconds,
-    // but that would require creating a timer, which takes stack just like a task, so it doesn't seem worth it.
-    // Here's an example.
-    button->disable_intr();
-    // You must have configiUSE_TIMERS set to 1 for software timers to work (FreeRTOSConfig.h)
-    // CONFIG_TIMER_TASK_PRIORITY sets the priority (sdkconfig.h)
-    // CONFIG_TIMER_QUEUE_LENGTH is the queue length (sdkconfig.h)
-    // CONFIG_TIMER_STACK_DEPTH is the stack size in words in Vanilla FreeRTOS, bytes in ESP32 modified (sdkconfig.h)
-    // https://docs.espressif.com/projects/esp-idf/en/latest/esp32s3/api-reference/system/freertos_idf.html?
-    TimerHandle_t xTimerCreate(
-        /* const char *const pcTimerName = */ "gpio_intr_on",
-        /* const TickType_t xTimerPeriodInTicks = */ pdMS_TO_TICKS(100),
-        /* const BaseType_t xAutoReload = */ false,
-        /* void *const pvTimerID = */ 0,
-    /* TimerCallbackFunction_t pxCallbackFunction = */ [](TimerHandle_t xTimer) { button->enable_intr(); });
-#endif
+    // Start the sampling timer if it is not already running
+    portENTER_CRITICAL_ISR(&sample_buttons_spinlock);
+    debounce.us_first_change = esp_timer_get_time();
+    is_sampling = true;
+    if(false == is_sampling_buttons)
+    {
+        (void) esp_timer_start_periodic(
+            /* esp_timer_handle_t timer = */ sample_buttons_timer_handle,
+            /* uint64_t period = */ BUTTON_US_SAMPLE_PERIOD);
+        is_sampling_buttons = true;
+    }
+    portEXIT_CRITICAL_ISR(&sample_buttons_spinlock);
+}
 
-    // Get current milliseconds
-    // https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-reference/system/esp_timer.html
-    int64_t ms_current_time = esp_timer_get_time();
+bool Button::sample(int64_t us_current_time)
+{
+    if(false == is_sampling)
+    {
+        return false;
+    }
 
-    // Only allow one thread to read/modify this button's members at a time
-    // If the semaphore is not available, wait 25 ticks to see if it becomes free
-#if 0
-    if ((NULL != mutex_handle) &&
-        (pdTRUE == xSemaphoreTakeFromISR(
-            /* xSemaphore = */ mutex_handle,
-            /* xBlockTime = */ TickType_t(25))))
+    // Stop repeating a held button once it is ignored
+    if(false == is_enabled)
     {
-#endif
-        // If the current time is at or past the time this edge is no longer considered noise...
-        if (ms_current_time >= ms_next_valid_edge)
-        {
-            // Update when the next edge trasition is no longer considered noise
-            ms_next_valid_edge = ms_current_time + ms_debounce;
-            is_pressed = !is_pressed;
-        }
+        debounce.is_held = false;
+    }
 
-#if 0
-        // Free sempahore so other threads can read/modify this button's members
-        xSemaphoreGiveFromISR(mutex_handle);
+    // Debounce what this sample read, and report what the button did, if anything
+    debounce_event_t event;
+    bool is_sampling_needed = debounce_sample(
+        /* debounce_t *debounce = */ &debounce,
+        /* bool is_down = */ read_is_down(),
+        /* int64_t us_current_time = */ us_current_time,
+        /* debounce_event_t *out_event = */ &event);
+    if((BUTTON_EVENT_NONE != event.type) && (true == is_enabled) && (nullptr != func_on_event))
+    {
+        (*func_on_event)(
+            /* BUTTON_EVENT_t event = */ event.type,
+            /* int64_t us_event_time = */ event.us_time);
     }
-#endif
+    if(true == is_sampling_needed)
+    {
+        return true;
+    }
+
+    // Go back to waiting for an interrupt, unless the button moved between the last sample and the interrupt being enabled
+    is_sampling = false;
+    if(false == is_enabled)
+    {
+        return false;
+    }
+    (void) gpio_intr_enable(/* gpio_num_t gpio_num = */ pin_in);
+    if(read_is_down() != debounce.is_pressed)
+    {
+        (void) gpio_intr_disable(/* gpio_num_t gpio_num = */ pin_in);
+        debounce.us_first_change = us_current_time;
+        is_sampling = true;
+    }
+    return is_sampling;
+}
+
+bool Button::get_is_sampling()
+{
+    return is_sampling;
+}
 
-    return is_pressed;
+bool Button::read_is_down()
+{
+    // Pull-up buttons read LOW (0) when pressed, pull-down buttons read HIGH (1) when pressed
+    return (is_pull_up ? 0 : 1) == gpio_get_level(/* gpio_num_t gpio_num = */ pin_in);
 }
\ No newline at end of file
@@ -0,0 +1,177 @@
+// Include custom soil moisture calibration API
+#include "calibration.h"
+
+// ====================================== //
+// Define useful constants and data types //
+// ====================================== //
+
+// The curve from the dry point to the wet point, as fractions of the way from the dry point's percent to the wet point's
+typedef struct calibration_table_s {
+    uint16_t fractions[CALIBRATION_TABLE_LENGTH];
+} calibration_table_t;
+
+// Get the number of bits needed to count to value, for a power of 2
+static constexpr uint32_t get_num_bits(uint32_t value)
+{
+    uint32_t num_bits = 0;
+    for(; value > 1; value >>= 1)
+    {
+        ++num_bits;
+    }
+    return num_bits;
+}
+
+// Define the number of bits of a position within one step between table entries
+#define CALIBRATION_STEP_BITS (CALIBRATION_POSITION_BITS - get_num_bits(CALIBRATION_TABLE_LENGTH - 1))
+// Define the position of the wet point
+#define CALIBRATION_POSITION_END (1 << CALIBRATION_POSITION_BITS)
+
+static_assert(((CALIBRATION_TABLE_LENGTH - 1) & (CALIBRATION_TABLE_LENGTH - 2)) == 0, "CALIBRATION_TABLE_LENGTH must be a power of 2, plus 1");
+static_assert(CALIBRATION_POSITION_BITS > get_num_bits(CALIBRATION_TABLE_LENGTH - 1), "CALIBRATION_POSITION_BITS must leave room to interpolate between table entries");
+
+// Work out the curve at every table entry, see: calibration.h
+// With raw readings scaled from 1 at the dry point to CALIBRATION_CURVE_WET_TO_DRY_RATIO at the wet point,
+// the soil's capacitance goes with 1 / raw, and its water content goes with its capacitance
+static constexpr calibration_table_t make_calibration_table()
+{
+    calibration_table_t table = {};
+    for(size_t i = 0; i < CALIBRATION_TABLE_LENGTH; ++i)
+    {
+        double position = (double) i / (CALIBRATION_TABLE_LENGTH - 1);
+        double raw = 1.0 - (position * (1.0 - CALIBRATION_CURVE_WET_TO_DRY_RATIO));
+        double fraction = ((1.0 / raw) - 1.0) / ((1.0 / CALIBRATION_CURVE_WET_TO_DRY_RATIO) - 1.0);
+        table.fractions[i] = (uint16_t) ((fraction * (1 << CALIBRATION_FRACTION_BITS)) + 0.5);
+    }
+    return table;
+}
+
+// Check the curve only ever rises, so every percent has one position on it
+static constexpr bool is_calibration_table_rising(const calibration_table_t table)
+{
+    for(size_t i = 1; i < CALIBRATION_TABLE_LENGTH; ++i)
+    {
+        if(table.fractions[i] <= table.fractions[i - 1])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ======================= //
+// Instantiate useful data //
+// ======================= //
+
+// The curve, built at compile time, so it is placed in flash, and no floats are used at run time
+static constexpr calibration_table_t calibration_table = make_calibration_table();
+static_assert(0 == calibration_table.fractions[0], "The curve must start at the dry point");
+static_assert((1 << CALIBRATION_FRACTION_BITS) == calibration_table.fractions[CALIBRATION_TABLE_LENGTH - 1], "The curve must end at the wet point");
+static_assert(true == is_calibration_table_rising(calibration_table), "The curve must only ever rise");
+
+// ===================== //
+// Define public methods //
+// ===================== //
+
+void calibration_set_default(calibration_t *calibration)
+{
+    calibration->dry.raw = CALIBRATION_DEFAULT_RAW_DRY;
+    calibration->dry.percent_q8 = CALIBRATION_PERCENT_Q8(CALIBRATION_DEFAULT_PERCENT_DRY);
+    calibration->wet.raw = CALIBRATION_DEFAULT_RAW_WET;
+    calibration->wet.percent_q8 = CALIBRATION_PERCENT_Q8(CALIBRATION_DEFAULT_PERCENT_WET);
+    calibration->mid.raw = (CALIBRATION_DEFAULT_RAW_DRY + CALIBRATION_DEFAULT_RAW_WET) / 2;
+    calibration->mid.percent_q8 = CALIBRATION_PERCENT_Q8((CALIBRATION_DEFAULT_PERCENT_DRY + CALIBRATION_DEFAULT_PERCENT_WET) / 2);
+    calibration->is_mid_set = false;
+}
+
+calibration_point_t *calibration_get_point(
+    calibration_t *calibration,
+    CALIBRATION_POINT_t point)
+{
+    switch(point)
+    {
+        case CALIBRATION_POINT_DRY:
+            return &calibration->dry;
+        case CALIBRATION_POINT_WET:
+            return &calibration->wet;
+        case CALIBRATION_POINT_MID:
+            return &calibration->mid;
+        default:
+            return nullptr;
+    }
+}
+
+bool calibration_build(
+    const calibration_t *calibration,
+    calibration_converter_t *out_converter)
+{
+    // Fall back on the default points if the dry and wet points can't be told apart
+    calibration_t points = *calibration;
+    bool is_valid = (points.dry.raw != points.wet.raw) && (points.dry.percent_q8 < points.wet.percent_q8);
+    if(false == is_valid)
+    {
+        calibration_set_default(/* calibration_t *calibration = */ &points);
+    }
+    out_converter->raw_min = (points.dry.raw < points.wet.raw) ? points.dry.raw : points.wet.raw;
+    out_converter->raw_max = (points.dry.raw > points.wet.raw) ? points.dry.raw : points.wet.raw;
+    out_converter->percent_q8_dry = points.dry.percent_q8;
+    out_converter->percent_q8_span = (int32_t) points.wet.percent_q8 - points.dry.percent_q8;
+
+    // Without a middle point, both pieces are the same line, from the dry point to the wet point
+    calibration_point_t mid = points.wet;
+    int32_t position_mid = CALIBRATION_POSITION_END;
+    if((true == points.is_mid_set) &&
+        (points.mid.raw > out_converter->raw_min) && (points.mid.raw < out_converter->raw_max) &&
+        (points.mid.percent_q8 > points.dry.percent_q8) && (points.mid.percent_q8 < points.wet.percent_q8))
+    {
+        // Find the position on the curve of the middle point's percent, the first piece ends there
+        int32_t fraction = (((int32_t) points.mid.percent_q8 - out_converter->percent_q8_dry) << CALIBRATION_FRACTION_BITS) / out_converter->percent_q8_span;
+        size_t i = 0;
+        while(fraction >= calibration_table.fractions[i + 1])
+        {
+            ++i;
+        }
+        position_mid = ((int32_t) i << CALIBRATION_STEP_BITS) +
+            ((fraction - calibration_table.fractions[i]) << CALIBRATION_STEP_BITS) / (calibration_table.fractions[i + 1] - calibration_table.fractions[i]);
+        mid = points.mid;
+    }
+
+    out_converter->raws_start[0] = points.dry.raw;
+    out_converter->raws_start[1] = mid.raw;
+    out_converter->positions_start[0] = 0;
+    out_converter->positions_start[1] = position_mid;
+    out_converter->positions_start[2] = CALIBRATION_POSITION_END;
+    out_converter->positions_per_raw_q16[0] = (position_mid << 16) / ((int32_t) mid.raw - points.dry.raw);
+    out_converter->positions_per_raw_q16[1] = (mid.raw == points.wet.raw) ?
+        out_converter->positions_per_raw_q16[0] :
+        ((CALIBRATION_POSITION_END - position_mid) << 16) / ((int32_t) points.wet.raw - mid.raw);
+    return is_valid;
+}
+
+uint16_t calibration_convert(
+    const calibration_converter_t *converter,
+    uint16_t raw)
+{
+    // Keep the reading between the dry and wet points
+    raw = (raw < converter->raw_min) ? converter->raw_min : ((raw > converter->raw_max) ? converter->raw_max : raw);
+
+    // Find where the reading falls on the curve, on the first piece, or on the second if it is past the middle point
+    // Each piece is only run over its own readings, so its product is at most the positions it spans, shifted up 16 bits,
+    // which fits in 32 bits however steep a middle point close to the dry or wet point makes it
+    // Both products are never negative, the pieces start on the dry side of every reading converted with them,
+    // so adding half and shifting rounds them to the nearest position
+    bool is_wet_lower = converter->raws_start[0] == converter->raw_max;
+    size_t piece = ((true == is_wet_lower) ? (raw < converter->raws_start[1]) : (raw > converter->raws_start[1])) ? 1 : 0;
+    int32_t position = converter->positions_start[piece] +
+        (((((int32_t) raw - converter->raws_start[piece]) * converter->positions_per_raw_q16[piece]) + (1 << 15)) >> 16);
+    position = (position < 0) ? 0 : ((position > CALIBRATION_POSITION_END) ? CALIBRATION_POSITION_END : position);
+
+    // Interpolate between the table entries on either side of the position
+    int32_t i = position >> CALIBRATION_STEP_BITS;
+    int32_t fraction = calibration_table.fractions[i];
+    if(i < (CALIBRATION_TABLE_LENGTH - 1))
+    {
+        int32_t step = position & ((1 << CALIBRATION_STEP_BITS) - 1);
+        fraction += ((calibration_table.fractions[i + 1] - fraction) * step) >> CALIBRATION_STEP_BITS;
+    }
+    return (uint16_t) (converter->percent_q8_dry + ((fraction * converter->percent_q8_span) >> CALIBRATION_FRACTION_BITS));
+}
\ No newline at end of file
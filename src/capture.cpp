@@ -0,0 +1,292 @@
+// Include custom sensor capture API
+#include "capture.h"
+// Include custom debug macros and compile flags
+#include "flags.h"
+
+// ====================================== //
+// Define useful constants and data types //
+// ====================================== //
+
+// Define the number of blocks, one being filled while the other is sent
+#define CAPTURE_NUM_BLOCKS 2
+// Define the size, in bytes, of each capture task's stack
+#define CAPTURE_TASK_STACK_BYTES 2048
+
+// The state of the capture, shared by task_capture and task_send_capture
+typedef struct capture_s {
+    // The sensor being captured, and the index of its pin being captured
+    Sensor *sensor;
+    size_t sensor_index;
+    // The number of samples to take from the sensor, before averaging
+    uint32_t num_sensor_samples;
+    // The number of sensor samples averaged into each captured sample
+    uint32_t decimation;
+    // What to send every block with
+    bool (*func_send_block)(const void *block, size_t num_block_bytes);
+    // Whether a capture is running, set by capture_start, cleared by task_capture once the last block is handed off
+    bool is_running;
+    // The blocks being filled and sent
+    capture_block_t blocks[CAPTURE_NUM_BLOCKS];
+    // Whether each block was handed to task_send_capture and not sent yet, task_capture does not touch a busy block
+    bool is_block_busy[CAPTURE_NUM_BLOCKS];
+    // Samples read from the sensor, before averaging
+    uint16_t sensor_samples[SENSOR_MAX_SAMPLES];
+} capture_t;
+
+// ======================= //
+// Instantiate useful data //
+// ======================= //
+
+// The state of the capture, statically allocated so capturing never allocates from the heap
+static capture_t capture;
+
+// The tasks doing the capture, and what they need to be created without allocating from the heap
+static TaskHandle_t capture_task_handle = nullptr;
+static StaticTask_t capture_task_buffer;
+static StackType_t capture_task_stack[CAPTURE_TASK_STACK_BYTES];
+static TaskHandle_t send_capture_task_handle = nullptr;
+static StaticTask_t send_capture_task_buffer;
+static StackType_t send_capture_task_stack[CAPTURE_TASK_STACK_BYTES];
+
+// ===================== //
+// Define helper methods //
+// ===================== //
+
+// Hand block index off to task_send_capture
+static void send_block(size_t index)
+{
+    __atomic_store_n(&capture.is_block_busy[index], true, __ATOMIC_RELEASE);
+    (void) xTaskNotify(
+        /* TaskHandle_t xTaskToNotify = */ send_capture_task_handle,
+        /* uint32_t ulValue = */ 1 << index,
+        /* eNotifyAction eAction = */ eSetBits);
+}
+
+// Start filling block index, as block sequence of a capture taken at sample_hz, flagged if samples were dropped before it
+static capture_block_t *start_block(
+    size_t index,
+    uint16_t sequence,
+    uint32_t sample_hz,
+    bool is_dropped)
+{
+    capture_block_t *block = &capture.blocks[index];
+    block->header.magic = CAPTURE_BLOCK_MAGIC;
+    block->header.sequence = sequence;
+    block->header.num_samples = 0;
+    block->header.flags = is_dropped ? CAPTURE_BLOCK_FLAG_DROPPED : 0;
+    block->header.sample_hz = sample_hz;
+    return block;
+}
+
+// ============ //
+// Define tasks //
+// ============ //
+
+void task_capture(void *parameters)
+{
+    while(1)
+    {
+        // Wait for capture_start
+        (void) ulTaskNotifyTake(
+            /* BaseType_t xClearCountOnExit = */ pdTRUE,
+            /* TickType_t xTicksToWait = */ portMAX_DELAY);
+        if(false == capture.sensor->start_capture(/* uint32_t ms_timeout = */ CAPTURE_MS_START_TIMEOUT))
+        {
+            s_println("Failed to take the sensor to capture it");
+            __atomic_store_n(&capture.is_running, false, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        // Average sensor samples into captured samples, and captured samples into blocks
+        uint32_t sample_hz = capture.sensor->get_channel_sample_hz() / capture.decimation;
+        uint32_t num_sensor_samples_left = capture.num_sensor_samples;
+        uint32_t sum = 0;
+        uint32_t num_summed = 0;
+        uint16_t sequence = 0;
+        size_t index = 0;
+        capture_block_t *block = nullptr;
+        bool is_dropped = false;
+        while(num_sensor_samples_left > 0)
+        {
+            bool is_overrun = false;
+            size_t num_sensor_samples = capture.sensor->read_capture(
+                /* size_t index = */ capture.sensor_index,
+                /* uint16_t *out_samples = */ capture.sensor_samples,
+                /* size_t max_samples = */ (num_sensor_samples_left < SENSOR_MAX_SAMPLES) ? num_sensor_samples_left : SENSOR_MAX_SAMPLES,
+                /* uint32_t ms_timeout = */ SENSOR_MS_READ_TIMEOUT,
+                /* bool *out_is_overrun = */ &is_overrun);
+            if(0 == num_sensor_samples)
+            {
+                break;
+            }
+            is_dropped |= is_overrun;
+            num_sensor_samples_left -= (num_sensor_samples < num_sensor_samples_left) ? num_sensor_samples : num_sensor_samples_left;
+
+            for(size_t i = 0; i < num_sensor_samples; ++i)
+            {
+                sum += capture.sensor_samples[i];
+                ++num_summed;
+                if(num_summed < capture.decimation)
+                {
+                    continue;
+                }
+                uint16_t sample = (uint16_t) ((sum + (capture.decimation / 2)) / capture.decimation);
+                sum = 0;
+                num_summed = 0;
+
+                // Start filling the next block, if it is still being sent, drop the sample instead of waiting
+                if(nullptr == block)
+                {
+                    if(true == __atomic_load_n(&capture.is_block_busy[index], __ATOMIC_ACQUIRE))
+                    {
+                        is_dropped = true;
+                        continue;
+                    }
+                    block = start_block(
+                        /* size_t index = */ index,
+                        /* uint16_t sequence = */ sequence,
+                        /* uint32_t sample_hz = */ sample_hz,
+                        /* bool is_dropped = */ is_dropped);
+                    is_dropped = false;
+                    ++sequence;
+                }
+                block->samples[block->header.num_samples] = sample;
+                ++block->header.num_samples;
+
+                // Send full blocks, and fill the other one
+                if(CAPTURE_BLOCK_NUM_SAMPLES == block->header.num_samples)
+                {
+                    send_block(/* size_t index = */ index);
+                    block = nullptr;
+                    index = (index + 1) % CAPTURE_NUM_BLOCKS;
+                }
+            }
+        }
+        capture.sensor->stop_capture();
+
+        // Send what is left, flagged as the last block, so the reader knows the capture ended
+        // If the block is still being sent, wait for it, there is nothing left to capture
+        if(nullptr == block)
+        {
+            while(true == __atomic_load_n(&capture.is_block_busy[index], __ATOMIC_ACQUIRE))
+            {
+                vTaskDelay(/* TickType_t xTicksToDelay = */ 1);
+            }
+            block = start_block(
+                /* size_t index = */ index,
+                /* uint16_t sequence = */ sequence,
+                /* uint32_t sample_hz = */ sample_hz,
+                /* bool is_dropped = */ is_dropped);
+        }
+        block->header.flags |= CAPTURE_BLOCK_FLAG_LAST;
+        send_block(/* size_t index = */ index);
+        __atomic_store_n(&capture.is_running, false, __ATOMIC_RELEASE);
+
+        PRINT_STACK_USAGE();
+    }
+}
+
+void task_send_capture(void *parameters)
+{
+    while(1)
+    {
+        // Wait for blocks to be handed off, one bit per block
+        uint32_t block_bits = 0;
+        (void) xTaskNotifyWait(
+            /* uint32_t ulBitsToClearOnEntry = */ 0,
+            /* uint32_t ulBitsToClearOnExit = */ UINT32_MAX,
+            /* uint32_t *pulNotificationValue = */ &block_bits,
+            /* TickType_t xTicksToWait = */ portMAX_DELAY);
+
+        // Send the blocks oldest first, if both were handed off before this woke up, the one with the lower sequence is older
+        size_t first = 0;
+        if((0 != (block_bits & 1)) && (0 != (block_bits & 2)) &&
+            ((int16_t) (capture.blocks[1].header.sequence - capture.blocks[0].header.sequence) < 0))
+        {
+            first = 1;
+        }
+        for(size_t i = 0; i < CAPTURE_NUM_BLOCKS; ++i)
+        {
+            size_t index = (first + i) % CAPTURE_NUM_BLOCKS;
+            if(0 == (block_bits & (1 << index)))
+            {
+                continue;
+            }
+            capture_block_t *block = &capture.blocks[index];
+            (void) capture.func_send_block(
+                /* const void *block = */ block,
+                /* size_t num_block_bytes = */ sizeof(block->header) + (block->header.num_samples * sizeof(*block->samples)));
+            __atomic_store_n(&capture.is_block_busy[index], false, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+// ===================== //
+// Define public methods //
+// ===================== //
+
+bool capture_start(
+    Sensor *sensor,
+    size_t index,
+    uint32_t ms_window,
+    uint32_t decimation,
+    bool (*func_send_block)(const void *block, size_t num_block_bytes))
+{
+    if(index >= sensor->get_num_channels())
+    {
+        return false;
+    }
+
+    // Only run one capture at a time
+    bool is_running = false;
+    if(false == __atomic_compare_exchange_n(&capture.is_running, &is_running, true, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        return false;
+    }
+
+    // Create the tasks the first time they are needed, from static memory
+    if(nullptr == capture_task_handle)
+    {
+        send_capture_task_handle = xTaskCreateStatic(
+            // Pointer to the task entry function. Tasks must be implemented to never return (i.e. continuous loop).
+            /* TaskFunction_t pxTaskCode = */ task_send_capture,
+            // A descriptive name for the task. This is mainly used to facilitate debugging. Max length defined by configMAX_TASK_NAME_LEN - default is 16.
+            /* const char *const pcName = */ "send_capture",
+            // The size of the task stack specified as the NUMBER OF BYTES. Note that this differs from vanilla FreeRTOS.
+            /* const uint32_t ulStackDepth = */ CAPTURE_TASK_STACK_BYTES,
+            // Pointer that will be used as the parameter for the task being created.
+            /* void *const pvParameters = */ NULL,
+            // The priority at which the task should run, below the menu and watering tasks.
+            /* UBaseType_t uxPriority = */ 4,
+            // The statically allocated stack and task control block.
+            /* StackType_t *const puxStackBuffer = */ send_capture_task_stack,
+            /* StaticTask_t *const pxTaskBuffer = */ &send_capture_task_buffer);
+        configASSERT(send_capture_task_handle);
+        capture_task_handle = xTaskCreateStatic(
+            // Pointer to the task entry function. Tasks must be implemented to never return (i.e. continuous loop).
+            /* TaskFunction_t pxTaskCode = */ task_capture,
+            // A descriptive name for the task. This is mainly used to facilitate debugging. Max length defined by configMAX_TASK_NAME_LEN - default is 16.
+            /* const char *const pcName = */ "capture",
+            // The size of the task stack specified as the NUMBER OF BYTES. Note that this differs from vanilla FreeRTOS.
+            /* const uint32_t ulStackDepth = */ CAPTURE_TASK_STACK_BYTES,
+            // Pointer that will be used as the parameter for the task being created.
+            /* void *const pvParameters = */ NULL,
+            // The priority at which the task should run, below the menu and watering tasks, above sending, so capturing keeps up.
+            /* UBaseType_t uxPriority = */ 5,
+            // The statically allocated stack and task control block.
+            /* StackType_t *const puxStackBuffer = */ capture_task_stack,
+            /* StaticTask_t *const pxTaskBuffer = */ &capture_task_buffer);
+        configASSERT(capture_task_handle);
+    }
+
+    // Set up the capture, and start it
+    decimation = (decimation < 1) ? 1 : decimation;
+    ms_window = (ms_window < CAPTURE_MS_MAX_WINDOW) ? ms_window : CAPTURE_MS_MAX_WINDOW;
+    capture.sensor = sensor;
+    capture.sensor_index = index;
+    capture.num_sensor_samples = (uint32_t) (((uint64_t) sensor->get_channel_sample_hz() * ms_window) / 1000);
+    capture.decimation = decimation;
+    capture.func_send_block = func_send_block;
+    (void) xTaskNotifyGive(/* TaskHandle_t xTaskToNotify = */ capture_task_handle);
+    return true;
+}
\ No newline at end of file
@@ -2,99 +2,127 @@
 #include "context.h"
 // Include custom debug macros and compile flags
 #include "flags.h"
+// Include custom formatting API
+#include "format.h"
+// Include ESP32 high resolution timer API
+#include "esp_timer.h"
 
 // ======================================= //
 // Define reusable tasks, interrupts, etc. //
 // ======================================= //
 
-void task_rotate_servo(Servo *servo)
+bool soil_moisture_probes_fuse(
+    soil_moisture_probe_t *probes,
+    size_t num_probes,
+    const sensor_reading_t *readings,
+    uint16_t *out_soil_moisture)
 {
-    // I've found with the API I'm using, if the servo is not written to first, its first read value will be garbage
-    servo->write(/* int value = */ 0);
-
-    // Tasks must be implemented to never return (i.e. continuous loop)
-    // https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-reference/system/freertos_idf.html
-    // TODO: This seems to turn a bit more than 90 degrees, calibrate it using the library?
-    const int angles[] = {0, 90, 0};
-    const size_t num_angle = sizeof(angles) / sizeof(*angles);
-    size_t angles_i = 0;
-    int angle_delta = 0;
-    while(1)
+    // Take probes reading at a rail, or wandering with noise, as disconnected, that is judged on the raw reading,
+    // converting clamps it between the probe's calibration points
+    // NOTE: Converting the reduced reading is the same as converting every sample, then reducing them,
+    //       since the median (and the middle half, for a trimmed mean) is the same samples before and after
+    //       a conversion that only ever moves one way, and the mean of a few neighbouring samples barely bends
+    for(size_t i = 0; i < num_probes; ++i)
     {
-        // Suspend this task until it is needed
-        vTaskSuspend(/* TaskHandle_t xTaskToSuspend = */ NULL);
-
-        // For every angle we want to reach...
-        for(angles_i = 0; angles_i < num_angle; ++angles_i)
+        soil_moisture_probe_t *probe = &probes[i];
+        probe->raw = readings[i].value;
+        probe->noise = readings[i].noise;
+        probe->soil_moisture = calibration_convert(
+            /* const calibration_converter_t *converter = */ &probe->converter,
+            /* uint16_t raw = */ readings[i].value);
+        if((0 == readings[i].num_samples) ||
+            (readings[i].value < CONTEXT_PROBE_MIN_CONNECTED) ||
+            (readings[i].value > CONTEXT_PROBE_MAX_CONNECTED) ||
+            (readings[i].noise > CONTEXT_PROBE_MAX_CONNECTED_NOISE))
         {
-            // If the angle is already at what we want, don't need to do anything
-            angle_delta = abs(servo->read() - angles[angles_i]);
-            if(0 == angle_delta)
-            {
-                continue;
-            }
-
-            // Tell the servo to go to a certain angle, wait until it reaches it or timeout
-            // NOTE: angle_delta is used as a timeout here, and assumes 1 second = 100 degrees in an ideal case.
-            //       It gives 2x that amount of time to be lenient to bad cases.
-            //       100ms = .1s .1s * 100deg = 10deg, 10deg / 2 = 5deg
-            servo->write(/* int value = */ angles[angles_i]);
-            do
-            {
-                vTaskDelay(/* const TickType_t xTicksToDelay = */ pdMS_TO_TICKS(100));
-                angle_delta -= 5;
-            } while ((angle_delta > 0) && (servo->read() != angles[angles_i]));
+            probe->status = PROBE_STATUS_DISCONNECTED;
+            probe->is_others_last_moved_set = false;
+        }
+        else if(PROBE_STATUS_DISCONNECTED == probe->status)
+        {
+            // Reconnected, start watching whether it moves from here
+            probe->status = PROBE_STATUS_OK;
+            probe->soil_moisture_last_moved = probe->soil_moisture;
+            probe->is_others_last_moved_set = false;
         }
-
-        // 29OCT2024: usStackDepth = 1024, uxTaskGetHighWaterMark = 252
-        PRINT_STACK_USAGE();
     }
-}
 
-void task_water(Context *context)
-{
-    // Tasks must be implemented to never return (i.e. continuous loop)
-    // https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-reference/system/freertos_idf.html
-    // Read the soil moisture sensor, while the soil moisture is below our desired threshold, add more water
-    while(1)
+    // Sum the probes that were counted last time, and are still connected, to judge each probe against the others
+    uint32_t weighted_sum = 0;
+    uint32_t sum_weights = 0;
+    for(size_t i = 0; i < num_probes; ++i)
     {
-        // Wait until it is the time for the next moisture check
-        // TODO: Is there a more efficient way to do this?
-        //       Maybe have a timer task that simply resumes or notifies this task?
-        while(false == context->is_soil_moisture_check_overdue())
+        if(PROBE_STATUS_OK == probes[i].status)
         {
-            // Wait 1 minute
-            vTaskDelay(/* TickType_t xTicksToDelay = */ 60 * 1000);
+            weighted_sum += (uint32_t) probes[i].config.weight * probes[i].soil_moisture;
+            sum_weights += probes[i].config.weight;
         }
+    }
 
-        // Update context's current moisture, time last checked, and time of next check
-        // if we fail, oh well, not really worth waiting until it works
-        (void) context->check_soil_moisture(/* bool update_next_moisture_check = */ true);
-
-        // While we are not at our desired moisture, add more water
-        // TODO: Optimize the number of sensor polls needed.
-        //       1. Do, say, 10 squirts. See how much it increases the soil moisture, find the average from that sample size.
-        //       2. Poll soil moisture
-        //       3. Use the earlier average to calculate how many squirts are needed. Do that many squirts.
-        //       4. Repeat from 2. This reduces the number of times the sensor needs to be polled, reducing corrosion.
-        while(true == context->is_current_soil_moisture_below_desired())
+    // Take a probe as stuck if the others moved as if the pot was watered, while it did not
+    for(size_t i = 0; i < num_probes; ++i)
+    {
+        soil_moisture_probe_t *probe = &probes[i];
+        if(PROBE_STATUS_DISCONNECTED == probe->status)
+        {
+            continue;
+        }
+        uint32_t others_weighted_sum = weighted_sum;
+        uint32_t others_sum_weights = sum_weights;
+        if(PROBE_STATUS_OK == probe->status)
         {
-            // Trigger servo motor to squirt, wait until it finishes
-            (void) context->spray(
-                /* bool in_isr = */ false,
-                /* bool is_blocking = */ true);
+            others_weighted_sum -= (uint32_t) probe->config.weight * probe->soil_moisture;
+            others_sum_weights -= probe->config.weight;
+        }
 
-            // Wait for water from squirting to soak into soil
-            vTaskDelay(/* TickType_t xTicksToDelay = */ pdMS_TO_TICKS(5000));
+        // A probe that moved is working, start watching whether it moves from here
+        if(abs((int) probe->soil_moisture - (int) probe->soil_moisture_last_moved) > CONTEXT_PROBE_STUCK_TOLERANCE)
+        {
+            probe->status = PROBE_STATUS_OK;
+            probe->soil_moisture_last_moved = probe->soil_moisture;
+            probe->is_others_last_moved_set = false;
+        }
 
-            // Update context's current moisture, time last checked, and time of next check
-            // if we fail, oh well, not really worth waiting until it works
-            (void) context->check_soil_moisture(/* bool update_next_moisture_check = */ true);
+        // With nothing to compare against, a probe that did not move can't be told apart from soil that did not change
+        if(0 == others_sum_weights)
+        {
+            continue;
+        }
+        uint16_t others_soil_moisture = (uint16_t) ((others_weighted_sum + (others_sum_weights / 2)) / others_sum_weights);
+        if(false == probe->is_others_last_moved_set)
+        {
+            probe->others_soil_moisture_last_moved = others_soil_moisture;
+            probe->is_others_last_moved_set = true;
+        }
+        else if(abs((int) others_soil_moisture - (int) probe->others_soil_moisture_last_moved) >= CONTEXT_PROBE_STUCK_OTHERS_MOVED)
+        {
+            probe->status = PROBE_STATUS_STUCK;
         }
+    }
 
-        // 24OCT2024: usStackDepth = 2048, uxTaskGetHighWaterMark = 1220
-        PRINT_STACK_USAGE();
+    // Average the probes still counted, by weight
+    weighted_sum = 0;
+    sum_weights = 0;
+    for(size_t i = 0; i < num_probes; ++i)
+    {
+        if(PROBE_STATUS_OK == probes[i].status)
+        {
+            weighted_sum += (uint32_t) probes[i].config.weight * probes[i].soil_moisture;
+            sum_weights += probes[i].config.weight;
+        }
     }
+    if(0 == sum_weights)
+    {
+        return false;
+    }
+    *out_soil_moisture = (uint16_t) ((weighted_sum + (sum_weights / 2)) / sum_weights);
+    return true;
+}
+
+// Define a timer callback for writing a setting to NVS once it has stopped changing
+void timer_save_context(TimerHandle_t timer_handle)
+{
+    ((Context *) pvTimerGetTimerID(/* TimerHandle_t xTimer = */ timer_handle))->save_check_schedule();
 }
 
 // ======================== //
@@ -103,33 +131,88 @@ void task_water(Context *context)
 
 Context::Context(
     StaticSemaphore_t *arg_mutex_buffer,
-    int arg_pin_servo_out,
-    gpio_num_t arg_pin_soil_moisture_sensor_in,
-    char *arg_nvs_namespace)
+    ZoneScheduler *arg_zone_scheduler,
+    ServoScheduler *arg_servo_scheduler,
+    const zone_config_t *zone_config)
 {
     // Create mutex, open it for grabbing
     // NOTE: "Mutex type semaphores cannot be used from within interrupt service routines."
     mutex_handle = xSemaphoreCreateMutexStatic(/* pxMutexBuffer = */ arg_mutex_buffer);
     assert(nullptr != mutex_handle);
 
-    // Attach servo
-    servo.attach(/* int pin = */ arg_pin_servo_out);
+    // The zone is added to the zone scheduler last, nothing should notify it before then
+    zone_scheduler = arg_zone_scheduler;
+    zone_index = ZONE_MAX_ZONES;
+    water_progress = {};
+    water_progress.state = WATER_STATE_IDLE;
 
-    // Remember the pin of the soil moisture sensor
-    pin_soil_moisture_sensor_in = arg_pin_soil_moisture_sensor_in;
+    // Set up the dose queue, the zone scheduler's actuate tasks run it once the zone is added
+    dose_queue.init(
+        /* uint32_t ms_min_gap = */ CONTEXT_MS_MIN_DOSE_GAP,
+        /* uint32_t max_per_hour = */ CONTEXT_MAX_DOSES_PER_HOUR);
+    dose_queue.set_executor(/* SemaphoreHandle_t semaphore_handle = */ zone_scheduler->get_actuate_semaphore_handle());
+    is_actuating = false;
+    dose_request = {};
+    ul_dose_left = 0;
+    is_dose_deferred = false;
+    is_actuator_stopped = true;
+    ul_water_dosed = 0;
 
-    // Set the ADC attenuation to 11 dB (up to ~3.3V input)
-    // https://esp32io.com/tutorials/esp32-soil-moisture-sensor
-    // TODO: What is this and how do I un-Arduino it?
-    analogSetAttenuation(ADC_11db);
+    // Keep the soil moisture probes, they are all counted until they read as disconnected or stuck
+    // The zone scheduler set up the sensor with every zone's probes, each probe's reading is found by its pin
+    num_soil_moisture_probes = (zone_config->num_soil_moisture_probes < CONTEXT_MAX_SOIL_MOISTURE_PROBES) ?
+        zone_config->num_soil_moisture_probes :
+        CONTEXT_MAX_SOIL_MOISTURE_PROBES;
+    for(size_t i = 0; i < num_soil_moisture_probes; ++i)
+    {
+        soil_moisture_probes[i] = {};
+        soil_moisture_probes[i].config = zone_config->soil_moisture_probes[i];
+        soil_moisture_probes[i].channel = zone_scheduler->get_soil_moisture_sensor_channel(
+            /* gpio_num_t pin = */ zone_config->soil_moisture_probes[i].pin);
+        soil_moisture_probes[i].status = PROBE_STATUS_OK;
+    }
 
     // Get a handle to the NVS namespace for this context
-    nvs_namespace = arg_nvs_namespace;
+    nvs_namespace = zone_config->nvs_namespace;
     nvs_handle = 0;
     (void) storage_init(/* bool reinit = */ false);
     (void) storage_open(/* char *name = */ nvs_namespace,
         /* nvs_handle_t *nvs_handle = */ &nvs_handle);
 
+    // Set up the actuator, a servo is added to the shared scheduler, and is only sent pulses while squirting,
+    // its rate is read from NVS, under the key for its kind, if it was never calibrated, start from the default for its kind
+    const servo_profile_t servo_profile = {
+        /* uint8_t angle_rest = */ CONTEXT_SERVO_ANGLE_REST,
+        /* uint8_t angle_squeeze = */ CONTEXT_SERVO_ANGLE_SQUEEZE,
+        /* uint16_t ms_squeeze = */ CONTEXT_SERVO_MS_SQUEEZE,
+        /* uint16_t ms_hold = */ CONTEXT_SERVO_MS_HOLD,
+        /* uint16_t ms_release = */ CONTEXT_SERVO_MS_RELEASE,
+        /* uint16_t ms_rest = */ CONTEXT_SERVO_MS_REST
+    };
+    const pump_profile_t pump_profile = {
+        /* uint8_t duty_percent = */ CONTEXT_PUMP_DUTY_PERCENT,
+        /* uint16_t ms_soft_start = */ CONTEXT_PUMP_MS_SOFT_START
+    };
+    servo_scheduler = arg_servo_scheduler;
+    uint32_t ul_per_unit = (ACTUATOR_TYPE_PUMP == zone_config->actuator.type) ? CONTEXT_PUMP_DEFAULT_UL_PER_S : CONTEXT_SERVO_DEFAULT_UL_PER_SQUIRT;
+    if(false == actuator.init(
+        /* const actuator_config_t *config = */ &zone_config->actuator,
+        /* ServoScheduler *servo_scheduler = */ servo_scheduler,
+        /* const servo_profile_t *servo_profile = */ &servo_profile,
+        /* const pump_profile_t *pump_profile = */ &pump_profile,
+        /* uint32_t ul_per_unit = */ ul_per_unit))
+    {
+        s_println("Failed to set up the actuator");
+    }
+    if(true == storage_get(
+        /* nvs_handle_t nvs_handle = */ nvs_handle,
+        /* char *key = */ get_actuator_rate_nvs_key(),
+        /* void *value = */ &ul_per_unit,
+        /* size_t num_value_bytes = */ sizeof(ul_per_unit)))
+    {
+        actuator.set_ul_per_unit(/* uint32_t ul_per_unit = */ ul_per_unit);
+    }
+
     // Get minute_moisture_check_freq from NVS
     if(false == storage_get(
         /* nvs_handle_t nvs_handle = */ nvs_handle,
@@ -146,6 +229,73 @@ Context::Context(
             /* size_t num_value_bytes = */ sizeof(minute_soil_moisture_check_freq));
     }
 
+    // Get how the next check is decided from NVS
+    if(false == storage_get(
+        /* nvs_handle_t nvs_handle = */ nvs_handle,
+        /* char *key = */ CONTEXT_NVS_KEY_CHECK_SCHEDULE,
+        /* void *value = */ &check_schedule,
+        /* size_t num_value_bytes = */ sizeof(check_schedule)))
+    {
+        // Set the default as checking every minute_soil_moisture_check_freq, and if made adaptive,
+        // checking between every 15 minutes and every 6 hours
+        check_schedule.is_adaptive = false;
+        check_schedule.minute_min_check_freq = 15;
+        check_schedule.minute_max_check_freq = 6 * 60;
+        (void) storage_set(
+            /* nvs_handle_t nvs_handle = */ nvs_handle,
+            /* char *key = */ CONTEXT_NVS_KEY_CHECK_SCHEDULE,
+            /* void *value = */ &check_schedule,
+            /* size_t num_value_bytes = */ sizeof(check_schedule));
+    }
+
+    // Get what has been learned about how long water takes to soak into this pot from NVS, if nothing has, start from the default
+    if(false == storage_get(
+        /* nvs_handle_t nvs_handle = */ nvs_handle,
+        /* char *key = */ CONTEXT_NVS_KEY_SOAK_MODEL,
+        /* void *value = */ &soak_model,
+        /* size_t num_value_bytes = */ sizeof(soak_model)))
+    {
+        soak_model.ms_settle = CONTEXT_MS_DEFAULT_SOAK_SETTLE;
+        soak_model.is_learned = false;
+    }
+    soak_curve.num_readings = 0;
+    soak_curve.is_settled = false;
+
+    // Get how each soil moisture probe was calibrated from NVS, probes that have not been start from the default points
+    // NOTE: Every probe's calibration is kept, even past num_soil_moisture_probes, so adding a probe does not lose the others'
+    calibration_t calibrations[CONTEXT_MAX_SOIL_MOISTURE_PROBES];
+    for(size_t i = 0; i < CONTEXT_MAX_SOIL_MOISTURE_PROBES; ++i)
+    {
+        calibration_set_default(/* calibration_t *calibration = */ &calibrations[i]);
+    }
+    (void) storage_get(
+        /* nvs_handle_t nvs_handle = */ nvs_handle,
+        /* char *key = */ CONTEXT_NVS_KEY_PROBE_CALIBRATIONS,
+        /* void *value = */ calibrations,
+        /* size_t num_value_bytes = */ sizeof(calibrations));
+    for(size_t i = 0; i < num_soil_moisture_probes; ++i)
+    {
+        soil_moisture_probes[i].calibration = calibrations[i];
+        (void) calibration_build(
+            /* const calibration_t *calibration = */ &soil_moisture_probes[i].calibration,
+            /* calibration_converter_t *out_converter = */ &soil_moisture_probes[i].converter);
+    }
+
+    // There are no readings yet to tell how fast the soil is drying
+    soil_moisture_history.num_readings = 0;
+    soil_moisture_history.max_drying_per_sec = 0.0f;
+    num_failed_soil_moisture_checks = 0;
+
+    // Create the timer that writes the check schedule to NVS after it stops changing, it is started by changing it
+    save_timer_handle = xTimerCreate(
+        /* const char *const pcTimerName = */ "save_context",
+        /* const TickType_t xTimerPeriodInTicks = */ pdMS_TO_TICKS(CONTEXT_MS_SAVE_DELAY),
+        // Only fire once per change, changing it again restarts the timer
+        /* const UBaseType_t uxAutoReload = */ pdFALSE,
+        /* void *const pvTimerID = */ this,
+        /* TimerCallbackFunction_t pxCallbackFunction = */ timer_save_context);
+    configASSERT(save_timer_handle);
+
     // Get the current soil moisture
     // TODO: is this being called before esp_timer_early_init?
     check_soil_moisture(/* bool move_time_next_moisture_check = */ true);
@@ -166,245 +316,1382 @@ Context::Context(
             /* size_t num_value_bytes = */ sizeof(desired_soil_moisture));
     }
 
-    // Create task to rotate servo motor (it can take several seconds)
-    // TODO: Look into static memory allocation instead?
-    xTaskCreate(
-        // Pointer to the task entry function. Tasks must be implemented to never return (i.e. continuous loop).
-        /* TaskFunction_t pxTaskCode = */ (TaskFunction_t) task_rotate_servo,
-        // A descriptive name for the task. This is mainly used to facilitate debugging. Max length defined by configMAX_TASK_NAME_LEN - default is 16.
-        /* const char *const pcName = */ "rotate_servo",
-        // The size of the task stack specified as the NUMBER OF BYTES. Note that this differs from vanilla FreeRTOS.
-        /* const configSTACK_DEPT_TYPE usStackDepth = */ 1024,
-        // Pointer that will be used as the parameter for the task being created.
-        /* void *const pvParameters = */ &servo,
-        // The priority at which the task should run.
-        // Systems that include MPU support can optionally create tasks in a privileged (system) mode by setting bit portPRIVILEGE_BIT of the priority parameter.
-        // For example, to create a privileged task at priority 2 the uxPriority parameter should be set to ( 2 | portPRIVILEGE_BIT ).
-        /* UBaseType_t uxPriority = */ 10,
-        // Used to pass back a handle by which the created task can be referenced.
-        /* TaskHandle_t *const pxCreatedTask = */ &rotate_servo_task_handle);
-    configASSERT(rotate_servo_task_handle);
-
-    // Create task to schedule sprays
-    // TODO: Look into static memory allocation instead?
-    xTaskCreate(
-        // Pointer to the task entry function. Tasks must be implemented to never return (i.e. continuous loop).
-        /* TaskFunction_t pxTaskCode = */ (TaskFunction_t) task_water,
-        // A descriptive name for the task. This is mainly used to facilitate debugging. Max length defined by configMAX_TASK_NAME_LEN - default is 16.
-        /* const char *const pcName = */ "water",
-        // The size of the task stack specified as the NUMBER OF BYTES. Note that this differs from vanilla FreeRTOS.
-        /* const configSTACK_DEPT_TYPE usStackDepth = */ 2048,
-        // Pointer that will be used as the parameter for the task being created.
-        /* void *const pvParameters = */ this,
-        // The priority at which the task should run.
-        // Systems that include MPU support can optionally create tasks in a privileged (system) mode by setting bit portPRIVILEGE_BIT of the priority parameter.
-        // For example, to create a privileged task at priority 2 the uxPriority parameter should be set to ( 2 | portPRIVILEGE_BIT ).
-        /* UBaseType_t uxPriority = */ 10,
-        // Used to pass back a handle by which the created task can be referenced.
-        /* TaskHandle_t *const pxCreatedTask = */ &water_task_handle);
-    configASSERT(water_task_handle);
+    // Get what has been learned about this pot from NVS, if nothing has, start from nothing
+    if(false == storage_get(
+        /* nvs_handle_t nvs_handle = */ nvs_handle,
+        /* char *key = */ CONTEXT_NVS_KEY_DOSE_MODEL,
+        /* void *value = */ &dose_model,
+        /* size_t num_value_bytes = */ sizeof(dose_model)))
+    {
+        dose_model.moisture_per_ml = 0.0f;
+        dose_model.num_samples = 0;
+    }
+
+    // Publish the settings loaded from NVS for readers
+    CONTEXT_LOCK(/* RET_VAL = */);
+    publish_snapshot();
+    CONTEXT_UNLOCK();
+
+    // Add the zone to the zone scheduler, and tell it when the first check is
+    zone_index = zone_scheduler->add_zone(/* Context *zone = */ this);
+    notify_zone_scheduler();
 }
 
-bool Context::is_soil_moisture_check_overdue()
+void Context::get_snapshot(context_snapshot_t *out_snapshot)
 {
-    // If the time of the next check is after the current time, we're overdue
-    CONTEXT_LOCK(/* RET_VAL = */ false);
-    bool is_overdue = time(/* time_t *_timer = */ nullptr) >= time_next_soil_moisture_check;
-    CONTEXT_UNLOCK();
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ out_snapshot);
+}
 
-    // Return result of check
-    return is_overdue;
+void Context::publish_snapshot()
+{
+    context_snapshot_t new_snapshot = {
+        /* uint16_t current_soil_moisture = */ current_soil_moisture,
+        /* uint16_t desired_soil_moisture = */ desired_soil_moisture,
+        /* uint32_t minute_soil_moisture_check_freq = */ minute_soil_moisture_check_freq,
+        /* time_t time_last_soil_moisture_check = */ time_last_soil_moisture_check,
+        /* time_t time_next_soil_moisture_check = */ time_next_soil_moisture_check,
+        /* check_schedule_t check_schedule = */ check_schedule,
+        /* soil_moisture_probe_reading_t soil_moisture_probes[] = */ {},
+        /* size_t num_soil_moisture_probes = */ num_soil_moisture_probes,
+        /* ACTUATOR_TYPE_t actuator_type = */ actuator.get_type(),
+        /* uint32_t ul_per_unit = */ actuator.get_ul_per_unit()
+    };
+    for(size_t i = 0; i < num_soil_moisture_probes; ++i)
+    {
+        new_snapshot.soil_moisture_probes[i].raw = soil_moisture_probes[i].raw;
+        new_snapshot.soil_moisture_probes[i].soil_moisture = soil_moisture_probes[i].soil_moisture;
+        new_snapshot.soil_moisture_probes[i].status = soil_moisture_probes[i].status;
+        new_snapshot.soil_moisture_probes[i].calibration = soil_moisture_probes[i].calibration;
+    }
+    snapshot.store(/* const context_snapshot_t *new_value = */ &new_snapshot);
 }
 
-bool Context::is_current_soil_moisture_below_desired()
+uint32_t Context::get_ul_to_desired()
 {
-    // If the current moisture is below the desired moisture, well
-    // NOTE: These sensors give a LOWER value when the soil is wetter.
-    //       So, a higher value means it is dryer.
-    //       The check here is whether the current soil humidity is dryer than what we want.
-    CONTEXT_LOCK(/* RET_VAL = */ false);
-    bool is_current_below_desired = current_soil_moisture > desired_soil_moisture;
+    CONTEXT_LOCK(/* RET_VAL = */ actuator.get_ul_min_dose());
+    uint32_t ul = dose_model_predict(
+        /* const dose_model_t *dose_model = */ &dose_model,
+        /* uint16_t current_soil_moisture = */ current_soil_moisture,
+        /* uint16_t desired_soil_moisture = */ desired_soil_moisture,
+        /* uint32_t ul_per_unit = */ actuator.get_ul_per_unit(),
+        /* uint32_t ul_min_dose = */ actuator.get_ul_min_dose());
     CONTEXT_UNLOCK();
+    return ul;
+}
 
-    // Return result of check
-    return is_current_below_desired;
+uint32_t Context::get_ul_per_unit()
+{
+    // The actuator keeps its rate atomically, there is no need to lock the context
+    return actuator.get_ul_per_unit();
 }
 
-MENU_CONTROL Context::check_soil_moisture(bool update_next_moisture_check)
+void Context::learn_dose_response(
+    uint16_t before_soil_moisture,
+    uint16_t after_soil_moisture,
+    uint32_t ul_dosed)
 {
-    // Get the current soil moisture from the ADC pin,
-    // update the time of the last check to now,
-    // and update the time of the next check (if desired)
-    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_RELEASE);
-    current_soil_moisture = analogRead(pin_soil_moisture_sensor_in);
-    time_last_soil_moisture_check = time(/* time_t *_timer = */ nullptr);
-    if(update_next_moisture_check)
+    CONTEXT_LOCK(/* RET_VAL = */);
+    if(true == dose_model_learn(
+        /* dose_model_t *dose_model = */ &dose_model,
+        /* uint16_t before_soil_moisture = */ before_soil_moisture,
+        /* uint16_t after_soil_moisture = */ after_soil_moisture,
+        /* uint32_t ul_dosed = */ ul_dosed))
     {
-        // NOTE: time_t is usually represented as seconds since the last epoch
-        time_next_soil_moisture_check = time_last_soil_moisture_check + (minute_soil_moisture_check_freq * 60);
+        (void) storage_set(
+            /* nvs_handle_t nvs_handle = */ nvs_handle,
+            /* char *key = */ CONTEXT_NVS_KEY_DOSE_MODEL,
+            /* void *value = */ &dose_model,
+            /* size_t num_value_bytes = */ sizeof(dose_model));
     }
     CONTEXT_UNLOCK();
+}
 
-    // Return control to the menu
-    return MENU_CONTROL_RELEASE;
+int64_t Context::get_us_next_water_step()
+{
+    // While watering, the next step is when the last step said
+    if(WATER_STATE_IDLE != water_progress.state)
+    {
+        return water_progress.us_next_step;
+    }
+
+    // Otherwise, it is the next soil moisture check, which is kept by the wall clock
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+    time_t sec_diff = cpy.time_next_soil_moisture_check - time(/* time_t *_timer = */ nullptr);
+    return esp_timer_get_time() + ((sec_diff <= 0) ? 0 : ((int64_t) sec_diff * 1000 * 1000));
 }
 
-MENU_CONTROL Context::water()
+int64_t Context::step_water()
 {
-    // Run task_water by updating its wait condition
-    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_RELEASE);
-    time_next_soil_moisture_check = time(/* time_t *_timer = */ nullptr);
-    CONTEXT_UNLOCK();
+    int64_t us_now = esp_timer_get_time();
+    int64_t us_next_step = us_now;
+    switch(water_progress.state)
+    {
+        case WATER_STATE_IDLE:
+        {
+            // The check may have moved later since it was due, if so, wait for it again
+            if(false == is_soil_moisture_check_overdue())
+            {
+                return get_us_next_water_step();
+            }
 
-    // Return control to the menu
-    return MENU_CONTROL_RELEASE;
+            // Update context's current moisture, time last checked, and time of next check
+            // Never water from a reading that failed, the last one may be long out of date, wait for the retry instead
+            if(false == try_check_soil_moisture(/* bool update_next_moisture_check = */ true))
+            {
+                return get_us_next_water_step();
+            }
+
+            // While we are not at our desired moisture, add more water
+            // Dose as much as it takes to get close to our desired moisture, then read the soil moisture again,
+            // instead of reading it after every dose, this reduces the number of times the sensor is used, reducing corrosion
+            context_snapshot_t before;
+            get_snapshot(/* context_snapshot_t *out_snapshot = */ &before);
+            water_progress.soil_moisture_before = before.current_soil_moisture;
+            water_progress.us_start = us_now;
+            water_progress.num_reads = 0;
+            water_progress.num_batches = 0;
+            water_progress.ul_watered = 0;
+            us_next_step = start_water_batch(/* int64_t us_now = */ us_now);
+            break;
+        }
+        case WATER_STATE_DOSING:
+        {
+            // Check back until the batch is dosed, or it took longer than allowed for each unit of it
+            bool is_dosed = dose_queue.is_done(/* uint32_t ticket = */ water_progress.dose_ticket);
+            if((false == is_dosed) && (us_now < water_progress.us_dose_timeout))
+            {
+                us_next_step = us_now + ((int64_t) CONTEXT_MS_DOSE_POLL * 1000);
+                break;
+            }
+
+            // Past the timeout, take a batch still waiting (ex. held back by the hourly cap) off the queue, so it is not dosed
+            // while soaking, or merged into the next batch, a batch the actuator started on is waited for, it finishes once it
+            // is dosed, or the actuator gives up on it
+            if((false == is_dosed) &&
+                (false == dose_queue.cancel(/* uint32_t ticket = */ water_progress.dose_ticket)) &&
+                (false == dose_queue.is_done(/* uint32_t ticket = */ water_progress.dose_ticket)))
+            {
+                us_next_step = us_now + ((int64_t) CONTEXT_MS_DOSE_POLL * 1000);
+                break;
+            }
+
+            // Soaking after nothing was dosed would only read the soil for nothing, and dose again, stop until the next check
+            if(__atomic_load_n(&ul_water_dosed, __ATOMIC_RELAXED) == water_progress.ul_water_dosed_start)
+            {
+                s_print("Watering stopped, nothing was dosed, zone: ");
+                s_println(zone_index + 1, DEC);
+                water_progress.state = WATER_STATE_IDLE;
+                return get_us_next_water_step();
+            }
+
+            // Wait for water to soak into soil, reading it at growing intervals until the readings settle
+            // Water takes a while to reach the probe, reading too early would see too little change and dose again
+            water_progress.soak_curve.soil_moisture_before = water_progress.soil_moisture_before;
+            water_progress.soak_curve.num_readings = 0;
+            water_progress.soak_curve.is_settled = false;
+            uint32_t ms_soak_interval = get_ms_soak_settle() / 2;
+            water_progress.ms_soak_interval = (ms_soak_interval < CONTEXT_MS_MIN_SOAK_INTERVAL) ? CONTEXT_MS_MIN_SOAK_INTERVAL : ms_soak_interval;
+            water_progress.us_soak_start = us_now;
+            water_progress.state = WATER_STATE_SOAKING;
+            us_next_step = us_now + ((int64_t) water_progress.ms_soak_interval * 1000);
+            break;
+        }
+        case WATER_STATE_SOAKING:
+        {
+            // Read again, waiting twice as long before the next read, until the readings settle, fill the curve, or time out
+            soak_curve_t *soak_curve = &water_progress.soak_curve;
+            uint32_t ms_after_dose = (uint32_t) ((us_now - water_progress.us_soak_start) / 1000);
+            water_progress.ms_soak_interval = ((water_progress.ms_soak_interval * 2) < CONTEXT_MS_MAX_SOAK_INTERVAL) ?
+                (water_progress.ms_soak_interval * 2) :
+                CONTEXT_MS_MAX_SOAK_INTERVAL;
+            // A reading that failed is left out of the curve, repeating the last one would look settled
+            uint16_t soil_moisture = 0;
+            bool is_read = read_soil_moisture(/* uint16_t *out_soil_moisture = */ &soil_moisture);
+            if(((false == is_read) || (false == soak_curve_add(
+                    /* soak_curve_t *curve = */ soak_curve,
+                    /* uint16_t soil_moisture = */ soil_moisture,
+                    /* uint32_t ms_after_dose = */ ms_after_dose))) &&
+                (soak_curve->num_readings < CONTEXT_SOAK_CURVE_LENGTH) &&
+                (ms_after_dose < CONTEXT_MS_SOAK_TIMEOUT))
+            {
+                us_next_step = esp_timer_get_time() + ((int64_t) water_progress.ms_soak_interval * 1000);
+                break;
+            }
+
+            // With no reading since the batch, nothing can be recorded or learned, and dosing again could flood the pot,
+            // stop watering, and check again after a while
+            if(0 == soak_curve->num_readings)
+            {
+                s_print("Watering stopped, the soil moisture could not be read, zone: ");
+                s_println(zone_index + 1, DEC);
+                water_progress.state = WATER_STATE_IDLE;
+                CONTEXT_LOCK(/* RET_VAL = */ get_us_next_water_step());
+                delay_time_next_soil_moisture_check();
+                publish_snapshot();
+                CONTEXT_UNLOCK();
+                notify_menu_changed();
+                return get_us_next_water_step();
+            }
+
+            // Update context's current moisture, time last checked, and time of next check, from the newest reading,
+            // and learn how long this pot takes to settle
+            finish_soak(/* const soak_curve_t *curve = */ soak_curve);
+
+            // Learn how much the water actually dosed changed the soil moisture, to better predict the next batch,
+            // not what was asked for, the actuator may have given up on some of it
+            context_snapshot_t after;
+            get_snapshot(/* context_snapshot_t *out_snapshot = */ &after);
+            uint32_t ul_dosed = __atomic_load_n(&ul_water_dosed, __ATOMIC_RELAXED) - water_progress.ul_water_dosed_start;
+            learn_dose_response(
+                /* uint16_t before_soil_moisture = */ water_progress.soil_moisture_before,
+                /* uint16_t after_soil_moisture = */ after.current_soil_moisture,
+                /* uint32_t ul_dosed = */ ul_dosed);
+            water_progress.soil_moisture_before = after.current_soil_moisture;
+            water_progress.num_reads += soak_curve->num_readings;
+            ++water_progress.num_batches;
+            water_progress.ul_watered += ul_dosed;
+            us_next_step = start_water_batch(/* int64_t us_now = */ esp_timer_get_time());
+            break;
+        }
+        default:
+        {
+            water_progress.state = WATER_STATE_IDLE;
+            return get_us_next_water_step();
+        }
+    }
+    water_progress.us_next_step = us_next_step;
+    return us_next_step;
 }
 
-MENU_CONTROL Context::spray(
-    bool in_isr,
-    bool is_blocking)
+int64_t Context::start_water_batch(int64_t us_now)
 {
-    // Run task_rotate_servo
-    if(true == in_isr)
+    // Once at our desired moisture, wait for the next check
+    if(false == is_current_soil_moisture_below_desired())
     {
-        (void) xTaskResumeFromISR(/* TaskHandle_t xTaskToResume = */ rotate_servo_task_handle);
+        // Report how much water it took, and how long, batching reads the sensor once per batch instead of once per squirt
+        if(0 != water_progress.num_reads)
+        {
+            // The format functions do not write a null terminator, leave room for one
+            char buf[16];
+            size_t num_chars = format_milli(buf, sizeof(buf) - 1, water_progress.ul_watered);
+            buf[num_chars] = '\0';
+            s_print("Watered (ml): ");
+            s_print(buf);
+            s_print(", zone: ");
+            s_print(zone_index + 1, DEC);
+            s_print(", batches: ");
+            s_print(water_progress.num_batches, DEC);
+            s_print(", reads: ");
+            s_print(water_progress.num_reads, DEC);
+            s_print(", time to target (s): ");
+            s_print((uint32_t) ((us_now - water_progress.us_start) / (1000 * 1000)), DEC);
+            s_print(", learned settle time (ms): ");
+            s_print(get_ms_soak_settle(), DEC);
+            actuator_stats_t actuator_stats;
+            get_actuator_stats(/* actuator_stats_t *out_stats = */ &actuator_stats);
+            s_print(", last dose (ms): ");
+            s_println(actuator_stats.us_last_dose / 1000, DEC);
+        }
+        water_progress.state = WATER_STATE_IDLE;
+        return get_us_next_water_step();
     }
-    else
+
+    // Trigger the actuator to dose as much as predicted, and check back until it finishes, allowing for each unit it takes
+    water_progress.ul_batch = get_ul_to_desired();
+    water_progress.ul_water_dosed_start = __atomic_load_n(&ul_water_dosed, __ATOMIC_RELAXED);
+    uint32_t num_batch_units = (water_progress.ul_batch / get_ul_per_unit()) + 1;
+    water_progress.dose_ticket = request_dose(
+        /* ACTUATION_SOURCE_t source = */ ACTUATION_SOURCE_WATER,
+        /* ACTUATION_PRIORITY_t priority = */ ACTUATION_PRIORITY_NORMAL,
+        /* uint32_t ul = */ water_progress.ul_batch);
+    water_progress.us_dose_timeout = us_now + ((int64_t) CONTEXT_MS_DOSE_TIMEOUT * num_batch_units * 1000);
+    water_progress.state = WATER_STATE_DOSING;
+    return us_now + ((int64_t) CONTEXT_MS_DOSE_POLL * 1000);
+}
+
+bool Context::step_actuate(TickType_t *out_ticks_until_allowed)
+{
+    *out_ticks_until_allowed = portMAX_DELAY;
+
+    // Only one task doses this Context at a time, the others move on to other zones
+    if(true == __atomic_exchange_n(&is_actuating, true, __ATOMIC_ACQUIRE))
+    {
+        return false;
+    }
+
+    // Start on the most urgent request waiting, if not on one already, requests made while dosing are queued behind it
+    if((0 == dose_request.ticket) &&
+        (true == dose_queue.start_next(/* actuation_request_t *out_request = */ &dose_request)))
     {
-        vTaskResume(/* TaskHandle_t xTaskToResume = */ rotate_servo_task_handle);
+        ul_dose_left = dose_request.amount;
     }
 
-    // If we wanted to block (yield) until the task finishes, do so
-    if(true == is_blocking)
+    bool is_stepped = false;
+    TickType_t ticks_until_allowed = 0;
+    if(0 == dose_request.ticket)
+    {
+        // Nothing is left to dose, stop, so a servo does not jitter or draw current while idle
+        if(false == is_actuator_stopped)
+        {
+            actuator.stop();
+            is_actuator_stopped = true;
+        }
+    }
+    else if((ul_dose_left * 2) < actuator.get_ul_min_dose())
+    {
+        // Dose until what is left is less than half the smallest dose, a servo squirts a whole number of times,
+        // a pump runs for as long as what is left takes, in runs of at most PUMP_MS_MAX_RUN
+        // Then mark the request done, and wake everyone waiting on it
+        dose_queue.finish(/* const actuation_request_t *request = */ &dose_request);
+        dose_request.ticket = 0;
+        is_stepped = true;
+    }
+    else if(0 != (ticks_until_allowed = dose_queue.get_ticks_until_allowed()))
+    {
+        // Wait for the gap after the last dose, or for the hourly cap to allow another,
+        // stopped, so a servo does not draw current holding its position meanwhile
+        if(false == is_actuator_stopped)
+        {
+            actuator.stop();
+            is_actuator_stopped = true;
+        }
+        is_dose_deferred = true;
+        *out_ticks_until_allowed = ticks_until_allowed;
+    }
+    else
     {
-        while(eSuspended != eTaskGetState(rotate_servo_task_handle))
+        // Dose, the LEDC moves a servo, or ramps up a pump, in hardware, and a servo's moves each wait for the scheduler
+        // to have room for them, so servos sharing the supply do not all start at once
+        uint32_t ul_dosed = 0;
+        is_actuator_stopped = false;
+        if(false == actuator.dose(
+            /* uint32_t ul_wanted = */ ul_dose_left,
+            /* uint32_t *out_ul_dosed = */ &ul_dosed))
+        {
+            s_println("Actuator did not dose as asked");
+        }
+        dose_queue.record_actuation(/* bool is_deferred = */ is_dose_deferred);
+        is_dose_deferred = false;
+        if(ACTUATION_SOURCE_WATER == dose_request.source)
         {
-            // Wait half a second to check if task is suspended again
-            // TODO: Look into task notifications?
-            vTaskDelay(/* TickType_t xTicksToDelay = */ pdMS_TO_TICKS(500));
+            (void) __atomic_add_fetch(&ul_water_dosed, ul_dosed, __ATOMIC_RELAXED);
         }
+
+        // Give up on the rest if nothing was dosed, so a broken actuator is not retried forever
+        ul_dose_left = (0 == ul_dosed) ? 0 : (ul_dose_left - ((ul_dosed < ul_dose_left) ? ul_dosed : ul_dose_left));
+        is_stepped = true;
     }
 
-    // Return control to the menu
-    return MENU_CONTROL_RELEASE;
+    __atomic_store_n(&is_actuating, false, __ATOMIC_RELEASE);
+    return is_stepped;
 }
 
-MENU_CONTROL Context::set_desired_soil_moisture_to_current()
+void Context::notify_zone_scheduler()
 {
-    // Set our desired soil moisture to match the last known soil moisture, in memory and NVS
-    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_RELEASE);
-    desired_soil_moisture = current_soil_moisture;
-    (void) storage_set(
-        /* nvs_handle_t nvs_handle = */ nvs_handle,
-        /* char *key = */ CONTEXT_NVS_KEY_DESIRED_SOIL_MOISTURE,
-        /* void *value = */ &desired_soil_moisture,
-        /* size_t num_value_bytes = */ sizeof(desired_soil_moisture));
-    CONTEXT_UNLOCK();
+    // Settings can change before the zone is added, until then its index is ZONE_MAX_ZONES, which is ignored,
+    // the zone scheduler reads them once it is added
+    zone_scheduler->notify_zone(/* size_t index = */ zone_index);
+}
 
-    // Return control to the menu
-    return MENU_CONTROL_RELEASE;
+bool Context::is_soil_moisture_check_overdue()
+{
+    // If the time of the next check is after the current time, we're overdue
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+    bool is_overdue = time(/* time_t *_timer = */ nullptr) >= cpy.time_next_soil_moisture_check;
+
+    // Return result of check
+    return is_overdue;
 }
 
-MENU_CONTROL Context::add_minute_soil_moisture_check_freq(int num_minutes)
+bool Context::is_current_soil_moisture_below_desired()
 {
-    // Alter the moisture check frequenecy in memory and NVS
-    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_KEEP);
-    minute_soil_moisture_check_freq += num_minutes;
-    (void) storage_set(
-        /* nvs_handle_t nvs_handle = */ nvs_handle,
-        /* char *key = */ CONTEXT_NVS_KEY_MINUTE_SOIL_MOISTURE_CHECK_FREQ,
-        /* void *value = */ &minute_soil_moisture_check_freq,
-        /* size_t num_value_bytes = */ sizeof(minute_soil_moisture_check_freq));
-    CONTEXT_UNLOCK();
+    // If the current moisture is below the desired moisture, well
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+    bool is_current_below_desired = cpy.current_soil_moisture < cpy.desired_soil_moisture;
 
-    // Do not return control to the menu
-    return MENU_CONTROL_KEEP;
+    // Return result of check
+    return is_current_below_desired;
 }
 
-String Context::str_current_soil_moisture()
+MENU_CONTROL Context::check_soil_moisture(bool update_next_moisture_check)
 {
-    // -------------------- //
-    //   Current X: 65535   //
-    // -------------------- //
-    String ret = String("Current X: ");
+    (void) try_check_soil_moisture(/* bool update_next_moisture_check = */ update_next_moisture_check);
+
+    // Return control to the menu
+    return MENU_CONTROL_RELEASE;
+}
 
-    CONTEXT_LOCK(/* RET_VAL = */ ret);
-    uint16_t cpy = current_soil_moisture;
+bool Context::try_check_soil_moisture(bool update_next_moisture_check)
+{
+    // Get the current soil moisture from the ADC pin,
+    // update the time of the last check to now,
+    // and update the time of the next check (if desired)
+    // The sensor has its own lock, read it before locking the context, so readers of the context do not wait on the ADC
+    sensor_reading_t readings[CONTEXT_MAX_SOIL_MOISTURE_PROBES];
+    bool is_read = read_soil_moisture_probes(/* sensor_reading_t *out_readings = */ readings);
+    CONTEXT_LOCK(/* RET_VAL = */ false);
+    uint16_t soil_moisture = 0;
+    bool is_recorded = (true == is_read) && (true == fuse_soil_moisture_probes(
+        /* const sensor_reading_t *readings = */ readings,
+        /* uint16_t *out_soil_moisture = */ &soil_moisture));
+    if(true == is_recorded)
+    {
+        record_soil_moisture(
+            /* uint16_t soil_moisture = */ soil_moisture,
+            /* bool update_next_moisture_check = */ update_next_moisture_check);
+    }
+    else
+    {
+        // Keep the last soil moisture, the sensor is busy or none of the probes can be trusted, show why every probe was left out,
+        // and try again after a while, instead of as soon as the zone scheduler sees the check is still due
+        if(update_next_moisture_check)
+        {
+            delay_time_next_soil_moisture_check();
+        }
+        publish_snapshot();
+    }
     CONTEXT_UNLOCK();
 
-    return ret + String(cpy, DEC);
+    // Tell the menu what it is showing changed
+    notify_menu_changed();
+
+    // Tell the zone scheduler when the next check is, if it moved
+    if(update_next_moisture_check)
+    {
+        notify_zone_scheduler();
+    }
+    return is_recorded;
 }
 
-String Context::str_desired_soil_moisture()
+void Context::record_soil_moisture(
+    uint16_t soil_moisture,
+    bool update_next_moisture_check)
 {
-    // -------------------- //
-    //   Desired X: 65535   //
-    // -------------------- //
-    String ret = String("Desired X: ");
+    current_soil_moisture = soil_moisture;
+    time_last_soil_moisture_check = time(/* time_t *_timer = */ nullptr);
+    num_failed_soil_moisture_checks = 0;
+    soil_moisture_history_add(
+        /* soil_moisture_history_t *history = */ &soil_moisture_history,
+        /* uint16_t soil_moisture = */ current_soil_moisture,
+        /* time_t time_reading = */ time_last_soil_moisture_check);
+    if(update_next_moisture_check)
+    {
+        update_time_next_soil_moisture_check();
+    }
+    publish_snapshot();
+}
 
-    CONTEXT_LOCK(/* RET_VAL = */ ret);
-    uint16_t cpy = desired_soil_moisture;
+uint32_t Context::get_ms_soak_settle()
+{
+    CONTEXT_LOCK(/* RET_VAL = */ CONTEXT_MS_DEFAULT_SOAK_SETTLE);
+    uint32_t ms_settle = soak_model.ms_settle;
     CONTEXT_UNLOCK();
+    return ms_settle;
+}
 
-    return ret + String(cpy, DEC);
+bool Context::fuse_soil_moisture_probes(
+    const sensor_reading_t *readings,
+    uint16_t *out_soil_moisture)
+{
+    return soil_moisture_probes_fuse(
+        /* soil_moisture_probe_t *probes = */ soil_moisture_probes,
+        /* size_t num_probes = */ num_soil_moisture_probes,
+        /* const sensor_reading_t *readings = */ readings,
+        /* uint16_t *out_soil_moisture = */ out_soil_moisture);
 }
 
-String Context::str_minute_soil_moisture_check_freq()
+bool Context::read_soil_moisture(uint16_t *out_soil_moisture)
 {
-    // -------------------- //
-    //   X freq: 100 min    //
-    // -------------------- //
-    String ret = String("X freq: ");
+    // The sensor has its own lock, read it before locking the context, so readers of the context do not wait on the ADC
+    sensor_reading_t readings[CONTEXT_MAX_SOIL_MOISTURE_PROBES];
+    if(false == read_soil_moisture_probes(/* sensor_reading_t *out_readings = */ readings))
+    {
+        return false;
+    }
 
-    CONTEXT_LOCK(/* RET_VAL = */ ret);
-    uint32_t cpy = minute_soil_moisture_check_freq;
+    // Fuse the probes, this is not recorded, but watching water soak in is when stuck probes are most likely to be caught
+    CONTEXT_LOCK(/* RET_VAL = */ false);
+    bool is_fused = fuse_soil_moisture_probes(
+        /* const sensor_reading_t *readings = */ readings,
+        /* uint16_t *out_soil_moisture = */ out_soil_moisture);
+    publish_snapshot();
     CONTEXT_UNLOCK();
-
-    return ret + String(cpy, DEC) + String(" min");
+    return is_fused;
 }
 
-String Context::str_time_last_soil_moisture_check()
+void Context::finish_soak(const soak_curve_t *curve)
 {
-    // -------------------- //
-    //   X read: 999min ago //
-    // -------------------- //
-    // or
-    // -------------------- //
-    //   X read: 9999hr ago //
-    // -------------------- //
-    String ret = String("X read: ");
+    // Nothing was read, so there is nothing to record or learn
+    if(0 == curve->num_readings)
+    {
+        return;
+    }
 
-    CONTEXT_LOCK(/* RET_VAL = */ ret);
-    time_t cpy = time_last_soil_moisture_check;
+    CONTEXT_LOCK(/* RET_VAL = */);
+    record_soil_moisture(
+        /* uint16_t soil_moisture = */ curve->soil_moistures[curve->num_readings - 1],
+        /* bool update_next_moisture_check = */ true);
+    memcpy(&soak_curve, curve, sizeof(soak_curve));
+    if(true == soak_model_learn(
+        /* soak_model_t *soak_model = */ &soak_model,
+        /* const soak_curve_t *curve = */ curve))
+    {
+        (void) storage_set(
+            /* nvs_handle_t nvs_handle = */ nvs_handle,
+            /* char *key = */ CONTEXT_NVS_KEY_SOAK_MODEL,
+            /* void *value = */ &soak_model,
+            /* size_t num_value_bytes = */ sizeof(soak_model));
+    }
     CONTEXT_UNLOCK();
 
-    // The time difference in minutes is: (current time - time of last check) * (1 minute / 60 seconds)
-    uint64_t min_diff = (time(/* time_t *_timer = */ nullptr) - cpy) / 60;
+    // Tell the menu what it is showing changed
+    notify_menu_changed();
 
-    return ret + ((min_diff < 999) ?
-        String(min_diff, DEC) + String("min ago") :
-        String(min_diff / 60, DEC) + String("hr ago"));
+    // Tell the zone scheduler when the next check is
+    notify_zone_scheduler();
 }
 
-String Context::str_time_next_soil_moisture_check()
+void Context::get_soak_curve(soak_curve_t *out_curve)
 {
-    // -------------------- //
-    //   Next X: in 999min  //
-    // -------------------- //
+    CONTEXT_LOCK(/* RET_VAL = */);
+    memcpy(out_curve, &soak_curve, sizeof(soak_curve));
+    CONTEXT_UNLOCK();
+}
+
+void Context::get_soil_moisture_sensor_power_stats(sensor_power_stats_t *out_stats)
+{
+    // The sensor, shared with every other Context, has its own lock, there is no need to lock the context
+    zone_scheduler->get_soil_moisture_sensor()->get_power_stats(/* sensor_power_stats_t *out_stats = */ out_stats);
+}
+
+void Context::get_servo_stats(servo_stats_t *out_stats)
+{
+    // The servo publishes its own stats, there is no need to lock the context
+    actuator.get_servo_stats(/* servo_stats_t *out_stats = */ out_stats);
+}
+
+void Context::get_actuator_stats(actuator_stats_t *out_stats)
+{
+    // The actuator publishes its own stats, there is no need to lock the context
+    actuator.get_stats(/* actuator_stats_t *out_stats = */ out_stats);
+}
+
+void Context::get_servo_scheduler_stats(servo_scheduler_stats_t *out_stats)
+{
+    // The scheduler has its own lock, there is no need to lock the context
+    servo_scheduler->get_stats(/* servo_scheduler_stats_t *out_stats = */ out_stats);
+}
+
+void Context::get_dose_queue_stats(actuation_stats_t *out_stats)
+{
+    // The dose queue has its own lock, there is no need to lock the context
+    dose_queue.get_stats(/* actuation_stats_t *out_stats = */ out_stats);
+}
+
+size_t Context::get_num_soil_moisture_probes()
+{
+    // The probes are set when constructed, there is no need to lock the context
+    return num_soil_moisture_probes;
+}
+
+size_t Context::get_soil_moisture_probes(
+    soil_moisture_probe_t *out_probes,
+    size_t max_probes)
+{
+    CONTEXT_LOCK(/* RET_VAL = */ 0);
+    size_t num_probes = (num_soil_moisture_probes < max_probes) ? num_soil_moisture_probes : max_probes;
+    memcpy(out_probes, soil_moisture_probes, num_probes * sizeof(*out_probes));
+    CONTEXT_UNLOCK();
+    return num_probes;
+}
+
+bool Context::capture_soil_moisture_sensor(
+    size_t index,
+    uint32_t ms_window,
+    uint32_t decimation,
+    bool (*func_send_block)(const void *block, size_t num_block_bytes))
+{
+    // The sensor, shared with every other Context, has its own lock, capture the probe's channel of it
+    // A probe's channel never changes, there is no need to lock the context
+    size_t channel = (index < num_soil_moisture_probes) ? soil_moisture_probes[index].channel : SENSOR_MAX_CHANNELS;
+    return capture_start(
+        /* Sensor *sensor = */ zone_scheduler->get_soil_moisture_sensor(),
+        /* size_t index = */ channel,
+        /* uint32_t ms_window = */ ms_window,
+        /* uint32_t decimation = */ decimation,
+        /* bool (*func_send_block)(const void *, size_t) = */ func_send_block);
+}
+
+MENU_CONTROL Context::water()
+{
+    // Run watering by making the next check now, and telling the zone scheduler to see it
+    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_RELEASE);
+    time_next_soil_moisture_check = time(/* time_t *_timer = */ nullptr);
+    publish_snapshot();
+    CONTEXT_UNLOCK();
+    notify_zone_scheduler();
+
+    // Tell the menu what it is showing changed
+    notify_menu_changed();
+
+    // Return control to the menu
+    return MENU_CONTROL_RELEASE;
+}
+
+MENU_CONTROL Context::dose(
+    ACTUATION_SOURCE_t source,
+    ACTUATION_PRIORITY_t priority,
+    uint32_t ul,
+    TickType_t ticks_to_wait)
+{
+    // Ask for the dose, and if we wanted to block (yield) until it finishes, do so
+    uint32_t dose_ticket = request_dose(
+        /* ACTUATION_SOURCE_t source = */ source,
+        /* ACTUATION_PRIORITY_t priority = */ priority,
+        /* uint32_t ul = */ ul);
+    if((0 != dose_ticket) && (0 != ticks_to_wait))
+    {
+        (void) wait_for_dose(
+            /* uint32_t dose_ticket = */ dose_ticket,
+            /* TickType_t ticks_to_wait = */ ticks_to_wait);
+    }
+
+    // Return control to the menu
+    return MENU_CONTROL_RELEASE;
+}
+
+uint32_t Context::request_dose(
+    ACTUATION_SOURCE_t source,
+    ACTUATION_PRIORITY_t priority,
+    uint32_t ul)
+{
+    // The dose queue has its own lock, and wakes the zone scheduler's actuate tasks itself
+    return dose_queue.request(
+        /* ACTUATION_SOURCE_t source = */ source,
+        /* ACTUATION_PRIORITY_t priority = */ priority,
+        /* uint32_t amount = */ ul);
+}
+
+bool Context::wait_for_dose(
+    uint32_t dose_ticket,
+    TickType_t ticks_to_wait)
+{
+    return dose_queue.wait(
+        /* uint32_t ticket = */ dose_ticket,
+        /* TickType_t ticks_to_wait = */ ticks_to_wait);
+}
+
+MENU_CONTROL Context::test_dose(ACTUATION_SOURCE_t source)
+{
+    // Don't wait, the menu and TCP tasks should not block on the actuator
+    return dose(
+        /* ACTUATION_SOURCE_t source = */ source,
+        /* ACTUATION_PRIORITY_t priority = */ ACTUATION_PRIORITY_HIGH,
+        /* uint32_t ul = */ actuator.get_ul_min_dose(),
+        /* TickType_t ticks_to_wait = */ 0);
+}
+
+MENU_CONTROL Context::calibrate_actuator()
+{
+    // Dose a whole number of units, the rate is then what was collected over ACTUATOR_NUM_CALIBRATION_UNITS
+    return dose(
+        /* ACTUATION_SOURCE_t source = */ ACTUATION_SOURCE_MENU,
+        /* ACTUATION_PRIORITY_t priority = */ ACTUATION_PRIORITY_HIGH,
+        /* uint32_t ul = */ ACTUATOR_NUM_CALIBRATION_UNITS * actuator.get_ul_per_unit(),
+        /* TickType_t ticks_to_wait = */ 0);
+}
+
+MENU_CONTROL Context::add_actuator_rate(int ul)
+{
+    // Alter the rate, keeping it within range (the actuator clamps it), in memory and NVS
+    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_KEEP);
+    int64_t new_ul_per_unit = (int64_t) actuator.get_ul_per_unit() + ul;
+    actuator.set_ul_per_unit(/* uint32_t ul_per_unit = */ (new_ul_per_unit < 0) ? 0 : (uint32_t) new_ul_per_unit);
+    uint32_t ul_per_unit = actuator.get_ul_per_unit();
+    (void) storage_set(
+        /* nvs_handle_t nvs_handle = */ nvs_handle,
+        /* char *key = */ get_actuator_rate_nvs_key(),
+        /* void *value = */ &ul_per_unit,
+        /* size_t num_value_bytes = */ sizeof(ul_per_unit));
+    publish_snapshot();
+    CONTEXT_UNLOCK();
+
+    // Tell the menu what it is showing changed
+    notify_menu_changed();
+
+    // Do not return control to the menu
+    return MENU_CONTROL_KEEP;
+}
+
+MENU_CONTROL Context::set_desired_soil_moisture_to_current()
+{
+    // Set our desired soil moisture to match the last known soil moisture, in memory and NVS
+    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_RELEASE);
+    desired_soil_moisture = current_soil_moisture;
+    (void) storage_set(
+        /* nvs_handle_t nvs_handle = */ nvs_handle,
+        /* char *key = */ CONTEXT_NVS_KEY_DESIRED_SOIL_MOISTURE,
+        /* void *value = */ &desired_soil_moisture,
+        /* size_t num_value_bytes = */ sizeof(desired_soil_moisture));
+    // An adaptive schedule checks when the soil is projected to dry to the desired soil moisture, so that moved
+    bool is_adaptive = check_schedule.is_adaptive;
+    if(true == is_adaptive)
+    {
+        update_time_next_soil_moisture_check();
+    }
+    publish_snapshot();
+    CONTEXT_UNLOCK();
+
+    // Tell the zone scheduler the next check moved
+    if(true == is_adaptive)
+    {
+        notify_zone_scheduler();
+    }
+
+    // Tell the menu what it is showing changed
+    notify_menu_changed();
+
+    // Return control to the menu
+    return MENU_CONTROL_RELEASE;
+}
+
+MENU_CONTROL Context::add_desired_soil_moisture(int percent_q8)
+{
+    // Alter our desired soil moisture, keeping it within range, in memory and NVS
+    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_KEEP);
+    int32_t new_percent_q8 = (int32_t) desired_soil_moisture + percent_q8;
+    if(new_percent_q8 < 0)
+    {
+        new_percent_q8 = 0;
+    }
+    else if(new_percent_q8 > CALIBRATION_MAX_PERCENT_Q8)
+    {
+        new_percent_q8 = CALIBRATION_MAX_PERCENT_Q8;
+    }
+    desired_soil_moisture = (uint16_t) new_percent_q8;
+    (void) storage_set(
+        /* nvs_handle_t nvs_handle = */ nvs_handle,
+        /* char *key = */ CONTEXT_NVS_KEY_DESIRED_SOIL_MOISTURE,
+        /* void *value = */ &desired_soil_moisture,
+        /* size_t num_value_bytes = */ sizeof(desired_soil_moisture));
+    // An adaptive schedule checks when the soil is projected to dry to the desired soil moisture, so that moved
+    bool is_adaptive = check_schedule.is_adaptive;
+    if(true == is_adaptive)
+    {
+        update_time_next_soil_moisture_check();
+    }
+    publish_snapshot();
+    CONTEXT_UNLOCK();
+
+    // Tell the zone scheduler the next check moved
+    if(true == is_adaptive)
+    {
+        notify_zone_scheduler();
+    }
+
+    // Tell the menu what it is showing changed
+    notify_menu_changed();
+
+    // Do not return control to the menu
+    return MENU_CONTROL_KEEP;
+}
+
+MENU_CONTROL Context::calibrate_soil_moisture_probe(
+    size_t index,
+    CALIBRATION_POINT_t point)
+{
+    // The sensor has its own lock, read it before locking the context, so readers of the context do not wait on the ADC
+    sensor_reading_t readings[CONTEXT_MAX_SOIL_MOISTURE_PROBES];
+    if(false == read_soil_moisture_probes(/* sensor_reading_t *out_readings = */ readings))
+    {
+        return MENU_CONTROL_RELEASE;
+    }
+
+    // Move the point to the probe's raw reading, a disconnected probe has nothing to calibrate to
+    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_RELEASE);
+    if((index >= num_soil_moisture_probes) || (0 == readings[index].num_samples))
+    {
+        CONTEXT_UNLOCK();
+        return MENU_CONTROL_RELEASE;
+    }
+    soil_moisture_probe_t *probe = &soil_moisture_probes[index];
+    calibration_point_t *calibration_point = calibration_get_point(
+        /* calibration_t *calibration = */ &probe->calibration,
+        /* CALIBRATION_POINT_t point = */ point);
+    if(nullptr == calibration_point)
+    {
+        CONTEXT_UNLOCK();
+        return MENU_CONTROL_RELEASE;
+    }
+    calibration_point->raw = readings[index].value;
+    if(CALIBRATION_POINT_MID == point)
+    {
+        probe->calibration.is_mid_set = true;
+    }
+    (void) calibration_build(
+        /* const calibration_t *calibration = */ &probe->calibration,
+        /* calibration_converter_t *out_converter = */ &probe->converter);
+    save_soil_moisture_probe_calibrations();
+
+    // Show what the reading works out to now, it is not recorded, the probe is likely out of the pot being calibrated
+    probe->raw = readings[index].value;
+    probe->soil_moisture = calibration_convert(
+        /* const calibration_converter_t *converter = */ &probe->converter,
+        /* uint16_t raw = */ probe->raw);
+    publish_snapshot();
+    CONTEXT_UNLOCK();
+
+    // Tell the menu what it is showing changed
+    notify_menu_changed();
+
+    // Return control to the menu
+    return MENU_CONTROL_RELEASE;
+}
+
+MENU_CONTROL Context::add_soil_moisture_probe_calibration_percent(
+    size_t index,
+    CALIBRATION_POINT_t point,
+    int percent_q8)
+{
+    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_KEEP);
+    if(index >= num_soil_moisture_probes)
+    {
+        CONTEXT_UNLOCK();
+        return MENU_CONTROL_KEEP;
+    }
+    soil_moisture_probe_t *probe = &soil_moisture_probes[index];
+    calibration_t *calibration = &probe->calibration;
+
+    // Keep the dry point below the wet point, by at least a step, so they can always be told apart
+    int32_t new_percent_q8 = 0;
+    switch(point)
+    {
+        case CALIBRATION_POINT_DRY:
+            new_percent_q8 = (int32_t) calibration->dry.percent_q8 + percent_q8;
+            new_percent_q8 = (new_percent_q8 < 0) ? 0 : new_percent_q8;
+            new_percent_q8 = (new_percent_q8 > ((int32_t) calibration->wet.percent_q8 - CALIBRATION_PERCENT_Q8(1))) ?
+                ((int32_t) calibration->wet.percent_q8 - CALIBRATION_PERCENT_Q8(1)) :
+                new_percent_q8;
+            calibration->dry.percent_q8 = (uint16_t) new_percent_q8;
+            break;
+        case CALIBRATION_POINT_WET:
+            new_percent_q8 = (int32_t) calibration->wet.percent_q8 + percent_q8;
+            new_percent_q8 = (new_percent_q8 > CALIBRATION_MAX_PERCENT_Q8) ? CALIBRATION_MAX_PERCENT_Q8 : new_percent_q8;
+            new_percent_q8 = (new_percent_q8 < ((int32_t) calibration->dry.percent_q8 + CALIBRATION_PERCENT_Q8(1))) ?
+                ((int32_t) calibration->dry.percent_q8 + CALIBRATION_PERCENT_Q8(1)) :
+                new_percent_q8;
+            calibration->wet.percent_q8 = (uint16_t) new_percent_q8;
+            break;
+        case CALIBRATION_POINT_MID:
+            // Going down to the dry point leaves the middle point out, until it is read again
+            new_percent_q8 = (int32_t) calibration->mid.percent_q8 + percent_q8;
+            if(new_percent_q8 <= (int32_t) calibration->dry.percent_q8)
+            {
+                new_percent_q8 = calibration->dry.percent_q8;
+                calibration->is_mid_set = false;
+            }
+            new_percent_q8 = (new_percent_q8 > ((int32_t) calibration->wet.percent_q8 - CALIBRATION_PERCENT_Q8(1))) ?
+                ((int32_t) calibration->wet.percent_q8 - CALIBRATION_PERCENT_Q8(1)) :
+                new_percent_q8;
+            calibration->mid.percent_q8 = (uint16_t) new_percent_q8;
+            break;
+        default:
+            break;
+    }
+    (void) calibration_build(
+        /* const calibration_t *calibration = */ calibration,
+        /* calibration_converter_t *out_converter = */ &probe->converter);
+    save_soil_moisture_probe_calibrations();
+    probe->soil_moisture = calibration_convert(
+        /* const calibration_converter_t *converter = */ &probe->converter,
+        /* uint16_t raw = */ probe->raw);
+    publish_snapshot();
+    CONTEXT_UNLOCK();
+
+    // Tell the menu what it is showing changed
+    notify_menu_changed();
+
+    // Do not return control to the menu
+    return MENU_CONTROL_KEEP;
+}
+
+MENU_CONTROL Context::add_minute_soil_moisture_check_freq(int num_minutes)
+{
+    // Alter the moisture check frequenecy in memory, keeping it within range
+    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_KEEP);
+    int64_t minute_new_freq = (int64_t) minute_soil_moisture_check_freq + num_minutes;
+    if(minute_new_freq < CONTEXT_MINUTE_MIN_SOIL_MOISTURE_CHECK_FREQ)
+    {
+        minute_new_freq = CONTEXT_MINUTE_MIN_SOIL_MOISTURE_CHECK_FREQ;
+    }
+    else if(minute_new_freq > CONTEXT_MINUTE_MAX_SOIL_MOISTURE_CHECK_FREQ)
+    {
+        minute_new_freq = CONTEXT_MINUTE_MAX_SOIL_MOISTURE_CHECK_FREQ;
+    }
+    minute_soil_moisture_check_freq = (uint32_t) minute_new_freq;
+    update_time_next_soil_moisture_check();
+    publish_snapshot();
+    CONTEXT_UNLOCK();
+
+    // Tell the zone scheduler the next check moved
+    notify_zone_scheduler();
+
+    // Write it to NVS once it stops changing, many changes in a row only write once
+    save_check_schedule_later();
+
+    // Tell the menu what it is showing changed
+    notify_menu_changed();
+
+    // Do not return control to the menu
+    return MENU_CONTROL_KEEP;
+}
+
+MENU_CONTROL Context::toggle_adaptive_check_schedule()
+{
+    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_KEEP);
+    check_schedule.is_adaptive = !check_schedule.is_adaptive;
+    update_time_next_soil_moisture_check();
+    publish_snapshot();
+    CONTEXT_UNLOCK();
+
+    // Tell the zone scheduler the next check moved
+    notify_zone_scheduler();
+
+    // Write it to NVS once it stops changing, many changes in a row only write once
+    save_check_schedule_later();
+
+    // Tell the menu what it is showing changed
+    notify_menu_changed();
+
+    // Do not return control to the menu
+    return MENU_CONTROL_KEEP;
+}
+
+MENU_CONTROL Context::add_minute_min_check_freq(int num_minutes)
+{
+    // Alter the shortest adaptive interval in memory, keeping it within range, and no longer than the longest
+    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_KEEP);
+    int64_t minute_new_freq = (int64_t) check_schedule.minute_min_check_freq + num_minutes;
+    if(minute_new_freq < CONTEXT_MINUTE_MIN_SOIL_MOISTURE_CHECK_FREQ)
+    {
+        minute_new_freq = CONTEXT_MINUTE_MIN_SOIL_MOISTURE_CHECK_FREQ;
+    }
+    else if(minute_new_freq > check_schedule.minute_max_check_freq)
+    {
+        minute_new_freq = check_schedule.minute_max_check_freq;
+    }
+    check_schedule.minute_min_check_freq = (uint32_t) minute_new_freq;
+    update_time_next_soil_moisture_check();
+    publish_snapshot();
+    CONTEXT_UNLOCK();
+
+    // Tell the zone scheduler the next check moved
+    notify_zone_scheduler();
+
+    // Write it to NVS once it stops changing, many changes in a row only write once
+    save_check_schedule_later();
+
+    // Tell the menu what it is showing changed
+    notify_menu_changed();
+
+    // Do not return control to the menu
+    return MENU_CONTROL_KEEP;
+}
+
+MENU_CONTROL Context::add_minute_max_check_freq(int num_minutes)
+{
+    // Alter the longest adaptive interval in memory, keeping it within range, and no shorter than the shortest
+    CONTEXT_LOCK(/* RET_VAL = */ MENU_CONTROL_KEEP);
+    int64_t minute_new_freq = (int64_t) check_schedule.minute_max_check_freq + num_minutes;
+    if(minute_new_freq < check_schedule.minute_min_check_freq)
+    {
+        minute_new_freq = check_schedule.minute_min_check_freq;
+    }
+    else if(minute_new_freq > CONTEXT_MINUTE_MAX_SOIL_MOISTURE_CHECK_FREQ)
+    {
+        minute_new_freq = CONTEXT_MINUTE_MAX_SOIL_MOISTURE_CHECK_FREQ;
+    }
+    check_schedule.minute_max_check_freq = (uint32_t) minute_new_freq;
+    update_time_next_soil_moisture_check();
+    publish_snapshot();
+    CONTEXT_UNLOCK();
+
+    // Tell the zone scheduler the next check moved
+    notify_zone_scheduler();
+
+    // Write it to NVS once it stops changing, many changes in a row only write once
+    save_check_schedule_later();
+
+    // Tell the menu what it is showing changed
+    notify_menu_changed();
+
+    // Do not return control to the menu
+    return MENU_CONTROL_KEEP;
+}
+
+void Context::update_time_next_soil_moisture_check()
+{
+    uint32_t minute_interval = minute_soil_moisture_check_freq;
+    if(true == check_schedule.is_adaptive)
+    {
+        minute_interval = soil_moisture_history_predict_minute_interval(
+            /* const soil_moisture_history_t *history = */ &soil_moisture_history,
+            /* uint16_t desired_soil_moisture = */ desired_soil_moisture,
+            /* const check_schedule_t *check_schedule = */ &check_schedule);
+    }
+    // NOTE: time_t is usually represented as seconds since the last epoch
+    time_next_soil_moisture_check = time_last_soil_moisture_check + ((time_t) minute_interval * 60);
+}
+
+void Context::delay_time_next_soil_moisture_check()
+{
+    uint32_t num_doublings = (num_failed_soil_moisture_checks < 31) ? num_failed_soil_moisture_checks : 31;
+    uint32_t s_retry = ((CONTEXT_S_MAX_CHECK_RETRY >> num_doublings) > CONTEXT_S_MIN_CHECK_RETRY) ?
+        (CONTEXT_S_MIN_CHECK_RETRY << num_doublings) :
+        CONTEXT_S_MAX_CHECK_RETRY;
+    ++num_failed_soil_moisture_checks;
+    time_next_soil_moisture_check = time(/* time_t *_timer = */ nullptr) + (time_t) s_retry;
+}
+
+void Context::save_check_schedule_later()
+{
+    (void) xTimerReset(
+        /* TimerHandle_t xTimer = */ save_timer_handle,
+        /* TickType_t xTicksToWait = */ 0);
+}
+
+void Context::save_soil_moisture_probe_calibrations()
+{
+    // Keep the calibrations of probes past num_soil_moisture_probes as they are in NVS, see: Context::Context
+    calibration_t calibrations[CONTEXT_MAX_SOIL_MOISTURE_PROBES];
+    for(size_t i = 0; i < CONTEXT_MAX_SOIL_MOISTURE_PROBES; ++i)
+    {
+        calibration_set_default(/* calibration_t *calibration = */ &calibrations[i]);
+    }
+    (void) storage_get(
+        /* nvs_handle_t nvs_handle = */ nvs_handle,
+        /* char *key = */ CONTEXT_NVS_KEY_PROBE_CALIBRATIONS,
+        /* void *value = */ calibrations,
+        /* size_t num_value_bytes = */ sizeof(calibrations));
+    for(size_t i = 0; i < num_soil_moisture_probes; ++i)
+    {
+        calibrations[i] = soil_moisture_probes[i].calibration;
+    }
+    (void) storage_set(
+        /* nvs_handle_t nvs_handle = */ nvs_handle,
+        /* char *key = */ CONTEXT_NVS_KEY_PROBE_CALIBRATIONS,
+        /* void *value = */ calibrations,
+        /* size_t num_value_bytes = */ sizeof(calibrations));
+}
+
+bool Context::read_soil_moisture_probes(sensor_reading_t *out_readings)
+{
+    // The sensor reads every zone's probes at once, keep this Context's, in the order of its probes
+    // A probe's channel never changes, there is no need to lock the context
+    sensor_reading_t readings[SENSOR_MAX_CHANNELS];
+    if(false == zone_scheduler->get_soil_moisture_sensor()->read(/* sensor_reading_t *out_readings = */ readings))
+    {
+        return false;
+    }
+    for(size_t i = 0; i < num_soil_moisture_probes; ++i)
+    {
+        size_t channel = soil_moisture_probes[i].channel;
+        out_readings[i] = (channel < SENSOR_MAX_CHANNELS) ? readings[channel] : sensor_reading_t {};
+    }
+    return true;
+}
+
+char *Context::get_actuator_rate_nvs_key()
+{
+    return (ACTUATOR_TYPE_PUMP == actuator.get_type()) ? (char *) CONTEXT_NVS_KEY_PUMP_RATE : (char *) CONTEXT_NVS_KEY_SERVO_RATE;
+}
+
+void Context::save_check_schedule()
+{
+    CONTEXT_LOCK(/* RET_VAL = */);
+    (void) storage_set(
+        /* nvs_handle_t nvs_handle = */ nvs_handle,
+        /* char *key = */ CONTEXT_NVS_KEY_MINUTE_SOIL_MOISTURE_CHECK_FREQ,
+        /* void *value = */ &minute_soil_moisture_check_freq,
+        /* size_t num_value_bytes = */ sizeof(minute_soil_moisture_check_freq));
+    (void) storage_set(
+        /* nvs_handle_t nvs_handle = */ nvs_handle,
+        /* char *key = */ CONTEXT_NVS_KEY_CHECK_SCHEDULE,
+        /* void *value = */ &check_schedule,
+        /* size_t num_value_bytes = */ sizeof(check_schedule));
+    CONTEXT_UNLOCK();
+}
+
+size_t Context::str_current_soil_moisture(
+    char *buf,
+    size_t num_buf_chars)
+{
+    // -------------------- //
+    //   Current X: 100.0%  //
+    // -------------------- //
+    size_t num_chars = format_str(buf, num_buf_chars, "Current X: ");
+
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+
+    num_chars += format_q8(buf + num_chars, num_buf_chars - num_chars, cpy.current_soil_moisture);
+    return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, "%");
+}
+
+size_t Context::str_desired_soil_moisture(
+    char *buf,
+    size_t num_buf_chars)
+{
+    // -------------------- //
+    //   Desired X: 100.0%  //
+    // -------------------- //
+    size_t num_chars = format_str(buf, num_buf_chars, "Desired X: ");
+
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+
+    num_chars += format_q8(buf + num_chars, num_buf_chars - num_chars, cpy.desired_soil_moisture);
+    return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, "%");
+}
+
+size_t Context::str_minute_soil_moisture_check_freq(
+    char *buf,
+    size_t num_buf_chars)
+{
+    // -------------------- //
+    //   X freq: 100 min    //
+    // -------------------- //
+    // or, for adaptive schedules
+    // -------------------- //
+    //   X freq: ~100 min   //
+    // -------------------- //
+    size_t num_chars = format_str(buf, num_buf_chars, "X freq: ");
+
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+
+    if(false == cpy.check_schedule.is_adaptive)
+    {
+        num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, cpy.minute_soil_moisture_check_freq);
+        return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, " min");
+    }
+
+    // Show the interval the adaptive schedule picked, the time from the last check to the next
+    // If watering moved the next check before the last, call it 0 minutes instead of a huge unsigned number
+    time_t sec_diff = cpy.time_next_soil_moisture_check - cpy.time_last_soil_moisture_check;
+    uint32_t min_diff = (sec_diff > 0) ? (sec_diff / 60) : 0;
+    num_chars += format_str(buf + num_chars, num_buf_chars - num_chars, "~");
+    num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, min_diff);
+    return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, " min");
+}
+
+size_t Context::str_check_schedule_mode(
+    char *buf,
+    size_t num_buf_chars)
+{
+    // -------------------- //
+    //   X mode: adaptive   //
+    // -------------------- //
+    size_t num_chars = format_str(buf, num_buf_chars, "X mode: ");
+
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+
+    return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, (true == cpy.check_schedule.is_adaptive) ? "adaptive" : "fixed");
+}
+
+size_t Context::str_minute_min_check_freq(
+    char *buf,
+    size_t num_buf_chars)
+{
+    // -------------------- //
+    //   X min: 15 min      //
+    // -------------------- //
+    size_t num_chars = format_str(buf, num_buf_chars, "X min: ");
+
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+
+    num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, cpy.check_schedule.minute_min_check_freq);
+    return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, " min");
+}
+
+size_t Context::str_minute_max_check_freq(
+    char *buf,
+    size_t num_buf_chars)
+{
+    // -------------------- //
+    //   X max: 720 min     //
+    // -------------------- //
+    size_t num_chars = format_str(buf, num_buf_chars, "X max: ");
+
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+
+    num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, cpy.check_schedule.minute_max_check_freq);
+    return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, " min");
+}
+
+size_t Context::str_time_last_soil_moisture_check(
+    char *buf,
+    size_t num_buf_chars)
+{
+    // -------------------- //
+    //   X read: 999min ago //
+    // -------------------- //
+    // or
+    // -------------------- //
+    //   X read: 9999hr ago //
+    // -------------------- //
+    size_t num_chars = format_str(buf, num_buf_chars, "X read: ");
+
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+
+    // The time difference in minutes is: (current time - time of last check) * (1 minute / 60 seconds)
+    // If the clock moved backwards, call it 0 minutes instead of a huge unsigned number
+    time_t sec_diff = time(/* time_t *_timer = */ nullptr) - cpy.time_last_soil_moisture_check;
+    uint32_t min_diff = (sec_diff > 0) ? (sec_diff / 60) : 0;
+
+    if(min_diff < 999)
+    {
+        num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, min_diff);
+        return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, "min ago");
+    }
+    num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, min_diff / 60);
+    return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, "hr ago");
+}
+
+size_t Context::str_time_next_soil_moisture_check(
+    char *buf,
+    size_t num_buf_chars)
+{
+    // -------------------- //
+    //   Next X: in 999min  //
+    // -------------------- //
     // or
     // -------------------- //
     //   Next X: in 9999hr  //
     // -------------------- //
-    String ret = String("Next X: in ");
+    size_t num_chars = format_str(buf, num_buf_chars, "Next X: in ");
 
-    CONTEXT_LOCK(/* RET_VAL = */ ret);
-    time_t cpy = time_next_soil_moisture_check;
-    CONTEXT_UNLOCK();
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
 
     // The time difference in minutes is: (time of next check - current time) * (1 minute / 60 seconds)
-    uint64_t min_diff = (cpy - time(/* time_t *_timer = */ nullptr)) / 60;
+    // If the check is already overdue, call it 0 minutes instead of a huge unsigned number
+    time_t sec_diff = cpy.time_next_soil_moisture_check - time(/* time_t *_timer = */ nullptr);
+    uint32_t min_diff = (sec_diff > 0) ? (sec_diff / 60) : 0;
+
+    if(min_diff < 999)
+    {
+        num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, min_diff);
+        return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, "min");
+    }
+    num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, min_diff / 60);
+    return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, "hr");
+}
+
+size_t Context::str_actuator_rate(
+    char *buf,
+    size_t num_buf_chars)
+{
+    // -------------------- //
+    //   Rate: 1.0 ml/sq    //
+    // -------------------- //
+    // or, for a pump
+    // -------------------- //
+    //   Rate: 5.0 ml/s     //
+    // -------------------- //
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+    size_t num_chars = format_str(buf, num_buf_chars, "Rate: ");
+    num_chars += format_milli(buf + num_chars, num_buf_chars - num_chars, cpy.ul_per_unit);
+    return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars,
+        (ACTUATOR_TYPE_PUMP == cpy.actuator_type) ? " ml/s" : " ml/sq");
+}
+
+size_t Context::str_soil_moisture_probe(
+    size_t index,
+    char *buf,
+    size_t num_buf_chars)
+{
+    // -------------------- //
+    //   Probe 1: 42.5% ok  //
+    // -------------------- //
+    // or, if it is not counted
+    // -------------------- //
+    // Probe 1: 42.5% stuck //
+    // -------------------- //
+    size_t num_chars = format_str(buf, num_buf_chars, "Probe ");
+    num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, (uint32_t) (index + 1));
+    num_chars += format_str(buf + num_chars, num_buf_chars - num_chars, ": ");
+
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+    if(index >= cpy.num_soil_moisture_probes)
+    {
+        return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, "none");
+    }
+
+    num_chars += format_q8(buf + num_chars, num_buf_chars - num_chars, cpy.soil_moisture_probes[index].soil_moisture);
+    num_chars += format_str(buf + num_chars, num_buf_chars - num_chars, "%");
+    switch(cpy.soil_moisture_probes[index].status)
+    {
+        case PROBE_STATUS_DISCONNECTED:
+            return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, " lost");
+        case PROBE_STATUS_STUCK:
+            return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, " stuck");
+        default:
+            return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, " ok");
+    }
+}
+
+size_t Context::str_soil_moisture_probe_calibration(
+    size_t index,
+    CALIBRATION_POINT_t point,
+    char *buf,
+    size_t num_buf_chars)
+{
+    // -------------------- //
+    //   Dry 1: 2900 = 0%   //
+    // -------------------- //
+    // or, if the middle point is left out
+    // -------------------- //
+    //   Mid 1: ---- = 25%  //
+    // -------------------- //
+    static const char *const str_points[CALIBRATION_POINT_MAX] = { "Dry ", "Wet ", "Mid " };
+    size_t num_chars = format_str(buf, num_buf_chars, (point < CALIBRATION_POINT_MAX) ? str_points[point] : "? ");
+    num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, (uint32_t) (index + 1));
+    num_chars += format_str(buf + num_chars, num_buf_chars - num_chars, ": ");
+
+    context_snapshot_t cpy;
+    (void) snapshot.load(/* context_snapshot_t *out_value = */ &cpy);
+    if(index >= cpy.num_soil_moisture_probes)
+    {
+        return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, "none");
+    }
+    calibration_point_t *calibration_point = calibration_get_point(
+        /* calibration_t *calibration = */ &cpy.soil_moisture_probes[index].calibration,
+        /* CALIBRATION_POINT_t point = */ point);
+    if(nullptr == calibration_point)
+    {
+        return num_chars;
+    }
 
-    return ret + ((min_diff < 999) ?
-        String(min_diff, DEC) + String("min") :
-        String(min_diff / 60, DEC) + String("hr"));
+    // Points are only ever moved in whole percents, so there is no need for a decimal place
+    if((CALIBRATION_POINT_MID == point) && (false == cpy.soil_moisture_probes[index].calibration.is_mid_set))
+    {
+        num_chars += format_str(buf + num_chars, num_buf_chars - num_chars, "----");
+    }
+    else
+    {
+        num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, calibration_point->raw);
+    }
+    num_chars += format_str(buf + num_chars, num_buf_chars - num_chars, " = ");
+    num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, (calibration_point->percent_q8 + 128) >> 8);
+    return num_chars + format_str(buf + num_chars, num_buf_chars - num_chars, "%");
 }
\ No newline at end of file
@@ -0,0 +1,91 @@
+// Include custom button debouncing API
+#include "debounce.h"
+
+void debounce_init(
+    debounce_t *debounce,
+    uint32_t us_debounce,
+    bool is_repeating)
+{
+    debounce->us_debounce = us_debounce;
+    debounce->is_repeating = is_repeating;
+    debounce->is_pressed = false;
+    debounce->was_down = false;
+    debounce->is_held = false;
+    debounce->us_last_change = 0;
+    debounce->us_first_change = 0;
+    debounce->us_next_repeat = 0;
+    debounce->us_repeat_period = BUTTON_US_REPEAT_PERIOD_START;
+}
+
+void debounce_reset(
+    debounce_t *debounce,
+    bool is_down)
+{
+    debounce->is_pressed = is_down;
+    debounce->was_down = is_down;
+}
+
+bool debounce_sample(
+    debounce_t *debounce,
+    bool is_down,
+    int64_t us_current_time,
+    debounce_event_t *out_event)
+{
+    out_event->type = BUTTON_EVENT_NONE;
+    out_event->us_time = us_current_time;
+
+    // Remember when the reading last changed
+    if(is_down != debounce->was_down)
+    {
+        // A held button has no edge to say when it started being let go, so this sample is the first change
+        if(true == debounce->is_held)
+        {
+            debounce->is_held = false;
+            debounce->us_first_change = us_current_time;
+        }
+        debounce->was_down = is_down;
+        debounce->us_last_change = us_current_time;
+        return true;
+    }
+
+    // Wait for the reading to stay the same for us_debounce
+    if((us_current_time - debounce->us_last_change) < debounce->us_debounce)
+    {
+        return true;
+    }
+
+    // The button settled, if it settled into a new state, report it
+    if(is_down != debounce->is_pressed)
+    {
+        debounce->is_pressed = is_down;
+        out_event->type = (true == is_down) ? BUTTON_EVENT_PRESS : BUTTON_EVENT_RELEASE;
+        out_event->us_time = debounce->us_first_change;
+
+        // Start timing repeats from when the press started, the first repeat is a sample or more away
+        if((true == is_down) && (true == debounce->is_repeating))
+        {
+            debounce->is_held = true;
+            debounce->us_next_repeat = debounce->us_first_change + BUTTON_US_REPEAT_DELAY;
+            debounce->us_repeat_period = BUTTON_US_REPEAT_PERIOD_START;
+        }
+        return debounce->is_held;
+    }
+
+    // Keep sampling a held repeating button, send a repeat whenever one is due,
+    // and bring the next one closer, so the longer the button is held the faster it repeats
+    if(true == debounce->is_held)
+    {
+        if(us_current_time >= debounce->us_next_repeat)
+        {
+            out_event->type = BUTTON_EVENT_REPEAT;
+            debounce->us_next_repeat = us_current_time + debounce->us_repeat_period;
+            debounce->us_repeat_period -= debounce->us_repeat_period / 4;
+            if(debounce->us_repeat_period < BUTTON_US_REPEAT_PERIOD_MIN)
+            {
+                debounce->us_repeat_period = BUTTON_US_REPEAT_PERIOD_MIN;
+            }
+        }
+        return true;
+    }
+    return false;
+}
\ No newline at end of file
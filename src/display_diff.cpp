@@ -0,0 +1,64 @@
+// Include custom display diffing API
+#include "display_diff.h"
+
+// Get the character at col of line, padded with spaces from num_line_chars
+static char display_get_char(
+    const char *line,
+    size_t num_line_chars,
+    size_t col)
+{
+    return (col < num_line_chars) ? line[col] : ' ';
+}
+
+size_t display_diff_line(
+    const char *line,
+    size_t num_line_chars,
+    char *displayed_line,
+    size_t num_cols,
+    bool is_displayed_line_valid,
+    size_t max_gap_chars,
+    display_run_t *out_runs)
+{
+    size_t num_runs = 0;
+    size_t col = 0;
+    while(col < num_cols)
+    {
+        if((true == is_displayed_line_valid) && (displayed_line[col] == display_get_char(line, num_line_chars, col)))
+        {
+            ++col;
+            continue;
+        }
+
+        // Grow the run over every changed character no more than max_gap_chars unchanged characters past its end
+        size_t run_end = col + 1;
+        for(size_t i = run_end; (i < num_cols) && (i <= run_end + max_gap_chars); ++i)
+        {
+            if((false == is_displayed_line_valid) || (displayed_line[i] != display_get_char(line, num_line_chars, i)))
+            {
+                run_end = i + 1;
+            }
+        }
+
+        for(size_t i = col; i < run_end; ++i)
+        {
+            displayed_line[i] = display_get_char(line, num_line_chars, i);
+        }
+        out_runs[num_runs].col = col;
+        out_runs[num_runs].num_chars = run_end - col;
+        ++num_runs;
+        col = run_end;
+    }
+    return num_runs;
+}
+
+size_t display_count_lcd_bytes(
+    const display_run_t *runs,
+    size_t num_runs)
+{
+    size_t num_bytes = 0;
+    for(size_t i = 0; i < num_runs; ++i)
+    {
+        num_bytes += 1 + runs[i].num_chars;
+    }
+    return num_bytes;
+}
\ No newline at end of file
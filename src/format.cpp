@@ -0,0 +1,99 @@
+// Include custom formatting API
+#include "format.h"
+
+// Count the decimal digits in value
+// NOTE: A uint32_t has at most 10 decimal digits
+static size_t format_count_digits(uint32_t value)
+{
+    size_t num_digits = 1;
+    for(; value >= 10; value /= 10)
+    {
+        ++num_digits;
+    }
+    return num_digits;
+}
+
+// Fill buf with FORMAT_OVERFLOW_CHAR, for a number that does not fit
+static size_t format_overflow(
+    char *buf,
+    size_t num_buf_chars)
+{
+    for(size_t i = 0; i < num_buf_chars; ++i)
+    {
+        buf[i] = FORMAT_OVERFLOW_CHAR;
+    }
+    return num_buf_chars;
+}
+
+// Write tenths into buf as decimal digits with one decimal place
+static size_t format_tenths(
+    char *buf,
+    size_t num_buf_chars,
+    uint32_t tenths)
+{
+    // The whole part, the point, and one decimal place
+    if((format_count_digits(/* uint32_t value = */ tenths / 10) + 2) > num_buf_chars)
+    {
+        return format_overflow(buf, num_buf_chars);
+    }
+    size_t num_chars = format_uint(buf, num_buf_chars, tenths / 10);
+    num_chars += format_str(buf + num_chars, num_buf_chars - num_chars, ".");
+    return num_chars + format_uint(buf + num_chars, num_buf_chars - num_chars, tenths % 10);
+}
+
+size_t format_str(
+    char *buf,
+    size_t num_buf_chars,
+    const char *str)
+{
+    size_t num_chars_written = 0;
+    for(; (num_chars_written < num_buf_chars) && ('\0' != str[num_chars_written]); ++num_chars_written)
+    {
+        buf[num_chars_written] = str[num_chars_written];
+    }
+    return num_chars_written;
+}
+
+size_t format_uint(
+    char *buf,
+    size_t num_buf_chars,
+    uint32_t value)
+{
+    // Count the digits first, so they can be written from the last to the first straight into buf,
+    // instead of into a temporary buffer that then has to be reversed or copied
+    size_t num_digits = format_count_digits(/* uint32_t value = */ value);
+    if(num_digits > num_buf_chars)
+    {
+        return format_overflow(buf, num_buf_chars);
+    }
+
+    // Write the digits from last to first
+    // NOTE: The compiler turns division by a constant 10 into a multiply and shift
+    for(size_t i = num_digits; i > 0; --i)
+    {
+        buf[i - 1] = '0' + (value % 10);
+        value /= 10;
+    }
+    return num_digits;
+}
+
+size_t format_q8(
+    char *buf,
+    size_t num_buf_chars,
+    uint32_t value_q8)
+{
+    // Round to tenths first, so 9.96 becomes 10.0 instead of 9.10
+    // NOTE: Widen before multiplying, so the largest values do not overflow
+    uint32_t tenths = (uint32_t) ((((uint64_t) value_q8 * 10) + 128) >> 8);
+    return format_tenths(buf, num_buf_chars, tenths);
+}
+
+size_t format_milli(
+    char *buf,
+    size_t num_buf_chars,
+    uint32_t value_milli)
+{
+    // Round to tenths first, so 9.96 becomes 10.0 instead of 9.10
+    uint32_t tenths = (uint32_t) (((uint64_t) value_milli + 50) / 100);
+    return format_tenths(buf, num_buf_chars, tenths);
+}
\ No newline at end of file
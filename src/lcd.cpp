@@ -0,0 +1,404 @@
+// Helpful resources:
+// 1. HD44780 datasheet, see table 6 for instructions, and figure 24 for 4-bit initialization.
+//    https://www.sparkfun.com/datasheets/LCD/HD44780.pdf
+// 2. PCF8574 datasheet, the I2C I/O expander on the display backpack.
+//    https://www.ti.com/lit/ds/symlink/pcf8574.pdf
+// 3. The LiquidCrystal_I2C library this replaces, which sends one I2C transaction per pin change.
+//    https://github.com/johnrickman/LiquidCrystal_I2C
+
+// Include custom LCD driver
+#include "lcd.h"
+// Include custom debug macros and compile flags
+#include "flags.h"
+
+// ======================= //
+// Define useful constants //
+// ======================= //
+
+// Define how the PCF8574 pins are wired to the HD44780 on the backpack
+// P0 = register select (0 = instruction, 1 = data)
+#define LCD_PCF8574_RS 0x01
+// P1 = read/write (0 = write), this driver only writes
+#define LCD_PCF8574_RW 0x02
+// P2 = enable, the HD44780 reads the data pins when this goes from high to low
+#define LCD_PCF8574_EN 0x04
+// P3 = backlight
+#define LCD_PCF8574_BL 0x08
+// P4-P7 = HD44780 data pins D4-D7
+
+// Define HD44780 instructions
+#define LCD_INSTRUCTION_CLEAR 0x01
+#define LCD_INSTRUCTION_ENTRY_MODE 0x04
+#define LCD_ENTRY_MODE_INCREMENT 0x02
+#define LCD_INSTRUCTION_DISPLAY_CONTROL 0x08
+#define LCD_DISPLAY_CONTROL_ON 0x04
+#define LCD_INSTRUCTION_FUNCTION_SET 0x20
+#define LCD_FUNCTION_SET_8_BIT 0x10
+#define LCD_FUNCTION_SET_2_LINE 0x08
+#define LCD_INSTRUCTION_SET_CGRAM_ADDR 0x40
+#define LCD_INSTRUCTION_SET_DDRAM_ADDR 0x80
+
+// Define how long, in microseconds, the HD44780 takes to carry out an instruction or take a character, it ignores anything sent before then
+// The datasheet gives 37 us at its typical 270 kHz clock, but lets the clock run as slow as 190 kHz, which takes 53 us
+#define LCD_US_EXECUTE 60
+// Define how long, in milliseconds, the HD44780 takes to clear the display, 1.52 ms at 270 kHz, 2.16 ms at 190 kHz
+#define LCD_MS_EXECUTE_CLEAR 3
+// Define how long, in microseconds, one I2C byte (8 bits and an acknowledge) holds the PCF8574's pins, rounded up
+#define LCD_US_PER_I2C_BYTE (((9 * 1000000) + LCD_I2C_HZ - 1) / LCD_I2C_HZ)
+// Define the number of I2C bytes to hold the pins for after each byte sent to the HD44780, so it is done carrying it out
+// before the next byte's first nibble is clocked in, which already takes 2 I2C bytes
+// At 400 kHz this is 1, at 100 kHz the bus is slow enough on its own
+#define LCD_NUM_EXECUTE_HOLD_BYTES \
+    ((LCD_US_EXECUTE > (2 * LCD_US_PER_I2C_BYTE)) ? \
+        ((LCD_US_EXECUTE - (2 * LCD_US_PER_I2C_BYTE) + LCD_US_PER_I2C_BYTE - 1) / LCD_US_PER_I2C_BYTE) : 0)
+
+// Define the most bytes one I2C transaction to the display can hold.
+// Every byte sent to the LCD takes 4 I2C bytes, and LCD_NUM_EXECUTE_HOLD_BYTES more while it is carried out,
+// and there is one more I2C byte each time register select changes.
+// The biggest transaction is a cursor move then LCD_MAX_RUN_CHARS characters.
+// NOTE: The Arduino Wire library can only hold 128 bytes per transaction
+#define LCD_MAX_TRANSACTION_BYTES (2 + ((4 + LCD_NUM_EXECUTE_HOLD_BYTES) * (1 + LCD_MAX_RUN_CHARS)))
+#if LCD_MAX_TRANSACTION_BYTES > 128
+#error "LCD_MAX_RUN_CHARS is too big to fit a run of characters in one I2C transaction"
+#endif
+
+// Define the number of times to repeat each write in Lcd::benchmark(), to average out noise
+#define LCD_NUM_BENCHMARK_ITERATIONS 10
+
+// Define the DDRAM address each row of the display starts at
+// Rows 2 and 3 are a continuation of rows 0 and 1 in memory
+static const uint8_t lcd_row_addrs[] = {0x00, 0x40, 0x14, 0x54};
+
+// Bytes to be sent to the PCF8574 in one I2C transaction
+typedef struct lcd_transaction_s {
+    // The bytes to send, in order
+    uint8_t bytes[LCD_MAX_TRANSACTION_BYTES];
+    // The number of used bytes in bytes
+    size_t num_bytes;
+    // The register select bit of the last byte added, so it is only set up again when it changes
+    uint8_t rs_bit;
+} lcd_transaction_t;
+
+// ======================================= //
+// Functions for building I2C transactions //
+// ======================================= //
+
+// Start a new transaction with nothing in it
+static void lcd_transaction_init(lcd_transaction_t *transaction)
+{
+    transaction->num_bytes = 0;
+    // Not a valid register select bit, so the first byte added sets up register select
+    transaction->rs_bit = 0xFF;
+}
+
+// Add one byte for the HD44780 to a transaction, as the PCF8574 writes that clock in its 2 nibbles
+static void lcd_transaction_add(
+    lcd_transaction_t *transaction,
+    uint8_t value,
+    uint8_t rs_bit,
+    uint8_t backlight_bit)
+{
+    uint8_t high = (value & 0xF0) | rs_bit | backlight_bit;
+    uint8_t low = ((value << 4) & 0xF0) | rs_bit | backlight_bit;
+
+    // Register select has to be stable before enable goes high, so when it changes, give it its own byte first
+    if(rs_bit != transaction->rs_bit)
+    {
+        transaction->bytes[transaction->num_bytes++] = high;
+        transaction->rs_bit = rs_bit;
+    }
+
+    // Raise then lower enable for each nibble, the HD44780 reads D4-D7 when enable falls
+    // At 400 kHz every I2C byte holds the pins for ~22 us, well over the HD44780's timing minimums
+    transaction->bytes[transaction->num_bytes++] = high | LCD_PCF8574_EN;
+    transaction->bytes[transaction->num_bytes++] = high;
+    transaction->bytes[transaction->num_bytes++] = low | LCD_PCF8574_EN;
+    transaction->bytes[transaction->num_bytes++] = low;
+
+    // Hold the pins while the HD44780 carries out the byte, this also covers the start of the next transaction
+    for(size_t i = 0; i < LCD_NUM_EXECUTE_HOLD_BYTES; ++i)
+    {
+        transaction->bytes[transaction->num_bytes++] = low;
+    }
+}
+
+// Send a transaction to the PCF8574 at i2c_addr in one I2C write
+static void lcd_transaction_send(
+    lcd_transaction_t *transaction,
+    uint8_t i2c_addr)
+{
+    Wire.beginTransmission(/* uint16_t address = */ i2c_addr);
+    (void) Wire.write(
+        /* const uint8_t *buffer = */ transaction->bytes,
+        /* size_t size = */ transaction->num_bytes);
+    (void) Wire.endTransmission(/* bool sendStop = */ true);
+}
+
+// ============ //
+// Define tasks //
+// ============ //
+
+void task_drain_lcd(Lcd *lcd)
+{
+    lcd_command_t command;
+
+    // Tasks must be implemented to never return (i.e. continuous loop)
+    // https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-reference/system/freertos_idf.html
+    // NOTE: Stack usage is not printed here, it would be printed for every run of characters and slow the display down
+    while(1)
+    {
+        // Wait for a command to enter the queue, then send it to the display
+        if(pdTRUE == xQueueReceive(
+            /* QueueHandle_t xQueue = */ lcd->command_queue_handle,
+            /* void *pvBuffer = */ &command,
+            /* TickType_t xTicksToWait */ portMAX_DELAY))
+        {
+            lcd->execute_command(/* lcd_command_t *command = */ &command);
+        }
+    }
+}
+
+// ==================== //
+// Lcd member functions //
+// ==================== //
+
+Lcd::Lcd(
+    uint8_t arg_i2c_addr,
+    uint8_t arg_num_cols,
+    uint8_t arg_num_rows)
+{
+    i2c_addr = arg_i2c_addr;
+    num_cols = arg_num_cols;
+    num_rows = (arg_num_rows < sizeof(lcd_row_addrs)) ? arg_num_rows : sizeof(lcd_row_addrs);
+    backlight_bit = LCD_PCF8574_BL;
+    command_queue_handle = nullptr;
+    drain_task_handle = nullptr;
+}
+
+void Lcd::init()
+{
+    lcd_command_t command = {};
+
+    // The HD44780 needs more than 40 ms after power rises before it can take instructions
+    vTaskDelay(/* TickType_t xTicksToDelay = */ pdMS_TO_TICKS(50));
+
+    // Put the HD44780 in 4-bit mode, no matter what mode it was left in, see figure 24 of its datasheet
+    write_nibble(/* uint8_t value = */ LCD_INSTRUCTION_FUNCTION_SET | LCD_FUNCTION_SET_8_BIT);
+    delayMicroseconds(/* uint32_t us = */ 4500);
+    write_nibble(/* uint8_t value = */ LCD_INSTRUCTION_FUNCTION_SET | LCD_FUNCTION_SET_8_BIT);
+    delayMicroseconds(/* uint32_t us = */ 4500);
+    write_nibble(/* uint8_t value = */ LCD_INSTRUCTION_FUNCTION_SET | LCD_FUNCTION_SET_8_BIT);
+    delayMicroseconds(/* uint32_t us = */ 150);
+    write_nibble(/* uint8_t value = */ LCD_INSTRUCTION_FUNCTION_SET);
+    delayMicroseconds(/* uint32_t us = */ LCD_US_EXECUTE);
+
+    // Use 2 line mode (rows 2 and 3 are continuations of rows 0 and 1), 5x8 pixel characters,
+    // turn the display on without a cursor, and move right after each character
+    lcd_transaction_t transaction;
+    lcd_transaction_init(&transaction);
+    lcd_transaction_add(&transaction, LCD_INSTRUCTION_FUNCTION_SET | LCD_FUNCTION_SET_2_LINE, 0, backlight_bit);
+    lcd_transaction_add(&transaction, LCD_INSTRUCTION_DISPLAY_CONTROL | LCD_DISPLAY_CONTROL_ON, 0, backlight_bit);
+    lcd_transaction_add(&transaction, LCD_INSTRUCTION_ENTRY_MODE | LCD_ENTRY_MODE_INCREMENT, 0, backlight_bit);
+    lcd_transaction_send(&transaction, i2c_addr);
+    command.type = LCD_COMMAND_CLEAR;
+    execute_command(/* lcd_command_t *command = */ &command);
+
+    // Create the queue of commands waiting to be sent to the display
+    command_queue_handle = xQueueCreate(
+        /* uxQueueLength = */ LCD_COMMAND_QUEUE_LENGTH,
+        /* uxItemSize = */ sizeof(lcd_command_t));
+    configASSERT(command_queue_handle);
+
+    // Create task to send queued commands to the display
+    // TODO: Look into static memory allocation instead?
+    xTaskCreate(
+        // Pointer to the task entry function. Tasks must be implemented to never return (i.e. continuous loop).
+        /* TaskFunction_t pxTaskCode = */ (TaskFunction_t) task_drain_lcd,
+        // A descriptive name for the task. This is mainly used to facilitate debugging. Max length defined by configMAX_TASK_NAME_LEN - default is 16.
+        /* const char *const pcName = */ "drain_lcd",
+        // The size of the task stack specified as the NUMBER OF BYTES. Note that this differs from vanilla FreeRTOS.
+        /* const configSTACK_DEPT_TYPE usStackDepth = */ 2048,
+        // Pointer that will be used as the parameter for the task being created.
+        /* void *const pvParameters = */ this,
+        // The priority at which the task should run.
+        // Systems that include MPU support can optionally create tasks in a privileged (system) mode by setting bit portPRIVILEGE_BIT of the priority parameter.
+        // For example, to create a privileged task at priority 2 the uxPriority parameter should be set to ( 2 | portPRIVILEGE_BIT ).
+        /* UBaseType_t uxPriority = */ 10,
+        // Used to pass back a handle by which the created task can be referenced.
+        /* TaskHandle_t *const pxCreatedTask = */ &drain_task_handle);
+    configASSERT(drain_task_handle);
+}
+
+void Lcd::clear()
+{
+    lcd_command_t command = {};
+    command.type = LCD_COMMAND_CLEAR;
+    queue_command(/* lcd_command_t *command = */ &command);
+}
+
+void Lcd::set_display(bool is_on)
+{
+    lcd_command_t command = {};
+    command.type = LCD_COMMAND_SET_DISPLAY;
+    command.arg = is_on;
+    queue_command(/* lcd_command_t *command = */ &command);
+}
+
+void Lcd::set_backlight(bool is_on)
+{
+    lcd_command_t command = {};
+    command.type = LCD_COMMAND_SET_BACKLIGHT;
+    command.arg = is_on;
+    queue_command(/* lcd_command_t *command = */ &command);
+}
+
+void Lcd::create_char(
+    uint8_t location,
+    const uint8_t *charmap)
+{
+    lcd_command_t command = {};
+    command.type = LCD_COMMAND_CREATE_CHAR;
+    command.arg = location;
+    command.num_chars = 8;
+    memcpy(command.chars, charmap, command.num_chars);
+    queue_command(/* lcd_command_t *command = */ &command);
+}
+
+void Lcd::write(
+    uint8_t col,
+    uint8_t row,
+    const char *chars,
+    size_t num_chars)
+{
+    // Do not write past the edge of the display
+    if((row >= num_rows) || (col >= num_cols))
+    {
+        return;
+    }
+    if(num_chars > (size_t) (num_cols - col))
+    {
+        num_chars = num_cols - col;
+    }
+
+    // Split the characters into as many commands as it takes to hold them
+    lcd_command_t command = {};
+    command.type = LCD_COMMAND_WRITE;
+    command.row = row;
+    while(num_chars > 0)
+    {
+        command.col = col;
+        command.num_chars = (num_chars < LCD_MAX_RUN_CHARS) ? num_chars : LCD_MAX_RUN_CHARS;
+        memcpy(command.chars, chars, command.num_chars);
+        queue_command(/* lcd_command_t *command = */ &command);
+
+        col += command.num_chars;
+        chars += command.num_chars;
+        num_chars -= command.num_chars;
+    }
+}
+
+void Lcd::benchmark()
+{
+    lcd_command_t command = {};
+    command.type = LCD_COMMAND_WRITE;
+    memset(command.chars, '#', sizeof(command.chars));
+
+    // Time writing every character on the display, one command per row, like a full redraw
+    int64_t us_start = esp_timer_get_time();
+    for(size_t i = 0; i < LCD_NUM_BENCHMARK_ITERATIONS; ++i)
+    {
+        for(command.row = 0; command.row < num_rows; ++command.row)
+        {
+            command.col = 0;
+            command.num_chars = (num_cols < LCD_MAX_RUN_CHARS) ? num_cols : LCD_MAX_RUN_CHARS;
+            execute_command(/* lcd_command_t *command = */ &command);
+        }
+    }
+    int64_t us_full_frame = (esp_timer_get_time() - us_start) / LCD_NUM_BENCHMARK_ITERATIONS;
+
+    // Time writing a single character, like a redraw where only one digit changed
+    command.row = 0;
+    command.num_chars = 1;
+    us_start = esp_timer_get_time();
+    for(size_t i = 0; i < LCD_NUM_BENCHMARK_ITERATIONS; ++i)
+    {
+        execute_command(/* lcd_command_t *command = */ &command);
+    }
+    int64_t us_single_cell = (esp_timer_get_time() - us_start) / LCD_NUM_BENCHMARK_ITERATIONS;
+
+    s_print("LCD full frame write (us): ");
+    s_println(us_full_frame, DEC);
+    s_print("LCD single cell write (us): ");
+    s_println(us_single_cell, DEC);
+
+    // Erase the benchmark characters
+    command.type = LCD_COMMAND_CLEAR;
+    execute_command(/* lcd_command_t *command = */ &command);
+}
+
+void Lcd::queue_command(lcd_command_t *command)
+{
+    // Wait as long as it takes for there to be room in the queue, dropping commands would leave the display wrong
+    (void) xQueueSend(
+        /* QueueHandle_t xQueue = */ command_queue_handle,
+        /* const void *const pvItemToQueue = */ command,
+        /* TickType_t xTicksToWait = */ portMAX_DELAY);
+}
+
+void Lcd::execute_command(lcd_command_t *command)
+{
+    lcd_transaction_t transaction;
+    lcd_transaction_init(&transaction);
+
+    switch(command->type)
+    {
+        case LCD_COMMAND_WRITE:
+            // Move the cursor, then write every character, in one transaction
+            lcd_transaction_add(&transaction, LCD_INSTRUCTION_SET_DDRAM_ADDR | (lcd_row_addrs[command->row] + command->col), 0, backlight_bit);
+            for(size_t i = 0; i < command->num_chars; ++i)
+            {
+                lcd_transaction_add(&transaction, command->chars[i], LCD_PCF8574_RS, backlight_bit);
+            }
+            lcd_transaction_send(&transaction, i2c_addr);
+            break;
+        case LCD_COMMAND_CLEAR:
+            // Clearing the display takes the HD44780 far longer than other instructions, it ignores anything sent before then
+            // NOTE: Delaying n ticks can end just after the nth tick starts, so delay one more to wait at least the whole time
+            lcd_transaction_add(&transaction, LCD_INSTRUCTION_CLEAR, 0, backlight_bit);
+            lcd_transaction_send(&transaction, i2c_addr);
+            vTaskDelay(/* TickType_t xTicksToDelay = */ pdMS_TO_TICKS(LCD_MS_EXECUTE_CLEAR) + 1);
+            break;
+        case LCD_COMMAND_SET_DISPLAY:
+            lcd_transaction_add(&transaction, LCD_INSTRUCTION_DISPLAY_CONTROL | ((0 != command->arg) ? LCD_DISPLAY_CONTROL_ON : 0), 0, backlight_bit);
+            lcd_transaction_send(&transaction, i2c_addr);
+            break;
+        case LCD_COMMAND_SET_BACKLIGHT:
+            // The backlight is a PCF8574 pin, not a HD44780 instruction, so only one I2C byte with enable low is needed
+            backlight_bit = (0 != command->arg) ? LCD_PCF8574_BL : 0;
+            transaction.bytes[transaction.num_bytes++] = backlight_bit;
+            lcd_transaction_send(&transaction, i2c_addr);
+            break;
+        case LCD_COMMAND_CREATE_CHAR:
+            // Move to the custom character in CGRAM, then write its rows, in one transaction
+            // The next LCD_COMMAND_WRITE moves the cursor back to DDRAM
+            lcd_transaction_add(&transaction, LCD_INSTRUCTION_SET_CGRAM_ADDR | ((command->arg & 0x7) << 3), 0, backlight_bit);
+            for(size_t i = 0; i < command->num_chars; ++i)
+            {
+                lcd_transaction_add(&transaction, command->chars[i], LCD_PCF8574_RS, backlight_bit);
+            }
+            lcd_transaction_send(&transaction, i2c_addr);
+            break;
+        default:
+            break;
+    }
+}
+
+void Lcd::write_nibble(uint8_t value)
+{
+    // Only used while the HD44780 may still be in 8-bit mode, where it reads one instruction per enable pulse
+    lcd_transaction_t transaction;
+    lcd_transaction_init(&transaction);
+    transaction.bytes[transaction.num_bytes++] = (value & 0xF0) | backlight_bit | LCD_PCF8574_EN;
+    transaction.bytes[transaction.num_bytes++] = (value & 0xF0) | backlight_bit;
+    lcd_transaction_send(&transaction, i2c_addr);
+}
\ No newline at end of file
@@ -19,6 +19,8 @@
 #include "tcp_ip.h"
 // Include custom storage API
 #include "storage.h"
+// Include custom Context class implementation
+#include "context.h"
 
 // =========================== //
 // Initialize and start device //
@@ -4,116 +4,330 @@
 #include "context.h"
 // Include custom TCP/IP API
 #include "tcp_ip.h"
-// Include FreeRTOS queue API
-#include "freertos/queue.h"
+// Include custom formatting API
+#include "format.h"
+// Include custom display diffing API
+#include "display_diff.h"
+// Include custom debug macros and compile flags
+#include "flags.h"
 
 // ======================= //
 // Define useful constants //
 // ======================= //
 
 // Define the number of lines in menu_lines
-#define NUM_MENU_LINES 8
+#define NUM_MENU_LINES (sizeof(menu_lines) / sizeof(*menu_lines))
+// Define the number of zones in zone_configs
+#define NUM_ZONES (sizeof(zone_configs) / sizeof(*zone_configs))
+// Define how long, in milliseconds, the "capture" TCP command captures the soil moisture sensor for
+#define MENU_MS_PROBE_CAPTURE_WINDOW 1000
+// Define the number of sensor samples the "capture" TCP command averages into each one it sends, 5 kHz with one probe
+#define MENU_PROBE_CAPTURE_DECIMATION 4
+
+// A single-producer, single-consumer ring of menu inputs from one source
+// The producer only writes num_pushed, the consumer only writes num_popped, so neither needs a lock.
+// Both only ever count up, and wrap around together, so num_pushed - num_popped is always the number waiting.
+typedef struct menu_input_ring_s {
+    // The inputs waiting, the next one to pop is at num_popped % MENU_INPUT_RING_LENGTH
+    menu_input_event_t events[MENU_INPUT_RING_LENGTH];
+    // The number of inputs ever pushed, only written by the producer
+    uint32_t num_pushed;
+    // The number of inputs ever popped, only written by the consumer
+    uint32_t num_popped;
+    // The number of inputs dropped because the ring was full, only written by the producer
+    uint32_t num_dropped;
+} menu_input_ring_t;
 
 // ======================= //
 // Instantiate useful data //
 // ======================= //
 
 // Initialize display peripheral
-LiquidCrystal_I2C display(
-    /* uint8_t lcd_Addr = */ DISPLAY_I2C_ADDR,
-    /* uint8_t lcd_cols = */ NUM_DISPLAY_CHARS_PER_LINE,
-    /* uint8_t lcd_rows = */ NUM_DISPLAY_LINES
-);
-
-// Store the handle the the menu input queue
-QueueHandle_t menu_input_queue_handle;
-
-// Store the handle of the task reading the menu input queue
-TaskHandle_t read_menu_input_queue_task_handle;
-
-// Define statically allocated buffer for context mutex
-StaticSemaphore_t context_mutex_buffer;
-
-// Create an instance of a context
-static Context context = { 
-    /* StaticSemaphore_t *mutex_buffer = */ &context_mutex_buffer,
-    /* int pin_servo_out = */ PIN_SERVO_OUT,
-    /* gpio_num_t arg_pin_soil_moisture_sensor_in = */ PIN_SOIL_MOISTURE_SENSOR_IN,
-    /* char *arg_nvs_namespace = */ "context"
+static Lcd display = {
+    /* uint8_t arg_i2c_addr = */ DISPLAY_I2C_ADDR,
+    /* uint8_t arg_num_cols = */ NUM_DISPLAY_CHARS_PER_LINE,
+    /* uint8_t arg_num_rows = */ NUM_DISPLAY_LINES
 };
 
+// Store the menu input queue, one ring per source, so every ring has a single producer
+// DRAM_ATTR keeps it out of flash, so interrupts can push to it while the flash cache is disabled
+DRAM_ATTR static menu_input_ring_t menu_input_rings[MENU_INPUT_SOURCE_MAX] = {};
+
+// Store the handle of the task reading the menu input queue, it is notified whenever an input is added
+TaskHandle_t read_menu_input_queue_task_handle = nullptr;
+
+// Store the handle of the task drawing the menu on the display, the only task allowed to write to the display
+TaskHandle_t render_menu_task_handle = nullptr;
+
+// Whether the display and its backlight should be on, task_render_menu turns it on or off to match
+volatile bool is_display_enabled = true;
+
+// Define statically allocated buffer for menu mutex
+StaticSemaphore_t menu_mutex_buffer;
+
+// Create the scheduler owning every servo, so servos sharing the 5 V supply do not all start moving at once
+// NOTE: This must be defined before any context, so it is constructed first
+static ServoScheduler servo_scheduler = {
+    /* uint8_t max_moving = */ CONTEXT_MAX_SERVOS_MOVING,
+    /* uint32_t ms_stagger = */ CONTEXT_MS_SERVO_STAGGER
+};
+
+// Define the soil moisture probes in each pot, and how much each counts towards its soil moisture
+// Add a line per probe for large pots, up to CONTEXT_MAX_SOIL_MOISTURE_PROBES, ex. { .pin = GPIO_NUM_34, .weight = 1 },
+static const soil_moisture_probe_config_t zone_1_soil_moisture_probes[] =
+{
+    { .pin = PIN_SOIL_MOISTURE_SENSOR_IN, .weight = 1 },
+};
+
+// Define the zones, one per pot, what waters each, a servo squeezing a spray bottle, or a pump or solenoid valve,
+// its probes, and the NVS namespace its settings are kept in
+// Add a line per pot, up to ZONE_MAX_ZONES, each with its own actuator and probes, on pins no other zone uses, ex.
+// { { ACTUATOR_TYPE_PUMP, PIN_PUMP_OUT }, zone_2_soil_moisture_probes, 1, "zone_2" },
+// NOTE: The first zone keeps the "context" namespace, so settings saved before there were zones are kept
+static const zone_config_t zone_configs[] =
+{
+    {
+        /* actuator_config_t actuator = */ { .type = ACTUATOR_TYPE_SERVO, .pin = PIN_SERVO_OUT },
+        /* const soil_moisture_probe_config_t *soil_moisture_probes = */ zone_1_soil_moisture_probes,
+        /* size_t num_soil_moisture_probes = */ sizeof(zone_1_soil_moisture_probes) / sizeof(*zone_1_soil_moisture_probes),
+        /* char *nvs_namespace = */ "context"
+    },
+};
+
+// Create the scheduler running every zone, and the sensor reading every zone's probes
+// NOTE: This must be defined before any context, so it is constructed first
+static ZoneScheduler zone_scheduler = {
+    /* const zone_config_t *zone_configs = */ zone_configs,
+    /* size_t num_zones = */ NUM_ZONES,
+    /* gpio_num_t pin_soil_moisture_sensor_power_out = */ PIN_SOIL_MOISTURE_SENSOR_POWER_OUT
+};
+
+// Define statically allocated buffers for the contexts' mutexes
+StaticSemaphore_t context_mutex_buffers[NUM_ZONES];
+
+// Create a context per zone, in the order of zone_configs
+static Context contexts[] = {
+    {
+        /* StaticSemaphore_t *mutex_buffer = */ &context_mutex_buffers[0],
+        /* ZoneScheduler *arg_zone_scheduler = */ &zone_scheduler,
+        /* ServoScheduler *arg_servo_scheduler = */ &servo_scheduler,
+        /* const zone_config_t *zone_config = */ &zone_configs[0]
+    },
+};
+static_assert(NUM_ZONES == (sizeof(contexts) / sizeof(*contexts)), "Every zone needs a context");
+static_assert(NUM_ZONES <= ZONE_MAX_ZONES, "Too many zones");
+
+// The index of the zone shown on the menu, and acted on by TCP commands
+static size_t index_zone_shown = 0;
+
+// The index of the soil moisture probe shown on the menu, and captured by the "capture" TCP command
+static size_t index_soil_moisture_probe_shown = 0;
+
+// Get the context of the zone shown on the menu
+static Context *get_context_shown()
+{
+    return &contexts[index_zone_shown];
+}
+
+// Show the zone num_zones after the one shown, wrapping around, with its first probe
+static MENU_CONTROL add_zone_shown(int num_zones)
+{
+    index_zone_shown = (size_t) ((((int) index_zone_shown + (num_zones % (int) NUM_ZONES)) + (int) NUM_ZONES) % (int) NUM_ZONES);
+    index_soil_moisture_probe_shown = 0;
+    return MENU_CONTROL_KEEP;
+}
+
+// Show the soil moisture probe num_probes after the one shown, wrapping around
+static MENU_CONTROL add_soil_moisture_probe_shown(int num_probes)
+{
+    int num_soil_moisture_probes = (int) get_context_shown()->get_num_soil_moisture_probes();
+    if(0 != num_soil_moisture_probes)
+    {
+        index_soil_moisture_probe_shown = (size_t) ((((int) index_soil_moisture_probe_shown + (num_probes % num_soil_moisture_probes)) +
+            num_soil_moisture_probes) % num_soil_moisture_probes);
+    }
+    return MENU_CONTROL_KEEP;
+}
+
+// Write which zone is shown into buf as a human-readable formatted string, return the number of characters written
+static size_t str_zone_shown(
+    char *buf,
+    size_t num_buf_chars)
+{
+    // Zone: 1 of 2
+    size_t num_chars = format_str(buf, num_buf_chars, "Zone: ");
+    num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, (uint32_t) (index_zone_shown + 1));
+    num_chars += format_str(buf + num_chars, num_buf_chars - num_chars, " of ");
+    num_chars += format_uint(buf + num_chars, num_buf_chars - num_chars, (uint32_t) NUM_ZONES);
+    return num_chars;
+}
+
 // Define the lines within the menu
 // Using C++ lambdas: https://en.cppreference.com/w/cpp/language/lambda
-// TODO: make context an argument so multiple contexts can be controlled by this menu
-static MenuLine menu_lines[NUM_MENU_LINES] = 
+// This table is constexpr, so it is built at compile time and placed in flash, and its lambdas become plain function pointers
+// Every line acts on the zone shown, picked by the first line
+static constexpr MenuLine menu_lines[] = 
 {
     {
-        /* String str_display = */ String(""),
-        /* String (*arg_func_to_str)() = */ []() { return context.str_current_soil_moisture(); },
-        /* MENU_CONTROL (*arg_func_on_up)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_confirm)() = */ []() { return context.check_soil_moisture(/* bool move_time_next_moisture_check = */ false); },
-        /* MENU_CONTROL (*arg_func_on_down)() = */ nullptr
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return str_zone_shown(buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return add_zone_shown(/* int num_zones = */ -(int) num_inputs); },
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return add_zone_shown(/* int num_zones = */ (int) num_inputs); }
+    },
+    {
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_current_soil_moisture(buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { *num_inputs_used = 1; return get_context_shown()->check_soil_moisture(/* bool move_time_next_moisture_check = */ false); },
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ nullptr
+    },
+    {
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_desired_soil_moisture(buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_desired_soil_moisture(/* int percent_q8 = */ CALIBRATION_PERCENT_Q8(1) * (int) num_inputs); },
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { *num_inputs_used = 1; return get_context_shown()->set_desired_soil_moisture_to_current(); },
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_desired_soil_moisture(/* int percent_q8 = */ -CALIBRATION_PERCENT_Q8(1) * (int) num_inputs); }
+    },
+    {
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_time_last_soil_moisture_check(buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ nullptr
+    },
+    {
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_time_next_soil_moisture_check(buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ nullptr
+    },
+    {
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_minute_soil_moisture_check_freq(buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_minute_soil_moisture_check_freq(/* int num_minutes = */ 5 * (int) num_inputs); },
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_minute_soil_moisture_check_freq(/* int num_minutes = */ -5 * (int) num_inputs); }
     },
     {
-        /* String str_display = */ String(""),
-        /* String (*arg_func_to_str)() = */ []() { return context.str_desired_soil_moisture(); },
-        /* MENU_CONTROL (*arg_func_on_up)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_confirm)() = */ []() { return context.set_desired_soil_moisture_to_current(); },
-        /* MENU_CONTROL (*arg_func_on_down)() = */ nullptr
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_check_schedule_mode(buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { *num_inputs_used = 1; return get_context_shown()->toggle_adaptive_check_schedule(); },
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ nullptr
     },
     {
-        /* String str_display = */ String(""),
-        /* String (*arg_func_to_str)() = */ []() { return context.str_time_last_soil_moisture_check(); },
-        /* MENU_CONTROL (*arg_func_on_up)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_confirm)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_down)() = */ nullptr
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_minute_min_check_freq(buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_minute_min_check_freq(/* int num_minutes = */ 5 * (int) num_inputs); },
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_minute_min_check_freq(/* int num_minutes = */ -5 * (int) num_inputs); }
     },
     {
-        /* String str_display = */ String(""),
-        /* String (*arg_func_to_str)() = */ []() { return context.str_time_next_soil_moisture_check(); },
-        /* MENU_CONTROL (*arg_func_on_up)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_confirm)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_down)() = */ nullptr
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_minute_max_check_freq(buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_minute_max_check_freq(/* int num_minutes = */ 5 * (int) num_inputs); },
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_minute_max_check_freq(/* int num_minutes = */ -5 * (int) num_inputs); }
     },
     {
-        /* String str_display = */ String(""),
-        /* String (*arg_func_to_str)() = */ []() { return context.str_minute_soil_moisture_check_freq(); },
-        /* MENU_CONTROL (*arg_func_on_up)() = */ []() { return context.add_minute_soil_moisture_check_freq(/* int num_minutes = */ 5); },
-        /* MENU_CONTROL (*arg_func_on_confirm)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_down)() = */ []() {  return context.add_minute_soil_moisture_check_freq(/* int num_minutes = */ -5); }
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_soil_moisture_probe(index_soil_moisture_probe_shown, buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return add_soil_moisture_probe_shown(/* int num_probes = */ -(int) num_inputs); },
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { *num_inputs_used = 1; return get_context_shown()->check_soil_moisture(/* bool move_time_next_moisture_check = */ false); },
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return add_soil_moisture_probe_shown(/* int num_probes = */ (int) num_inputs); }
     },
     {
-        /* String str_display = */ String("X now"),
-        /* String (*arg_func_to_str)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_up)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_confirm)() = */ []() { return context.check_soil_moisture(/* bool move_time_next_moisture_check = */ true); },
-        /* MENU_CONTROL (*arg_func_on_down)() = */ nullptr
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_soil_moisture_probe_calibration(index_soil_moisture_probe_shown, CALIBRATION_POINT_DRY, buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_soil_moisture_probe_calibration_percent(index_soil_moisture_probe_shown, CALIBRATION_POINT_DRY,
+            /* int percent_q8 = */ CALIBRATION_PERCENT_Q8(1) * (int) num_inputs); },
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { *num_inputs_used = 1; return get_context_shown()->calibrate_soil_moisture_probe(index_soil_moisture_probe_shown, CALIBRATION_POINT_DRY); },
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_soil_moisture_probe_calibration_percent(index_soil_moisture_probe_shown, CALIBRATION_POINT_DRY,
+            /* int percent_q8 = */ -CALIBRATION_PERCENT_Q8(1) * (int) num_inputs); }
     },
     {
-        /* String str_display = */ String("Test spray"),
-        /* String (*arg_func_to_str)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_up)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_confirm)() = */ []() { return context.spray(/* bool in_isr = */ false,
-            /* bool is_blocking = */ false); },
-        /* MENU_CONTROL (*arg_func_on_down)() = */ nullptr
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_soil_moisture_probe_calibration(index_soil_moisture_probe_shown, CALIBRATION_POINT_WET, buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_soil_moisture_probe_calibration_percent(index_soil_moisture_probe_shown, CALIBRATION_POINT_WET,
+            /* int percent_q8 = */ CALIBRATION_PERCENT_Q8(1) * (int) num_inputs); },
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { *num_inputs_used = 1; return get_context_shown()->calibrate_soil_moisture_probe(index_soil_moisture_probe_shown, CALIBRATION_POINT_WET); },
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_soil_moisture_probe_calibration_percent(index_soil_moisture_probe_shown, CALIBRATION_POINT_WET,
+            /* int percent_q8 = */ -CALIBRATION_PERCENT_Q8(1) * (int) num_inputs); }
     },
     {
-        /* String str_display = */ String("Wipe NVS"),
-        /* String (*arg_func_to_str)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_up)() = */ nullptr,
-        /* MENU_CONTROL (*arg_func_on_confirm)() = */ []() { 
-            storage_wipe(/* bool reset = */ true); 
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_soil_moisture_probe_calibration(index_soil_moisture_probe_shown, CALIBRATION_POINT_MID, buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_soil_moisture_probe_calibration_percent(index_soil_moisture_probe_shown, CALIBRATION_POINT_MID,
+            /* int percent_q8 = */ CALIBRATION_PERCENT_Q8(1) * (int) num_inputs); },
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { *num_inputs_used = 1; return get_context_shown()->calibrate_soil_moisture_probe(index_soil_moisture_probe_shown, CALIBRATION_POINT_MID); },
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_soil_moisture_probe_calibration_percent(index_soil_moisture_probe_shown, CALIBRATION_POINT_MID,
+            /* int percent_q8 = */ -CALIBRATION_PERCENT_Q8(1) * (int) num_inputs); }
+    },
+    {
+        /* const char *str_display = */ "X now",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { *num_inputs_used = 1; return get_context_shown()->check_soil_moisture(/* bool move_time_next_moisture_check = */ true); },
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ nullptr
+    },
+    {
+        /* const char *str_display = */ "Water now",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { *num_inputs_used = 1; return get_context_shown()->water(); },
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ nullptr
+    },
+    {
+        /* const char *str_display = */ "Test dose",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { *num_inputs_used = 1; return get_context_shown()->test_dose(/* ACTUATION_SOURCE_t source = */ ACTUATION_SOURCE_MENU); },
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ nullptr
+    },
+    {
+        // Confirm doses ACTUATOR_NUM_CALIBRATION_UNITS units, measure what comes out, then set the rate to a tenth of it
+        /* const char *str_display = */ "",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ [](char *buf, size_t num_buf_chars) { return get_context_shown()->str_actuator_rate(buf, num_buf_chars); },
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_actuator_rate(/* int ul = */ 100 * (int) num_inputs); },
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { *num_inputs_used = 1; return get_context_shown()->calibrate_actuator(); },
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) { return get_context_shown()->add_actuator_rate(/* int ul = */ -100 * (int) num_inputs); }
+    },
+    {
+        /* const char *str_display = */ "Wipe NVS",
+        /* size_t (*arg_func_to_str)(char *, size_t) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_up)(size_t, size_t *) = */ nullptr,
+        /* MENU_CONTROL (*arg_func_on_confirm)(size_t, size_t *) = */ [](size_t num_inputs, size_t *num_inputs_used) {
+            *num_inputs_used = 1;
+            storage_wipe(/* bool reset = */ true);
             return MENU_CONTROL_RELEASE;
         },
-        /* MENU_CONTROL (*arg_func_on_down)() = */ nullptr
+        /* MENU_CONTROL (*arg_func_on_down)(size_t, size_t *) = */ nullptr
     }
     // TODO: have menu to show if successfully connected to WiFi and TCP
-    // TODO: have option to automatically update display every X seconds
 };
 
+// Check at compile time that menu_lines fits the display
+// Return whether every menu line's fixed string fits on the display after the 2 characters for the cursor
+static constexpr bool is_every_menu_line_str_display_short_enough()
+{
+    for(size_t i = 0; i < NUM_MENU_LINES; ++i)
+    {
+        if(menu_lines[i].get_str_display_len() > (NUM_DISPLAY_CHARS_PER_LINE - 2))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(NUM_MENU_LINES >= NUM_DISPLAY_LINES, "menu_lines needs at least NUM_DISPLAY_LINES lines, or the same line would show more than once");
+static_assert(is_every_menu_line_str_display_short_enough(), "A menu line's str_display is too long to fit on the display");
+
 // Create an instance of a menu
 static Menu menu = {
-    /* MenuLine *arg_menu_lines = */ menu_lines,
+    /* StaticSemaphore_t *arg_mutex_buffer = */ &menu_mutex_buffer,
+    /* const MenuLine *arg_menu_lines = */ menu_lines,
     /* size_t arg_num_menu_lines = */ NUM_MENU_LINES
 };
 
@@ -133,7 +347,7 @@ enum CUSTOM_CHAR_t : uint8_t
 };
 
 // Define custom character for water emoji, X in the display examples
-byte custom_char_water_drop[] = {
+const uint8_t custom_char_water_drop[] = {
     0b00100,
     0b01110,
     0b01110,
@@ -145,7 +359,7 @@ byte custom_char_water_drop[] = {
 };
 
 // Define custom character for filled right-arrow emoji, # in display examples
-byte custom_char_filled_right_arrow[] = {
+const uint8_t custom_char_filled_right_arrow[] = {
     0b01000,
     0b01100,
     0b01110,
@@ -160,11 +374,6 @@ byte custom_char_filled_right_arrow[] = {
 // Functions for getting local global variables from other files //
 // ============================================================= //
 
-LiquidCrystal_I2C *get_display()
-{
-    return &display;
-}
-
 TaskHandle_t get_read_menu_input_queue_task_handle()
 {
     return read_menu_input_queue_task_handle;
@@ -175,6 +384,7 @@ TaskHandle_t get_read_menu_input_queue_task_handle()
 // =================================================== //
 
 void task_read_menu_input_queue();
+void task_render_menu();
 
 void init_menu()
 {
@@ -183,27 +393,23 @@ void init_menu()
     // https://forum.arduino.cc/t/liquidcrystal_i2c-how-to-change-pins/572686/7
     Wire.begin(
         /* int sda = */ PIN_I2C_DISPLAY_SDA,
-        /* int sdl = */ PIN_I2C_DISPLAY_SCL
+        /* int sdl = */ PIN_I2C_DISPLAY_SCL,
+        /* uint32_t frequency = */ LCD_I2C_HZ
     );
     display.init();
-    display.clear();
-    display.backlight();
-    display.setCursor(
+#if PRINT && RUN_DISPLAY_BENCHMARK
+    display.benchmark();
+#endif // PRINT && RUN_DISPLAY_BENCHMARK
+    display.write(
         /* uint8_t col = */ 0,
-        /* uint8_t row = */ 0
-    );
-    display.print(/* const char *c = */ "Hello world!");
+        /* uint8_t row = */ 0,
+        /* const char *chars = */ "Hello world!",
+        /* size_t num_chars = */ strlen("Hello world!"));
 
     // Register custom characters
     // TODO: Use water character. By having a menu line not hold a string, but write to the screen itself? Or can they be passed in print?
-    display.createChar(CUSTOM_CHAR_WATER_DROP, custom_char_water_drop);
-    display.createChar(CUSTOM_CHAR_FILLED_RIGHT_ARROW, custom_char_filled_right_arrow);
-
-    // Set queue_handle_menu_input to point to a queue capable of holding 10 menu inputs
-    menu_input_queue_handle = xQueueCreate(
-        /* uxQueueLength = */ 10,
-        /* uxItemSize = */ sizeof(MENU_INPUT_t));
-    configASSERT(menu_input_queue_handle);
+    display.create_char(CUSTOM_CHAR_WATER_DROP, custom_char_water_drop);
+    display.create_char(CUSTOM_CHAR_FILLED_RIGHT_ARROW, custom_char_filled_right_arrow);
 
     // Start task to read inputs added to queue
     // TODO: Look into static memory allocation instead?
@@ -223,71 +429,505 @@ void init_menu()
         // Used to pass back a handle by which the created task can be referenced.
         /* TaskHandle_t *const pxCreatedTask = */ &read_menu_input_queue_task_handle);
     configASSERT(read_menu_input_queue_task_handle);
+
+    // Start task to draw the menu on the display, so slow I2C and TCP writes do not delay reading the next input
+    // TODO: Look into static memory allocation instead?
+    xTaskCreate(
+        // Pointer to the task entry function. Tasks must be implemented to never return (i.e. continuous loop).
+        /* TaskFunction_t pxTaskCode = */ (TaskFunction_t) task_render_menu,
+        // A descriptive name for the task. This is mainly used to facilitate debugging. Max length defined by configMAX_TASK_NAME_LEN - default is 16.
+        /* const char *const pcName = */ "render_menu",
+        // The size of the task stack specified as the NUMBER OF BYTES. Note that this differs from vanilla FreeRTOS.
+        /* const configSTACK_DEPT_TYPE usStackDepth = */ 2048,
+        // Pointer that will be used as the parameter for the task being created.
+        /* void *const pvParameters = */ NULL,
+        // The priority at which the task should run.
+        // Systems that include MPU support can optionally create tasks in a privileged (system) mode by setting bit portPRIVILEGE_BIT of the priority parameter.
+        // For example, to create a privileged task at priority 2 the uxPriority parameter should be set to ( 2 | portPRIVILEGE_BIT ).
+        /* UBaseType_t uxPriority = */ 10,
+        // Used to pass back a handle by which the created task can be referenced.
+        /* TaskHandle_t *const pxCreatedTask = */ &render_menu_task_handle);
+    configASSERT(render_menu_task_handle);
+}
+
+void notify_menu_changed()
+{
+    // Context members can change before the menu is initialized, there is nothing to draw yet
+    if(nullptr == render_menu_task_handle)
+    {
+        return;
+    }
+    (void) xTaskNotifyGive(/* TaskHandle_t xTaskToNotify = */ render_menu_task_handle);
+}
+
+void show_next_zone()
+{
+    (void) add_zone_shown(/* int num_zones = */ 1);
+    notify_menu_changed();
+#if WIFI_ENABLED
+    // Zone: 2 of 3
+    char buf[24];
+    size_t num_chars = str_zone_shown(buf, sizeof(buf));
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "\n");
+    (void) tcp_send(
+        /* void *packet = */ buf,
+        /* size_t num_packet_bytes = */ num_chars);
+#endif // WIFI_ENABLED
+}
+
+void water_now()
+{
+    (void) get_context_shown()->water();
+}
+
+void dose_now()
+{
+    (void) get_context_shown()->test_dose(/* ACTUATION_SOURCE_t source = */ ACTUATION_SOURCE_TCP);
+}
+
+void send_soak_curve()
+{
+#if WIFI_ENABLED
+    soak_curve_t curve;
+    get_context_shown()->get_soak_curve(/* soak_curve_t *out_curve = */ &curve);
+
+    // Send one line per reading, so the buffer stays small
+    // Soak from 20.5%, settled, learned settle (ms): 45000
+    // 2000 ms: 21.0%
+    char buf[64];
+    size_t num_chars = format_str(buf, sizeof(buf), "Soak from ");
+    num_chars += format_q8(buf + num_chars, sizeof(buf) - num_chars, curve.soil_moisture_before);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "%");
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, (true == curve.is_settled) ? ", settled" : ", timed out");
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", learned settle (ms): ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, get_context_shown()->get_ms_soak_settle());
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "\n");
+    (void) tcp_send(
+        /* void *packet = */ buf,
+        /* size_t num_packet_bytes = */ num_chars);
+    for(size_t i = 0; i < curve.num_readings; ++i)
+    {
+        num_chars = format_uint(buf, sizeof(buf), curve.ms_after_dose[i]);
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, " ms: ");
+        num_chars += format_q8(buf + num_chars, sizeof(buf) - num_chars, curve.soil_moistures[i]);
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "%\n");
+        (void) tcp_send(
+            /* void *packet = */ buf,
+            /* size_t num_packet_bytes = */ num_chars);
+    }
+#endif // WIFI_ENABLED
+}
+
+void send_probe_stats()
+{
+#if WIFI_ENABLED
+    sensor_power_stats_t stats;
+    get_context_shown()->get_soil_moisture_sensor_power_stats(/* sensor_power_stats_t *out_stats = */ &stats);
+
+    // Probe on (ms): 12345 of (s): 86400, windows: 24
+    // Bursts: 30, coalesced reads: 2
+    char buf[64];
+    size_t num_chars = format_str(buf, sizeof(buf), "Probe on (ms): ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, (uint32_t) (stats.us_powered / 1000));
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, " of (s): ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, (uint32_t) (stats.us_since_init / (1000 * 1000)));
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", windows: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_power_windows);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "\n");
+    (void) tcp_send(
+        /* void *packet = */ buf,
+        /* size_t num_packet_bytes = */ num_chars);
+    num_chars = format_str(buf, sizeof(buf), "Bursts: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_bursts);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", coalesced reads: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_coalesced_reads);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "\n");
+    (void) tcp_send(
+        /* void *packet = */ buf,
+        /* size_t num_packet_bytes = */ num_chars);
+#endif // WIFI_ENABLED
+}
+
+void send_servo_stats()
+{
+#if WIFI_ENABLED
+    servo_stats_t stats;
+    get_context_shown()->get_servo_stats(/* servo_stats_t *out_stats = */ &stats);
+    servo_scheduler_stats_t scheduler_stats;
+    get_context_shown()->get_servo_scheduler_stats(/* servo_scheduler_stats_t *out_stats = */ &scheduler_stats);
+
+    // Squirts: 12, last (ms): 912, average (ms): 905, fade timeouts: 0
+    // Squeezes: 24, most squeezing at once: 2, waited for budget: 4, for stagger: 7, waited (ms): 1630
+    char buf[96];
+    size_t num_chars = format_str(buf, sizeof(buf), "Squirts: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_squirts);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", last (ms): ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.us_last_squirt / 1000);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", average (ms): ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars,
+        (0 == stats.num_squirts) ? 0 : (uint32_t) (stats.us_squirts / (1000 * (uint64_t) stats.num_squirts)));
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", fade timeouts: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_fade_timeouts);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "\n");
+    (void) tcp_send(
+        /* void *packet = */ buf,
+        /* size_t num_packet_bytes = */ num_chars);
+
+    num_chars = format_str(buf, sizeof(buf), "Squeezes: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, scheduler_stats.num_moves);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", most squeezing at once: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, scheduler_stats.max_moving_seen);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", waited for budget: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, scheduler_stats.num_budget_waits);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", for stagger: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, scheduler_stats.num_stagger_waits);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", waited (ms): ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, (uint32_t) (scheduler_stats.us_waited / 1000));
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "\n");
+    (void) tcp_send(
+        /* void *packet = */ buf,
+        /* size_t num_packet_bytes = */ num_chars);
+#endif // WIFI_ENABLED
+}
+
+void send_dose_queue_stats()
+{
+#if WIFI_ENABLED
+    actuation_stats_t stats;
+    get_context_shown()->get_dose_queue_stats(/* actuation_stats_t *out_stats = */ &stats);
+    actuator_stats_t actuator_stats;
+    get_context_shown()->get_actuator_stats(/* actuator_stats_t *out_stats = */ &actuator_stats);
+
+    // Requests (menu/tcp/water): 2/1/5, queued: 6, merged: 2, dropped: 0, cancelled: 0, done: 6
+    // Doses: 31, deferred: 3, dosed (ml): 31.0, latency (ms) last: 2712, max: 9120, average: 4410
+    static const char *const str_sources[ACTUATION_SOURCE_MAX] = { "menu", "tcp", "water" };
+    char buf[128];
+    size_t num_chars = format_str(buf, sizeof(buf), "Requests (");
+    for(size_t i = 0; i < ACTUATION_SOURCE_MAX; ++i)
+    {
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, (0 == i) ? "" : "/");
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, str_sources[i]);
+    }
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "): ");
+    for(size_t i = 0; i < ACTUATION_SOURCE_MAX; ++i)
+    {
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, (0 == i) ? "" : "/");
+        num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_requests[i]);
+    }
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", queued: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_queued);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", merged: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_merged);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", dropped: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_dropped);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", cancelled: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_cancelled);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", done: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_done);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "\n");
+    (void) tcp_send(
+        /* void *packet = */ buf,
+        /* size_t num_packet_bytes = */ num_chars);
+
+    num_chars = format_str(buf, sizeof(buf), "Doses: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_actuations);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", deferred: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.num_deferred);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", dosed (ml): ");
+    num_chars += format_milli(buf + num_chars, sizeof(buf) - num_chars, (uint32_t) actuator_stats.ul_dosed);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", latency (ms) last: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.us_last_latency / 1000);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", max: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, stats.us_max_latency / 1000);
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", average: ");
+    num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars,
+        (0 == stats.num_done) ? 0 : (uint32_t) (stats.us_latencies / (1000 * (uint64_t) stats.num_done)));
+    num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "\n");
+    (void) tcp_send(
+        /* void *packet = */ buf,
+        /* size_t num_packet_bytes = */ num_chars);
+#endif // WIFI_ENABLED
+}
+
+void send_soil_moisture_probes()
+{
+#if WIFI_ENABLED
+    soil_moisture_probe_t probes[CONTEXT_MAX_SOIL_MOISTURE_PROBES];
+    size_t num_probes = get_context_shown()->get_soil_moisture_probes(
+        /* soil_moisture_probe_t *out_probes = */ probes,
+        /* size_t max_probes = */ CONTEXT_MAX_SOIL_MOISTURE_PROBES);
+
+    // Send one line per probe, so the buffer stays small
+    // Probe 1 (GPIO 35, weight 1): 42.5% (raw 1500), noise: 3, ok
+    static const char *const str_statuses[PROBE_STATUS_MAX] = { "ok", "disconnected", "stuck" };
+    char buf[96];
+    for(size_t i = 0; i < num_probes; ++i)
+    {
+        size_t num_chars = format_str(buf, sizeof(buf), "Probe ");
+        num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, (uint32_t) (i + 1));
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, " (GPIO ");
+        num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, (uint32_t) probes[i].config.pin);
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", weight ");
+        num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, probes[i].config.weight);
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "): ");
+        num_chars += format_q8(buf + num_chars, sizeof(buf) - num_chars, probes[i].soil_moisture);
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "% (raw ");
+        num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, probes[i].raw);
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "), noise: ");
+        num_chars += format_uint(buf + num_chars, sizeof(buf) - num_chars, probes[i].noise);
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, ", ");
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, (probes[i].status < PROBE_STATUS_MAX) ? str_statuses[probes[i].status] : "?");
+        num_chars += format_str(buf + num_chars, sizeof(buf) - num_chars, "\n");
+        (void) tcp_send(
+            /* void *packet = */ buf,
+            /* size_t num_packet_bytes = */ num_chars);
+    }
+#endif // WIFI_ENABLED
+}
+
+void start_probe_capture()
+{
+#if WIFI_ENABLED
+    if(false == get_context_shown()->capture_soil_moisture_sensor(
+        /* size_t index = */ index_soil_moisture_probe_shown,
+        /* uint32_t ms_window = */ MENU_MS_PROBE_CAPTURE_WINDOW,
+        /* uint32_t decimation = */ MENU_PROBE_CAPTURE_DECIMATION,
+        /* bool (*func_send_block)(const void *, size_t) = */ [](const void *block, size_t num_block_bytes) {
+            return tcp_send(/* void *packet = */ (void *) block, /* size_t num_packet_bytes = */ num_block_bytes); }))
+    {
+        s_println("Failed to start probe capture, one is already running");
+    }
+#endif // WIFI_ENABLED
+}
+
+void set_display_enabled(bool is_enabled)
+{
+    is_display_enabled = is_enabled;
+    notify_menu_changed();
 }
 
 // Use non-member function, so many sources can write to the same input queue
 // Bound functions, such as member functions, can only be called, not used as pointers
-void add_to_menu_input_queue(
+// IRAM_ATTR puts this function in internal RAM instead of flash memory, so it can be called from interrupts
+void IRAM_ATTR add_to_menu_input_queue(
     MENU_INPUT_t menu_input,
+    MENU_INPUT_SOURCE_t source,
+    bool is_repeat,
+    int64_t us_time,
     bool from_isr)
 {
-    // Write menu input GPIO pin number to queue holding all button presses
-    // Remember, non-ISR queue access is not safe from within interrupts!
-    // Don't care about the return value, I am ok with losing some button inputs
+    if(source >= MENU_INPUT_SOURCE_MAX)
+    {
+        return;
+    }
+    menu_input_ring_t *ring = &menu_input_rings[source];
+
+    // Don't care about losing inputs when the ring is full, just count them
+    uint32_t num_pushed = ring->num_pushed;
+    if((num_pushed - __atomic_load_n(&ring->num_popped, __ATOMIC_ACQUIRE)) >= MENU_INPUT_RING_LENGTH)
+    {
+        ++ring->num_dropped;
+        return;
+    }
+    menu_input_event_t *event = &ring->events[num_pushed & (MENU_INPUT_RING_LENGTH - 1)];
+    event->input = menu_input;
+    event->source = source;
+    event->flags = is_repeat ? MENU_INPUT_FLAG_REPEAT : 0;
+    event->us_time = (uint32_t) us_time;
+
+    // Publish the input only after it is fully written, the release makes sure the reader on the other core sees it that way too
+    __atomic_store_n(&ring->num_pushed, num_pushed + 1, __ATOMIC_RELEASE);
+
+    // Wake the task reading the menu input queue
+    // Inputs can be added before the menu is initialized, they will be read once it is
+    if(nullptr == read_menu_input_queue_task_handle)
+    {
+        return;
+    }
     if(true == from_isr)
     {
-        (void) xQueueSendFromISR(
-            // The handle to the queue on which the item is to be posted.
-            /* QueueHandle_t xQueue = */ menu_input_queue_handle,
-            // A pointer to the item that is to be placed on the queue.
-            // The size of the items the queue will hold was defined when the queue was created,
-            // so this many bytes will be copied from pvItemToQueue into the queue storage area.
-            /* const void *const pvItemToQueue = */ &menu_input,
-            // xQueueGenericSendFromISR() will set *pxHigherPriorityTaskWoken to pdTRUE if sending to the queue caused a task to unblock,
-            // and the unblocked task has a priority higher than the currently running task.
-            // If xQueueGenericSendFromISR() sets this value to pdTRUE then a context switch should be requested before the interrupt is exited.
-            /* BaseType_t *const pxHigherPriorityTaskWoken = */ NULL
-        );
+        // vTaskNotifyGiveFromISR() will set *pxHigherPriorityTaskWoken to pdTRUE if the notified task has a higher priority than the interrupted one,
+        // in which case a context switch should be requested before the interrupt is exited, so the input is read right away.
+        BaseType_t is_higher_priority_task_woken = pdFALSE;
+        vTaskNotifyGiveFromISR(
+            /* TaskHandle_t xTaskToNotify = */ read_menu_input_queue_task_handle,
+            /* BaseType_t *pxHigherPriorityTaskWoken = */ &is_higher_priority_task_woken);
+        portYIELD_FROM_ISR(is_higher_priority_task_woken);
         return;
     }
-    (void) xQueueSend(
-        // The handle to the queue on which the item is to be posted.
-        /* QueueHandle_t xQueue = */ menu_input_queue_handle,
-        // A pointer to the item that is to be placed on the queue.
-        // The size of the items the queue will hold was defined when the queue was created,
-        // so this many bytes will be copied from pvItemToQueue into the queue storage area.
-        /* const void *const pvItemToQueue = */ &menu_input,
-        // The maximum amount of time the task should block waiting for space to become 
-        // available on the queue, should it already be full. The call will return immediately
-        // if this is set to 0 and the queue is full. The time is defined in tick periods so 
-        // the constant portTICK_PERIOD_MS should be used to convert to real time if this is required.
-        /* TickType_t xTicksToWait = */ pdMS_TO_TICKS(10)
-    );
+    (void) xTaskNotifyGive(/* TaskHandle_t xTaskToNotify = */ read_menu_input_queue_task_handle);
+}
+
+// Take the oldest input waiting in the menu input queue, across every source
+// Returns false if there are no inputs waiting
+static bool pop_menu_input(menu_input_event_t *menu_input_event)
+{
+    menu_input_ring_t *oldest_ring = nullptr;
+    for(size_t i = 0; i < MENU_INPUT_SOURCE_MAX; ++i)
+    {
+        menu_input_ring_t *ring = &menu_input_rings[i];
+        if(ring->num_popped == __atomic_load_n(&ring->num_pushed, __ATOMIC_ACQUIRE))
+        {
+            continue;
+        }
+        // Compare times by subtracting, so wrapping around does not matter
+        const menu_input_event_t *event = &ring->events[ring->num_popped & (MENU_INPUT_RING_LENGTH - 1)];
+        if((nullptr == oldest_ring) ||
+            ((int32_t) (event->us_time - oldest_ring->events[oldest_ring->num_popped & (MENU_INPUT_RING_LENGTH - 1)].us_time) < 0))
+        {
+            oldest_ring = ring;
+        }
+    }
+    if(nullptr == oldest_ring)
+    {
+        return false;
+    }
+
+    // Copy the input out before freeing its slot, the release makes sure the producer does not overwrite it early
+    *menu_input_event = oldest_ring->events[oldest_ring->num_popped & (MENU_INPUT_RING_LENGTH - 1)];
+    __atomic_store_n(&oldest_ring->num_popped, oldest_ring->num_popped + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Take the oldest input waiting in the menu input queue, waiting up to ticks_to_wait for one to be added if there are none
+// Returns false if no input was added in time
+static bool receive_menu_input(
+    menu_input_event_t *menu_input_event,
+    TickType_t ticks_to_wait)
+{
+    if(true == pop_menu_input(/* menu_input_event_t *menu_input_event = */ menu_input_event))
+    {
+        return true;
+    }
+    if(0 == ticks_to_wait)
+    {
+        return false;
+    }
+
+    // Every input added notifies this task, an input added since the ring was checked leaves a notification, so this returns right away
+    (void) ulTaskNotifyTake(
+        /* BaseType_t xClearCountOnExit = */ pdTRUE,
+        /* TickType_t xTicksToWait = */ ticks_to_wait);
+    return pop_menu_input(/* menu_input_event_t *menu_input_event = */ menu_input_event);
+}
+
+#if PRINT && PRINT_INPUT_LATENCY
+// Get the name of a menu input source, for printing
+static const char *get_menu_input_source_name(MENU_INPUT_SOURCE_t source)
+{
+    switch(source)
+    {
+        case MENU_INPUT_SOURCE_BUTTON:
+            return "button";
+        case MENU_INPUT_SOURCE_TCP:
+            return "TCP";
+        default:
+            return "?";
+    }
+}
+#endif // PRINT && PRINT_INPUT_LATENCY
+
+// Hand a run of the same menu input to the menu, and print how long it took to get there if asked to
+static void react_to_menu_input_run(
+    MENU_INPUT_t menu_input,
+    size_t num_menu_inputs,
+    MENU_INPUT_SOURCE_t source,
+    uint32_t us_first_time,
+    uint32_t us_max_wait)
+{
+    menu.react_to_menu_input(
+        /* MENU_INPUT_t menu_input = */ menu_input,
+        /* size_t num_menu_inputs = */ num_menu_inputs);
+#if PRINT && PRINT_INPUT_LATENCY
+    s_print("Menu input ");
+    s_print((unsigned) menu_input, DEC);
+    s_print(" x");
+    s_print((unsigned) num_menu_inputs, DEC);
+    s_print(" from ");
+    s_print(get_menu_input_source_name(/* MENU_INPUT_SOURCE_t source = */ source));
+    s_print(", longest wait in queue (us): ");
+    s_print(us_max_wait, DEC);
+    s_print(", handled after capture (us): ");
+    s_print((uint32_t) esp_timer_get_time() - us_first_time, DEC);
+    s_print(", dropped: ");
+    s_println(menu_input_rings[source].num_dropped, DEC);
+#endif // PRINT && PRINT_INPUT_LATENCY
 }
 
 // Use non-member function, so multiple menus can read from the same input queue
 void task_read_menu_input_queue()
 {
-    // Get GPIO pin number from queue holding all button presses
-    MENU_INPUT_t menu_input = MENU_INPUT_NONE;
+    // Get menu input from queue holding all button presses
+    menu_input_event_t menu_input_event = {};
 
     // Tasks must be implemented to never return (i.e. continuous loop)
     // https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-reference/system/freertos_idf.html
     while(1)
     {
         // Wait for an input to enter the menu input queue
-        if(pdTRUE == xQueueReceive(
-            // The handle to the queue from which the item is to be received.
-            /* QueueHandle_t xQueue = */ menu_input_queue_handle,
-            // Pointer to the buffer into which the received item will be copied.
-            /* void *pvBuffer = */ &menu_input,
-            // The maximum amount of time the task should block waiting for an item to receive should the queue be empty at the time of the call.
-            // xQueueReceive() will return immediately if xTicksToWait is zero and the queue is empty.
-            // The time is defined in tick periods so the constant portTICK_PERIOD_MS should be used to convert to real time if this is required.
-            /* TickType_t xTicksToWait */ portMAX_DELAY))
+        if(true == receive_menu_input(
+            /* menu_input_event_t *menu_input_event = */ &menu_input_event,
+            /* TickType_t ticks_to_wait = */ portMAX_DELAY))
         {
-            // Use the menu input to manipulated the menu
-            menu.react_to_menu_input(/* MENU_INPUT_t menu_input = */ menu_input);
+            // Use the menu input, and every other menu input already waiting in the queue, to manipulate the menu,
+            // then update the display once for all of them instead of once per input.
+            // Stop taking inputs once MENU_MS_INPUT_BATCH_BUDGET has passed, so a stream of inputs still updates the display.
+            // A single input finds the queue empty and updates the display right away.
+            // Runs of the same input are handed to the menu together, so ex. a run of ups on a value only changes it once.
+            // Repeats from a held button come slower than the batch budget, so once one arrives,
+            // keep waiting for more until a frame (MENU_MS_MIN_FRAME_PERIOD) has passed, and fold the whole frame's worth together.
+            int64_t us_batch_deadline = esp_timer_get_time() + (MENU_MS_INPUT_BATCH_BUDGET * 1000);
+            bool is_waiting_for_repeats = false;
+            MENU_INPUT_t menu_input = menu_input_event.input;
+            MENU_INPUT_SOURCE_t source = menu_input_event.source;
+            size_t num_menu_inputs = 0;
+            // When the first input of the run was captured, and the longest any input of the run waited in the queue
+            uint32_t us_first_time = menu_input_event.us_time;
+            uint32_t us_max_wait = 0;
+            TickType_t ticks_to_wait = 0;
+            do
+            {
+                int64_t us_current_time = esp_timer_get_time();
+                if(menu_input != menu_input_event.input)
+                {
+                    react_to_menu_input_run(
+                        /* MENU_INPUT_t menu_input = */ menu_input,
+                        /* size_t num_menu_inputs = */ num_menu_inputs,
+                        /* MENU_INPUT_SOURCE_t source = */ source,
+                        /* uint32_t us_first_time = */ us_first_time,
+                        /* uint32_t us_max_wait = */ us_max_wait);
+                    menu_input = menu_input_event.input;
+                    source = menu_input_event.source;
+                    num_menu_inputs = 0;
+                    us_first_time = menu_input_event.us_time;
+                    us_max_wait = 0;
+                }
+                ++num_menu_inputs;
+                uint32_t us_wait = (uint32_t) us_current_time - menu_input_event.us_time;
+                us_max_wait = (us_wait > us_max_wait) ? us_wait : us_max_wait;
+
+                if((0 != (menu_input_event.flags & MENU_INPUT_FLAG_REPEAT)) && (false == is_waiting_for_repeats))
+                {
+                    is_waiting_for_repeats = true;
+                    us_batch_deadline = us_current_time + (MENU_MS_MIN_FRAME_PERIOD * 1000);
+                }
+
+                int64_t us_until_batch_deadline = us_batch_deadline - esp_timer_get_time();
+                if(us_until_batch_deadline <= 0)
+                {
+                    break;
+                }
+                ticks_to_wait = is_waiting_for_repeats ? pdMS_TO_TICKS(us_until_batch_deadline / 1000) : 0;
+            } while(true == receive_menu_input(
+                /* menu_input_event_t *menu_input_event = */ &menu_input_event,
+                /* TickType_t ticks_to_wait = */ ticks_to_wait));
+            react_to_menu_input_run(
+                /* MENU_INPUT_t menu_input = */ menu_input,
+                /* size_t num_menu_inputs = */ num_menu_inputs,
+                /* MENU_INPUT_SOURCE_t source = */ source,
+                /* uint32_t us_first_time = */ us_first_time,
+                /* uint32_t us_max_wait = */ us_max_wait);
+            notify_menu_changed();
         }
 
         // 29OCT2024: usStackDepth = 2048, uxTaskGetHighWaterMark = 356
@@ -295,62 +935,105 @@ void task_read_menu_input_queue()
     }
 }
 
-// ========================= //
-// MenuLine member functions //
-// ========================= //
+// Use non-member function, so the display is only ever written to from one task
+void task_render_menu()
+{
+    // Whether the display and its backlight are currently on
+    bool is_display_on = true;
+    // When the last frame was drawn
+    TickType_t ticks_last_frame = xTaskGetTickCount();
 
-MenuLine::MenuLine(
-    String arg_str_display,
-    String (*arg_func_to_str)(),
-    bool (*arg_func_on_up)(),
-    bool (*arg_func_on_confirm)(),
-    bool (*arg_func_on_down)())
-{
-    str_display = arg_str_display;
-    func_to_str = arg_func_to_str;
-    func_on_up = arg_func_on_up;
-    func_on_confirm = arg_func_on_confirm;
-    func_on_down = arg_func_on_down;
-}
+    // Tasks must be implemented to never return (i.e. continuous loop)
+    // https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-reference/system/freertos_idf.html
+    while(1)
+    {
+        // Wait for something shown on the menu to change, or for it to be time to refresh lines showing times
+        (void) ulTaskNotifyTake(
+            // Clear the notification count, many changes only need one frame
+            /* BaseType_t xClearCountOnExit = */ pdTRUE,
+            /* TickType_t xTicksToWait = */ pdMS_TO_TICKS(MENU_MS_AUTO_REFRESH_PERIOD));
 
-MENU_CONTROL MenuLine::react_to_menu_input(MENU_INPUT_t input)
-{
-    // Get the function to call based on the input received
-    // NOTE: can use hashmap instead of switch statement, ex. func_to_call = funcs[MENU_INPUT_UP]
-    bool (*func_to_call)() = nullptr;
-    switch(input)
-    {
-        case MENU_INPUT_UP:
-            func_to_call = func_on_up;
-            break;
-        case MENU_INPUT_DOWN:
-            func_to_call = func_on_down;
-            break;
-        case MENU_INPUT_CONFIRM:
-            func_to_call = func_on_confirm;
-            break;
-        default:
-            break;
+        // Do not draw frames closer together than MENU_MS_MIN_FRAME_PERIOD,
+        // changes that are notified while waiting are drawn in this same frame
+        TickType_t ticks_since_last_frame = xTaskGetTickCount() - ticks_last_frame;
+        if(ticks_since_last_frame < pdMS_TO_TICKS(MENU_MS_MIN_FRAME_PERIOD))
+        {
+            vTaskDelay(/* TickType_t xTicksToDelay = */ pdMS_TO_TICKS(MENU_MS_MIN_FRAME_PERIOD) - ticks_since_last_frame);
+            (void) ulTaskNotifyTake(
+                /* BaseType_t xClearCountOnExit = */ pdTRUE,
+                /* TickType_t xTicksToWait = */ 0);
+        }
+        ticks_last_frame = xTaskGetTickCount();
+
+        // Turn the display on or off if it was asked to
+        if(is_display_on != is_display_enabled)
+        {
+            is_display_on = is_display_enabled;
+            if(true == is_display_on)
+            {
+                display.set_display(/* bool is_on = */ true);
+                display.set_backlight(/* bool is_on = */ true);
+            }
+            else
+            {
+                display.set_display(/* bool is_on = */ false);
+                display.set_backlight(/* bool is_on = */ false);
+            }
+        }
+
+        // Only draw the menu if anyone can see it
+        if(true == is_display_on)
+        {
+            menu.update_display();
+        }
+
+        PRINT_STACK_USAGE();
     }
+}
+
+// ========================= //
+// MenuLine member functions //
+// ========================= //
 
-    // If there is not a function defined for this input, do nothing
-    if (nullptr == func_to_call)
+MENU_CONTROL MenuLine::react_to_menu_input(
+    MENU_INPUT_t input,
+    size_t num_inputs,
+    size_t *out_num_inputs_used) const
+{
+    // Get the function to call straight from the table, indexed by the input received
+    // If there is not a function defined for this input, give every input back to the menu
+    if((input >= MENU_INPUT_MAX) || (nullptr == funcs_on_input[input]))
     {
+        *out_num_inputs_used = 0;
         return MENU_CONTROL_RELEASE;
     }
 
-    // Call the function
-    return (*func_to_call)();
+    // Call the function, it uses every input unless it says otherwise
+    *out_num_inputs_used = num_inputs;
+    MENU_CONTROL control = (*funcs_on_input[input])(num_inputs, out_num_inputs_used);
+
+    // A function keeping control must use at least one input, or it would be called again with the same inputs forever
+    if(*out_num_inputs_used > num_inputs)
+    {
+        *out_num_inputs_used = num_inputs;
+    }
+    else if((MENU_CONTROL_KEEP == control) && (0 == *out_num_inputs_used))
+    {
+        *out_num_inputs_used = 1;
+    }
+    return control;
 }
 
-void MenuLine::get_str(String **arg_str)
+size_t MenuLine::get_str(
+    char *buf,
+    size_t num_buf_chars) const
 {
     // Only generate a new string if there's a function to do it
     if (nullptr != func_to_str)
     {
-        str_display = (*func_to_str)();
+        return (*func_to_str)(buf, num_buf_chars);
     }
-    *arg_str = &str_display;
+    return format_str(buf, num_buf_chars, str_display);
 }
 
 // ===================== //
@@ -358,50 +1041,70 @@ void MenuLine::get_str(String **arg_str)
 // ===================== //
 
 Menu::Menu(
-    MenuLine *arg_menu_lines,
+    StaticSemaphore_t *arg_mutex_buffer,
+    const MenuLine *arg_menu_lines,
     size_t arg_num_menu_lines)
 {
+    // Create mutex, open it for grabbing
+    mutex_handle = xSemaphoreCreateMutexStatic(/* pxMutexBuffer = */ arg_mutex_buffer);
+    assert(nullptr != mutex_handle);
+
     menu_lines = arg_menu_lines;
     num_menu_lines = arg_num_menu_lines;
     index_menu_item_hover = 0;
     is_menu_item_selected = false;
+    is_displayed_buffer_valid = false;
+    num_lcd_bytes_last_frame = 0;
 }
 
-void Menu::react_to_menu_input(MENU_INPUT_t menu_input)
+void Menu::react_to_menu_input(
+    MENU_INPUT_t menu_input,
+    size_t num_menu_inputs)
 {
-    // If a menu item is currently selected, use its handlers for button inputs
-    if(true == is_menu_item_selected)
-    {
-        // The menu line handler tells if after this button press, the menu should consume inputs again instead of the menu line
-        is_menu_item_selected = (MENU_CONTROL_KEEP == menu_lines[index_menu_item_hover].react_to_menu_input(menu_input));
-    }
-    else
+    MENU_LOCK(/* RET_VAL = */);
+
+    while(num_menu_inputs > 0)
     {
+        // If a menu item is currently selected, use its handlers for button inputs
+        if(true == is_menu_item_selected)
+        {
+            // The menu line handler gets every input left at once, so it can apply them together
+            // The menu line handler tells if after these button presses, the menu should consume inputs again instead of the menu line,
+            // and how many it used, the rest are handled as if they came after, by the menu if it gave control back
+            size_t num_inputs_used = 0;
+            is_menu_item_selected = (MENU_CONTROL_KEEP == menu_lines[index_menu_item_hover].react_to_menu_input(
+                /* MENU_INPUT_t input = */ menu_input,
+                /* size_t num_inputs = */ num_menu_inputs,
+                /* size_t *out_num_inputs_used = */ &num_inputs_used));
+            num_menu_inputs -= num_inputs_used;
+            continue;
+        }
+
         // This menu input goes to the menu, not a menu line
         switch(menu_input)
         {
             case MENU_INPUT_UP:
-                index_menu_item_hover = (index_menu_item_hover == 0) ? (num_menu_lines - 1) : (index_menu_item_hover - 1);
+                index_menu_item_hover = (index_menu_item_hover + num_menu_lines - (num_menu_inputs % num_menu_lines)) % num_menu_lines;
+                num_menu_inputs = 0;
                 break;
             case MENU_INPUT_CONFIRM:
+                // Any confirms after this one go to the menu line it selected
                 is_menu_item_selected = true;
+                --num_menu_inputs;
                 break;
             case MENU_INPUT_DOWN:
-                index_menu_item_hover = (index_menu_item_hover == (num_menu_lines - 1)) ? (0) : (index_menu_item_hover + 1);
+                index_menu_item_hover = (index_menu_item_hover + (num_menu_inputs % num_menu_lines)) % num_menu_lines;
+                num_menu_inputs = 0;
                 break;
             default:
+                num_menu_inputs = 0;
                 break;
         }
     }
 
-    // Update the display
-    // TODO: Don't update per every input?
-    //       If the inputs were really fast after one-another, their operations can be combined,
-    //       then the display is updated again to save the number of times the function is called.
-    update_display();
+    MENU_UNLOCK();
 }
 
-// TODO: Do it need to put a mutex lock around this? Altough seeing things glitch around would be pretty fun...
 void Menu::update_display()
 {
     // NOTE: There is a compiler check in menu.h to assert the display buffer is at least 1 line and 2 characters
@@ -417,7 +1120,13 @@ void Menu::update_display()
     // |   option C         |
     // |   option D         |
     // +--------------------+
-    String *menu_line_str = nullptr;
+#if PRINT && PRINT_DISPLAY_DIAGNOSTICS
+    // Generating a frame should never allocate from the heap, remember how much was free to check after
+    uint32_t num_heap_bytes_free = esp_get_free_heap_size();
+#endif // PRINT && PRINT_DISPLAY_DIAGNOSTICS
+
+    // Do not let inputs move the menu while this frame of it is being generated
+    MENU_LOCK(/* RET_VAL = */);
     size_t num_chars_written = 0;
     for(size_t line_num = 0; line_num < NUM_DISPLAY_LINES; ++line_num)
     {
@@ -431,17 +1140,10 @@ void Menu::update_display()
         display_buffer[num_chars_written] = ' ';
         ++num_chars_written;
 
-        // Get the menu line, as a string, at the top line + the line offset
-        menu_lines[(index_menu_item_hover + line_num) % num_menu_lines].get_str(/* char **arg_str = */ &menu_line_str);
-
-        // Copy the menu line to display_buffer
-        if(nullptr != menu_line_str)
-        {
-            menu_line_str->toCharArray(
-                /* char *buf = */ &(display_buffer[num_chars_written]),
-                /* unsigned int bufsize = */ sizeof(display_buffer) - num_chars_written);
-            num_chars_written += menu_line_str->length();
-        }
+        // Write the menu line at the top line + the line offset straight into display_buffer, in the rest of the line
+        num_chars_written += menu_lines[(index_menu_item_hover + line_num) % num_menu_lines].get_str(
+            /* char *buf = */ &(display_buffer[num_chars_written]),
+            /* size_t num_buf_chars = */ NUM_DISPLAY_CHARS_PER_LINE - 2);
 
         // End each line with a newline \n
         display_buffer[num_chars_written] = '\n';
@@ -451,33 +1153,59 @@ void Menu::update_display()
     // Set null terminating character
     display_buffer[num_chars_written] = '\0';
     ++num_chars_written;
+    MENU_UNLOCK();
+
+#if PRINT && PRINT_DISPLAY_DIAGNOSTICS
+    // NOTE: Another task allocating at the same time also shows up here, so only a change on every frame points at this code
+    s_print("Heap bytes used generating this frame: ");
+    s_println((int32_t) (num_heap_bytes_free - esp_get_free_heap_size()), DEC);
+#endif // PRINT && PRINT_DISPLAY_DIAGNOSTICS
 
     // -------------------------------------- //
     // Update display to match display buffer //
     // -------------------------------------- //
 
-    // Clear existing characters on display
-    display.clear();
-
-    // Update the display at each line to match display_buffer
-    // This display API requires newlines to instead be null terminating characters
-    // Use sliding window (one pointer on the left and one on the right to say where the string starts and ends)
+    // Only send the characters that changed since the last frame, instead of clearing and rewriting the whole display.
+    // Clearing makes the display flicker, and every character sent costs at least 4 bytes on the I2C bus.
+    // Use sliding window (one pointer on the left and one on the right to say where the line starts and ends)
+    num_lcd_bytes_last_frame = 0;
     for(size_t line_num = 0, left = 0, right = 0; line_num < NUM_DISPLAY_LINES; ++line_num)
     {
-        // Find the next newline, set it to null terminator
+        // Find the next newline, lines shorter than the display are padded with spaces
         for(right = left; '\n' != display_buffer[right]; ++right);
-        display_buffer[right] = '\0';
+        size_t num_line_chars = right - left;
 
-        // Update display line
-        display.setCursor(
-            /* int col = */ 0,
-            /* int row = */ line_num);
-        display.print(/* const char *c = */ &(display_buffer[left]));
+        // Find each run of changed characters in this line, and send it with one cursor move
+        display_run_t runs[NUM_DISPLAY_CHARS_PER_LINE];
+        size_t num_runs = display_diff_line(
+            /* const char *line = */ &(display_buffer[left]),
+            /* size_t num_line_chars = */ num_line_chars,
+            /* char *displayed_line = */ displayed_buffer[line_num],
+            /* size_t num_cols = */ NUM_DISPLAY_CHARS_PER_LINE,
+            /* bool is_displayed_line_valid = */ is_displayed_buffer_valid,
+            /* size_t max_gap_chars = */ NUM_DISPLAY_MAX_RUN_GAP_CHARS,
+            /* display_run_t *out_runs = */ runs);
+        for(size_t i = 0; i < num_runs; ++i)
+        {
+            display.write(
+                /* uint8_t col = */ runs[i].col,
+                /* uint8_t row = */ line_num,
+                /* const char *chars = */ &(displayed_buffer[line_num][runs[i].col]),
+                /* size_t num_chars = */ runs[i].num_chars);
+        }
+        num_lcd_bytes_last_frame += display_count_lcd_bytes(
+            /* const display_run_t *runs = */ runs,
+            /* size_t num_runs = */ num_runs);
 
-        // Get ready for next loop, undo modification
+        // Get ready for next loop
         left = right + 1;
-        display_buffer[right] = '\n';
     }
+    is_displayed_buffer_valid = true;
+
+#if PRINT && PRINT_DISPLAY_DIAGNOSTICS
+    s_print("LCD bytes (cursor moves and characters) written this frame: ");
+    s_println(num_lcd_bytes_last_frame, DEC);
+#endif // PRINT && PRINT_DISPLAY_DIAGNOSTICS
 
     // ------------------------------------- //
     // Send display buffer out over WiFi/TCP //
@@ -496,4 +1224,14 @@ void Menu::update_display()
 #if BLUETOOTH_ENABLED
     // TODO: write implementation
 #endif
+}
+
+void Menu::invalidate_display()
+{
+    is_displayed_buffer_valid = false;
+}
+
+size_t Menu::get_num_lcd_bytes_last_frame()
+{
+    return num_lcd_bytes_last_frame;
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+// Include custom pump API
+#include "pump.h"
+// Include FreeRTOS common header
+#include "freertos/FreeRTOS.h"
+// Include FreeRTOS task API
+#include "freertos/task.h"
+// Include custom debug macros and compile flags
+#include "flags.h"
+
+// ======================= //
+// Instantiate useful data //
+// ======================= //
+
+// The number of pumps set up, each took the next LEDC channel
+// NOTE: Pumps are set up while setting up, one at a time, so this is not locked
+static size_t num_pumps = 0;
+
+// ========================== //
+// Define Pump implementation //
+// ========================== //
+
+Pump::Pump()
+{
+    pin = GPIO_NUM_NC;
+    channel = (ledc_channel_t) (PUMP_FIRST_CHANNEL + PUMP_MAX_PUMPS);
+}
+
+bool Pump::init(gpio_num_t arg_pin)
+{
+    if(num_pumps >= PUMP_MAX_PUMPS)
+    {
+        s_println("No LEDC channel left for another pump");
+        return false;
+    }
+    pin = arg_pin;
+
+    // Set up the timer, every pump sharing it sets it up the same way
+    esp_err_t status = ESP_OK;
+    ledc_timer_config_t timer_config = {};
+    timer_config.speed_mode = PUMP_SPEED_MODE;
+    timer_config.duty_resolution = PUMP_DUTY_RESOLUTION;
+    timer_config.timer_num = PUMP_TIMER;
+    timer_config.freq_hz = PUMP_PWM_FREQ_HZ;
+    timer_config.clk_cfg = LEDC_AUTO_CLK;
+    ESP_ERROR_RETURN_FALSE_IF_FAILED(status, ledc_timer_config(/* const ledc_timer_config_t *timer_conf = */ &timer_config));
+
+    // Set up the channel, off
+    ledc_channel_config_t channel_config = {};
+    channel_config.gpio_num = pin;
+    channel_config.speed_mode = PUMP_SPEED_MODE;
+    channel_config.channel = (ledc_channel_t) (PUMP_FIRST_CHANNEL + num_pumps);
+    channel_config.intr_type = LEDC_INTR_DISABLE;
+    channel_config.timer_sel = PUMP_TIMER;
+    channel_config.duty = 0;
+    channel_config.hpoint = 0;
+    ESP_ERROR_RETURN_FALSE_IF_FAILED(status, ledc_channel_config(/* const ledc_channel_config_t *ledc_conf = */ &channel_config));
+    channel = channel_config.channel;
+    ++num_pumps;
+
+    // Install the fade service, once for every pump and servo
+    // NOTE: The fade service is already installed if a servo or another pump installed it, that is fine
+    status = ledc_fade_func_install(/* int intr_alloc_flags = */ 0);
+    if((ESP_OK != status) && (ESP_ERR_INVALID_STATE != status))
+    {
+        s_println("Failed to install the LEDC fade service for a pump");
+        return false;
+    }
+    return true;
+}
+
+bool Pump::run(
+    const pump_profile_t *profile,
+    uint32_t ms_run)
+{
+    if(channel >= (PUMP_FIRST_CHANNEL + PUMP_MAX_PUMPS))
+    {
+        return false;
+    }
+    ms_run = (ms_run < PUMP_MS_MAX_RUN) ? ms_run : PUMP_MS_MAX_RUN;
+    uint8_t duty_percent = (profile->duty_percent < 100) ? profile->duty_percent : 100;
+    uint32_t duty = (((uint32_t) 1 << PUMP_DUTY_BITS) * duty_percent) / 100;
+    uint32_t ms_soft_start = (profile->ms_soft_start < ms_run) ? profile->ms_soft_start : ms_run;
+
+    // Start from off, this also starts the output again after the last run stopped it
+    set_duty(/* uint32_t duty = */ 0);
+
+    // Ramp up in hardware, the fade runs on its own, so just wait out the run, and switch off at the end
+    if(0 == ms_soft_start)
+    {
+        set_duty(/* uint32_t duty = */ duty);
+    }
+    else if((ESP_OK != ledc_set_fade_with_time(
+            /* ledc_mode_t speed_mode = */ PUMP_SPEED_MODE,
+            /* ledc_channel_t channel = */ channel,
+            /* uint32_t target_duty = */ duty,
+            /* int max_fade_time_ms = */ (int) ms_soft_start)) ||
+        (ESP_OK != ledc_fade_start(
+            /* ledc_mode_t speed_mode = */ PUMP_SPEED_MODE,
+            /* ledc_channel_t channel = */ channel,
+            /* ledc_fade_mode_t fade_mode = */ LEDC_FADE_NO_WAIT)))
+    {
+        s_println("Failed to start a pump's soft start, starting it at full power");
+        set_duty(/* uint32_t duty = */ duty);
+    }
+    vTaskDelay(/* TickType_t xTicksToDelay = */ pdMS_TO_TICKS(ms_run));
+
+    // Stop the output, even if the soft start is still fading
+    (void) ledc_stop(
+        /* ledc_mode_t speed_mode = */ PUMP_SPEED_MODE,
+        /* ledc_channel_t channel = */ channel,
+        /* uint32_t idle_level = */ 0);
+    return true;
+}
+
+void Pump::set_duty(uint32_t duty)
+{
+    (void) ledc_set_duty(
+        /* ledc_mode_t speed_mode = */ PUMP_SPEED_MODE,
+        /* ledc_channel_t channel = */ channel,
+        /* uint32_t duty = */ duty);
+    (void) ledc_update_duty(
+        /* ledc_mode_t speed_mode = */ PUMP_SPEED_MODE,
+        /* ledc_channel_t channel = */ channel);
+}
\ No newline at end of file
@@ -0,0 +1,503 @@
+// Helpful resources:
+// 1. ESP-IDF v4.4 ADC API, see "ADC Continuous (DMA) Mode Driver" and "ADC Calibration".
+//    https://docs.espressif.com/projects/esp-idf/en/v4.4/esp32/api-reference/peripherals/adc.html
+// 2. ESP-IDF v4.4 ADC DMA example.
+//    https://github.com/espressif/esp-idf/blob/v4.4/examples/peripherals/adc/dma_read/main/adc_dma_example_main.c
+
+#include <string.h>
+
+// Include custom analog sensor API
+#include "sensor.h"
+// Include Arduino API, for timing analogRead()
+#include <Arduino.h>
+// Include ESP32 high resolution timer API
+#include "esp_timer.h"
+// Include custom debug macros and compile flags
+#include "flags.h"
+
+// ====================== //
+// Define timer callbacks //
+// ====================== //
+
+void timer_power_off_sensor(TimerHandle_t timer_handle)
+{
+    // If a burst is being taken, leave the sensor on, the burst restarts this timer when it is done
+    Sensor *sensor = (Sensor *) pvTimerGetTimerID(/* TimerHandle_t xTimer = */ timer_handle);
+    if(pdFALSE == xSemaphoreTake(/* xSemaphore = */ sensor->mutex_handle, /* xBlockTime = */ 0))
+    {
+        return;
+    }
+    sensor->power_off();
+    (void) xSemaphoreGive(/* xSemaphore = */ sensor->mutex_handle);
+}
+
+// ============================ //
+// Define Sensor implementation //
+// ============================ //
+
+Sensor::Sensor()
+{
+    mutex_handle = nullptr;
+    for(size_t i = 0; i < SENSOR_MAX_CHANNELS; ++i)
+    {
+        channels[i] = ADC1_CHANNEL_MAX;
+    }
+    num_channels = 0;
+    num_samples = 0;
+    reduction = SENSOR_REDUCTION_MEDIAN;
+    is_calibrated = false;
+    pin_power = GPIO_NUM_NC;
+    ms_warm_up = 0;
+    power_timer_handle = nullptr;
+    is_powered = true;
+    us_init = 0;
+    us_power_on = 0;
+    us_powered_before = 0;
+    num_power_windows = 0;
+    num_bursts = 0;
+    num_coalesced_reads = 0;
+    us_last_burst = 0;
+    for(size_t i = 0; i < SENSOR_MAX_CHANNELS; ++i)
+    {
+        last_readings[i] = {};
+    }
+}
+
+bool Sensor::init(
+    const gpio_num_t *pins,
+    size_t num_pins,
+    adc_atten_t atten,
+    size_t arg_num_samples,
+    SENSOR_REDUCTION_t arg_reduction,
+    bool arg_is_calibrated,
+    gpio_num_t arg_pin_power,
+    uint32_t arg_ms_warm_up)
+{
+    if((0 == num_pins) || (num_pins > SENSOR_MAX_CHANNELS))
+    {
+        s_println("Failed to set up the sensor, too many or too few pins");
+        return false;
+    }
+
+    // Find the ADC1 channel wired to each pin, continuous mode can't read ADC2
+    uint32_t channel_mask = 0;
+    num_channels = num_pins;
+    for(size_t i = 0; i < num_channels; ++i)
+    {
+        channels[i] = ADC1_CHANNEL_MAX;
+        for(int j = 0; j < ADC1_CHANNEL_MAX; ++j)
+        {
+            gpio_num_t pin_channel = GPIO_NUM_NC;
+            if((ESP_OK == adc1_pad_get_io_num(/* adc1_channel_t channel = */ (adc1_channel_t) j, /* gpio_num_t *gpio_num = */ &pin_channel)) &&
+                (pins[i] == pin_channel))
+            {
+                channels[i] = (adc1_channel_t) j;
+                break;
+            }
+        }
+        if(ADC1_CHANNEL_MAX == channels[i])
+        {
+            s_println("Failed to find an ADC1 channel for a sensor pin");
+            return false;
+        }
+        channel_mask |= (uint32_t) BIT(channels[i]);
+    }
+
+    num_samples = (arg_num_samples < 1) ? 1 : ((arg_num_samples > SENSOR_MAX_SAMPLES) ? SENSOR_MAX_SAMPLES : arg_num_samples);
+    reduction = arg_reduction;
+    is_calibrated = arg_is_calibrated;
+
+    // Create mutex, open it for grabbing
+    mutex_handle = xSemaphoreCreateMutex();
+    configASSERT(mutex_handle);
+
+    // Without a power pin, the sensor is always on, count it as one powered window since init()
+    pin_power = arg_pin_power;
+    ms_warm_up = arg_ms_warm_up;
+    us_init = esp_timer_get_time();
+    us_power_on = us_init;
+    is_powered = true;
+    num_power_windows = 1;
+    if(GPIO_NUM_NC != pin_power)
+    {
+        // Start with the sensor off, it is powered on by the first read()
+        (void) gpio_reset_pin(/* gpio_num_t gpio_num = */ pin_power);
+        (void) gpio_set_direction(/* gpio_num_t gpio_num = */ pin_power, /* gpio_mode_t mode = */ GPIO_MODE_OUTPUT);
+        (void) gpio_set_level(/* gpio_num_t gpio_num = */ pin_power, /* uint32_t level = */ 0);
+        is_powered = false;
+        num_power_windows = 0;
+
+        // Create the timer that powers the sensor off after it has not been read for as long as it takes to warm up,
+        // it is started by every burst
+        power_timer_handle = xTimerCreate(
+            /* const char *const pcTimerName = */ "power_sensor",
+            /* const TickType_t xTimerPeriodInTicks = */ (0 == pdMS_TO_TICKS(ms_warm_up)) ? 1 : pdMS_TO_TICKS(ms_warm_up),
+            // Only fire once per burst, another burst restarts the timer
+            /* const UBaseType_t uxAutoReload = */ pdFALSE,
+            /* void *const pvTimerID = */ this,
+            /* TimerCallbackFunction_t pxCallbackFunction = */ timer_power_off_sensor);
+        configASSERT(power_timer_handle);
+    }
+
+#if PRINT && PRINT_SENSOR_DIAGNOSTICS
+    // Time one analogRead() to compare read() against, it can't be called once the ADC is in continuous mode
+    int64_t us_start = esp_timer_get_time();
+    (void) analogRead(/* uint8_t pin = */ pins[0]);
+    s_print("Sensor analogRead() time (us): ");
+    s_println((uint32_t) (esp_timer_get_time() - us_start), DEC);
+#endif // PRINT && PRINT_SENSOR_DIAGNOSTICS
+
+    // Get the characteristics of this chip's ADC, to convert readings to millivolts
+    if(true == is_calibrated)
+    {
+        (void) esp_adc_cal_characterize(
+            /* adc_unit_t adc_num = */ ADC_UNIT_1,
+            /* adc_atten_t atten = */ atten,
+            /* adc_bits_width_t bit_width = */ ADC_WIDTH_BIT_12,
+            /* uint32_t default_vref = */ SENSOR_DEFAULT_MV_VREF,
+            /* esp_adc_cal_characteristics_t *chars = */ &adc_chars);
+    }
+
+    // Set up the continuous mode driver, with room for one burst from every pin in each DMA interrupt,
+    // and room for many bursts in its ring buffer, so captures keep up even when higher priority tasks run for a while
+    uint32_t num_burst_bytes = (uint32_t) (num_channels * num_samples * SENSOR_BYTES_PER_SAMPLE);
+    adc_digi_init_config_t init_config = {
+        .max_store_buf_size = SENSOR_NUM_RING_BUF_BURSTS * num_burst_bytes,
+        .conv_num_each_intr = num_burst_bytes,
+        .adc1_chan_mask = channel_mask,
+        .adc2_chan_mask = 0,
+    };
+    if(ESP_OK != adc_digi_initialize(/* const adc_digi_init_config_t *init_config = */ &init_config))
+    {
+        s_println("Failed to initialize the sensor ADC");
+        return false;
+    }
+
+    // Sample our channels in turn, as fast as allowed
+    adc_digi_pattern_config_t patterns[SENSOR_MAX_CHANNELS];
+    for(size_t i = 0; i < num_channels; ++i)
+    {
+        patterns[i] = {
+            .atten = (uint8_t) atten,
+            .channel = (uint8_t) channels[i],
+            .unit = 0,
+            .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+        };
+    }
+    adc_digi_configuration_t config = {
+        // NOTE: The ESP32 must limit the number of conversions, it stops converting when it reaches the limit
+        .conv_limit_en = 1,
+        .conv_limit_num = 250,
+        .pattern_num = (uint32_t) num_channels,
+        .adc_pattern = patterns,
+        .sample_freq_hz = SENSOR_SAMPLE_FREQ_HZ,
+        // NOTE: The ESP32 only supports continuous mode on ADC1
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+    };
+    if(ESP_OK != adc_digi_controller_configure(/* const adc_digi_configuration_t *config = */ &config))
+    {
+        s_println("Failed to configure the sensor ADC");
+        (void) adc_digi_deinitialize();
+        return false;
+    }
+    return true;
+}
+
+size_t Sensor::get_num_channels()
+{
+    return num_channels;
+}
+
+uint32_t Sensor::get_channel_sample_hz()
+{
+    return (0 == num_channels) ? 0 : (uint32_t) (SENSOR_SAMPLE_FREQ_HZ / num_channels);
+}
+
+bool Sensor::read(sensor_reading_t *out_readings)
+{
+    if(nullptr == mutex_handle)
+    {
+        return false;
+    }
+    // Wait for another task's burst, but not for a capture, the caller can use its last reading instead of stalling
+    int64_t us_asked = esp_timer_get_time();
+    if(pdFALSE == xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ pdMS_TO_TICKS(ms_warm_up + SENSOR_MS_LOCK_TIMEOUT)))
+    {
+        return false;
+    }
+
+    // If another task took a burst that started after this was asked for, while this waited for it, its result is as new
+    if(us_last_burst >= us_asked)
+    {
+        memcpy(out_readings, last_readings, num_channels * sizeof(*out_readings));
+        ++num_coalesced_reads;
+        (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+        return true;
+    }
+
+    // Power the sensor on, if it is not still on from the last burst
+    us_last_burst = esp_timer_get_time();
+    ++num_bursts;
+    start_adc();
+
+    // Let the ADC fill the DMA buffer while this task blocks, until there are enough samples from every pin
+    size_t num_captured[SENSOR_MAX_CHANNELS] = {};
+    size_t num_full = 0;
+    while(num_full < num_channels)
+    {
+        bool is_overrun = false;
+        uint32_t num_bytes = read_dma(
+            /* uint32_t max_bytes = */ (uint32_t) (num_channels * num_samples * SENSOR_BYTES_PER_SAMPLE),
+            /* uint32_t ms_timeout = */ SENSOR_MS_READ_TIMEOUT,
+            /* bool *out_is_overrun = */ &is_overrun);
+        if(0 == num_bytes)
+        {
+            break;
+        }
+        for(uint32_t offset = 0; (offset + SENSOR_BYTES_PER_SAMPLE) <= num_bytes; offset += SENSOR_BYTES_PER_SAMPLE)
+        {
+            uint16_t sample = 0;
+            size_t index = get_sample_index(/* uint32_t offset = */ offset, /* uint16_t *out_sample = */ &sample);
+            if((index >= num_channels) || (num_captured[index] >= num_samples))
+            {
+                continue;
+            }
+            samples[index][num_captured[index]] = sample;
+            ++num_captured[index];
+            if(num_samples == num_captured[index])
+            {
+                ++num_full;
+            }
+        }
+    }
+    stop_adc();
+
+    size_t num_captured_total = 0;
+    for(size_t i = 0; i < num_channels; ++i)
+    {
+        num_captured_total += num_captured[i];
+    }
+    if(0 == num_captured_total)
+    {
+        // Do not hand out a stale result to readers waiting on this burst
+        us_last_burst = 0;
+        (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+        return false;
+    }
+
+#if PRINT && PRINT_SENSOR_DIAGNOSTICS
+    int64_t us_start = esp_timer_get_time();
+#endif // PRINT && PRINT_SENSOR_DIAGNOSTICS
+
+    for(size_t i = 0; i < num_channels; ++i)
+    {
+        reduce(
+            /* size_t index = */ i,
+            /* size_t num_captured = */ num_captured[i],
+            /* sensor_reading_t *out_reading = */ &out_readings[i]);
+    }
+    memcpy(last_readings, out_readings, num_channels * sizeof(*out_readings));
+
+#if PRINT && PRINT_SENSOR_DIAGNOSTICS
+    uint32_t us_reduce = (uint32_t) (esp_timer_get_time() - us_start);
+    for(size_t i = 0; i < num_channels; ++i)
+    {
+        s_print("Sensor ");
+        s_print(i, DEC);
+        s_print(" value: ");
+        s_print(out_readings[i].value, DEC);
+        s_print(", noise: ");
+        s_print(out_readings[i].noise, DEC);
+        s_print(", mV: ");
+        s_print(out_readings[i].mv, DEC);
+        s_print(", samples: ");
+        s_println(out_readings[i].num_samples, DEC);
+    }
+    s_print("Sensor CPU time (us): ");
+    s_println(us_reduce, DEC);
+#endif // PRINT && PRINT_SENSOR_DIAGNOSTICS
+
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+    return true;
+}
+
+bool Sensor::start_capture(uint32_t ms_timeout)
+{
+    if((nullptr == mutex_handle) ||
+        (pdFALSE == xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ pdMS_TO_TICKS(ms_timeout))))
+    {
+        return false;
+    }
+    start_adc();
+    return true;
+}
+
+size_t Sensor::read_capture(
+    size_t index,
+    uint16_t *out_samples,
+    size_t max_samples,
+    uint32_t ms_timeout,
+    bool *out_is_overrun)
+{
+    // Read as many samples from every pin as are wanted from the one at index, they are interleaved
+    max_samples = (max_samples < SENSOR_MAX_SAMPLES) ? max_samples : SENSOR_MAX_SAMPLES;
+    uint32_t num_bytes = read_dma(
+        /* uint32_t max_bytes = */ (uint32_t) (num_channels * max_samples * SENSOR_BYTES_PER_SAMPLE),
+        /* uint32_t ms_timeout = */ ms_timeout,
+        /* bool *out_is_overrun = */ out_is_overrun);
+
+    size_t num_copied = 0;
+    for(uint32_t offset = 0; ((offset + SENSOR_BYTES_PER_SAMPLE) <= num_bytes) && (num_copied < max_samples); offset += SENSOR_BYTES_PER_SAMPLE)
+    {
+        uint16_t sample = 0;
+        if(index == get_sample_index(/* uint32_t offset = */ offset, /* uint16_t *out_sample = */ &sample))
+        {
+            out_samples[num_copied] = sample;
+            ++num_copied;
+        }
+    }
+    return num_copied;
+}
+
+void Sensor::stop_capture()
+{
+    stop_adc();
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+}
+
+void Sensor::start_adc()
+{
+    // Power the sensor on, if it is not still on from the last burst
+    power_on();
+
+    // Throw away samples captured after the last burst was taken, they are from before this was asked for
+    uint32_t num_bytes = 0;
+    while(ESP_OK == adc_digi_read_bytes(
+        /* uint8_t *buf = */ dma_buf,
+        /* uint32_t length_max = */ sizeof(dma_buf),
+        /* uint32_t *out_length = */ &num_bytes,
+        /* uint32_t timeout_ms = */ 0))
+    {
+    }
+
+    (void) adc_digi_start();
+}
+
+void Sensor::stop_adc()
+{
+    (void) adc_digi_stop();
+
+    // Power the sensor off once it has not been read for as long as it takes to warm up,
+    // if it is read again before then, staying on costs less than warming up again
+    if(nullptr != power_timer_handle)
+    {
+        (void) xTimerReset(
+            /* TimerHandle_t xTimer = */ power_timer_handle,
+            /* TickType_t xTicksToWait = */ 0);
+    }
+}
+
+uint32_t Sensor::read_dma(
+    uint32_t max_bytes,
+    uint32_t ms_timeout,
+    bool *out_is_overrun)
+{
+    // NOTE: ESP_ERR_INVALID_STATE means the driver's ring buffer filled up and dropped samples,
+    //       what was read is still good
+    uint32_t num_bytes = 0;
+    max_bytes = (max_bytes < sizeof(dma_buf)) ? max_bytes : (uint32_t) sizeof(dma_buf);
+    esp_err_t err = adc_digi_read_bytes(
+        /* uint8_t *buf = */ dma_buf,
+        /* uint32_t length_max = */ max_bytes,
+        /* uint32_t *out_length = */ &num_bytes,
+        /* uint32_t timeout_ms = */ ms_timeout);
+    *out_is_overrun = (ESP_ERR_INVALID_STATE == err);
+    if((ESP_OK != err) && (ESP_ERR_INVALID_STATE != err))
+    {
+        return 0;
+    }
+    return num_bytes;
+}
+
+size_t Sensor::get_sample_index(
+    uint32_t offset,
+    uint16_t *out_sample)
+{
+    // Every sample is tagged with the channel it was taken from, so samples can be split by pin whatever order they come in
+    adc_digi_output_data_t *output = (adc_digi_output_data_t *) &dma_buf[offset];
+    *out_sample = output->type1.data;
+    for(size_t i = 0; i < num_channels; ++i)
+    {
+        if(channels[i] == output->type1.channel)
+        {
+            return i;
+        }
+    }
+    return num_channels;
+}
+
+void Sensor::get_power_stats(sensor_power_stats_t *out_stats)
+{
+    if((nullptr == mutex_handle) ||
+        (pdFALSE == xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ pdMS_TO_TICKS(ms_warm_up + SENSOR_MS_LOCK_TIMEOUT))))
+    {
+        *out_stats = {};
+        return;
+    }
+    int64_t us_now = esp_timer_get_time();
+    out_stats->us_powered = us_powered_before + ((true == is_powered) ? (uint64_t) (us_now - us_power_on) : 0);
+    out_stats->us_since_init = (uint64_t) (us_now - us_init);
+    out_stats->num_power_windows = num_power_windows;
+    out_stats->num_bursts = num_bursts;
+    out_stats->num_coalesced_reads = num_coalesced_reads;
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+}
+
+void Sensor::power_on()
+{
+    if(true == is_powered)
+    {
+        return;
+    }
+    (void) gpio_set_level(/* gpio_num_t gpio_num = */ pin_power, /* uint32_t level = */ 1);
+    us_power_on = esp_timer_get_time();
+    is_powered = true;
+    ++num_power_windows;
+    vTaskDelay(/* TickType_t xTicksToDelay = */ pdMS_TO_TICKS(ms_warm_up));
+}
+
+void Sensor::power_off()
+{
+    // A sensor without a power pin is always on
+    if((false == is_powered) || (GPIO_NUM_NC == pin_power))
+    {
+        return;
+    }
+    (void) gpio_set_level(/* gpio_num_t gpio_num = */ pin_power, /* uint32_t level = */ 0);
+    us_powered_before += (uint64_t) (esp_timer_get_time() - us_power_on);
+    is_powered = false;
+}
+
+void Sensor::reduce(
+    size_t index,
+    size_t num_captured,
+    sensor_reading_t *out_reading)
+{
+    if(0 == num_captured)
+    {
+        *out_reading = {};
+        return;
+    }
+
+    sensor_reduce_samples(
+        /* uint16_t *samples = */ samples[index],
+        /* size_t num_samples = */ num_captured,
+        /* SENSOR_REDUCTION_t reduction = */ reduction,
+        /* uint16_t *out_value = */ &(out_reading->value),
+        /* uint16_t *out_noise = */ &(out_reading->noise));
+    out_reading->mv = (true == is_calibrated) ?
+        esp_adc_cal_raw_to_voltage(/* uint32_t adc_reading = */ out_reading->value, /* const esp_adc_cal_characteristics_t *chars = */ &adc_chars) :
+        0;
+    out_reading->num_samples = (uint32_t) num_captured;
+}
\ No newline at end of file
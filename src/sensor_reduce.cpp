@@ -0,0 +1,41 @@
+// Include standard sorting algorithms
+#include <algorithm>
+
+// Include custom sample reduction API
+#include "sensor_reduce.h"
+
+void sensor_reduce_samples(
+    uint16_t *samples,
+    size_t num_samples,
+    SENSOR_REDUCTION_t reduction,
+    uint16_t *out_value,
+    uint16_t *out_noise)
+{
+    // Sort the samples, the median, quartiles, and trimmed mean all come from their order
+    std::sort(samples, samples + num_samples);
+    size_t index_q1 = num_samples / 4;
+    size_t index_q3 = (3 * num_samples) / 4;
+    index_q3 = (index_q3 < num_samples) ? index_q3 : (num_samples - 1);
+
+    if(SENSOR_REDUCTION_TRIMMED_MEAN == reduction)
+    {
+        // Average the middle half, dropping the lowest and highest quarter as outliers
+        size_t index_end = num_samples - index_q1;
+        uint32_t sum = 0;
+        for(size_t i = index_q1; i < index_end; ++i)
+        {
+            sum += samples[i];
+        }
+        size_t num_summed = index_end - index_q1;
+        *out_value = (uint16_t) ((sum + (num_summed / 2)) / num_summed);
+    }
+    else
+    {
+        // Take the middle sample, or round the middle two together
+        size_t index_mid = num_samples / 2;
+        *out_value = (0 != (num_samples % 2)) ?
+            samples[index_mid] :
+            (uint16_t) ((samples[index_mid - 1] + samples[index_mid] + 1) / 2);
+    }
+    *out_noise = (uint16_t) ((samples[index_q3] - samples[index_q1]) / 2);
+}
\ No newline at end of file
@@ -0,0 +1,360 @@
+// Helpful resources:
+// 1. ESP-IDF v4.4 LEDC API, see "Change PWM Duty Cycle using Hardware" and "ledc_cb_register".
+//    https://docs.espressif.com/projects/esp-idf/en/v4.4/esp32/api-reference/peripherals/ledc.html
+// 2. ESP-IDF v4.4 LEDC fade example.
+//    https://github.com/espressif/esp-idf/blob/v4.4/examples/peripherals/ledc/ledc_fade/main/ledc_fade_example_main.c
+
+// Include custom servo motor API
+#include "servo.h"
+// Include ESP32 high resolution timer API
+#include "esp_timer.h"
+// Include custom debug macros and compile flags
+#include "flags.h"
+
+// ========================= //
+// Define interrupt handlers //
+// ========================= //
+
+// IRAM_ATTR puts this function in internal RAM instead of flash memory, so it can run while the flash cache is disabled
+bool IRAM_ATTR isr_servo_fade_end(
+    const ledc_cb_param_t *param,
+    void *user_arg)
+{
+    if(LEDC_FADE_END_EVT != param->event)
+    {
+        return false;
+    }
+
+    // xSemaphoreGiveFromISR() will set *pxHigherPriorityTaskWoken to pdTRUE if the waiting task has a higher priority than the interrupted one,
+    // returning that asks the LEDC driver to switch to it before the interrupt is exited
+    ServoMotor *servo = (ServoMotor *) user_arg;
+    BaseType_t is_higher_priority_task_woken = pdFALSE;
+    (void) xSemaphoreGiveFromISR(
+        /* SemaphoreHandle_t xSemaphore = */ servo->fade_done_semaphore_handle,
+        /* BaseType_t *pxHigherPriorityTaskWoken = */ &is_higher_priority_task_woken);
+    return pdTRUE == is_higher_priority_task_woken;
+}
+
+// ================================ //
+// Define ServoMotor implementation //
+// ================================ //
+
+ServoMotor::ServoMotor()
+{
+    scheduler = nullptr;
+    pin = GPIO_NUM_NC;
+    timer = LEDC_TIMER_0;
+    channel = LEDC_CHANNEL_0;
+    fade_done_semaphore_handle = nullptr;
+    is_attached = false;
+    angle = 0;
+    stats = {};
+}
+
+bool ServoMotor::init(
+    gpio_num_t arg_pin,
+    ledc_timer_t arg_timer,
+    ledc_channel_t arg_channel,
+    ServoScheduler *arg_scheduler)
+{
+    scheduler = arg_scheduler;
+    pin = arg_pin;
+    timer = arg_timer;
+    channel = arg_channel;
+
+    // Create the semaphore the fade-end interrupt gives, from static memory
+    fade_done_semaphore_handle = xSemaphoreCreateBinaryStatic(/* StaticSemaphore_t *pxSemaphoreBuffer = */ &fade_done_semaphore_buffer);
+    configASSERT(fade_done_semaphore_handle);
+
+    // Set up the timer, every servo sharing it sets it up the same way
+    esp_err_t status = ESP_OK;
+    ledc_timer_config_t timer_config = {};
+    timer_config.speed_mode = SERVO_SPEED_MODE;
+    timer_config.duty_resolution = SERVO_DUTY_RESOLUTION;
+    timer_config.timer_num = timer;
+    timer_config.freq_hz = SERVO_PWM_FREQ_HZ;
+    timer_config.clk_cfg = LEDC_AUTO_CLK;
+    ESP_ERROR_RETURN_FALSE_IF_FAILED(status, ledc_timer_config(/* const ledc_timer_config_t *timer_conf = */ &timer_config));
+
+    // Set up the channel, then stop its pulses until the first squirt
+    ledc_channel_config_t channel_config = {};
+    channel_config.gpio_num = pin;
+    channel_config.speed_mode = SERVO_SPEED_MODE;
+    channel_config.channel = channel;
+    channel_config.intr_type = LEDC_INTR_DISABLE;
+    channel_config.timer_sel = timer;
+    channel_config.duty = 0;
+    channel_config.hpoint = 0;
+    ESP_ERROR_RETURN_FALSE_IF_FAILED(status, ledc_channel_config(/* const ledc_channel_config_t *ledc_conf = */ &channel_config));
+    (void) ledc_stop(
+        /* ledc_mode_t speed_mode = */ SERVO_SPEED_MODE,
+        /* ledc_channel_t channel = */ channel,
+        /* uint32_t idle_level = */ 0);
+    is_attached = false;
+
+    // Install the fade service, once for every servo, then have it tell this servo when its fades end
+    // NOTE: The fade service is already installed if another servo installed it, that is fine
+    status = ledc_fade_func_install(/* int intr_alloc_flags = */ 0);
+    if((ESP_OK != status) && (ESP_ERR_INVALID_STATE != status))
+    {
+        s_println("Failed to install the LEDC fade service for a servo");
+        return false;
+    }
+    ledc_cbs_t callbacks = {};
+    callbacks.fade_cb = isr_servo_fade_end;
+    ESP_ERROR_RETURN_FALSE_IF_FAILED(status, ledc_cb_register(
+        /* ledc_mode_t speed_mode = */ SERVO_SPEED_MODE,
+        /* ledc_channel_t channel = */ channel,
+        /* ledc_cbs_t *cbs = */ &callbacks,
+        /* void *user_arg = */ this));
+    return true;
+}
+
+bool ServoMotor::squirt(const servo_profile_t *profile)
+{
+    int64_t us_start = esp_timer_get_time();
+
+    // Wait for the budget to have room for this servo to squeeze, it is held through the hold, until the release is done,
+    // a servo pushing against what it squeezes draws nearly as much as one moving
+    if(nullptr != scheduler)
+    {
+        scheduler->start_squeeze();
+    }
+
+    // Squeeze, hold, release, then rest, stopping early if a move fails, the servo is sent back to rest either way
+    attach(/* uint8_t angle = */ profile->angle_rest);
+    bool is_done = move(/* uint8_t angle = */ profile->angle_squeeze, /* uint32_t ms_fade = */ profile->ms_squeeze);
+    if(true == is_done)
+    {
+        vTaskDelay(/* TickType_t xTicksToDelay = */ pdMS_TO_TICKS(profile->ms_hold));
+    }
+    is_done &= move(/* uint8_t angle = */ profile->angle_rest, /* uint32_t ms_fade = */ profile->ms_release);
+    if(nullptr != scheduler)
+    {
+        scheduler->end_squeeze();
+    }
+    vTaskDelay(/* TickType_t xTicksToDelay = */ pdMS_TO_TICKS(profile->ms_rest));
+
+    // Publish how long it took
+    uint32_t us_squirt = (uint32_t) (esp_timer_get_time() - us_start);
+    ++stats.num_squirts;
+    stats.us_last_squirt = us_squirt;
+    stats.us_squirts += us_squirt;
+    stats_snapshot.store(/* const servo_stats_t *new_value = */ &stats);
+    return is_done;
+}
+
+void ServoMotor::detach()
+{
+    if(false == is_attached)
+    {
+        return;
+    }
+    (void) ledc_stop(
+        /* ledc_mode_t speed_mode = */ SERVO_SPEED_MODE,
+        /* ledc_channel_t channel = */ channel,
+        /* uint32_t idle_level = */ 0);
+    is_attached = false;
+}
+
+void ServoMotor::get_stats(servo_stats_t *out_stats)
+{
+    (void) stats_snapshot.load(/* servo_stats_t *out_value = */ out_stats);
+}
+
+void ServoMotor::attach(uint8_t arg_angle)
+{
+    if(true == is_attached)
+    {
+        return;
+    }
+
+    // Setting the duty starts the pulses again
+    // NOTE: The servo is assumed to still be at rest, where it was detached, so it does not jump when the pulses start
+    angle = arg_angle;
+    (void) ledc_set_duty(
+        /* ledc_mode_t speed_mode = */ SERVO_SPEED_MODE,
+        /* ledc_channel_t channel = */ channel,
+        /* uint32_t duty = */ get_duty(/* uint8_t angle = */ angle));
+    (void) ledc_update_duty(
+        /* ledc_mode_t speed_mode = */ SERVO_SPEED_MODE,
+        /* ledc_channel_t channel = */ channel);
+    is_attached = true;
+    ++stats.num_attaches;
+}
+
+bool ServoMotor::move(
+    uint8_t arg_angle,
+    uint32_t ms_fade)
+{
+    ms_fade = (ms_fade < SERVO_MS_MIN_FADE) ? SERVO_MS_MIN_FADE : ms_fade;
+
+    // A fade to where the servo already is would never step, so it may never end, wait it out instead
+    uint32_t duty = get_duty(/* uint8_t angle = */ arg_angle);
+    if(duty == get_duty(/* uint8_t angle = */ angle))
+    {
+        vTaskDelay(/* TickType_t xTicksToDelay = */ pdMS_TO_TICKS(ms_fade));
+        return true;
+    }
+
+    // Clear a fade end left over from a move that timed out, then start the fade, and wait for it to end
+    (void) xSemaphoreTake(/* xSemaphore = */ fade_done_semaphore_handle, /* xBlockTime = */ 0);
+    angle = arg_angle;
+    bool is_done = true;
+    if((ESP_OK != ledc_set_fade_with_time(
+            /* ledc_mode_t speed_mode = */ SERVO_SPEED_MODE,
+            /* ledc_channel_t channel = */ channel,
+            /* uint32_t target_duty = */ duty,
+            /* int max_fade_time_ms = */ (int) ms_fade)) ||
+        (ESP_OK != ledc_fade_start(
+            /* ledc_mode_t speed_mode = */ SERVO_SPEED_MODE,
+            /* ledc_channel_t channel = */ channel,
+            /* ledc_fade_mode_t fade_mode = */ LEDC_FADE_NO_WAIT)))
+    {
+        s_println("Failed to start a servo fade");
+        is_done = false;
+    }
+    else if(pdFALSE == xSemaphoreTake(
+        /* xSemaphore = */ fade_done_semaphore_handle,
+        /* xBlockTime = */ pdMS_TO_TICKS(ms_fade + SERVO_MS_FADE_TIMEOUT_MARGIN)))
+    {
+        ++stats.num_fade_timeouts;
+        is_done = false;
+    }
+    return is_done;
+}
+
+uint32_t ServoMotor::get_duty(uint8_t arg_angle)
+{
+    // Map the angle to a pulse width, then the pulse width to a share of the PWM period
+    arg_angle = (arg_angle > SERVO_MAX_ANGLE) ? SERVO_MAX_ANGLE : arg_angle;
+    uint32_t us_pulse = SERVO_US_MIN_PULSE + (((uint32_t) arg_angle * (SERVO_US_MAX_PULSE - SERVO_US_MIN_PULSE)) / SERVO_MAX_ANGLE);
+    return (us_pulse << SERVO_DUTY_BITS) / (1000000 / SERVO_PWM_FREQ_HZ);
+}
+
+// ==================================== //
+// Define ServoScheduler implementation //
+// ==================================== //
+
+ServoScheduler::ServoScheduler(
+    uint8_t max_moving,
+    uint32_t ms_stagger)
+{
+    num_servos = 0;
+    servo_budget_init(
+        /* servo_budget_t *budget = */ &budget,
+        /* uint8_t max_moving = */ max_moving,
+        /* uint32_t ms_stagger = */ ms_stagger);
+    stats = {};
+
+    // Create the mutex, and the semaphore counting room in the budget, from static memory
+    mutex_handle = xSemaphoreCreateMutexStatic(/* StaticSemaphore_t *pxMutexBuffer = */ &mutex_buffer);
+    configASSERT(mutex_handle);
+    room_semaphore_handle = xSemaphoreCreateCountingStatic(
+        /* UBaseType_t uxMaxCount = */ budget.max_moving,
+        /* UBaseType_t uxInitialCount = */ budget.max_moving,
+        /* StaticSemaphore_t *pxSemaphoreBuffer = */ &room_semaphore_buffer);
+    configASSERT(room_semaphore_handle);
+}
+
+size_t ServoScheduler::add_servo(gpio_num_t pin)
+{
+    // NOTE: Servos are added while setting up, before any are squirted, so this does not lock
+    if(num_servos >= SERVO_SCHEDULER_MAX_SERVOS)
+    {
+        s_println("No LEDC channel left for another servo");
+        return SERVO_SCHEDULER_MAX_SERVOS;
+    }
+    if(false == servos[num_servos].init(
+        /* gpio_num_t arg_pin = */ pin,
+        /* ledc_timer_t arg_timer = */ SERVO_SCHEDULER_TIMER,
+        /* ledc_channel_t arg_channel = */ (ledc_channel_t) (SERVO_SCHEDULER_FIRST_CHANNEL + num_servos),
+        /* ServoScheduler *arg_scheduler = */ this))
+    {
+        return SERVO_SCHEDULER_MAX_SERVOS;
+    }
+    return num_servos++;
+}
+
+bool ServoScheduler::squirt(
+    size_t index,
+    const servo_profile_t *profile)
+{
+    if(index >= num_servos)
+    {
+        return false;
+    }
+    return servos[index].squirt(/* const servo_profile_t *profile = */ profile);
+}
+
+void ServoScheduler::detach(size_t index)
+{
+    if(index < num_servos)
+    {
+        servos[index].detach();
+    }
+}
+
+void ServoScheduler::get_servo_stats(
+    size_t index,
+    servo_stats_t *out_stats)
+{
+    if(index >= num_servos)
+    {
+        *out_stats = {};
+        return;
+    }
+    servos[index].get_stats(/* servo_stats_t *out_stats = */ out_stats);
+}
+
+void ServoScheduler::get_stats(servo_scheduler_stats_t *out_stats)
+{
+    (void) xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY);
+    *out_stats = stats;
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+}
+
+void ServoScheduler::start_squeeze()
+{
+    int64_t us_wait_start = esp_timer_get_time();
+
+    // Wait for room in the budget, squeezes waiting for room are let in in the order they came, by priority
+    bool is_budget_wait = (pdFALSE == xSemaphoreTake(/* xSemaphore = */ room_semaphore_handle, /* xBlockTime = */ 0));
+    if(true == is_budget_wait)
+    {
+        (void) xSemaphoreTake(/* xSemaphore = */ room_semaphore_handle, /* xBlockTime = */ portMAX_DELAY);
+    }
+
+    // Then wait out the stagger after the last start, another squeeze let in at the same time may start first
+    bool is_stagger_wait = false;
+    while(1)
+    {
+        (void) xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY);
+        int64_t us_now = esp_timer_get_time();
+        int64_t us_wait = servo_budget_try_start(/* servo_budget_t *budget = */ &budget, /* int64_t us_now = */ us_now);
+        if(0 == us_wait)
+        {
+            ++stats.num_moves;
+            stats.num_budget_waits += (true == is_budget_wait) ? 1 : 0;
+            stats.num_stagger_waits += (true == is_stagger_wait) ? 1 : 0;
+            stats.us_waited += (uint64_t) (us_now - us_wait_start);
+            stats.max_moving_seen = (budget.num_moving > stats.max_moving_seen) ? budget.num_moving : stats.max_moving_seen;
+            (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+            return;
+        }
+        (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+
+        // The room semaphore keeps the budget from being full here, but wait a tick rather than spin if it ever is
+        TickType_t ticks_wait = (us_wait < 0) ? 1 : pdMS_TO_TICKS((us_wait + 999) / 1000);
+        vTaskDelay(/* TickType_t xTicksToDelay = */ (0 == ticks_wait) ? 1 : ticks_wait);
+        is_stagger_wait = true;
+    }
+}
+
+void ServoScheduler::end_squeeze()
+{
+    (void) xSemaphoreTake(/* xSemaphore = */ mutex_handle, /* xBlockTime = */ portMAX_DELAY);
+    servo_budget_end(/* servo_budget_t *budget = */ &budget);
+    (void) xSemaphoreGive(/* xSemaphore = */ mutex_handle);
+    (void) xSemaphoreGive(/* xSemaphore = */ room_semaphore_handle);
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+// Include custom servo budget API
+#include "servo_budget.h"
+
+void servo_budget_init(
+    servo_budget_t *budget,
+    uint8_t max_moving,
+    uint32_t ms_stagger)
+{
+    budget->max_moving = (0 == max_moving) ? 1 : max_moving;
+    budget->us_stagger = (int64_t) ms_stagger * 1000;
+    budget->num_moving = 0;
+    budget->us_last_start = 0;
+    budget->is_started = false;
+}
+
+int64_t servo_budget_try_start(
+    servo_budget_t *budget,
+    int64_t us_now)
+{
+    if(budget->num_moving >= budget->max_moving)
+    {
+        return SERVO_BUDGET_FULL;
+    }
+
+    // Space starts out, that is when a servo draws the most current
+    if(true == budget->is_started)
+    {
+        int64_t us_start = budget->us_last_start + budget->us_stagger;
+        if(us_start > us_now)
+        {
+            return us_start - us_now;
+        }
+    }
+    ++budget->num_moving;
+    budget->us_last_start = us_now;
+    budget->is_started = true;
+    return 0;
+}
+
+void servo_budget_end(servo_budget_t *budget)
+{
+    budget->num_moving = (0 == budget->num_moving) ? 0 : (budget->num_moving - 1);
+}
\ No newline at end of file
@@ -5,17 +5,21 @@
 
 // Include FreeRTOS task API
 #include "freertos/task.h"
+// Include FreeRTOS semaphore API
+#include "freertos/semphr.h"
 // Include light-weight IP socket API
 #include "lwip/sockets.h"
 // Include custom Menu class implementation
 #include "menu.h"
+// Include ESP32 high resolution timer API
+#include "esp_timer.h"
 
 // ====================================== //
 // Define useful constants and data types //
 // ====================================== //
 
 // Define the number of currently supported TCP commands
-#define NUM_TCP_COMMANDS 3
+#define NUM_TCP_COMMANDS 12
 
 // Define, when receiving a TCP packet, what special strings should cause what actions
 typedef struct tcp_command_s {
@@ -37,25 +41,73 @@ const tcp_command_t tcp_commands[NUM_TCP_COMMANDS] = {
         .command = "up",
         .action = []() { add_to_menu_input_queue(
             /* MENU_INPUT_t menu_input = */ MENU_INPUT_UP,
+            /* MENU_INPUT_SOURCE_t source = */ MENU_INPUT_SOURCE_TCP,
+            /* bool is_repeat = */ false,
+            /* int64_t us_time = */ esp_timer_get_time(),
             /* bool from_isr = */ false); },
     },
     {
         .command = "down",
         .action = []() { add_to_menu_input_queue(
             /* MENU_INPUT_t menu_input = */ MENU_INPUT_DOWN,
+            /* MENU_INPUT_SOURCE_t source = */ MENU_INPUT_SOURCE_TCP,
+            /* bool is_repeat = */ false,
+            /* int64_t us_time = */ esp_timer_get_time(),
             /* bool from_isr = */ false); },
     },
     {
         .command = "confirm",
         .action = []() { add_to_menu_input_queue(
             /* MENU_INPUT_t menu_input = */ MENU_INPUT_CONFIRM,
+            /* MENU_INPUT_SOURCE_t source = */ MENU_INPUT_SOURCE_TCP,
+            /* bool is_repeat = */ false,
+            /* int64_t us_time = */ esp_timer_get_time(),
             /* bool from_isr = */ false); },
     },
+    {
+        .command = "zone",
+        .action = []() { show_next_zone(); },
+    },
+    {
+        .command = "water",
+        .action = []() { water_now(); },
+    },
+    {
+        .command = "soak",
+        .action = []() { send_soak_curve(); },
+    },
+    {
+        .command = "probe",
+        .action = []() { send_probe_stats(); },
+    },
+    {
+        .command = "capture",
+        .action = []() { start_probe_capture(); },
+    },
+    {
+        .command = "probes",
+        .action = []() { send_soil_moisture_probes(); },
+    },
+    {
+        .command = "servo",
+        .action = []() { send_servo_stats(); },
+    },
+    {
+        .command = "dose",
+        .action = []() { dose_now(); },
+    },
+    {
+        .command = "queue",
+        .action = []() { send_dose_queue_stats(); },
+    },
 #if 0
     {
         .command = "sleep",
         .action = []() { add_to_menu_input_queue(
             /* MENU_INPUT_t menu_input = */ MENU_INPUT_SLEEP,
+            /* MENU_INPUT_SOURCE_t source = */ MENU_INPUT_SOURCE_TCP,
+            /* bool is_repeat = */ false,
+            /* int64_t us_time = */ esp_timer_get_time(),
             /* bool from_isr = */ false); },
     },
 #endif
@@ -67,6 +119,10 @@ int ip_socket_file_descriptor = 0;
 // Keep track of the handle of the task that reads IP packets (task_read_ip_packets(...))
 TaskHandle_t read_ip_packet_task_handle = nullptr;
 
+// Keep packets sent from different tasks (ex. display frames and sensor captures) from interleaving
+static StaticSemaphore_t send_mutex_buffer;
+static SemaphoreHandle_t send_mutex_handle = nullptr;
+
 // NOTE: For now this code is good enough.
 //       Only *sleep*(...), *display*(...), and main(...) call this API.
 //       Will need to update this code to be thread-safe if that changes.
@@ -125,6 +181,7 @@ void task_read_ip_packets()
         }
 
         // 29OCT2024: usStackDepth = 1024 + 512, uxTaskGetHighWaterMark = 400
+        // The "soak" command copies a soak_curve_t onto this stack, so it was raised to 2048
         PRINT_STACK_USAGE();
     }
 }
@@ -142,6 +199,12 @@ bool tcp_start(
 {
     // Instantiate server information
     struct sockaddr_in server_info = { 0 };
+    // Create the send mutex the first time, from static memory
+    if(nullptr == send_mutex_handle)
+    {
+        send_mutex_handle = xSemaphoreCreateMutexStatic(/* StaticSemaphore_t *pxMutexBuffer = */ &send_mutex_buffer);
+        configASSERT(send_mutex_handle);
+    }
     // Give the protocol family that will be used for this server
     // AF_INET = IPv4 Internet protocols
     server_info.sin_family = AF_INET;
@@ -203,7 +266,7 @@ bool tcp_start(
         // A descriptive name for the task. This is mainly used to facilitate debugging. Max length defined by configMAX_TASK_NAME_LEN - default is 16.
         /* const char *const pcName = */ "read_ip",
         // The size of the task stack specified as the NUMBER OF BYTES. Note that this differs from vanilla FreeRTOS.
-        /* const configSTACK_DEPT_TYPE usStackDepth = */ 1024 + 512,
+        /* const configSTACK_DEPT_TYPE usStackDepth = */ 2048,
         // Pointer that will be used as the parameter for the task being created.
         /* void *const pvParameters = */ NULL,
         // The priority at which the task should run.
@@ -228,14 +291,23 @@ bool tcp_send(
     size_t num_packet_bytes,
     int flags)
 {
-    // Send the packet and return the result
+    if(nullptr == send_mutex_handle)
+    {
+        return false;
+    }
+    // Send the packet whole, before any other task sends, and return the result
     // See the link below for default settings, for example, this code blocks by default.
     // https://www.man7.org/linux/man-pages/man2/send.2.html
-    return -1 != send(
+    (void) xSemaphoreTake(
+        /* xSemaphore = */ send_mutex_handle,
+        /* xBlockTime = */ portMAX_DELAY);
+    bool is_sent = -1 != send(
         /* int sockfd = */ ip_socket_file_descriptor,
         /* const void buf[.len] = */ packet,
         /* size_t len = */ num_packet_bytes,
         /* int flags = */ flags);
+    (void) xSemaphoreGive(/* xSemaphore = */ send_mutex_handle);
+    return is_sent;
 }
 
 #endif // WIFI_ENABLED
\ No newline at end of file
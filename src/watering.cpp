@@ -0,0 +1,247 @@
+// Include custom watering model API
+#include "watering.h"
+#include <string.h>
+
+// ===================== //
+// Define public methods //
+// ===================== //
+
+uint32_t dose_model_predict(
+    const dose_model_t *dose_model,
+    uint16_t current_soil_moisture,
+    uint16_t desired_soil_moisture,
+    uint32_t ul_per_unit,
+    uint32_t ul_min_dose)
+{
+    // Dose one unit at a time until there is enough to go off of
+    if((dose_model->num_samples < CONTEXT_DOSE_MODEL_MIN_SAMPLES) ||
+        (dose_model->moisture_per_ml <= 0.0f) ||
+        (current_soil_moisture >= desired_soil_moisture) ||
+        (0 == ul_min_dose))
+    {
+        return ul_per_unit;
+    }
+
+    // Round down to a whole number of the smallest dose, so the batch stops short of the desired soil moisture instead of going past it
+    float ul = 1000.0f * (float) (desired_soil_moisture - current_soil_moisture) / dose_model->moisture_per_ml;
+    uint32_t ul_max = CONTEXT_MAX_UNITS_PER_BATCH * ul_per_unit;
+    if(ul >= (float) ul_max)
+    {
+        return (ul_max / ul_min_dose) * ul_min_dose;
+    }
+    uint32_t num_min_doses = (uint32_t) (ul / (float) ul_min_dose);
+    return (0 == num_min_doses) ? ul_min_dose : (num_min_doses * ul_min_dose);
+}
+
+bool dose_model_learn(
+    dose_model_t *dose_model,
+    uint16_t before_soil_moisture,
+    uint16_t after_soil_moisture,
+    uint32_t ul_dosed)
+{
+    // Ignore readings that did not get wetter, learning from them would predict too much water next time
+    if((0 == ul_dosed) || (after_soil_moisture <= before_soil_moisture))
+    {
+        return false;
+    }
+
+    // Take the first pair as is, then keep an exponentially weighted moving average,
+    // so the model follows the pot as it changes (ex. the soil compacting, the bottle emptying)
+    float moisture_per_ml = 1000.0f * (float) (after_soil_moisture - before_soil_moisture) / (float) ul_dosed;
+    if(0 == dose_model->num_samples)
+    {
+        dose_model->moisture_per_ml = moisture_per_ml;
+    }
+    else
+    {
+        dose_model->moisture_per_ml += CONTEXT_DOSE_MODEL_WEIGHT * (moisture_per_ml - dose_model->moisture_per_ml);
+    }
+    if(dose_model->num_samples < CONTEXT_DOSE_MODEL_MIN_SAMPLES)
+    {
+        ++dose_model->num_samples;
+    }
+    return true;
+}
+
+bool soak_curve_add(
+    soak_curve_t *curve,
+    uint16_t soil_moisture,
+    uint32_t ms_after_dose)
+{
+    if(curve->num_readings >= CONTEXT_SOAK_CURVE_LENGTH)
+    {
+        return false;
+    }
+    curve->soil_moistures[curve->num_readings] = soil_moisture;
+    curve->ms_after_dose[curve->num_readings] = ms_after_dose;
+    ++curve->num_readings;
+
+    // It takes two readings to tell how fast they are changing, and none count before the least soak time
+    if((curve->num_readings < 2) || (ms_after_dose < CONTEXT_MS_SOAK))
+    {
+        return false;
+    }
+
+    // The readings settled if the newest two are within noise of each other, or changing slower than the settled rate
+    uint16_t soil_moisture_last = curve->soil_moistures[curve->num_readings - 2];
+    uint32_t moisture_diff = (soil_moisture > soil_moisture_last) ? (soil_moisture - soil_moisture_last) : (soil_moisture_last - soil_moisture);
+    uint32_t ms_diff = ms_after_dose - curve->ms_after_dose[curve->num_readings - 2];
+    curve->is_settled = (moisture_diff <= CONTEXT_SOAK_SETTLED_MOISTURE_NOISE) ||
+        ((moisture_diff * 60 * 1000) <= ((uint64_t) CONTEXT_SOAK_SETTLED_MOISTURE_PER_MINUTE * ms_diff));
+    return curve->is_settled;
+}
+
+bool soak_model_learn(
+    soak_model_t *soak_model,
+    const soak_curve_t *curve)
+{
+    // A curve that timed out only says it takes longer than it waited, not how much longer
+    if(false == curve->is_settled)
+    {
+        return false;
+    }
+
+    // The water had soaked in by the first of the two readings that settled
+    // Take the first settle time as is, then keep an exponentially weighted moving average
+    uint32_t ms_settle = curve->ms_after_dose[curve->num_readings - 2];
+    if(false == soak_model->is_learned)
+    {
+        soak_model->ms_settle = ms_settle;
+        soak_model->is_learned = true;
+    }
+    else
+    {
+        soak_model->ms_settle = (uint32_t) ((float) soak_model->ms_settle + (CONTEXT_SOAK_MODEL_WEIGHT * ((float) ms_settle - (float) soak_model->ms_settle)));
+    }
+    return true;
+}
+
+// Fit a line through the readings of history with least squares, and set out_soil_moisture_per_sec to its slope,
+// how fast the soil is drying (negative) or getting wetter, and out_newest_soil_moisture to where it is at the newest reading
+// Returns false if there are too few readings, or they were all at the same time, the outputs are left as is
+static bool soil_moisture_history_fit(
+    const soil_moisture_history_t *history,
+    float *out_soil_moisture_per_sec,
+    float *out_newest_soil_moisture)
+{
+    size_t num_readings = history->num_readings;
+    if(num_readings < CONTEXT_MIN_SOIL_MOISTURE_HISTORY_FIT)
+    {
+        return false;
+    }
+
+    // Use times relative to the oldest reading, so they fit in a float without losing precision
+    float sec_span = (float) (history->times[num_readings - 1] - history->times[0]);
+    float mean_sec = 0.0f;
+    float mean_soil_moisture = 0.0f;
+    for(size_t i = 0; i < num_readings; ++i)
+    {
+        mean_sec += (float) (history->times[i] - history->times[0]);
+        mean_soil_moisture += (float) history->soil_moistures[i];
+    }
+    mean_sec /= num_readings;
+    mean_soil_moisture /= num_readings;
+    float covariance = 0.0f;
+    float variance = 0.0f;
+    for(size_t i = 0; i < num_readings; ++i)
+    {
+        float sec_diff = (float) (history->times[i] - history->times[0]) - mean_sec;
+        covariance += sec_diff * ((float) history->soil_moistures[i] - mean_soil_moisture);
+        variance += sec_diff * sec_diff;
+    }
+    if(variance <= 0.0f)
+    {
+        return false;
+    }
+    *out_soil_moisture_per_sec = covariance / variance;
+    *out_newest_soil_moisture = mean_soil_moisture + (*out_soil_moisture_per_sec * (sec_span - mean_sec));
+    return true;
+}
+
+void soil_moisture_history_add(
+    soil_moisture_history_t *history,
+    uint16_t soil_moisture,
+    time_t time_reading)
+{
+    // Start over if the pot was watered
+    if((history->num_readings > 0) &&
+        (soil_moisture > (history->soil_moistures[history->num_readings - 1] + CONTEXT_SOIL_MOISTURE_WATERED_RISE)))
+    {
+        history->num_readings = 0;
+    }
+
+    // Drop the oldest reading if there is no room
+    if(history->num_readings == CONTEXT_SOIL_MOISTURE_HISTORY_LENGTH)
+    {
+        memmove(&history->soil_moistures[0], &history->soil_moistures[1], (CONTEXT_SOIL_MOISTURE_HISTORY_LENGTH - 1) * sizeof(*history->soil_moistures));
+        memmove(&history->times[0], &history->times[1], (CONTEXT_SOIL_MOISTURE_HISTORY_LENGTH - 1) * sizeof(*history->times));
+        --history->num_readings;
+    }
+    history->soil_moistures[history->num_readings] = soil_moisture;
+    history->times[history->num_readings] = time_reading;
+    ++history->num_readings;
+
+    // Remember the fastest the soil has been drying, a faster line takes over at once, a slower one (or none) wears it down slowly,
+    // so it lasts through a night of slow drying to the next day, but follows the pot as it changes (ex. the weather cooling)
+    float soil_moisture_per_sec = 0.0f;
+    float newest_soil_moisture = 0.0f;
+    if(false == soil_moisture_history_fit(
+        /* const soil_moisture_history_t *history = */ history,
+        /* float *out_soil_moisture_per_sec = */ &soil_moisture_per_sec,
+        /* float *out_newest_soil_moisture = */ &newest_soil_moisture))
+    {
+        return;
+    }
+    float drying_per_sec = (soil_moisture_per_sec < 0.0f) ? -soil_moisture_per_sec : 0.0f;
+    if(drying_per_sec > history->max_drying_per_sec)
+    {
+        history->max_drying_per_sec = drying_per_sec;
+    }
+    else
+    {
+        history->max_drying_per_sec -= CONTEXT_MAX_DRYING_DECAY * (history->max_drying_per_sec - drying_per_sec);
+    }
+}
+
+uint32_t soil_moisture_history_predict_minute_interval(
+    const soil_moisture_history_t *history,
+    uint16_t desired_soil_moisture,
+    const check_schedule_t *check_schedule)
+{
+    // Check again soon until there are enough readings to fit a line through
+    float soil_moisture_per_sec = 0.0f;
+    float newest_soil_moisture = 0.0f;
+    if(false == soil_moisture_history_fit(
+        /* const soil_moisture_history_t *history = */ history,
+        /* float *out_soil_moisture_per_sec = */ &soil_moisture_per_sec,
+        /* float *out_newest_soil_moisture = */ &newest_soil_moisture))
+    {
+        return check_schedule->minute_min_check_freq;
+    }
+
+    // Never wait longer than the readings span, a line fit over a short time (or through noise) says little about
+    // much later. This also lets the interval grow quickly when the soil is not drying at all, as each check makes the span longer.
+    float minute_interval = (float) (history->times[history->num_readings - 1] - history->times[0]) / 60.0f;
+
+    // Project when the soil dries to desired_soil_moisture, counting from the newest reading, at the faster of how fast
+    // the line says it is drying, and the fastest it has been seen drying, since how fast the soil dries changes through the day,
+    // and a line fit through a night of slow drying would otherwise sleep through the morning, and past desired
+    // Only wait part of the way there, the soil may still dry faster than projected, ex. on the first day, before the fastest is seen
+    float drying_per_sec = (soil_moisture_per_sec < 0.0f) ? -soil_moisture_per_sec : 0.0f;
+    drying_per_sec = (history->max_drying_per_sec > drying_per_sec) ? history->max_drying_per_sec : drying_per_sec;
+    if(drying_per_sec > 0.0f)
+    {
+        float minute_projected = CONTEXT_PROJECTED_CHECK_SHARE * ((newest_soil_moisture - (float) desired_soil_moisture) / drying_per_sec) / 60.0f;
+        minute_interval = (minute_projected < minute_interval) ? minute_projected : minute_interval;
+    }
+
+    if(minute_interval <= (float) check_schedule->minute_min_check_freq)
+    {
+        return check_schedule->minute_min_check_freq;
+    }
+    if(minute_interval >= (float) check_schedule->minute_max_check_freq)
+    {
+        return check_schedule->minute_max_check_freq;
+    }
+    return (uint32_t) minute_interval;
+}
\ No newline at end of file
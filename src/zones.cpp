@@ -0,0 +1,336 @@
+// Include custom zone scheduler API
+#include "zones.h"
+// Include custom Context class implementation
+#include "context.h"
+// Include ESP32 high resolution timer API
+#include "esp_timer.h"
+// Include custom debug macros and compile flags
+#include "flags.h"
+
+// ======================================= //
+// Define reusable tasks, interrupts, etc. //
+// ======================================= //
+
+void task_schedule_zones(ZoneScheduler *zone_scheduler)
+{
+    zone_heap_t heap;
+    zone_heap_init(/* zone_heap_t *heap = */ &heap);
+    TickType_t ticks_to_wait = portMAX_DELAY;
+
+    // Tasks must be implemented to never return (i.e. continuous loop)
+    // https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-reference/system/freertos_idf.html
+    while(1)
+    {
+        // Wait until the soonest deadline, or until a zone's next step moves, each zone sets its own bit
+        uint32_t zone_bits = 0;
+        (void) xTaskNotifyWait(
+            /* uint32_t ulBitsToClearOnEntry = */ 0,
+            /* uint32_t ulBitsToClearOnExit = */ UINT32_MAX,
+            /* uint32_t *pulNotificationValue = */ &zone_bits,
+            /* TickType_t xTicksToWait = */ ticks_to_wait);
+
+        // Ask every zone whose next step moved when it is now
+        for(size_t i = 0; i < zone_scheduler->num_zones; ++i)
+        {
+            if(0 != (zone_bits & ((uint32_t) 1 << i)))
+            {
+                zone_heap_set(
+                    /* zone_heap_t *heap = */ &heap,
+                    /* uint8_t zone = */ (uint8_t) i,
+                    /* int64_t us_deadline = */ zone_scheduler->zones[i]->get_us_next_water_step());
+            }
+        }
+
+        // Step every zone that is due, soonest first, a zone due again straight away (ex. its check found it dry) is stepped again
+        zone_deadline_t deadline;
+        while((true == zone_heap_peek(/* const zone_heap_t *heap = */ &heap, /* zone_deadline_t *out_deadline = */ &deadline)) &&
+            (deadline.us_deadline <= esp_timer_get_time()))
+        {
+            zone_heap_set(
+                /* zone_heap_t *heap = */ &heap,
+                /* uint8_t zone = */ deadline.zone,
+                /* int64_t us_deadline = */ zone_scheduler->zones[deadline.zone]->step_water());
+        }
+
+        // Sleep until the soonest deadline, rounding up, so waking up is never too early
+        if(false == zone_heap_peek(/* const zone_heap_t *heap = */ &heap, /* zone_deadline_t *out_deadline = */ &deadline))
+        {
+            ticks_to_wait = portMAX_DELAY;
+        }
+        else
+        {
+            int64_t ms_wait = ((deadline.us_deadline - esp_timer_get_time()) + 999) / 1000;
+            ms_wait = (ms_wait < 0) ? 0 : ((ms_wait > ZONE_MS_MAX_SCHEDULE_WAIT) ? ZONE_MS_MAX_SCHEDULE_WAIT : ms_wait);
+            ticks_to_wait = pdMS_TO_TICKS((uint32_t) ms_wait) + 1;
+        }
+
+        PRINT_STACK_USAGE();
+    }
+}
+
+void task_actuate_zones(ZoneScheduler *zone_scheduler)
+{
+    TickType_t ticks_to_wait = portMAX_DELAY;
+    size_t zone_first = 0;
+
+    // Tasks must be implemented to never return (i.e. continuous loop)
+    // https://docs.espressif.com/projects/esp-idf/en/stable/esp32/api-reference/system/freertos_idf.html
+    while(1)
+    {
+        // Wait until a dose is requested, or until the gap or hourly cap lets a deferred dose go
+        (void) xSemaphoreTake(
+            /* xSemaphore = */ zone_scheduler->actuate_semaphore_handle,
+            /* xBlockTime = */ ticks_to_wait);
+        size_t num_zones = zone_scheduler->num_zones;
+        if(0 == num_zones)
+        {
+            ticks_to_wait = portMAX_DELAY;
+            continue;
+        }
+
+        // Take turns dosing one unit for each zone, starting one zone further along every round, so no zone is always last,
+        // until a whole round doses nothing, a zone another task is dosing is skipped
+        bool is_dosed = false;
+        do
+        {
+            is_dosed = false;
+            ticks_to_wait = portMAX_DELAY;
+            for(size_t i = 0; i < num_zones; ++i)
+            {
+                TickType_t ticks_until_allowed = portMAX_DELAY;
+                is_dosed |= zone_scheduler->zones[(zone_first + i) % num_zones]->step_actuate(
+                    /* TickType_t *out_ticks_until_allowed = */ &ticks_until_allowed);
+                ticks_to_wait = (ticks_until_allowed < ticks_to_wait) ? ticks_until_allowed : ticks_to_wait;
+            }
+            zone_first = (zone_first + 1) % num_zones;
+        } while(true == is_dosed);
+
+        PRINT_STACK_USAGE();
+    }
+}
+
+// ========================== //
+// Define zone heap functions //
+// ========================== //
+
+// Swap the deadlines at positions i and j of heap, and where their zones are
+static void zone_heap_swap(
+    zone_heap_t *heap,
+    size_t i,
+    size_t j)
+{
+    zone_deadline_t deadline = heap->deadlines[i];
+    heap->deadlines[i] = heap->deadlines[j];
+    heap->deadlines[j] = deadline;
+    heap->positions[heap->deadlines[i].zone] = (uint8_t) i;
+    heap->positions[heap->deadlines[j].zone] = (uint8_t) j;
+}
+
+void zone_heap_init(zone_heap_t *heap)
+{
+    heap->num_deadlines = 0;
+    for(size_t i = 0; i < ZONE_MAX_ZONES; ++i)
+    {
+        heap->positions[i] = ZONE_MAX_ZONES;
+    }
+}
+
+void zone_heap_set(
+    zone_heap_t *heap,
+    uint8_t zone,
+    int64_t us_deadline)
+{
+    if(zone >= ZONE_MAX_ZONES)
+    {
+        return;
+    }
+
+    // Add the zone at the end, if it is not in the heap yet
+    size_t i = heap->positions[zone];
+    if(i >= heap->num_deadlines)
+    {
+        i = heap->num_deadlines++;
+        heap->positions[zone] = (uint8_t) i;
+        heap->deadlines[i].zone = zone;
+    }
+    heap->deadlines[i].us_deadline = us_deadline;
+
+    // Move it up past every parent due later
+    while((0 != i) && (heap->deadlines[(i - 1) / 2].us_deadline > heap->deadlines[i].us_deadline))
+    {
+        zone_heap_swap(/* zone_heap_t *heap = */ heap, /* size_t i = */ i, /* size_t j = */ (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+
+    // Move it down past every child due sooner, swapping with the sooner child, so it becomes the parent of the other
+    while(1)
+    {
+        size_t soonest = i;
+        size_t child = (2 * i) + 1;
+        for(size_t j = child; (j < (child + 2)) && (j < heap->num_deadlines); ++j)
+        {
+            soonest = (heap->deadlines[j].us_deadline < heap->deadlines[soonest].us_deadline) ? j : soonest;
+        }
+        if(soonest == i)
+        {
+            break;
+        }
+        zone_heap_swap(/* zone_heap_t *heap = */ heap, /* size_t i = */ i, /* size_t j = */ soonest);
+        i = soonest;
+    }
+}
+
+bool zone_heap_peek(
+    const zone_heap_t *heap,
+    zone_deadline_t *out_deadline)
+{
+    if(0 == heap->num_deadlines)
+    {
+        return false;
+    }
+    *out_deadline = heap->deadlines[0];
+    return true;
+}
+
+// =================================== //
+// Define ZoneScheduler implementation //
+// =================================== //
+
+ZoneScheduler::ZoneScheduler(
+    const zone_config_t *zone_configs,
+    size_t arg_num_zones,
+    gpio_num_t pin_soil_moisture_sensor_power_out)
+{
+    num_zones = 0;
+    for(size_t i = 0; i < ZONE_MAX_ZONES; ++i)
+    {
+        zones[i] = nullptr;
+    }
+
+    // Gather every zone's probe pins, once each, a probe can be shared between zones (ex. two valves watering one bed)
+    num_soil_moisture_sensor_pins = 0;
+    for(size_t i = 0; i < arg_num_zones; ++i)
+    {
+        for(size_t j = 0; j < zone_configs[i].num_soil_moisture_probes; ++j)
+        {
+            gpio_num_t pin = zone_configs[i].soil_moisture_probes[j].pin;
+            if(SENSOR_MAX_CHANNELS != get_soil_moisture_sensor_channel(/* gpio_num_t pin = */ pin))
+            {
+                continue;
+            }
+            if(num_soil_moisture_sensor_pins >= SENSOR_MAX_CHANNELS)
+            {
+                s_println("Too many soil moisture probe pins, the rest are not read");
+                break;
+            }
+            pins_soil_moisture_sensor[num_soil_moisture_sensor_pins++] = pin;
+        }
+    }
+
+    // Set up the soil moisture probes, read together in one scan, with the ADC attenuation at 11 dB (up to ~3.3V input),
+    // only powering them around readings
+    // https://esp32io.com/tutorials/esp32-soil-moisture-sensor
+    (void) soil_moisture_sensor.init(
+        /* const gpio_num_t *pins = */ pins_soil_moisture_sensor,
+        /* size_t num_pins = */ num_soil_moisture_sensor_pins,
+        /* adc_atten_t atten = */ ADC_ATTEN_DB_11,
+        /* size_t arg_num_samples = */ CONTEXT_SOIL_MOISTURE_NUM_SAMPLES,
+        /* SENSOR_REDUCTION_t arg_reduction = */ CONTEXT_SOIL_MOISTURE_REDUCTION,
+        /* bool arg_is_calibrated = */ false,
+        /* gpio_num_t arg_pin_power = */ pin_soil_moisture_sensor_power_out,
+        /* uint32_t arg_ms_warm_up = */ CONTEXT_MS_SOIL_MOISTURE_SENSOR_WARM_UP);
+
+    // Create the semaphore counting doses requested, from static memory, a few more than can be queued at once is plenty
+    actuate_semaphore_handle = xSemaphoreCreateCountingStatic(
+        /* UBaseType_t uxMaxCount = */ ZONE_MAX_ZONES * ACTUATION_QUEUE_LENGTH,
+        /* UBaseType_t uxInitialCount = */ 0,
+        /* StaticSemaphore_t *pxSemaphoreBuffer = */ &actuate_semaphore_buffer);
+    configASSERT(actuate_semaphore_handle);
+
+    // Create task to step every zone's watering
+    // TODO: Look into static memory allocation instead?
+    xTaskCreate(
+        // Pointer to the task entry function. Tasks must be implemented to never return (i.e. continuous loop).
+        /* TaskFunction_t pxTaskCode = */ (TaskFunction_t) task_schedule_zones,
+        // A descriptive name for the task. This is mainly used to facilitate debugging. Max length defined by configMAX_TASK_NAME_LEN - default is 16.
+        /* const char *const pcName = */ "schedule_zones",
+        // The size of the task stack specified as the NUMBER OF BYTES. Note that this differs from vanilla FreeRTOS.
+        // The soak readings are kept by each zone, so this needs no more than task_water did
+        /* const configSTACK_DEPT_TYPE usStackDepth = */ 2048,
+        // Pointer that will be used as the parameter for the task being created.
+        /* void *const pvParameters = */ this,
+        // The priority at which the task should run.
+        // Systems that include MPU support can optionally create tasks in a privileged (system) mode by setting bit portPRIVILEGE_BIT of the priority parameter.
+        // For example, to create a privileged task at priority 2 the uxPriority parameter should be set to ( 2 | portPRIVILEGE_BIT ).
+        /* UBaseType_t uxPriority = */ 10,
+        // Used to pass back a handle by which the created task can be referenced.
+        /* TaskHandle_t *const pxCreatedTask = */ &schedule_task_handle);
+    configASSERT(schedule_task_handle);
+
+    // Create tasks to dose every zone's requests (a dose can take several seconds)
+    for(size_t i = 0; i < ZONE_NUM_ACTUATE_TASKS; ++i)
+    {
+        TaskHandle_t actuate_task_handle = nullptr;
+        xTaskCreate(
+            // Pointer to the task entry function. Tasks must be implemented to never return (i.e. continuous loop).
+            /* TaskFunction_t pxTaskCode = */ (TaskFunction_t) task_actuate_zones,
+            // A descriptive name for the task. This is mainly used to facilitate debugging. Max length defined by configMAX_TASK_NAME_LEN - default is 16.
+            /* const char *const pcName = */ "actuate_zones",
+            // The size of the task stack specified as the NUMBER OF BYTES. Note that this differs from vanilla FreeRTOS.
+            /* const configSTACK_DEPT_TYPE usStackDepth = */ 1024,
+            // Pointer that will be used as the parameter for the task being created.
+            /* void *const pvParameters = */ this,
+            // The priority at which the task should run.
+            // Systems that include MPU support can optionally create tasks in a privileged (system) mode by setting bit portPRIVILEGE_BIT of the priority parameter.
+            // For example, to create a privileged task at priority 2 the uxPriority parameter should be set to ( 2 | portPRIVILEGE_BIT ).
+            /* UBaseType_t uxPriority = */ 10,
+            // Used to pass back a handle by which the created task can be referenced.
+            /* TaskHandle_t *const pxCreatedTask = */ &actuate_task_handle);
+        configASSERT(actuate_task_handle);
+    }
+}
+
+size_t ZoneScheduler::add_zone(Context *zone)
+{
+    if(num_zones >= ZONE_MAX_ZONES)
+    {
+        s_println("No room for another zone");
+        return ZONE_MAX_ZONES;
+    }
+    zones[num_zones] = zone;
+    return num_zones++;
+}
+
+void ZoneScheduler::notify_zone(size_t index)
+{
+    if(index >= ZONE_MAX_ZONES)
+    {
+        return;
+    }
+    (void) xTaskNotify(
+        /* TaskHandle_t xTaskToNotify = */ schedule_task_handle,
+        /* uint32_t ulValue = */ (uint32_t) 1 << index,
+        /* eNotifyAction eAction = */ eSetBits);
+}
+
+SemaphoreHandle_t ZoneScheduler::get_actuate_semaphore_handle()
+{
+    return actuate_semaphore_handle;
+}
+
+Sensor *ZoneScheduler::get_soil_moisture_sensor()
+{
+    return &soil_moisture_sensor;
+}
+
+size_t ZoneScheduler::get_soil_moisture_sensor_channel(gpio_num_t pin)
+{
+    for(size_t i = 0; i < num_soil_moisture_sensor_pins; ++i)
+    {
+        if(pin == pins_soil_moisture_sensor[i])
+        {
+            return i;
+        }
+    }
+    return SENSOR_MAX_CHANNELS;
+}
\ No newline at end of file
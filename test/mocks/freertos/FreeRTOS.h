@@ -0,0 +1,18 @@
+#ifndef __MOCK_FREERTOS_H__
+#define __MOCK_FREERTOS_H__
+
+// A stand-in for FreeRTOS's common header, for the modules built for the native test environment, see: [env:native] in platformio.ini
+// It only provides what those modules use, on top of the compiler's atomics, it is NOT a simulation of FreeRTOS.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// A spinlock, taken by spinning on a flag, there are no interrupts to disable on a computer
+typedef struct {
+    bool is_locked;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {false}
+#define portENTER_CRITICAL(mux) while(__atomic_test_and_set(&(mux)->is_locked, __ATOMIC_ACQUIRE))
+#define portEXIT_CRITICAL(mux) __atomic_clear(&(mux)->is_locked, __ATOMIC_RELEASE)
+
+#endif // __MOCK_FREERTOS_H__
\ No newline at end of file
@@ -0,0 +1,7 @@
+#ifndef __MOCK_TASK_H__
+#define __MOCK_TASK_H__
+
+// A stand-in for FreeRTOS's task API, for the modules built for the native test environment, see: freertos/FreeRTOS.h
+#include "freertos/FreeRTOS.h"
+
+#endif // __MOCK_TASK_H__
\ No newline at end of file
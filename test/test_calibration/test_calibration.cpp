@@ -0,0 +1,172 @@
+// Include Unity test framework
+#include <unity.h>
+
+// Include custom soil moisture calibration API
+#include "calibration.h"
+
+// ====================================== //
+// Define useful constants and data types //
+// ====================================== //
+
+// Define how far, in fixed point percent, a conversion may be from the curve worked out in floating point
+// The table is interpolated linearly between entries, which stays well within this on a curve this gentle
+#define TEST_CURVE_TOLERANCE CALIBRATION_PERCENT_Q8(0.25)
+// Define the range of raw readings the ADC gives
+#define TEST_RAW_MAX 4095
+
+// Build converter from calibration, and check calibration was valid
+static void test_build(
+    const calibration_t *calibration,
+    calibration_converter_t *out_converter)
+{
+    TEST_ASSERT_TRUE(calibration_build(
+        /* const calibration_t *calibration = */ calibration,
+        /* calibration_converter_t *out_converter = */ out_converter));
+}
+
+// Get the percent, in fixed point, the curve gives a raw reading between the dry and wet points, without a middle point,
+// worked out in floating point the same way as the table, see: calibration.h
+static uint16_t test_curve_percent_q8(
+    const calibration_t *calibration,
+    uint16_t raw)
+{
+    double position = ((double) raw - calibration->dry.raw) / ((double) calibration->wet.raw - calibration->dry.raw);
+    double raw_scaled = 1.0 - (position * (1.0 - CALIBRATION_CURVE_WET_TO_DRY_RATIO));
+    double fraction = ((1.0 / raw_scaled) - 1.0) / ((1.0 / CALIBRATION_CURVE_WET_TO_DRY_RATIO) - 1.0);
+    return (uint16_t) (calibration->dry.percent_q8 + (fraction * (calibration->wet.percent_q8 - calibration->dry.percent_q8)) + 0.5);
+}
+
+// Check every raw reading the ADC gives converts to a percent between the dry and wet points,
+// and that the percent never gets drier as the reading moves from the dry point towards the wet point
+static void test_every_raw_is_monotonic(
+    const calibration_t *calibration,
+    const calibration_converter_t *converter)
+{
+    bool is_wet_lower = calibration->wet.raw < calibration->dry.raw;
+    uint16_t percent_q8_last = 0;
+    for(uint32_t i = 0; i <= TEST_RAW_MAX; ++i)
+    {
+        // Walk from the dry end of the ADC's range to the wet end
+        uint16_t raw = (uint16_t) ((true == is_wet_lower) ? (TEST_RAW_MAX - i) : i);
+        uint16_t percent_q8 = calibration_convert(
+            /* const calibration_converter_t *converter = */ converter,
+            /* uint16_t raw = */ raw);
+        TEST_ASSERT_GREATER_OR_EQUAL(calibration->dry.percent_q8, percent_q8);
+        TEST_ASSERT_LESS_OR_EQUAL(calibration->wet.percent_q8, percent_q8);
+        if(i > 0)
+        {
+            TEST_ASSERT_GREATER_OR_EQUAL(percent_q8_last, percent_q8);
+        }
+        percent_q8_last = percent_q8;
+    }
+}
+
+// ============ //
+// Define tests //
+// ============ //
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_default_points()
+{
+    calibration_t calibration;
+    calibration_set_default(&calibration);
+    calibration_converter_t converter;
+    test_build(&calibration, &converter);
+
+    // The dry and wet points convert to their own percents, readings past them are clamped
+    TEST_ASSERT_EQUAL(CALIBRATION_PERCENT_Q8(CALIBRATION_DEFAULT_PERCENT_DRY), calibration_convert(&converter, CALIBRATION_DEFAULT_RAW_DRY));
+    TEST_ASSERT_EQUAL(CALIBRATION_PERCENT_Q8(CALIBRATION_DEFAULT_PERCENT_WET), calibration_convert(&converter, CALIBRATION_DEFAULT_RAW_WET));
+    TEST_ASSERT_EQUAL(CALIBRATION_PERCENT_Q8(CALIBRATION_DEFAULT_PERCENT_DRY), calibration_convert(&converter, TEST_RAW_MAX));
+    TEST_ASSERT_EQUAL(CALIBRATION_PERCENT_Q8(CALIBRATION_DEFAULT_PERCENT_WET), calibration_convert(&converter, 0));
+
+    // Halfway between the points is a table entry, 1 / 0.7 - 1 over 1 / 0.4 - 1 of the way, 14.29%, not 25%,
+    // since equal steps in the reading are smaller steps in water content near dry
+    TEST_ASSERT_EQUAL(3657, calibration_convert(&converter, (CALIBRATION_DEFAULT_RAW_DRY + CALIBRATION_DEFAULT_RAW_WET) / 2));
+
+    // Everywhere else follows the curve
+    for(uint16_t raw = CALIBRATION_DEFAULT_RAW_WET; raw <= CALIBRATION_DEFAULT_RAW_DRY; raw += 17)
+    {
+        TEST_ASSERT_UINT_WITHIN(TEST_CURVE_TOLERANCE, test_curve_percent_q8(&calibration, raw), calibration_convert(&converter, raw));
+    }
+    test_every_raw_is_monotonic(&calibration, &converter);
+}
+
+static void test_mid_point()
+{
+    // A probe wetter at its middle reading than the curve expects, the conversion bends to pass through every point
+    calibration_t calibration;
+    calibration_set_default(&calibration);
+    calibration.mid.raw = 2050;
+    calibration.mid.percent_q8 = CALIBRATION_PERCENT_Q8(20);
+    calibration.is_mid_set = true;
+    calibration_converter_t converter;
+    test_build(&calibration, &converter);
+
+    TEST_ASSERT_EQUAL(CALIBRATION_PERCENT_Q8(CALIBRATION_DEFAULT_PERCENT_DRY), calibration_convert(&converter, CALIBRATION_DEFAULT_RAW_DRY));
+    TEST_ASSERT_UINT_WITHIN(CALIBRATION_PERCENT_Q8(0.05), CALIBRATION_PERCENT_Q8(20), calibration_convert(&converter, 2050));
+    TEST_ASSERT_EQUAL(CALIBRATION_PERCENT_Q8(CALIBRATION_DEFAULT_PERCENT_WET), calibration_convert(&converter, CALIBRATION_DEFAULT_RAW_WET));
+    test_every_raw_is_monotonic(&calibration, &converter);
+}
+
+static void test_mid_point_next_to_dry_point()
+{
+    // A middle point one count from the dry point makes the first piece as steep as it gets,
+    // readings past it are still run along the first piece, which must not overflow
+    calibration_t calibration;
+    calibration_set_default(&calibration);
+    calibration.mid.raw = CALIBRATION_DEFAULT_RAW_DRY - 1;
+    calibration.mid.percent_q8 = CALIBRATION_PERCENT_Q8(49);
+    calibration.is_mid_set = true;
+    calibration_converter_t converter;
+    test_build(&calibration, &converter);
+
+    TEST_ASSERT_EQUAL(CALIBRATION_PERCENT_Q8(CALIBRATION_DEFAULT_PERCENT_DRY), calibration_convert(&converter, CALIBRATION_DEFAULT_RAW_DRY));
+    TEST_ASSERT_UINT_WITHIN(CALIBRATION_PERCENT_Q8(0.05), CALIBRATION_PERCENT_Q8(49), calibration_convert(&converter, CALIBRATION_DEFAULT_RAW_DRY - 1));
+    TEST_ASSERT_EQUAL(CALIBRATION_PERCENT_Q8(CALIBRATION_DEFAULT_PERCENT_WET), calibration_convert(&converter, CALIBRATION_DEFAULT_RAW_WET));
+    test_every_raw_is_monotonic(&calibration, &converter);
+
+    // The same, with the middle point one count from the wet point, and readings that rise as the soil gets wetter
+    calibration.dry.raw = 100;
+    calibration.wet.raw = 4000;
+    calibration.mid.raw = 3999;
+    calibration.mid.percent_q8 = CALIBRATION_PERCENT_Q8(1);
+    test_build(&calibration, &converter);
+    TEST_ASSERT_EQUAL(CALIBRATION_PERCENT_Q8(CALIBRATION_DEFAULT_PERCENT_DRY), calibration_convert(&converter, 100));
+    TEST_ASSERT_EQUAL(CALIBRATION_PERCENT_Q8(CALIBRATION_DEFAULT_PERCENT_WET), calibration_convert(&converter, 4000));
+    test_every_raw_is_monotonic(&calibration, &converter);
+}
+
+static void test_invalid_points()
+{
+    // Dry and wet points that can't be told apart fall back on the default points
+    calibration_t calibration;
+    calibration_set_default(&calibration);
+    calibration.wet.raw = calibration.dry.raw;
+    calibration_converter_t converter;
+    TEST_ASSERT_FALSE(calibration_build(&calibration, &converter));
+    TEST_ASSERT_EQUAL(3657, calibration_convert(&converter, (CALIBRATION_DEFAULT_RAW_DRY + CALIBRATION_DEFAULT_RAW_WET) / 2));
+
+    // A middle point that is not between the dry and wet points is left out
+    calibration_set_default(&calibration);
+    calibration.mid.raw = 3500;
+    calibration.is_mid_set = true;
+    test_build(&calibration, &converter);
+    TEST_ASSERT_EQUAL(3657, calibration_convert(&converter, (CALIBRATION_DEFAULT_RAW_DRY + CALIBRATION_DEFAULT_RAW_WET) / 2));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_default_points);
+    RUN_TEST(test_mid_point);
+    RUN_TEST(test_mid_point_next_to_dry_point);
+    RUN_TEST(test_invalid_points);
+    return UNITY_END();
+}
\ No newline at end of file
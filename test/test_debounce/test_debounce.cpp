@@ -0,0 +1,253 @@
+// Include Unity test framework
+#include <unity.h>
+
+// Include custom button debouncing API
+#include "debounce.h"
+
+// ====================================== //
+// Define useful constants and data types //
+// ====================================== //
+
+// Define how long, in microseconds, the simulated button must be steady, and how often it is sampled, as buttons[] in button.cpp are
+#define TEST_US_DEBOUNCE (30 * 1000)
+#define TEST_US_SAMPLE_PERIOD 1000
+// Define the resolution, in microseconds, of the simulated waveforms, and of when interrupts see their edges
+#define TEST_US_STEP 10
+// Define the most edges a waveform can have, and the most events it can make
+#define TEST_MAX_EDGES 64
+#define TEST_MAX_EVENTS 64
+
+// A synthetic waveform of whether a button is held down, it starts up, and flips at every edge
+typedef struct waveform_s {
+    int64_t us_edges[TEST_MAX_EDGES];
+    size_t num_edges;
+} waveform_t;
+
+// The events a simulated button made
+typedef struct events_s {
+    debounce_event_t events[TEST_MAX_EVENTS];
+    size_t num_events;
+} events_t;
+
+// ============================================== //
+// Functions for building and replaying waveforms //
+// ============================================== //
+
+// Add a bounce to waveform, num_edges edges, starting at us_start, spaced apart by the us_gaps given, repeated
+static void waveform_add_bounce(
+    waveform_t *waveform,
+    int64_t us_start,
+    size_t num_edges,
+    const uint32_t *us_gaps,
+    size_t num_gaps)
+{
+    int64_t us_edge = us_start;
+    for(size_t i = 0; i < num_edges; ++i)
+    {
+        waveform->us_edges[waveform->num_edges++] = us_edge;
+        us_edge += us_gaps[i % num_gaps];
+    }
+}
+
+// Get whether the button in waveform is held down at us_time
+static bool waveform_is_down(
+    const waveform_t *waveform,
+    int64_t us_time)
+{
+    size_t num_edges_passed = 0;
+    for(; (num_edges_passed < waveform->num_edges) && (waveform->us_edges[num_edges_passed] <= us_time); ++num_edges_passed);
+    return 0 != (num_edges_passed & 1);
+}
+
+// Play waveform into a button debounced like Button does, until us_end, and collect the events it makes into out_events
+// An edge while waiting for an interrupt starts sampling, every TEST_US_SAMPLE_PERIOD until it settles, edges while sampling are ignored
+static void waveform_play(
+    const waveform_t *waveform,
+    bool is_repeating,
+    int64_t us_end,
+    events_t *out_events)
+{
+    debounce_t debounce;
+    debounce_init(
+        /* debounce_t *debounce = */ &debounce,
+        /* uint32_t us_debounce = */ TEST_US_DEBOUNCE,
+        /* bool is_repeating = */ is_repeating);
+    debounce_reset(
+        /* debounce_t *debounce = */ &debounce,
+        /* bool is_down = */ false);
+    out_events->num_events = 0;
+
+    bool is_sampling = false;
+    int64_t us_next_sample = 0;
+    bool was_down = false;
+    for(int64_t us_time = 0; us_time < us_end; us_time += TEST_US_STEP)
+    {
+        bool is_down = waveform_is_down(waveform, us_time);
+
+        // An interrupt on any edge starts sampling, like Button::start_sampling
+        if((false == is_sampling) && (is_down != was_down))
+        {
+            debounce.us_first_change = us_time;
+            is_sampling = true;
+            us_next_sample = us_time + TEST_US_SAMPLE_PERIOD;
+        }
+        was_down = is_down;
+        if((false == is_sampling) || (us_time < us_next_sample))
+        {
+            continue;
+        }
+
+        debounce_event_t event;
+        is_sampling = debounce_sample(
+            /* debounce_t *debounce = */ &debounce,
+            /* bool is_down = */ is_down,
+            /* int64_t us_current_time = */ us_time,
+            /* debounce_event_t *out_event = */ &event);
+        if((BUTTON_EVENT_NONE != event.type) && (out_events->num_events < TEST_MAX_EVENTS))
+        {
+            out_events->events[out_events->num_events++] = event;
+        }
+        us_next_sample += TEST_US_SAMPLE_PERIOD;
+
+        // Keep sampling if the button moved between the last sample and the interrupt being enabled, like Button::sample
+        if((false == is_sampling) && (is_down != debounce.is_pressed))
+        {
+            debounce.us_first_change = us_time;
+            is_sampling = true;
+        }
+    }
+}
+
+// Count the events of type in events
+static size_t events_count(
+    const events_t *events,
+    BUTTON_EVENT_t type)
+{
+    size_t num_events = 0;
+    for(size_t i = 0; i < events->num_events; ++i)
+    {
+        num_events += (type == events->events[i].type) ? 1 : 0;
+    }
+    return num_events;
+}
+
+// ============ //
+// Define tests //
+// ============ //
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_bouncy_press_and_release()
+{
+    // Bounce for about 2 ms going down, hold for 200 ms, then bounce for about 3 ms coming up
+    // An odd number of edges each time, so the button ends up down, then up
+    static const uint32_t us_press_gaps[] = {80, 350, 40, 600, 120, 900};
+    static const uint32_t us_release_gaps[] = {500, 60, 1100, 30, 250, 700, 90};
+    waveform_t waveform = {};
+    waveform_add_bounce(&waveform, 10 * 1000, 7, us_press_gaps, sizeof(us_press_gaps) / sizeof(*us_press_gaps));
+    waveform_add_bounce(&waveform, 210 * 1000, 9, us_release_gaps, sizeof(us_release_gaps) / sizeof(*us_release_gaps));
+
+    events_t events;
+    waveform_play(&waveform, /* bool is_repeating = */ false, 400 * 1000, &events);
+
+    // Exactly one press and one release, each reported at its first edge
+    TEST_ASSERT_EQUAL(2, events.num_events);
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_PRESS, events.events[0].type);
+    TEST_ASSERT_EQUAL(10 * 1000, events.events[0].us_time);
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_RELEASE, events.events[1].type);
+    TEST_ASSERT_EQUAL(210 * 1000, events.events[1].us_time);
+}
+
+static void test_bounce_slower_than_sampling()
+{
+    // Bounce with gaps up to most of the debounce time, each one seen by several samples, still one press
+    static const uint32_t us_gaps[] = {3000, 12000, 7000, 25000, 1500};
+    waveform_t waveform = {};
+    waveform_add_bounce(&waveform, 5 * 1000, 11, us_gaps, sizeof(us_gaps) / sizeof(*us_gaps));
+
+    events_t events;
+    waveform_play(&waveform, /* bool is_repeating = */ false, 300 * 1000, &events);
+    TEST_ASSERT_EQUAL(1, events.num_events);
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_PRESS, events.events[0].type);
+    TEST_ASSERT_EQUAL(5 * 1000, events.events[0].us_time);
+}
+
+static void test_glitches_are_ignored()
+{
+    // Pulses shorter than the debounce time, and shorter than a sample, are not presses
+    static const uint32_t us_short_gaps[] = {20};
+    static const uint32_t us_long_gaps[] = {TEST_US_DEBOUNCE - 5000};
+    waveform_t waveform = {};
+    waveform_add_bounce(&waveform, 10 * 1000, 2, us_short_gaps, 1);
+    waveform_add_bounce(&waveform, 100 * 1000, 2, us_long_gaps, 1);
+
+    events_t events;
+    waveform_play(&waveform, /* bool is_repeating = */ false, 300 * 1000, &events);
+    TEST_ASSERT_EQUAL(0, events.num_events);
+}
+
+static void test_held_button_repeats()
+{
+    // Press with a bounce, and hold for 1.5 s, a repeating button repeats faster the longer it is held, then releases once
+    static const uint32_t us_gaps[] = {200, 900, 50};
+    waveform_t waveform = {};
+    waveform_add_bounce(&waveform, 10 * 1000, 5, us_gaps, sizeof(us_gaps) / sizeof(*us_gaps));
+    waveform_add_bounce(&waveform, 1510 * 1000, 5, us_gaps, sizeof(us_gaps) / sizeof(*us_gaps));
+
+    events_t events;
+    waveform_play(&waveform, /* bool is_repeating = */ true, 2000 * 1000, &events);
+    TEST_ASSERT_EQUAL(1, events_count(&events, BUTTON_EVENT_PRESS));
+    TEST_ASSERT_EQUAL(1, events_count(&events, BUTTON_EVENT_RELEASE));
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_PRESS, events.events[0].type);
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_RELEASE, events.events[events.num_events - 1].type);
+    // A held button is sampled instead of waiting for an interrupt, so its release is reported at the first sample that saw it
+    TEST_ASSERT_INT_WITHIN(TEST_US_SAMPLE_PERIOD, 1510 * 1000, events.events[events.num_events - 1].us_time);
+
+    // The first repeat comes BUTTON_US_REPEAT_DELAY after the press started, then each comes sooner than the last
+    TEST_ASSERT_GREATER_THAN(2, events_count(&events, BUTTON_EVENT_REPEAT));
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_REPEAT, events.events[1].type);
+    TEST_ASSERT_INT_WITHIN(TEST_US_SAMPLE_PERIOD, (10 * 1000) + BUTTON_US_REPEAT_DELAY, events.events[1].us_time);
+    for(size_t i = 3; i < events.num_events - 1; ++i)
+    {
+        int64_t us_period = events.events[i].us_time - events.events[i - 1].us_time;
+        int64_t us_period_last = events.events[i - 1].us_time - events.events[i - 2].us_time;
+        TEST_ASSERT_LESS_OR_EQUAL(us_period_last, us_period);
+        TEST_ASSERT_GREATER_OR_EQUAL(BUTTON_US_REPEAT_PERIOD_MIN, us_period);
+    }
+}
+
+static void test_press_while_already_down()
+{
+    // Starting from a button already held down, nothing is reported until it is let go
+    debounce_t debounce;
+    debounce_init(&debounce, TEST_US_DEBOUNCE, false);
+    debounce_reset(&debounce, /* bool is_down = */ true);
+
+    debounce_event_t event;
+    debounce.us_first_change = 0;
+    bool is_sampling = true;
+    int64_t us_time = 0;
+    for(; (true == is_sampling) && (us_time < (100 * 1000)); us_time += TEST_US_SAMPLE_PERIOD)
+    {
+        is_sampling = debounce_sample(&debounce, /* bool is_down = */ true, us_time, &event);
+        TEST_ASSERT_EQUAL(BUTTON_EVENT_NONE, event.type);
+    }
+    TEST_ASSERT_FALSE(is_sampling);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bouncy_press_and_release);
+    RUN_TEST(test_bounce_slower_than_sampling);
+    RUN_TEST(test_glitches_are_ignored);
+    RUN_TEST(test_held_button_repeats);
+    RUN_TEST(test_press_while_already_down);
+    return UNITY_END();
+}
\ No newline at end of file
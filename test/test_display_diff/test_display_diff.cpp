@@ -0,0 +1,172 @@
+// Include Unity test framework
+#include <unity.h>
+#include <string.h>
+
+// Include custom display diffing API
+#include "display_diff.h"
+
+// ====================================== //
+// Define useful constants and data types //
+// ====================================== //
+
+// Define the size of the simulated display, and how far apart changes may be to share a run, as in menu.h
+#define TEST_NUM_LINES 4
+#define TEST_NUM_COLS 20
+#define TEST_MAX_GAP_CHARS 1
+
+// A simulated display, and the runs and bytes the last frame sent to it
+typedef struct display_s {
+    char displayed[TEST_NUM_LINES][TEST_NUM_COLS];
+    bool is_valid;
+    display_run_t runs[TEST_NUM_LINES][TEST_NUM_COLS];
+    size_t num_runs[TEST_NUM_LINES];
+    size_t num_lcd_bytes;
+} display_t;
+
+// ================================== //
+// Functions for sending whole frames //
+// ================================== //
+
+// Diff every line of a frame against display, like Menu::update_display(), and return the total number of runs
+static size_t display_send_frame(
+    display_t *display,
+    const char *lines[TEST_NUM_LINES])
+{
+    size_t num_runs = 0;
+    display->num_lcd_bytes = 0;
+    for(size_t line_num = 0; line_num < TEST_NUM_LINES; ++line_num)
+    {
+        display->num_runs[line_num] = display_diff_line(
+            /* const char *line = */ lines[line_num],
+            /* size_t num_line_chars = */ strlen(lines[line_num]),
+            /* char *displayed_line = */ display->displayed[line_num],
+            /* size_t num_cols = */ TEST_NUM_COLS,
+            /* bool is_displayed_line_valid = */ display->is_valid,
+            /* size_t max_gap_chars = */ TEST_MAX_GAP_CHARS,
+            /* display_run_t *out_runs = */ display->runs[line_num]);
+        display->num_lcd_bytes += display_count_lcd_bytes(
+            /* const display_run_t *runs = */ display->runs[line_num],
+            /* size_t num_runs = */ display->num_runs[line_num]);
+        num_runs += display->num_runs[line_num];
+    }
+    display->is_valid = true;
+    return num_runs;
+}
+
+// Check a line of display shows str, padded with spaces to the full width
+static void display_assert_line(
+    const display_t *display,
+    size_t line_num,
+    const char *str)
+{
+    char expected[TEST_NUM_COLS];
+    memset(expected, ' ', sizeof(expected));
+    memcpy(expected, str, strlen(str));
+    TEST_ASSERT_EQUAL_MEMORY(expected, display->displayed[line_num], TEST_NUM_COLS);
+}
+
+// A menu frame, and the same frame a moment later
+static const char *frame_a[TEST_NUM_LINES] = {"- Moisture: 41.5%", "  Zone: 1", "  Water: 12.0 mL", "  Squeezes: 3"};
+static const char *frame_b[TEST_NUM_LINES] = {"- Moisture: 41.6%", "  Zone: 1", "  Water: 12.0 mL", "  Squeezes: 3"};
+
+// ============ //
+// Define tests //
+// ============ //
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// Nothing is known to be on the display before the first frame, so every line is sent whole
+static void test_first_frame_sends_every_line_whole()
+{
+    display_t display = {};
+    TEST_ASSERT_EQUAL_UINT32(TEST_NUM_LINES, display_send_frame(&display, frame_a));
+    for(size_t line_num = 0; line_num < TEST_NUM_LINES; ++line_num)
+    {
+        TEST_ASSERT_EQUAL_UINT32(1, display.num_runs[line_num]);
+        TEST_ASSERT_EQUAL_UINT32(0, display.runs[line_num][0].col);
+        TEST_ASSERT_EQUAL_UINT32(TEST_NUM_COLS, display.runs[line_num][0].num_chars);
+        display_assert_line(&display, line_num, frame_a[line_num]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(TEST_NUM_LINES * (1 + TEST_NUM_COLS), display.num_lcd_bytes);
+}
+
+// Sending the same frame again sends nothing
+static void test_unchanged_frame_sends_nothing()
+{
+    display_t display = {};
+    (void) display_send_frame(&display, frame_a);
+    TEST_ASSERT_EQUAL_UINT32(0, display_send_frame(&display, frame_a));
+    TEST_ASSERT_EQUAL_UINT32(0, display.num_lcd_bytes);
+}
+
+// One digit changing sends one cursor move and that digit
+static void test_single_char_change_sends_one_char()
+{
+    display_t display = {};
+    (void) display_send_frame(&display, frame_a);
+    TEST_ASSERT_EQUAL_UINT32(1, display_send_frame(&display, frame_b));
+    TEST_ASSERT_EQUAL_UINT32(1, display.num_runs[0]);
+    TEST_ASSERT_EQUAL_UINT32(strlen("- Moisture: 41."), display.runs[0][0].col);
+    TEST_ASSERT_EQUAL_UINT32(1, display.runs[0][0].num_chars);
+    TEST_ASSERT_EQUAL_UINT32(2, display.num_lcd_bytes);
+    display_assert_line(&display, 0, frame_b[0]);
+}
+
+// A line where every character changes is sent as one run
+static void test_full_line_change_sends_one_run()
+{
+    const char *frame_c[TEST_NUM_LINES] = {"- Moisture: 41.5%", "  Zone: 1", "  Water: 12.0 mL", "  Squeezes: 3"};
+    display_t display = {};
+    (void) display_send_frame(&display, frame_a);
+    frame_c[1] = "ABCDEFGHIJKLMNOPQRST";
+    TEST_ASSERT_EQUAL_UINT32(1, display_send_frame(&display, frame_c));
+    TEST_ASSERT_EQUAL_UINT32(1, display.num_runs[1]);
+    TEST_ASSERT_EQUAL_UINT32(0, display.runs[1][0].col);
+    TEST_ASSERT_EQUAL_UINT32(TEST_NUM_COLS, display.runs[1][0].num_chars);
+    TEST_ASSERT_EQUAL_UINT32(1 + TEST_NUM_COLS, display.num_lcd_bytes);
+    display_assert_line(&display, 1, frame_c[1]);
+}
+
+// Changes with up to TEST_MAX_GAP_CHARS unchanged characters between them share a run, further apart they do not,
+// and a line getting shorter rewrites what it used to show with spaces
+static void test_runs_bridge_small_gaps_and_pad_short_lines()
+{
+    const char *frame_c[TEST_NUM_LINES] = {"- Moisture: 41.5%", "  Zone: 1", "  Water: 12.0 mL", "  Squeezes: 3"};
+    display_t display = {};
+    (void) display_send_frame(&display, frame_a);
+    // Change columns 2 and 4, one unchanged character apart, and columns 9 and 12, two apart
+    frame_c[0] = "- xoxsturx: x1.5%";
+    // Drop " mL", the space already matches the padding so only "mL" is rewritten
+    frame_c[2] = "  Water: 12.0";
+    TEST_ASSERT_EQUAL_UINT32(4, display_send_frame(&display, frame_c));
+    TEST_ASSERT_EQUAL_UINT32(3, display.num_runs[0]);
+    TEST_ASSERT_EQUAL_UINT32(2, display.runs[0][0].col);
+    TEST_ASSERT_EQUAL_UINT32(3, display.runs[0][0].num_chars);
+    TEST_ASSERT_EQUAL_UINT32(9, display.runs[0][1].col);
+    TEST_ASSERT_EQUAL_UINT32(1, display.runs[0][1].num_chars);
+    TEST_ASSERT_EQUAL_UINT32(12, display.runs[0][2].col);
+    TEST_ASSERT_EQUAL_UINT32(1, display.runs[0][2].num_chars);
+    TEST_ASSERT_EQUAL_UINT32(1, display.num_runs[2]);
+    TEST_ASSERT_EQUAL_UINT32(strlen("  Water: 12.0 "), display.runs[2][0].col);
+    TEST_ASSERT_EQUAL_UINT32(2, display.runs[2][0].num_chars);
+    TEST_ASSERT_EQUAL_UINT32((1 + 3) + (1 + 1) + (1 + 1) + (1 + 2), display.num_lcd_bytes);
+    display_assert_line(&display, 0, frame_c[0]);
+    display_assert_line(&display, 2, frame_c[2]);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_frame_sends_every_line_whole);
+    RUN_TEST(test_unchanged_frame_sends_nothing);
+    RUN_TEST(test_single_char_change_sends_one_char);
+    RUN_TEST(test_full_line_change_sends_one_run);
+    RUN_TEST(test_runs_bridge_small_gaps_and_pad_short_lines);
+    return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+// Include Unity test framework
+#include <unity.h>
+#include <new>
+#include <stdlib.h>
+
+// Include custom formatting API
+#include "format.h"
+
+// ======================================== //
+// Count heap allocations made during tests //
+// ======================================== //
+
+// The number of times operator new was called, so tests can check formatting never allocates
+static size_t num_allocations = 0;
+
+void *operator new(size_t size)
+{
+    ++num_allocations;
+    void *ptr = malloc((0 == size) ? 1 : size);
+    if(nullptr == ptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept
+{
+    (void) size;
+    free(ptr);
+}
+
+// ============ //
+// Define tests //
+// ============ //
+
+void setUp()
+{
+    num_allocations = 0;
+}
+
+void tearDown()
+{
+}
+
+static void test_format_uint_fits()
+{
+    char buf[10];
+    TEST_ASSERT_EQUAL(1, format_uint(buf, sizeof(buf), 0));
+    TEST_ASSERT_EQUAL_STRING_LEN("0", buf, 1);
+    TEST_ASSERT_EQUAL(3, format_uint(buf, sizeof(buf), 420));
+    TEST_ASSERT_EQUAL_STRING_LEN("420", buf, 3);
+    TEST_ASSERT_EQUAL(10, format_uint(buf, sizeof(buf), 4294967295u));
+    TEST_ASSERT_EQUAL_STRING_LEN("4294967295", buf, 10);
+}
+
+static void test_format_uint_overflow()
+{
+    // A number that does not fit fills what room there is with the overflow character, never a smaller number
+    char buf[4] = {'x', 'x', 'x', 'x'};
+    TEST_ASSERT_EQUAL(3, format_uint(buf, 3, 12345));
+    TEST_ASSERT_EQUAL_STRING_LEN("###x", buf, 4);
+    TEST_ASSERT_EQUAL(3, format_uint(buf, 3, 999));
+    TEST_ASSERT_EQUAL_STRING_LEN("999x", buf, 4);
+    TEST_ASSERT_EQUAL(3, format_uint(buf, 3, 1000));
+    TEST_ASSERT_EQUAL_STRING_LEN("###x", buf, 4);
+    TEST_ASSERT_EQUAL(0, format_uint(buf, 0, 7));
+}
+
+static void test_format_q8()
+{
+    char buf[10];
+    // 42.5 is 42 * 256 + 128
+    TEST_ASSERT_EQUAL(4, format_q8(buf, sizeof(buf), (42 * 256) + 128));
+    TEST_ASSERT_EQUAL_STRING_LEN("42.5", buf, 4);
+    // 9.96 rounds up to 10.0, not 9.10
+    TEST_ASSERT_EQUAL(4, format_q8(buf, sizeof(buf), (9 * 256) + 246));
+    TEST_ASSERT_EQUAL_STRING_LEN("10.0", buf, 4);
+    // The largest value does not overflow while rounding
+    TEST_ASSERT_EQUAL(10, format_q8(buf, sizeof(buf), 4294967295u));
+    TEST_ASSERT_EQUAL_STRING_LEN("16777216.0", buf, 10);
+}
+
+static void test_format_tenths_overflow()
+{
+    // A decimal that does not fit is all overflow characters, not its whole part with the point or decimal place cut off
+    char buf[4];
+    TEST_ASSERT_EQUAL(3, format_q8(buf, 3, (12 * 256) + 128));
+    TEST_ASSERT_EQUAL_STRING_LEN("###", buf, 3);
+    TEST_ASSERT_EQUAL(4, format_q8(buf, 4, (12 * 256) + 128));
+    TEST_ASSERT_EQUAL_STRING_LEN("12.5", buf, 4);
+    TEST_ASSERT_EQUAL(3, format_milli(buf, 3, 12500));
+    TEST_ASSERT_EQUAL_STRING_LEN("###", buf, 3);
+    TEST_ASSERT_EQUAL(3, format_milli(buf, 3, 1450));
+    TEST_ASSERT_EQUAL_STRING_LEN("1.5", buf, 3);
+}
+
+static void test_format_line_without_allocating()
+{
+    // Build a menu line the way Context::str_* do, chaining calls into a fixed-width slice of the display buffer
+    char line[20];
+    size_t num_chars = format_str(line, sizeof(line), "Current: ");
+    num_chars += format_q8(line + num_chars, sizeof(line) - num_chars, (31 * 256) + 64);
+    num_chars += format_str(line + num_chars, sizeof(line) - num_chars, "% ");
+    num_chars += format_milli(line + num_chars, sizeof(line) - num_chars, 2500);
+    num_chars += format_str(line + num_chars, sizeof(line) - num_chars, "ml");
+    TEST_ASSERT_EQUAL(20, num_chars);
+    TEST_ASSERT_EQUAL_STRING_LEN("Current: 31.3% 2.5ml", line, 20);
+
+    // Running past the end of the line writes nothing more
+    num_chars += format_uint(line + num_chars, sizeof(line) - num_chars, 12345);
+    TEST_ASSERT_EQUAL(20, num_chars);
+    TEST_ASSERT_EQUAL(0, num_allocations);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_format_uint_fits);
+    RUN_TEST(test_format_uint_overflow);
+    RUN_TEST(test_format_q8);
+    RUN_TEST(test_format_tenths_overflow);
+    RUN_TEST(test_format_line_without_allocating);
+    return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+// Include Unity test framework
+#include <unity.h>
+
+// Include custom sample reduction API
+#include "sensor_reduce.h"
+
+// ====================================== //
+// Define useful constants and data types //
+// ====================================== //
+
+// Define the true value of the synthetic burst, the most its samples are off by, and how many samples it has
+#define TEST_TRUE_VALUE 2000
+#define TEST_MAX_NOISE 40
+#define TEST_NUM_SAMPLES 64
+// Define how many samples of the synthetic burst are spikes to the ends of the ADC's range
+#define TEST_NUM_SPIKES 8
+
+// Fill samples with a burst of TEST_TRUE_VALUE, off by up to TEST_MAX_NOISE, with TEST_NUM_SPIKES of them spiking to 0 or 4095
+// NOTE: The noise comes from a fixed linear congruential generator, so the test is the same every run
+static void fill_burst(uint16_t *samples)
+{
+    uint32_t state = 12345;
+    for(size_t i = 0; i < TEST_NUM_SAMPLES; ++i)
+    {
+        state = (state * 1103515245) + 12345;
+        int32_t noise = (int32_t) ((state >> 16) % ((2 * TEST_MAX_NOISE) + 1)) - TEST_MAX_NOISE;
+        samples[i] = (uint16_t) (TEST_TRUE_VALUE + noise);
+    }
+    for(size_t i = 0; i < TEST_NUM_SPIKES; ++i)
+    {
+        samples[(i * TEST_NUM_SAMPLES) / TEST_NUM_SPIKES] = (0 == (i % 2)) ? 4095 : 0;
+    }
+}
+
+// ============ //
+// Define tests //
+// ============ //
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// The median is the middle sample, or the middle two rounded together
+static void test_median_of_odd_and_even_bursts()
+{
+    uint16_t value = 0;
+    uint16_t noise = 0;
+
+    uint16_t odd[] = {30, 10, 50, 20, 40};
+    sensor_reduce_samples(odd, 5, SENSOR_REDUCTION_MEDIAN, &value, &noise);
+    TEST_ASSERT_EQUAL_UINT16(30, value);
+
+    uint16_t even[] = {40, 10, 21, 30};
+    sensor_reduce_samples(even, 4, SENSOR_REDUCTION_MEDIAN, &value, &noise);
+    TEST_ASSERT_EQUAL_UINT16(26, value);
+
+    uint16_t single[] = {1234};
+    sensor_reduce_samples(single, 1, SENSOR_REDUCTION_MEDIAN, &value, &noise);
+    TEST_ASSERT_EQUAL_UINT16(1234, value);
+    TEST_ASSERT_EQUAL_UINT16(0, noise);
+}
+
+// The trimmed mean averages the middle half, so the lowest and highest quarter can be anything
+static void test_trimmed_mean_ignores_outer_quarters()
+{
+    uint16_t value = 0;
+    uint16_t noise = 0;
+    uint16_t samples[] = {4095, 100, 0, 102, 101, 4095, 103, 0};
+    sensor_reduce_samples(samples, 8, SENSOR_REDUCTION_TRIMMED_MEAN, &value, &noise);
+    // The middle half is 100, 101, 102, 103, which averages to 101.5, rounded up
+    TEST_ASSERT_EQUAL_UINT16(102, value);
+}
+
+// The noise is half the range from the first to the third quartile
+static void test_noise_is_semi_interquartile_range()
+{
+    uint16_t value = 0;
+    uint16_t noise = 0;
+    uint16_t samples[] = {0, 10, 20, 30, 40, 50, 60, 4095};
+    sensor_reduce_samples(samples, 8, SENSOR_REDUCTION_MEDIAN, &value, &noise);
+    // Quartiles are at indexes 2 and 6 of the sorted samples, 20 and 60
+    TEST_ASSERT_EQUAL_UINT16(20, noise);
+}
+
+// A noisy burst with spikes reduces to within a few counts of its true value,
+// even though single samples from it, like one analogRead() would give, are off by up to the whole range
+static void test_noisy_burst_with_spikes_reduces_close_to_true_value()
+{
+    uint16_t samples[TEST_NUM_SAMPLES];
+    uint16_t value = 0;
+    uint16_t noise = 0;
+
+    fill_burst(samples);
+    sensor_reduce_samples(samples, TEST_NUM_SAMPLES, SENSOR_REDUCTION_MEDIAN, &value, &noise);
+    TEST_ASSERT_UINT16_WITHIN(TEST_MAX_NOISE / 4, TEST_TRUE_VALUE, value);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(TEST_MAX_NOISE, noise);
+
+    fill_burst(samples);
+    sensor_reduce_samples(samples, TEST_NUM_SAMPLES, SENSOR_REDUCTION_TRIMMED_MEAN, &value, &noise);
+    TEST_ASSERT_UINT16_WITHIN(TEST_MAX_NOISE / 4, TEST_TRUE_VALUE, value);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_median_of_odd_and_even_bursts);
+    RUN_TEST(test_trimmed_mean_ignores_outer_quarters);
+    RUN_TEST(test_noise_is_semi_interquartile_range);
+    RUN_TEST(test_noisy_burst_with_spikes_reduces_close_to_true_value);
+    return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+// Include Unity test framework
+#include <unity.h>
+#include <thread>
+#include <chrono>
+#include <time.h>
+
+// Include custom lock-free snapshot API
+#include "seqlock.h"
+
+// ====================================== //
+// Define useful constants and data types //
+// ====================================== //
+
+// Define how long, in milliseconds, writers and readers race each other
+#define TEST_MS_STRESS 2000
+// Define the number of writers and of readers racing each other
+#define TEST_NUM_WRITERS 2
+#define TEST_NUM_READERS 2
+// Define the number of words in the snapshot past its Context fields, so it is about the size of context_snapshot_t
+#define TEST_NUM_EXTRA_WORDS 24
+
+// A snapshot shaped like context_snapshot_t, every field is set from the same counter, so a read mixing two stores can be spotted
+typedef struct test_snapshot_s {
+    uint16_t current_soil_moisture;
+    uint16_t desired_soil_moisture;
+    uint32_t minute_soil_moisture_check_freq;
+    time_t time_last_soil_moisture_check;
+    time_t time_next_soil_moisture_check;
+    uint32_t extra_words[TEST_NUM_EXTRA_WORDS];
+} test_snapshot_t;
+
+// What each writer or reader counted
+typedef struct stress_counts_s {
+    uint64_t num_ops;
+    uint64_t num_torn_reads;
+    uint64_t num_sequences_odd;
+    uint64_t num_sequences_backwards;
+} stress_counts_t;
+
+// Set every field of snapshot from value
+static void test_snapshot_set(
+    test_snapshot_t *snapshot,
+    uint32_t value)
+{
+    snapshot->current_soil_moisture = (uint16_t) value;
+    snapshot->desired_soil_moisture = (uint16_t) value;
+    snapshot->minute_soil_moisture_check_freq = value;
+    snapshot->time_last_soil_moisture_check = (time_t) value;
+    snapshot->time_next_soil_moisture_check = (time_t) value;
+    for(size_t i = 0; i < TEST_NUM_EXTRA_WORDS; ++i)
+    {
+        snapshot->extra_words[i] = value;
+    }
+}
+
+// Get whether every field of snapshot was set from the same value
+static bool test_snapshot_is_whole(const test_snapshot_t *snapshot)
+{
+    uint32_t value = snapshot->minute_soil_moisture_check_freq;
+    bool is_whole = (snapshot->current_soil_moisture == (uint16_t) value) &&
+        (snapshot->desired_soil_moisture == (uint16_t) value) &&
+        (snapshot->time_last_soil_moisture_check == (time_t) value) &&
+        (snapshot->time_next_soil_moisture_check == (time_t) value);
+    for(size_t i = 0; i < TEST_NUM_EXTRA_WORDS; ++i)
+    {
+        is_whole &= (snapshot->extra_words[i] == value);
+    }
+    return is_whole;
+}
+
+// ============ //
+// Define tests //
+// ============ //
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_load_returns_last_store()
+{
+    Seqlock<test_snapshot_t> snapshot;
+    test_snapshot_t cpy;
+
+    // Nothing stored yet reads as all zeros, at sequence 0
+    TEST_ASSERT_EQUAL(0, snapshot.load(&cpy));
+    TEST_ASSERT_TRUE(test_snapshot_is_whole(&cpy));
+    TEST_ASSERT_EQUAL(0, cpy.minute_soil_moisture_check_freq);
+
+    // Every store bumps the sequence by 2
+    test_snapshot_t new_snapshot;
+    test_snapshot_set(&new_snapshot, 42);
+    snapshot.store(&new_snapshot);
+    TEST_ASSERT_EQUAL(2, snapshot.load(&cpy));
+    TEST_ASSERT_EQUAL(42, cpy.minute_soil_moisture_check_freq);
+    TEST_ASSERT_TRUE(test_snapshot_is_whole(&cpy));
+    test_snapshot_set(&new_snapshot, 43);
+    snapshot.store(&new_snapshot);
+    TEST_ASSERT_EQUAL(4, snapshot.load(&cpy));
+    TEST_ASSERT_EQUAL(43, cpy.minute_soil_moisture_check_freq);
+}
+
+static void test_concurrent_readers_never_see_torn_values()
+{
+    static Seqlock<test_snapshot_t> snapshot;
+    static stress_counts_t counts[TEST_NUM_WRITERS + TEST_NUM_READERS];
+    static volatile bool is_running;
+    is_running = true;
+
+    // Each writer stores different values, so writers racing each other also show up as torn reads
+    std::thread threads[TEST_NUM_WRITERS + TEST_NUM_READERS];
+    for(size_t i = 0; i < TEST_NUM_WRITERS; ++i)
+    {
+        counts[i] = {};
+        threads[i] = std::thread([i]() {
+            test_snapshot_t new_snapshot;
+            for(uint32_t n = 1; true == is_running; ++n)
+            {
+                test_snapshot_set(&new_snapshot, (n * TEST_NUM_WRITERS) + (uint32_t) i);
+                snapshot.store(&new_snapshot);
+                ++counts[i].num_ops;
+            }
+        });
+    }
+
+    // Each reader checks every load is whole, and that sequence numbers are even and never go backwards
+    for(size_t i = TEST_NUM_WRITERS; i < (TEST_NUM_WRITERS + TEST_NUM_READERS); ++i)
+    {
+        counts[i] = {};
+        threads[i] = std::thread([i]() {
+            test_snapshot_t cpy;
+            uint32_t sequence_last = 0;
+            while(true == is_running)
+            {
+                uint32_t sequence = snapshot.load(&cpy);
+                counts[i].num_torn_reads += (false == test_snapshot_is_whole(&cpy)) ? 1 : 0;
+                counts[i].num_sequences_odd += (0 != (sequence & 1)) ? 1 : 0;
+                counts[i].num_sequences_backwards += (sequence < sequence_last) ? 1 : 0;
+                sequence_last = sequence;
+                ++counts[i].num_ops;
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(TEST_MS_STRESS));
+    is_running = false;
+    for(size_t i = 0; i < (TEST_NUM_WRITERS + TEST_NUM_READERS); ++i)
+    {
+        threads[i].join();
+    }
+
+    // Both sides must actually have run, or nothing was raced
+    for(size_t i = 0; i < (TEST_NUM_WRITERS + TEST_NUM_READERS); ++i)
+    {
+        TEST_ASSERT_GREATER_THAN(0, counts[i].num_ops);
+        TEST_ASSERT_EQUAL(0, counts[i].num_torn_reads);
+        TEST_ASSERT_EQUAL(0, counts[i].num_sequences_odd);
+        TEST_ASSERT_EQUAL(0, counts[i].num_sequences_backwards);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_load_returns_last_store);
+    RUN_TEST(test_concurrent_readers_never_see_torn_values);
+    return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,210 @@
+// Include Unity test framework
+#include <unity.h>
+
+// Include custom servo budget API
+#include "servo_budget.h"
+
+// ====================================== //
+// Define useful constants and data types //
+// ====================================== //
+
+// Define the number of simulated servos, how many squirts each is asked for at once, and the stagger, in milliseconds, between starts
+#define TEST_NUM_SERVOS 4
+#define TEST_NUM_SQUIRTS 3
+#define TEST_MS_STAGGER 50
+// Define how long, in milliseconds, each part of a simulated squirt takes, as servo_profile_t does
+#define TEST_MS_SQUEEZE 300
+#define TEST_MS_HOLD 200
+#define TEST_MS_RELEASE 300
+#define TEST_MS_REST 100
+// Define the resolution, in microseconds, of the virtual clock
+#define TEST_US_STEP 1000
+
+// What a simulated servo is doing
+enum TEST_SERVO_PHASE_t : uint8_t
+{
+    TEST_SERVO_PHASE_WAIT = 0,
+    TEST_SERVO_PHASE_SQUEEZE,
+    TEST_SERVO_PHASE_HOLD,
+    TEST_SERVO_PHASE_RELEASE,
+    TEST_SERVO_PHASE_REST,
+    TEST_SERVO_PHASE_DONE
+};
+
+// A simulated servo, squirting the way ServoMotor::squirt does
+typedef struct test_servo_s {
+    TEST_SERVO_PHASE_t phase;
+    // When, on the virtual clock, its phase ends
+    int64_t us_phase_end;
+    uint32_t num_squirts_left;
+} test_servo_t;
+
+// Squirt TEST_NUM_SERVOS simulated servos TEST_NUM_SQUIRTS times each, sharing a budget of max_moving, on a virtual clock,
+// checking at every step that no more than max_moving servos are squeezing, holding, or releasing, and that starts keep to the stagger
+// Returns when, on the virtual clock, every servo was done, and the most servos seen squeezing at once in out_max_moving_seen
+static int64_t test_squirt_servos(
+    uint8_t max_moving,
+    uint8_t *out_max_moving_seen)
+{
+    servo_budget_t budget;
+    servo_budget_init(
+        /* servo_budget_t *budget = */ &budget,
+        /* uint8_t max_moving = */ max_moving,
+        /* uint32_t ms_stagger = */ TEST_MS_STAGGER);
+    test_servo_t servos[TEST_NUM_SERVOS];
+    for(size_t i = 0; i < TEST_NUM_SERVOS; ++i)
+    {
+        servos[i] = {TEST_SERVO_PHASE_WAIT, 0, TEST_NUM_SQUIRTS};
+    }
+
+    *out_max_moving_seen = 0;
+    int64_t us_last_start = 0;
+    bool is_started = false;
+    size_t num_done = 0;
+    int64_t us_time = 0;
+    for(; num_done < TEST_NUM_SERVOS; us_time += TEST_US_STEP)
+    {
+        // End the parts of squirts that are over first, so a squeeze ending now makes room for one starting now
+        for(size_t i = 0; i < TEST_NUM_SERVOS; ++i)
+        {
+            test_servo_t *servo = &servos[i];
+            if((TEST_SERVO_PHASE_WAIT == servo->phase) || (TEST_SERVO_PHASE_DONE == servo->phase) || (us_time < servo->us_phase_end))
+            {
+                continue;
+            }
+            switch(servo->phase)
+            {
+                case TEST_SERVO_PHASE_SQUEEZE:
+                    servo->phase = TEST_SERVO_PHASE_HOLD;
+                    servo->us_phase_end = us_time + ((int64_t) TEST_MS_HOLD * 1000);
+                    break;
+                case TEST_SERVO_PHASE_HOLD:
+                    servo->phase = TEST_SERVO_PHASE_RELEASE;
+                    servo->us_phase_end = us_time + ((int64_t) TEST_MS_RELEASE * 1000);
+                    break;
+                case TEST_SERVO_PHASE_RELEASE:
+                    servo_budget_end(/* servo_budget_t *budget = */ &budget);
+                    servo->phase = TEST_SERVO_PHASE_REST;
+                    servo->us_phase_end = us_time + ((int64_t) TEST_MS_REST * 1000);
+                    break;
+                default:
+                    --servo->num_squirts_left;
+                    servo->phase = (0 == servo->num_squirts_left) ? TEST_SERVO_PHASE_DONE : TEST_SERVO_PHASE_WAIT;
+                    num_done += (0 == servo->num_squirts_left) ? 1 : 0;
+                    break;
+            }
+        }
+
+        // Then start the squeezes the budget has room for
+        for(size_t i = 0; i < TEST_NUM_SERVOS; ++i)
+        {
+            test_servo_t *servo = &servos[i];
+            if((TEST_SERVO_PHASE_WAIT != servo->phase) ||
+                (0 != servo_budget_try_start(/* servo_budget_t *budget = */ &budget, /* int64_t us_now = */ us_time)))
+            {
+                continue;
+            }
+            if(true == is_started)
+            {
+                TEST_ASSERT_GREATER_OR_EQUAL((int64_t) TEST_MS_STAGGER * 1000, us_time - us_last_start);
+            }
+            us_last_start = us_time;
+            is_started = true;
+            servo->phase = TEST_SERVO_PHASE_SQUEEZE;
+            servo->us_phase_end = us_time + ((int64_t) TEST_MS_SQUEEZE * 1000);
+        }
+
+        // Count the servos drawing current from the supply, a servo holding the squeeze angle pushes against the bottle
+        uint8_t num_squeezing = 0;
+        for(size_t i = 0; i < TEST_NUM_SERVOS; ++i)
+        {
+            num_squeezing += ((TEST_SERVO_PHASE_SQUEEZE <= servos[i].phase) && (TEST_SERVO_PHASE_RELEASE >= servos[i].phase)) ? 1 : 0;
+        }
+        TEST_ASSERT_LESS_OR_EQUAL(max_moving, num_squeezing);
+        TEST_ASSERT_EQUAL(num_squeezing, budget.num_moving);
+        *out_max_moving_seen = (num_squeezing > *out_max_moving_seen) ? num_squeezing : *out_max_moving_seen;
+    }
+    return us_time;
+}
+
+// ============ //
+// Define tests //
+// ============ //
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_try_start_keeps_to_budget_and_stagger()
+{
+    servo_budget_t budget;
+    servo_budget_init(&budget, /* uint8_t max_moving = */ 2, /* uint32_t ms_stagger = */ TEST_MS_STAGGER);
+
+    // The first squeeze is not held back, the next waits out the stagger
+    TEST_ASSERT_EQUAL(0, servo_budget_try_start(&budget, 0));
+    TEST_ASSERT_EQUAL(40 * 1000, servo_budget_try_start(&budget, 10 * 1000));
+    TEST_ASSERT_EQUAL(0, servo_budget_try_start(&budget, 50 * 1000));
+    TEST_ASSERT_EQUAL(2, budget.num_moving);
+
+    // Past the budget, nothing starts until a squeeze ends, however long it waits
+    TEST_ASSERT_EQUAL(SERVO_BUDGET_FULL, servo_budget_try_start(&budget, 10 * 1000 * 1000));
+    servo_budget_end(&budget);
+    TEST_ASSERT_EQUAL(1, budget.num_moving);
+    TEST_ASSERT_EQUAL(0, servo_budget_try_start(&budget, 10 * 1000 * 1000));
+    TEST_ASSERT_EQUAL(2, budget.num_moving);
+}
+
+static void test_init_and_end_are_clamped()
+{
+    // A budget of 0 would never let a servo squeeze, it lets one
+    servo_budget_t budget;
+    servo_budget_init(&budget, /* uint8_t max_moving = */ 0, /* uint32_t ms_stagger = */ 0);
+    TEST_ASSERT_EQUAL(1, budget.max_moving);
+    TEST_ASSERT_EQUAL(0, servo_budget_try_start(&budget, 0));
+    TEST_ASSERT_EQUAL(SERVO_BUDGET_FULL, servo_budget_try_start(&budget, 0));
+
+    // Ending more squeezes than started does not make room for more than the budget
+    servo_budget_end(&budget);
+    servo_budget_end(&budget);
+    TEST_ASSERT_EQUAL(0, budget.num_moving);
+    TEST_ASSERT_EQUAL(0, servo_budget_try_start(&budget, 0));
+    TEST_ASSERT_EQUAL(SERVO_BUDGET_FULL, servo_budget_try_start(&budget, 0));
+}
+
+static void test_squirts_keep_to_budget_through_hold()
+{
+    // Every budget is used up, and a bigger budget is never slower
+    int64_t us_taken_last = INT64_MAX;
+    for(uint8_t max_moving = 1; max_moving <= TEST_NUM_SERVOS; ++max_moving)
+    {
+        uint8_t max_moving_seen = 0;
+        int64_t us_taken = test_squirt_servos(max_moving, &max_moving_seen);
+        TEST_ASSERT_EQUAL(max_moving, max_moving_seen);
+        TEST_ASSERT_LESS_OR_EQUAL(us_taken_last, us_taken);
+        us_taken_last = us_taken;
+
+        // A budget of 1 squeezes, holds, and releases one servo at a time, only resting overlaps
+        if(1 == max_moving)
+        {
+            TEST_ASSERT_GREATER_OR_EQUAL((int64_t) TEST_NUM_SERVOS * TEST_NUM_SQUIRTS * (TEST_MS_SQUEEZE + TEST_MS_HOLD + TEST_MS_RELEASE) * 1000, us_taken);
+        }
+    }
+
+    // With room for every servo, they only wait for the stagger, a few milliseconds of each squirt
+    uint8_t max_moving_seen = 0;
+    int64_t us_taken = test_squirt_servos(TEST_NUM_SERVOS, &max_moving_seen);
+    TEST_ASSERT_LESS_THAN((int64_t) TEST_NUM_SQUIRTS * ((TEST_MS_SQUEEZE + TEST_MS_HOLD + TEST_MS_RELEASE + TEST_MS_REST) + (TEST_NUM_SERVOS * TEST_MS_STAGGER)) * 1000, us_taken);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_try_start_keeps_to_budget_and_stagger);
+    RUN_TEST(test_init_and_end_are_clamped);
+    RUN_TEST(test_squirts_keep_to_budget_through_hold);
+    return UNITY_END();
+}
\ No newline at end of file
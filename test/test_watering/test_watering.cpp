@@ -0,0 +1,342 @@
+// Include Unity test framework
+#include <unity.h>
+
+// Include custom watering model API
+#include "watering.h"
+
+// ====================================== //
+// Define useful constants and data types //
+// ====================================== //
+
+// Define the soil moisture readings of the simulated pot
+#define TEST_DRY_SOIL_MOISTURE CALIBRATION_PERCENT_Q8(5)
+#define TEST_DESIRED_SOIL_MOISTURE CALIBRATION_PERCENT_Q8(30)
+// Define the number of times the simulated pot dries out and is watered
+#define TEST_NUM_WATERINGS 10
+// Define the most reads a watering may take, so a model that stops dosing fails instead of hanging
+#define TEST_MAX_READS_PER_WATERING 100
+// Define the simulated pump's rate, in microlitres per second, and its shortest run, in milliseconds, as ACTUATOR_MS_MIN_PUMP_RUN
+#define TEST_PUMP_UL_PER_SEC 5000
+#define TEST_PUMP_MS_MIN_RUN 200
+
+// Define how far above desired watering leaves the simulated pot, when checking the schedule
+#define TEST_WATERED_SOIL_MOISTURE_RISE CALIBRATION_PERCENT_Q8(5)
+// Define how far each reading of the simulated pot is off, when checking the schedule
+#define TEST_SOIL_MOISTURE_NOISE CALIBRATION_PERCENT_Q8(0.15)
+// Define the fixed check frequency, in minutes, the adaptive schedule is compared against
+#define TEST_MINUTE_FIXED_CHECK_FREQ 60
+// Define the adaptive schedule's limits, in minutes
+#define TEST_MINUTE_MIN_CHECK_FREQ 15
+#define TEST_MINUTE_MAX_CHECK_FREQ (6 * 60)
+
+// A simulated pot, and how it responds to water
+typedef struct test_pot_s {
+    // The actuator's rate, in microlitres per unit (a squirt, or a second of running), and the least it doses
+    uint32_t ul_per_unit;
+    uint32_t ul_min_dose;
+    // The average rise in soil moisture per smallest dose, and how much each varies from it
+    uint16_t moisture_per_min_dose;
+    uint16_t moisture_per_min_dose_noise;
+    // The state of a linear congruential generator for noise, its quality does not matter here
+    uint32_t random_state;
+} test_pot_t;
+
+// How one simulated watering went
+typedef struct test_watering_s {
+    uint32_t num_reads;
+    uint32_t ul_watered;
+    // How far past the desired soil moisture it ended up
+    uint16_t overshoot;
+} test_watering_t;
+
+// How a simulated week of checking a pot went
+typedef struct test_week_s {
+    uint32_t num_reads;
+    uint32_t num_waterings;
+    // The furthest a reading was below desired when it was watered
+    uint32_t max_soil_moisture_past_desired;
+} test_week_t;
+
+// Get the most the smallest dose can raise the soil moisture of pot
+static uint16_t test_pot_max_moisture_per_min_dose(const test_pot_t *pot)
+{
+    return pot->moisture_per_min_dose + pot->moisture_per_min_dose_noise;
+}
+
+// Water pot from dry the way Context::step_water does, batching doses with dose_model, and learning from every batch
+static test_watering_t test_pot_water(
+    test_pot_t *pot,
+    dose_model_t *dose_model)
+{
+    test_watering_t watering = {};
+    uint16_t soil_moisture = TEST_DRY_SOIL_MOISTURE;
+    while((soil_moisture < TEST_DESIRED_SOIL_MOISTURE) && (watering.num_reads < TEST_MAX_READS_PER_WATERING))
+    {
+        uint32_t ul_batch = dose_model_predict(
+            /* const dose_model_t *dose_model = */ dose_model,
+            /* uint16_t current_soil_moisture = */ soil_moisture,
+            /* uint16_t desired_soil_moisture = */ TEST_DESIRED_SOIL_MOISTURE,
+            /* uint32_t ul_per_unit = */ pot->ul_per_unit,
+            /* uint32_t ul_min_dose = */ pot->ul_min_dose);
+        TEST_ASSERT_EQUAL(0, ul_batch % pot->ul_min_dose);
+        TEST_ASSERT_LESS_OR_EQUAL(CONTEXT_MAX_UNITS_PER_BATCH * pot->ul_per_unit, ul_batch);
+
+        uint16_t before_soil_moisture = soil_moisture;
+        for(uint32_t ul_dosed = 0; ul_dosed < ul_batch; ul_dosed += pot->ul_min_dose)
+        {
+            pot->random_state = (pot->random_state * 1103515245) + 12345;
+            int32_t noise = (int32_t) ((pot->random_state >> 16) % ((2 * pot->moisture_per_min_dose_noise) + 1)) - pot->moisture_per_min_dose_noise;
+            int32_t next_soil_moisture = (int32_t) soil_moisture + pot->moisture_per_min_dose + noise;
+            soil_moisture = (next_soil_moisture < CALIBRATION_MAX_PERCENT_Q8) ? (uint16_t) next_soil_moisture : CALIBRATION_MAX_PERCENT_Q8;
+        }
+        (void) dose_model_learn(
+            /* dose_model_t *dose_model = */ dose_model,
+            /* uint16_t before_soil_moisture = */ before_soil_moisture,
+            /* uint16_t after_soil_moisture = */ soil_moisture,
+            /* uint32_t ul_dosed = */ ul_batch);
+        ++watering.num_reads;
+        watering.ul_watered += ul_batch;
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(TEST_DESIRED_SOIL_MOISTURE, soil_moisture);
+    watering.overshoot = soil_moisture - TEST_DESIRED_SOIL_MOISTURE;
+    return watering;
+}
+
+// Simulate a week of checking a pot that dries soil_moisture_per_hour on average, 1.8x that at midday and 0.2x that at midnight,
+// on check_schedule, or every TEST_MINUTE_FIXED_CHECK_FREQ if it is not adaptive, watering it whenever a reading is below desired
+static test_week_t test_schedule_week(
+    const check_schedule_t *check_schedule,
+    uint32_t soil_moisture_per_hour)
+{
+    test_week_t week = {};
+    soil_moisture_history_t history = {};
+    // A fixed seed, so every run is the same
+    uint32_t random_state = 1;
+    // Keep the soil moisture in hundredths, so slow drying still adds up every minute
+    int32_t centi_soil_moisture = (TEST_DESIRED_SOIL_MOISTURE + TEST_WATERED_SOIL_MOISTURE_RISE) * 100;
+    uint32_t minute_next_check = 0;
+    for(uint32_t minute = 0; minute < (7 * 24 * 60); ++minute)
+    {
+        // Scale the drying rate from 1.8 at midday down to 0.2 at midnight, in tenths
+        int32_t minute_from_midday = (int32_t) (minute % (24 * 60)) - (12 * 60);
+        minute_from_midday = (minute_from_midday < 0) ? -minute_from_midday : minute_from_midday;
+        centi_soil_moisture -= (int32_t) (soil_moisture_per_hour * 100 * ((18 * 60) - ((minute_from_midday * 4) / 3))) / (10 * 60 * 60);
+        if(minute < minute_next_check)
+        {
+            continue;
+        }
+
+        // Read the soil moisture, with noise from a linear congruential generator, its quality does not matter here
+        random_state = (random_state * 1103515245) + 12345;
+        int32_t noise = (int32_t) ((random_state >> 16) % ((2 * TEST_SOIL_MOISTURE_NOISE) + 1)) - TEST_SOIL_MOISTURE_NOISE;
+        uint16_t soil_moisture = (uint16_t) ((centi_soil_moisture / 100) + noise);
+        soil_moisture_history_add(
+            /* soil_moisture_history_t *history = */ &history,
+            /* uint16_t soil_moisture = */ soil_moisture,
+            /* time_t time_reading = */ (time_t) minute * 60);
+        ++week.num_reads;
+
+        // Water it if it is too dry, and read it again, like Context::step_water does
+        if(soil_moisture < TEST_DESIRED_SOIL_MOISTURE)
+        {
+            uint32_t soil_moisture_past_desired = TEST_DESIRED_SOIL_MOISTURE - soil_moisture;
+            week.max_soil_moisture_past_desired = (soil_moisture_past_desired > week.max_soil_moisture_past_desired) ?
+                soil_moisture_past_desired :
+                week.max_soil_moisture_past_desired;
+            centi_soil_moisture = (TEST_DESIRED_SOIL_MOISTURE + TEST_WATERED_SOIL_MOISTURE_RISE) * 100;
+            soil_moisture_history_add(
+                /* soil_moisture_history_t *history = */ &history,
+                /* uint16_t soil_moisture = */ (uint16_t) (centi_soil_moisture / 100),
+                /* time_t time_reading = */ (time_t) minute * 60);
+            ++week.num_reads;
+            ++week.num_waterings;
+        }
+
+        minute_next_check = minute + ((true == check_schedule->is_adaptive) ?
+            soil_moisture_history_predict_minute_interval(
+                /* const soil_moisture_history_t *history = */ &history,
+                /* uint16_t desired_soil_moisture = */ TEST_DESIRED_SOIL_MOISTURE,
+                /* const check_schedule_t *check_schedule = */ check_schedule) :
+            TEST_MINUTE_FIXED_CHECK_FREQ);
+    }
+    return week;
+}
+
+// ============ //
+// Define tests //
+// ============ //
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_dose_model_predict()
+{
+    // Until enough has been learned, or once there, dose one unit
+    dose_model_t dose_model = {};
+    TEST_ASSERT_EQUAL(1000, dose_model_predict(&dose_model, CALIBRATION_PERCENT_Q8(10), CALIBRATION_PERCENT_Q8(30), 1000, 1000));
+    dose_model.moisture_per_ml = CALIBRATION_PERCENT_Q8(1);
+    dose_model.num_samples = CONTEXT_DOSE_MODEL_MIN_SAMPLES - 1;
+    TEST_ASSERT_EQUAL(1000, dose_model_predict(&dose_model, CALIBRATION_PERCENT_Q8(10), CALIBRATION_PERCENT_Q8(30), 1000, 1000));
+    dose_model.num_samples = CONTEXT_DOSE_MODEL_MIN_SAMPLES;
+    TEST_ASSERT_EQUAL(1000, dose_model_predict(&dose_model, CALIBRATION_PERCENT_Q8(30), CALIBRATION_PERCENT_Q8(30), 1000, 1000));
+
+    // Learned at 1% per ml, 5.5% to go is 5.5 ml, rounded down to whole smallest doses
+    TEST_ASSERT_EQUAL(5000, dose_model_predict(&dose_model, CALIBRATION_PERCENT_Q8(24.5), CALIBRATION_PERCENT_Q8(30), 1000, 1000));
+    TEST_ASSERT_EQUAL(5400, dose_model_predict(&dose_model, CALIBRATION_PERCENT_Q8(24.5), CALIBRATION_PERCENT_Q8(30), 5000, 200));
+    // Less than the smallest dose to go is still the smallest dose
+    TEST_ASSERT_EQUAL(1000, dose_model_predict(&dose_model, CALIBRATION_PERCENT_Q8(29.5), CALIBRATION_PERCENT_Q8(30), 1000, 1000));
+    // No more than CONTEXT_MAX_UNITS_PER_BATCH units at once
+    TEST_ASSERT_EQUAL(CONTEXT_MAX_UNITS_PER_BATCH * 1000, dose_model_predict(&dose_model, CALIBRATION_PERCENT_Q8(0), CALIBRATION_PERCENT_Q8(30), 1000, 1000));
+}
+
+static void test_dose_model_learn()
+{
+    // The first pair is taken as is, later ones move the average CONTEXT_DOSE_MODEL_WEIGHT of the way
+    dose_model_t dose_model = {};
+    TEST_ASSERT_TRUE(dose_model_learn(&dose_model, CALIBRATION_PERCENT_Q8(10), CALIBRATION_PERCENT_Q8(14), 2000));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, CALIBRATION_PERCENT_Q8(2), dose_model.moisture_per_ml);
+    TEST_ASSERT_TRUE(dose_model_learn(&dose_model, CALIBRATION_PERCENT_Q8(10), CALIBRATION_PERCENT_Q8(16), 2000));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, CALIBRATION_PERCENT_Q8(2) + (CONTEXT_DOSE_MODEL_WEIGHT * CALIBRATION_PERCENT_Q8(1)), dose_model.moisture_per_ml);
+    TEST_ASSERT_EQUAL(CONTEXT_DOSE_MODEL_MIN_SAMPLES, dose_model.num_samples);
+
+    // Readings that did not get wetter, or nothing dosed, teach nothing
+    dose_model_t learned = dose_model;
+    TEST_ASSERT_FALSE(dose_model_learn(&dose_model, CALIBRATION_PERCENT_Q8(16), CALIBRATION_PERCENT_Q8(16), 2000));
+    TEST_ASSERT_FALSE(dose_model_learn(&dose_model, CALIBRATION_PERCENT_Q8(16), CALIBRATION_PERCENT_Q8(15), 2000));
+    TEST_ASSERT_FALSE(dose_model_learn(&dose_model, CALIBRATION_PERCENT_Q8(10), CALIBRATION_PERCENT_Q8(16), 0));
+    TEST_ASSERT_EQUAL_FLOAT(learned.moisture_per_ml, dose_model.moisture_per_ml);
+}
+
+static void test_batched_squirts_reach_desired_without_going_past()
+{
+    // A servo squeezing a spray bottle, each squirt is one unit, and the smallest dose
+    test_pot_t pot = {
+        /* uint32_t ul_per_unit = */ 1000,
+        /* uint32_t ul_min_dose = */ 1000,
+        /* uint16_t moisture_per_min_dose = */ CALIBRATION_PERCENT_Q8(0.7),
+        /* uint16_t moisture_per_min_dose_noise = */ CALIBRATION_PERCENT_Q8(0.12),
+        /* uint32_t random_state = */ 1
+    };
+    dose_model_t dose_model = {};
+    for(uint32_t watering_i = 0; watering_i < TEST_NUM_WATERINGS; ++watering_i)
+    {
+        test_watering_t watering = test_pot_water(&pot, &dose_model);
+
+        // Going past the desired soil moisture by less than a squirt can't be helped, more means a batch was too big
+        TEST_ASSERT_LESS_THAN(test_pot_max_moisture_per_min_dose(&pot), watering.overshoot);
+
+        // Once the model has learned, a watering takes a few batches, instead of a read for every squirt
+        if(watering_i > 0)
+        {
+            uint32_t num_squirts = watering.ul_watered / pot.ul_per_unit;
+            uint32_t num_min_batches = (num_squirts + CONTEXT_MAX_UNITS_PER_BATCH - 1) / CONTEXT_MAX_UNITS_PER_BATCH;
+            TEST_ASSERT_LESS_OR_EQUAL(num_min_batches + 2, watering.num_reads);
+        }
+    }
+}
+
+static void test_batched_pump_runs_reach_desired_without_going_past()
+{
+    // A pump, each second of running is one unit, and the shortest run is the smallest dose, the same water per ml as the servo's pot
+    test_pot_t pot = {
+        /* uint32_t ul_per_unit = */ TEST_PUMP_UL_PER_SEC,
+        /* uint32_t ul_min_dose = */ (TEST_PUMP_UL_PER_SEC * TEST_PUMP_MS_MIN_RUN) / 1000,
+        /* uint16_t moisture_per_min_dose = */ CALIBRATION_PERCENT_Q8(0.7),
+        /* uint16_t moisture_per_min_dose_noise = */ CALIBRATION_PERCENT_Q8(0.12),
+        /* uint32_t random_state = */ 1
+    };
+    dose_model_t dose_model = {};
+    for(uint32_t watering_i = 0; watering_i < TEST_NUM_WATERINGS; ++watering_i)
+    {
+        test_watering_t watering = test_pot_water(&pot, &dose_model);
+
+        // Going past the desired soil moisture by less than the shortest run can't be helped, more means a run was too long
+        TEST_ASSERT_LESS_THAN(test_pot_max_moisture_per_min_dose(&pot), watering.overshoot);
+
+        // Once the model has learned, a batch runs as long as it takes to get close, so a watering takes a couple of reads
+        if(watering_i > 0)
+        {
+            uint32_t num_min_batches = (watering.ul_watered + (CONTEXT_MAX_UNITS_PER_BATCH * pot.ul_per_unit) - 1) / (CONTEXT_MAX_UNITS_PER_BATCH * pot.ul_per_unit);
+            TEST_ASSERT_LESS_OR_EQUAL(num_min_batches + 2, watering.num_reads);
+        }
+    }
+}
+
+static void test_predict_minute_interval()
+{
+    check_schedule_t check_schedule = {
+        /* bool is_adaptive = */ true,
+        /* uint32_t minute_min_check_freq = */ TEST_MINUTE_MIN_CHECK_FREQ,
+        /* uint32_t minute_max_check_freq = */ TEST_MINUTE_MAX_CHECK_FREQ
+    };
+
+    // Too few readings to fit a line, check again soon
+    soil_moisture_history_t history = {};
+    soil_moisture_history_add(&history, CALIBRATION_PERCENT_Q8(40), 0);
+    soil_moisture_history_add(&history, CALIBRATION_PERCENT_Q8(39), 60 * 60);
+    TEST_ASSERT_EQUAL(TEST_MINUTE_MIN_CHECK_FREQ, soil_moisture_history_predict_minute_interval(&history, TEST_DESIRED_SOIL_MOISTURE, &check_schedule));
+
+    // Drying 1% an hour for 4 hours, 6% above desired is 6 hours away, only part of which is waited, and never longer than the readings span
+    for(uint32_t hour = 2; hour <= 4; ++hour)
+    {
+        soil_moisture_history_add(&history, CALIBRATION_PERCENT_Q8(40) - (hour * CALIBRATION_PERCENT_Q8(1)), hour * 60 * 60);
+    }
+    TEST_ASSERT_UINT_WITHIN(1, (uint32_t) (CONTEXT_PROJECTED_CHECK_SHARE * 6 * 60), soil_moisture_history_predict_minute_interval(&history, TEST_DESIRED_SOIL_MOISTURE, &check_schedule));
+    TEST_ASSERT_EQUAL(4 * 60, soil_moisture_history_predict_minute_interval(&history, CALIBRATION_PERCENT_Q8(20), &check_schedule));
+
+    // Watering starts the history over, and a night of not drying after it, a flat line, which alone would wait as long as
+    // the schedule allows, still only waits part of how long the fastest drying seen takes to reach desired
+    soil_moisture_history_add(&history, CALIBRATION_PERCENT_Q8(37.5), 5 * 60 * 60);
+    TEST_ASSERT_EQUAL(1, history.num_readings);
+    for(uint32_t hour = 7; hour <= 17; hour += 2)
+    {
+        soil_moisture_history_add(&history, CALIBRATION_PERCENT_Q8(37.5), hour * 60 * 60);
+    }
+    uint32_t minute_interval = soil_moisture_history_predict_minute_interval(&history, TEST_DESIRED_SOIL_MOISTURE, &check_schedule);
+    TEST_ASSERT_GREATER_THAN(TEST_MINUTE_MIN_CHECK_FREQ, minute_interval);
+    TEST_ASSERT_LESS_THAN(TEST_MINUTE_MAX_CHECK_FREQ, minute_interval);
+}
+
+static void test_adaptive_schedule_never_dries_past_fixed_schedule()
+{
+    // A pot drying slowly, about as fast as the fixed schedule was tuned for, and quickly
+    static const uint16_t soil_moistures_per_hour[] = {CALIBRATION_PERCENT_Q8(0.1), CALIBRATION_PERCENT_Q8(0.3), CALIBRATION_PERCENT_Q8(1)};
+    for(size_t i = 0; i < (sizeof(soil_moistures_per_hour) / sizeof(*soil_moistures_per_hour)); ++i)
+    {
+        check_schedule_t check_schedule = {
+            /* bool is_adaptive = */ false,
+            /* uint32_t minute_min_check_freq = */ TEST_MINUTE_MIN_CHECK_FREQ,
+            /* uint32_t minute_max_check_freq = */ TEST_MINUTE_MAX_CHECK_FREQ
+        };
+        test_week_t fixed = test_schedule_week(&check_schedule, soil_moistures_per_hour[i]);
+        check_schedule.is_adaptive = true;
+        test_week_t adaptive = test_schedule_week(&check_schedule, soil_moistures_per_hour[i]);
+
+        // Waiting longer between checks must not let the soil get drier than checking every hour does
+        TEST_ASSERT_GREATER_THAN(0, adaptive.num_waterings);
+        TEST_ASSERT_LESS_OR_EQUAL(fixed.max_soil_moisture_past_desired, adaptive.max_soil_moisture_past_desired);
+
+        // And it must save reads, unless the pot dries so fast that it needs checking more than hourly anyway
+        if(soil_moistures_per_hour[i] <= CALIBRATION_PERCENT_Q8(0.3))
+        {
+            TEST_ASSERT_LESS_THAN(fixed.num_reads, adaptive.num_reads);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_dose_model_predict);
+    RUN_TEST(test_dose_model_learn);
+    RUN_TEST(test_batched_squirts_reach_desired_without_going_past);
+    RUN_TEST(test_batched_pump_runs_reach_desired_without_going_past);
+    RUN_TEST(test_predict_minute_interval);
+    RUN_TEST(test_adaptive_schedule_never_dries_past_fixed_schedule);
+    return UNITY_END();
+}
\ No newline at end of file